@@ -0,0 +1,119 @@
+// 购物车保存路径的微基准：对比 SAVE_CART 直接把已解析的 cart 对象交给保存逻辑（现行实现），
+// 与旧实现的 “cart.dump() 再由 SERsaveCart 重新解析” 往返，统计每次保存的耗时与堆分配次数。
+// 存储后端为 MemoryStorage，两条路径都包含完整的保存逻辑（重算金额、写入存储）。
+// 计时前先建好购物车引用的商品（id 1..50）与购物车本身，计时循环只测更新已有购物车这一常见路径，
+// 并确认每条路径的响应都是成功，避免把错误分支或未命中的查找计入结果。
+//
+//   cmake -S . -B build -DHACHIMI_BUILD_BENCH=ON && cmake --build build --target hachimi-bench-cart
+//   ./build/hachimi-bench-cart [迭代次数]
+#include "Server.h"
+#include "MemoryStorage.h"
+#include "ServerMetrics.h"
+#include "logger.h"
+#include <QCoreApplication>
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// 全局分配计数：替换 operator new/delete，只计数不改变行为
+static std::atomic<uint64_t> allocations{ 0 };
+
+void* operator new(std::size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static const int MaxItems = 50;
+
+static nlohmann::json makeCart(int items) {
+    nlohmann::json cart;
+    cart["cart_id"] = "c20240101000000000_bench";
+    cart["shipping_address"] = "上海市浦东新区世纪大道 100 号";
+    cart["discount_policy"] = "";
+    nlohmann::json arr = nlohmann::json::array();
+    for (int i = 0; i < items; ++i) {
+        nlohmann::json it;
+        it["good_id"] = i + 1;
+        it["good_name"] = "商品-" + std::to_string(i + 1);
+        it["price"] = 9.5 + i;
+        it["quantity"] = 1 + i % 3;
+        arr.push_back(it);
+    }
+    cart["items"] = arr;
+    return cart;
+}
+
+struct Sample {
+    double usPerSave = 0.0;
+    double allocsPerSave = 0.0;
+};
+
+template <typename Fn>
+static Sample measure(int iterations, Fn&& fn) {
+    for (int i = 0; i < iterations / 10 + 1; ++i) fn(); // 预热
+    const uint64_t allocBefore = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) fn();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    Sample s;
+    s.usPerSave = std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+    s.allocsPerSave = static_cast<double>(allocations.load() - allocBefore) / iterations;
+    return s;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    Logger::instance().configure("warn");
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const std::string phone = "13800000000";
+
+    MemoryStorage* storage = new MemoryStorage("");
+    Server server(0, storage);
+    // 购物车引用的商品：MemoryStorage 的商品 id 从 1 开始自增，与 makeCart 中的 good_id 对应
+    for (int i = 0; i < MaxItems; ++i) {
+        Good g(0, "商品-" + std::to_string(i + 1), 9.5 + i, 1000000, "bench");
+        if (!storage->DTBsaveGood(g)) {
+            std::fprintf(stderr, "setup: failed to seed goods\n");
+            return 1;
+        }
+    }
+    auto expectSaved = [](const char* what, const std::string& resp) {
+        if (ServerMetrics::isErrorResponse(resp)) {
+            std::fprintf(stderr, "%s failed: %s\n", what, resp.c_str());
+            std::exit(1);
+        }
+    };
+    std::printf("%-6s %-14s %12s %14s\n", "items", "path", "us/save", "allocs/save");
+    for (int items : { 1, 10, MaxItems }) {
+        nlohmann::json body;
+        body["userPhone"] = phone;
+        body["cart"] = makeCart(items);
+        const std::string payload = body.dump();
+        const std::string request = "SAVE_CART " + payload;
+
+        // 先创建（或按本轮条目数重写）购物车，之后两条路径都是更新已有购物车
+        expectSaved("setup", server.SERprocessRequest(request));
+        expectSaved("dump+parse", server.SERsaveCart(phone, body["cart"].dump()));
+        expectSaved("direct", server.SERprocessRequest(request));
+
+        // 旧实现：命令层解析请求后 cart.dump()，SERsaveCart 再把文本解析回对象
+        Sample roundTrip = measure(iterations, [&]() {
+            nlohmann::json j = nlohmann::json::parse(payload);
+            std::string resp = server.SERsaveCart(phone, j["cart"].dump());
+        });
+        // 现行实现：经命令分发，解析一次后直接传递 cart 对象
+        Sample direct = measure(iterations, [&]() {
+            std::string resp = server.SERprocessRequest(request);
+        });
+        std::printf("%-6d %-14s %12.2f %14.1f\n", items, "dump+parse", roundTrip.usPerSave, roundTrip.allocsPerSave);
+        std::printf("%-6d %-14s %12.2f %14.1f\n", items, "direct", direct.usPerSave, direct.allocsPerSave);
+    }
+    return 0;
+}
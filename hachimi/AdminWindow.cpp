@@ -15,7 +15,10 @@
 #include <QDoubleSpinBox>
 #include <QApplication> // 用于切换主题
 #include <QDateTimeEdit> // 新增：用于订单筛选的日期时间选择
+#include <QScrollBar>
+#include <QTimer>
 #include "Theme.h"
+#include "UiHelpers.h"
 
 // 状态映射辅助函数
 static QString orderStatusToText(int status) {
@@ -30,73 +33,6 @@ static QString orderStatusToText(int status) {
     }
 }
 
-// 统一解析订单ID到 QDateTime（兼容 c*/o*，多种编码）
-static QDateTime parseOrderIdToDateTime(const QString& oid) {
-    QString s = oid.trimmed();
-    if (s.isEmpty()) return QDateTime();
-
-    // 去掉首字母前缀（c/o 等）
-    if (!s.isEmpty() && s.at(0).isLetter()) s = s.mid(1);
-
-    // 截到下划线前（若存在），通常 '_' 之后是随机串
-    int us = s.indexOf('_');
-    if (us > 0) s = s.left(us);
-
-    auto isAllDigits = [](const QString& t) {
-        for (QChar c : t) if (!c.isDigit()) return false;
-        return true;
-        };
-
-    // 提取前缀连续数字串
-    int digits = 0;
-    while (digits < s.size() && s.at(digits).isDigit()) ++digits;
-    QString head = s.left(digits);
-
-    // 1) 17位 yyyyMMddHHmmsszzz
-    if (head.size() >= 17 && isAllDigits(head.left(17))) {
-        QDateTime dt = QDateTime::fromString(head.left(17), "yyyyMMddHHmmsszzz");
-        if (dt.isValid()) return dt.toLocalTime();
-    }
-
-    // 2) 14位 yyyyMMddHHmmss + 可选毫秒
-    if (head.size() >= 14 && isAllDigits(head.left(14))) {
-        QDateTime dt = QDateTime::fromString(head.left(14), "yyyyMMddHHmmss");
-        if (dt.isValid()) {
-            int ms = 0;
-            if (head.size() >= 17 && isAllDigits(head.mid(14, 3))) {
-                bool ok = false;
-                int v = head.mid(14, 3).toInt(&ok);
-                if (ok) ms = v;
-            }
-            dt = dt.addMSecs(ms);
-            return dt.toLocalTime();
-        }
-    }
-
-    // 3) epoch 毫秒（13位）或秒（10位）
-    if (head.size() >= 13 && isAllDigits(head.left(13))) {
-        bool ok = false;
-        qint64 ms = head.left(13).toLongLong(&ok);
-        if (ok) {
-            QDateTime dt = QDateTime::fromMSecsSinceEpoch(ms);
-            if (dt.isValid()) return dt.toLocalTime();
-        }
-    }
-    if (head.size() >= 10 && isAllDigits(head.left(10))) {
-        bool ok = false;
-        qint64 sec = head.left(10).toLongLong(&ok);
-        if (ok) {
-            QDateTime dt = QDateTime::fromSecsSinceEpoch(sec);
-            if (dt.isValid()) return dt.toLocalTime();
-        }
-    }
-
-    // 4) 尝试 ISO 格式（若订单ID中直接内嵌了 ISO 字符串）
-    QDateTime iso = QDateTime::fromString(s, Qt::ISODate);
-    if (iso.isValid()) return iso.toLocalTime();
-
-    return QDateTime();
-}
 // 判断系统当前是否为深色主题（基于 QPalette::Window 的 lightness）
 static bool isSystemDarkTheme() {
     QColor bg = qApp->palette().color(QPalette::Window);
@@ -171,16 +107,6 @@ static void applyTheme_AdminWindow(bool dark) {
     Logger::instance().info(std::string("AdminWindow: theme switched to ") + (dark ? "dark" : "light"));
 }
 
-// helper: case-insensitive substring
-static bool containsIC_admin(const std::string& haystack, const std::string& needle) {
-    if (needle.empty()) return true;
-    std::string h = haystack;
-    std::string n = needle;
-    std::transform(h.begin(), h.end(), h.begin(), ::tolower);
-    std::transform(n.begin(), n.end(), n.begin(), ::tolower);
-    return h.find(n) != std::string::npos;
-}
-
 // 节流实现：每秒最多允许一次（首次允许）
 bool AdminWindow::tryThrottle(QWidget* parent) {
     // 如果在构造/初始化阶段希望抑制节流弹窗则直接允许
@@ -446,11 +372,13 @@ AdminWindow::AdminWindow(Client* client, QWidget* parent)
     // 创建促销标签页
     createPromotionsTab();
 
-    // 首次加载 —— 允许批量内部刷新而不触发节流提示
-    refreshUsers();
-    refreshGoods();
-    refreshOrders();
-    refreshPromotions();
+    // 用户/商品/订单表滚动到底部附近时加载下一页
+    connect(usersTable->verticalScrollBar(), &QScrollBar::valueChanged, this, &AdminWindow::loadMoreUsers);
+    connect(goodsTable->verticalScrollBar(), &QScrollBar::valueChanged, this, &AdminWindow::loadMoreGoods);
+    connect(ordersTable->verticalScrollBar(), &QScrollBar::valueChanged, this, &AdminWindow::loadMoreOrders);
+
+    // 首次加载 —— 用户、商品、订单的第一页与促销以流水线方式一次发出（一次往返），结果返回后统一填表
+    refreshAllInternal();
 
     // 构造完成后恢复节流行为（用户交互才会被节流）
     suppressThrottle_ = false;
@@ -466,19 +394,174 @@ void AdminWindow::onReturnToIdentitySelection() {
     this->close();
 }
 
+// 用户、商品、订单（第一页）、促销四个请求带 id 同时发出，服务端可并行处理；在网络线程执行，返回后在 UI 线程填表
+void AdminWindow::refreshAllInternal() {
+    if (!client_) return;
+    struct Snapshot {
+        Client::AccountsPage users;
+        Client::GoodsPage goods;
+        Client::OrdersPage orders;
+        std::vector<nlohmann::json> promotions;
+    };
+    ordersFilter_ = currentOrderFilter();
+    const Client::OrderFilter filter = ordersFilter_;
+    goodsFilter_ = currentGoodsFilter();
+    const Client::GoodsFilter goodsFilter = goodsFilter_;
+    usersPhoneFilter_.clear();
+    resetPaging(usersPaging_, usersTable);
+    resetPaging(goodsPaging_, goodsTable);
+    resetPaging(ordersPaging_, ordersTable);
+    usersPaging_.loading = goodsPaging_.loading = ordersPaging_.loading = true;
+    const uint64_t usersSeq = usersPaging_.seq, goodsSeq = goodsPaging_.seq, ordersSeq = ordersPaging_.seq;
+    setButtonLoading(refreshOrdersBtn, true);
+    bool submitted = client_->CLTasync(this,
+        [filter, goodsFilter](Client& c) {
+            Client::Batch batch;
+            batch.getAccountsPage("", PageSize);
+            batch.getGoodsPage(0, PageSize, goodsFilter);
+            batch.queryOrders(filter, "", PageSize);
+            batch.getAllPromotions();
+            Client::BatchResult r = c.CLTpipeline(batch);
+            Snapshot snap;
+            snap.users = Client::CLTparseAccountsPage(r[0]);
+            snap.goods = Client::CLTparseGoodsPage(r[1]);
+            snap.orders = Client::CLTparseOrdersPage(r[2]);
+            snap.promotions = Client::CLTparsePromotionsRaw(r[3]);
+            fillMissingAddresses(c, snap.orders.items);
+            return snap;
+        },
+        [this, usersSeq, goodsSeq, ordersSeq](Snapshot snap) {
+            populatePromotions(snap.promotions);
+            if (usersSeq == usersPaging_.seq) {
+                usersPaging_.loading = false;
+                usersPaging_.hasMore = snap.users.hasMore;
+                usersPaging_.nextAfter = snap.users.nextAfter;
+                populateUsers(snap.users.items, true);
+                QTimer::singleShot(0, this, &AdminWindow::loadMoreUsers);
+            }
+            if (goodsSeq == goodsPaging_.seq) {
+                goodsPaging_.loading = false;
+                goodsPaging_.hasMore = snap.goods.hasMore;
+                goodsPaging_.nextAfter = std::to_string(snap.goods.nextAfter);
+                populateGoods(snap.goods.items, true);
+                QTimer::singleShot(0, this, &AdminWindow::loadMoreGoods);
+            }
+            if (ordersSeq != ordersPaging_.seq) return; // 订单已有更新的刷新请求
+            setButtonLoading(refreshOrdersBtn, false);
+            ordersPaging_.loading = false;
+            ordersPaging_.hasMore = snap.orders.hasMore;
+            ordersPaging_.nextAfter = snap.orders.nextAfter;
+            populateOrders(snap.orders.items, true);
+            QTimer::singleShot(0, this, &AdminWindow::loadMoreOrders);
+        });
+    if (!submitted) {
+        usersPaging_.loading = goodsPaging_.loading = ordersPaging_.loading = false;
+        setButtonLoading(refreshOrdersBtn, false);
+    }
+}
+
+// ---------------- 分页加载 ----------------
+void AdminWindow::resetPaging(PagingState& paging, QTableWidget* table) {
+    ++paging.seq;
+    paging.nextAfter.clear();
+    paging.loading = false;
+    paging.hasMore = false; // 清空表格时滚动条变化会触发 loadMore*，此时不应发起加载
+    if (table) table->setRowCount(0);
+    paging.hasMore = true;
+}
+
+// 滚动条距底部不足一屏（或表格内容不足一屏、没有滚动余量）时需要下一页
+static bool nearBottom(QTableWidget* table) {
+    const QScrollBar* sb = table->verticalScrollBar();
+    return sb->value() >= sb->maximum() - sb->pageStep();
+}
+
+// 每页填表后经事件循环再检查一次：表格布局更新后若仍未填满一屏则继续加载
+void AdminWindow::loadMoreUsers() {
+    if (!client_ || usersPaging_.loading || !usersPaging_.hasMore || !nearBottom(usersTable)) return;
+    usersPaging_.loading = true;
+    const uint64_t seq = usersPaging_.seq;
+    const bool firstSearchPage = !usersPhoneFilter_.empty() && usersPaging_.nextAfter.empty();
+    bool submitted = client_->CLTasync(this,
+        [after = usersPaging_.nextAfter, phone = usersPhoneFilter_](Client& c) { return c.CLTgetAccountsPage(after, PageSize, phone); },
+        [this, seq, firstSearchPage](Client::AccountsPage page) {
+            if (seq != usersPaging_.seq) return;
+            usersPaging_.loading = false;
+            usersPaging_.hasMore = page.hasMore;
+            usersPaging_.nextAfter = page.nextAfter;
+            populateUsers(page.items, true);
+            if (firstSearchPage && page.items.empty()) {
+                QMessageBox::information(this, "查询用户", "未找到匹配的用户");
+                return;
+            }
+            QTimer::singleShot(0, this, &AdminWindow::loadMoreUsers);
+        });
+    if (!submitted) usersPaging_.loading = false;
+}
+
+void AdminWindow::loadMoreGoods() {
+    if (!client_ || goodsPaging_.loading || !goodsPaging_.hasMore || !nearBottom(goodsTable)) return;
+    goodsPaging_.loading = true;
+    const uint64_t seq = goodsPaging_.seq;
+    const int afterId = goodsPaging_.nextAfter.empty() ? 0 : std::stoi(goodsPaging_.nextAfter);
+    bool submitted = client_->CLTasync(this,
+        [afterId, filter = goodsFilter_](Client& c) { return c.CLTgetGoodsPage(afterId, PageSize, filter); },
+        [this, seq](Client::GoodsPage page) {
+            if (seq != goodsPaging_.seq) return;
+            goodsPaging_.loading = false;
+            goodsPaging_.hasMore = page.hasMore;
+            goodsPaging_.nextAfter = std::to_string(page.nextAfter);
+            populateGoods(page.items, true);
+            QTimer::singleShot(0, this, &AdminWindow::loadMoreGoods);
+        });
+    if (!submitted) goodsPaging_.loading = false;
+}
+
+// 订单（及缺失的收货地址）在客户端网络线程拉取；第一页加载期间刷新按钮显示“加载中...”
+void AdminWindow::loadMoreOrders() {
+    if (!client_ || ordersPaging_.loading || !ordersPaging_.hasMore || !nearBottom(ordersTable)) return;
+    ordersPaging_.loading = true;
+    const uint64_t seq = ordersPaging_.seq;
+    const bool firstPage = ordersPaging_.nextAfter.empty();
+    if (firstPage) setButtonLoading(refreshOrdersBtn, true);
+    bool submitted = client_->CLTasync(this,
+        [after = ordersPaging_.nextAfter, filter = ordersFilter_](Client& c) {
+            Client::OrdersPage page = c.CLTqueryOrders(filter, after, PageSize);
+            fillMissingAddresses(c, page.items);
+            return page;
+        },
+        [this, seq, firstPage](Client::OrdersPage page) {
+            if (seq != ordersPaging_.seq) return; // 已有更新的刷新请求
+            if (firstPage) setButtonLoading(refreshOrdersBtn, false);
+            ordersPaging_.loading = false;
+            ordersPaging_.hasMore = page.hasMore;
+            ordersPaging_.nextAfter = page.nextAfter;
+            populateOrders(page.items, true);
+            QTimer::singleShot(0, this, &AdminWindow::loadMoreOrders);
+        });
+    if (!submitted) {
+        ordersPaging_.loading = false;
+        if (firstPage) setButtonLoading(refreshOrdersBtn, false);
+    }
+}
+
 // ---------------- 用户/商品/订单 已在之前文件中实现 ----------------
 void AdminWindow::refreshUsers() {
     if (!tryThrottle(this)) return;
-    usersTable->setRowCount(0);
-    if (!client_) return;
-    auto users = client_->CLTgetAllAccounts();
-    usersTable->setRowCount((int)users.size());
+    usersPhoneFilter_.clear();
+    resetPaging(usersPaging_, usersTable);
+    loadMoreUsers();
+}
+
+void AdminWindow::populateUsers(const std::vector<User>& users, bool append) {
+    const int base = append ? usersTable->rowCount() : 0;
+    usersTable->setRowCount(base + (int)users.size());
     for (int i = 0; i < (int)users.size(); ++i) {
         const User& u = users[i];
-        usersTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(u.getPhone())));
-        usersTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(u.getAddress())));
+        usersTable->setItem(base + i, 0, new QTableWidgetItem(QString::fromStdString(u.getPhone())));
+        usersTable->setItem(base + i, 1, new QTableWidgetItem(QString::fromStdString(u.getAddress())));
         // 显示明文密码（仅管理员视图），使用访问器获取密码
-        usersTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(u.getPassword())));
+        usersTable->setItem(base + i, 2, new QTableWidgetItem(QString::fromStdString(u.getPassword())));
     }
 }
 
@@ -487,7 +570,7 @@ void AdminWindow::onSearchUser() {
     Logger::instance().info("AdminWindow::onSearchUser called");
     if (!client_) return;
     bool ok;
-    QString phone = QInputDialog::getText(this, "查询用户", "手机号:", QLineEdit::Normal, "", &ok);
+    QString phone = QInputDialog::getText(this, "查询用户", "手机号（部分匹配）:", QLineEdit::Normal, "", &ok);
     if (!ok) return;
     phone = phone.trimmed();
     if (phone.isEmpty()) {
@@ -495,22 +578,11 @@ void AdminWindow::onSearchUser() {
         return;
     }
 
-    // 获取所有用户并在客户端筛选（服务端暂无按手机号单独查询的 API）
-    auto users = client_->CLTgetAllAccounts();
-    for (int i = 0; i < (int)users.size(); ++i) {
-        if (QString::fromStdString(users[i].getPhone()) == phone) {
-            // 找到：只显示这一行
-            usersTable->setRowCount(1);
-            const User& u = users[i];
-            usersTable->setItem(0, 0, new QTableWidgetItem(QString::fromStdString(u.getPhone())));
-            usersTable->setItem(0, 1, new QTableWidgetItem(QString::fromStdString(u.getAddress())));
-            usersTable->setItem(0, 2, new QTableWidgetItem(QString::fromStdString(u.getPassword())));
-            QMessageBox::information(this, "查询用户", "找到匹配用户，表格已过滤显示该用户。若要查看全部用户，请点击“刷新用户”。");
-            return;
-        }
-    }
-
-    QMessageBox::information(this, "查询用户", "未找到匹配的用户");
+    // 由服务端按手机号筛选（GET_ACCOUNTS_PAGE 的 phone 参数），表格只分页加载匹配的用户；
+    // 点击“刷新用户”恢复显示全部用户
+    usersPhoneFilter_ = phone.toStdString();
+    resetPaging(usersPaging_, usersTable);
+    loadMoreUsers();
 }
 
 void AdminWindow::onAddUser() {
@@ -600,41 +672,24 @@ void AdminWindow::onDeleteUser() {
 
 // ---------------- 商品管理 ----------------
 //
+// 名称、分类、价格筛选由服务端完成（GET_GOODS_PAGE 的筛选参数），各页只含匹配的商品
 void AdminWindow::refreshGoodsInternal() {
-    goodsTable->setRowCount(0);
-    if (!client_) return;
-    auto goods = client_->CLTgetAllGoods();
-
-    // 读取筛选条件（本地 UI 操作，不做节流）
-    std::string nameFilter;
-    double minPrice = 0.0;
-    double maxPrice = 1e18;
-    std::string categoryFilter;
-    if (goodsNameFilterEdit) nameFilter = goodsNameFilterEdit->text().toStdString();
-    if (priceMinSpin) minPrice = priceMinSpin->value();
-    if (priceMaxSpin) maxPrice = priceMaxSpin->value();
-    if (categoryFilterEdit) categoryFilter = categoryFilterEdit->text().toStdString();
-    if (maxPrice < minPrice) std::swap(minPrice, maxPrice);
-
-    // 过滤
-    std::vector<Good> filtered;
-    for (const auto& g : goods) {
-        if (!containsIC_admin(g.getName(), nameFilter)) continue;
-        if (!containsIC_admin(g.getCategory(), categoryFilter)) continue;
-        double p = g.getPrice();
-        if (p + 1e-9 < minPrice) continue;
-        if (p - 1e-9 > maxPrice) continue;
-        filtered.push_back(g);
-    }
-
-    goodsTable->setRowCount((int)filtered.size());
-    for (int i = 0; i < (int)filtered.size(); ++i) {
-        const Good& g = filtered[i];
-        goodsTable->setItem(i, 0, new QTableWidgetItem(QString::number(g.getId())));
-        goodsTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(g.getName())));
-        goodsTable->setItem(i, 2, new QTableWidgetItem(QString::number(g.getPrice())));
-        goodsTable->setItem(i, 3, new QTableWidgetItem(QString::number(g.getStock())));
-        goodsTable->setItem(i, 4, new QTableWidgetItem(QString::fromStdString(g.getCategory())));
+    goodsFilter_ = currentGoodsFilter();
+    resetPaging(goodsPaging_, goodsTable);
+    loadMoreGoods();
+}
+
+void AdminWindow::populateGoods(const std::vector<Good>& goods, bool append) {
+    if (!append) goodsTable->setRowCount(0);
+    const int base = goodsTable->rowCount();
+    goodsTable->setRowCount(base + (int)goods.size());
+    for (int i = 0; i < (int)goods.size(); ++i) {
+        const Good& g = goods[i];
+        goodsTable->setItem(base + i, 0, new QTableWidgetItem(QString::number(g.getId())));
+        goodsTable->setItem(base + i, 1, new QTableWidgetItem(QString::fromStdString(g.getName())));
+        goodsTable->setItem(base + i, 2, new QTableWidgetItem(QString::number(g.getPrice())));
+        goodsTable->setItem(base + i, 3, new QTableWidgetItem(QString::number(g.getStock())));
+        goodsTable->setItem(base + i, 4, new QTableWidgetItem(QString::fromStdString(g.getCategory())));
     }
 }
 
@@ -720,79 +775,74 @@ void AdminWindow::onClearGoodsFilter() {
 
 //
 // ---------------- 订单管理 ----------------
+// 订单（及缺失的收货地址）在客户端网络线程拉取，返回后在 UI 线程筛选并填表
 void AdminWindow::refreshOrders() {
     if (!tryThrottle(this)) return;
-    ordersTable->setRowCount(0);
     if (!client_) return;
+    // 手机号、状态与时间范围都由服务端筛选（QUERY_ORDERS），结果按订单号倒序分页
+    ordersFilter_ = currentOrderFilter();
+    resetPaging(ordersPaging_, ordersTable);
+    loadMoreOrders();
+}
 
-    // 管理员可以指定手机号（留空表示获取最近的订单集合）
-    QString phoneFilter = (ordersPhoneFilterEdit ? ordersPhoneFilterEdit->text().trimmed() : QString());
-
-    // 请求服务端：若 phoneFilter 为空则获取最近若干订单（服务端实现），否则按用户拉取
-    auto orders = client_->CLTgetAllOrders(phoneFilter.toStdString());
-
-    // 读取时间范围
-    QDateTime start = orderStartEdit ? orderStartEdit->dateTime() : QDateTime::fromSecsSinceEpoch(0);
-    QDateTime end = orderEndEdit ? orderEndEdit->dateTime() : QDateTime::currentDateTime().addYears(10);
+// 当前商品筛选控件对应的服务端查询条件；价格上限取控件最大值时视为不限
+Client::GoodsFilter AdminWindow::currentGoodsFilter() const {
+    Client::GoodsFilter filter;
+    if (goodsNameFilterEdit) filter.name = goodsNameFilterEdit->text().trimmed().toStdString();
+    if (categoryFilterEdit) filter.category = categoryFilterEdit->text().trimmed().toStdString();
+    if (priceMinSpin) filter.minPrice = priceMinSpin->value();
+    if (priceMaxSpin && priceMaxSpin->value() < priceMaxSpin->maximum()) filter.maxPrice = priceMaxSpin->value();
+    return filter;
+}
 
-    // 读取状态筛选（-1 表示全部）
-    int selStatus = -1;
+// 当前筛选控件对应的服务端查询条件（手机号留空表示全部用户）
+Client::OrderFilter AdminWindow::currentOrderFilter() const {
+    Client::OrderFilter filter;
+    if (ordersPhoneFilterEdit) filter.userPhone = ordersPhoneFilterEdit->text().trimmed().toStdString();
     if (ordersStatusFilter) {
         QVariant v = ordersStatusFilter->currentData();
-        if (v.isValid()) selStatus = v.toInt();
-    }
-
-    // 同样使用健壮的解析逻辑（注意：避免使用已弃用的 setTimeSpec）
-    auto parseOid = [](const std::string& oidStr) -> QDateTime {
-        QString oid = QString::fromStdString(oidStr).trimmed();
-        if (!oid.startsWith('c')) return QDateTime();
-        if (oid.size() < 18) return QDateTime();
-        QString sub = oid.mid(1, 17); // YYYYMMDDHHmmsszzz
-        QDateTime dt = QDateTime::fromString(sub, "yyyyMMddHHmmsszzz");
-        if (dt.isValid()) { dt = dt.toLocalTime(); return dt; }
-        QString datePart = sub.left(14);
-        QString msPart = sub.mid(14, 3);
-        QDateTime dt2 = QDateTime::fromString(datePart, "yyyyMMddHHmmss");
-        if (!dt2.isValid()) return QDateTime();
-        bool ok = false;
-        int msec = msPart.toInt(&ok);
-        if (!ok) msec = 0;
-        dt2 = dt2.addMSecs(msec);
-        dt2 = dt2.toLocalTime();
-        return dt2;
-    };
+        if (v.isValid() && v.toInt() != -1) filter.statuses.push_back(v.toInt());
+    }
+    if (orderStartEdit) filter.from = orderFilterTime(orderStartEdit->dateTime(), false);
+    if (orderEndEdit) filter.to = orderFilterTime(orderEndEdit->dateTime(), true);
+    return filter;
+}
 
-    std::vector<Order> filtered;
-    filtered.reserve(orders.size());
-    for (const auto& o : orders) {
-        // 按状态过滤（若选中“全部”即 selStatus == -1 则不过滤）
-        if (selStatus != -1 && o.getStatus() != selStatus) continue;
-
-        QDateTime dt = parseOrderIdToDateTime(QString::fromStdString(o.getOrderId()));
-        if (dt.isValid()) {
-            if (dt >= start && dt <= end) filtered.push_back(o);
-        } else {
-            // 保留无法解析的订单（如需严格过滤可以改为跳过）
-            filtered.push_back(o);
+// 列表中缺少收货地址的订单补拉详情：所有详情请求以流水线方式一次发出（在网络线程调用）
+void AdminWindow::fillMissingAddresses(Client& c, std::vector<Order>& orders) {
+    Client::Batch details;
+    std::vector<size_t> targets;
+    for (size_t i = 0; i < orders.size(); ++i) {
+        if (!orders[i].getShippingAddress().empty()) continue;
+        details.getOrderDetail(orders[i].getOrderId(), orders[i].getUserPhone());
+        targets.push_back(i);
+    }
+    if (details.empty()) return;
+    Client::BatchResult r = c.CLTpipeline(details);
+    for (size_t k = 0; k < targets.size(); ++k) {
+        Order detail;
+        if (Client::CLTparseOrderDetail(r[k], detail)) {
+            orders[targets[k]].setShippingAddress(detail.getShippingAddress());
         }
     }
+}
 
-    ordersTable->setRowCount((int)filtered.size());
-    for (int i = 0; i < (int)filtered.size(); ++i) {
-        const Order& o = filtered[i];
-        ordersTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(o.getOrderId())));
-        ordersTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(o.getUserPhone())));
+// 按时间范围与状态筛选后填表
+void AdminWindow::populateOrders(const std::vector<Order>& orders, bool append) {
+    if (!append) ordersTable->setRowCount(0);
+    // 筛选已在服务端完成（见 currentOrderFilter），这里只填表
+    const int base = ordersTable->rowCount();
+    ordersTable->setRowCount(base + (int)orders.size());
+    for (int i = 0; i < (int)orders.size(); ++i) {
+        const Order& o = orders[i];
+        ordersTable->setItem(base + i, 0, new QTableWidgetItem(QString::fromStdString(o.getOrderId())));
+        ordersTable->setItem(base + i, 1, new QTableWidgetItem(QString::fromStdString(o.getUserPhone())));
 
         QString addr = QString::fromStdString(o.getShippingAddress());
-        if (addr.isEmpty()) {
-            Order detail;
-            bool ok = client_->CLTgetOrderDetail(o.getOrderId(), o.getUserPhone(), detail);
-            if (ok) addr = QString::fromStdString(detail.getShippingAddress());
-        }
-        ordersTable->setItem(i, 2, new QTableWidgetItem(addr));
-        ordersTable->setItem(i, 3, new QTableWidgetItem(orderStatusToText(o.getStatus())));
+        ordersTable->setItem(base + i, 2, new QTableWidgetItem(addr));
+        ordersTable->setItem(base + i, 3, new QTableWidgetItem(orderStatusToText(o.getStatus())));
         QString summary = QString("总计 %1").arg(o.getTotalAmount());
-        ordersTable->setItem(i, 4, new QTableWidgetItem(summary));
+        ordersTable->setItem(base + i, 4, new QTableWidgetItem(summary));
     }
 }
 
@@ -1744,6 +1794,10 @@ void AdminWindow::onEditPromotion() {
 void AdminWindow::refreshPromotions() {
     if (!tryThrottle(this)) return;
     if (!client_) return;
+    populatePromotions(client_->CLTgetAllPromotionsRaw());
+}
+
+void AdminWindow::populatePromotions(const std::vector<nlohmann::json>& rows) {
     promoTable->setRowCount(0);
 
     QString selType = "ALL";
@@ -1752,7 +1806,6 @@ void AdminWindow::refreshPromotions() {
         if (v.isValid()) selType = v.toString();
     }
 
-    auto rows = client_->CLTgetAllPromotionsRaw();
     int outRow = 0;
     promoTable->setRowCount(static_cast<int>(rows.size())); // 先设最大，再按需填
     for (const auto& r : rows) {
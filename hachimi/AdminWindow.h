@@ -152,7 +152,45 @@ private:
     // INTERNAL helpers
     // 不带节流的内部刷新，用于在需要避免二次节流（如筛选按钮）时调用
     void refreshGoodsInternal();
+    // 首次加载：用户、商品、订单、促销以流水线方式一次往返取回
+    void refreshAllInternal();
+
+    // 用已取回的数据填表（各表的筛选都已在服务端完成）；append 为 true 时追加到表尾（分页加载的后续页）
+    void populateUsers(const std::vector<User>& users, bool append = false);
+    void populateGoods(const std::vector<Good>& goods, bool append = false);
+    void populateOrders(const std::vector<Order>& orders, bool append = false);
+    void populatePromotions(const std::vector<nlohmann::json>& rows);
+    // 为缺少收货地址的订单补拉详情（网络线程调用，详情请求以流水线方式一次发出）
+    static void fillMissingAddresses(Client& c, std::vector<Order>& orders);
 
     // 构造期间抑制节流弹窗（构造期连续刷新时使用）
     bool suppressThrottle_ = false;
+
+
+    // 分页加载：用户/商品/订单表滚动到接近底部时按游标拉取下一页（键集分页，见 Client::CLTget*Page），
+    // 加载耗时与内存只与已浏览的页数有关
+    static constexpr int PageSize = 100;
+    struct PagingState {
+        std::string nextAfter; // 下一页游标（商品为 id 的十进制文本），空表示从第一页开始
+        bool hasMore = false;
+        bool loading = false;
+        uint64_t seq = 0;      // 每次重新加载时递增：只应用最后一次发起的加载结果
+    };
+    PagingState usersPaging_;
+    PagingState goodsPaging_;
+    PagingState ordersPaging_;
+    // 订单表的服务端筛选条件：刷新时从筛选控件读取，后续各页沿用同一条件
+    Client::OrderFilter ordersFilter_;
+    Client::OrderFilter currentOrderFilter() const;
+    // 商品表的服务端筛选条件（同上）
+    Client::GoodsFilter goodsFilter_;
+    Client::GoodsFilter currentGoodsFilter() const;
+    // 用户表按手机号（部分匹配）查询时的条件，空表示全部用户；刷新用户时清空
+    std::string usersPhoneFilter_;
+    // 清空表格与游标，下一次 loadMore* 从第一页开始
+    static void resetPaging(PagingState& paging, QTableWidget* table);
+    // 已加载到末尾、正在加载或未滚动到底部附近时不做任何事（表格不足一屏时总会继续加载）
+    void loadMoreUsers();
+    void loadMoreGoods();
+    void loadMoreOrders();
 };
\ No newline at end of file
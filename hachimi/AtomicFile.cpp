@@ -0,0 +1,35 @@
+#include "AtomicFile.h"
+#include <cstdio>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+bool writeFileAtomically(const std::string& path, const std::string& contents) {
+    const std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(contents.data(), 1, contents.size(), f) == contents.size() && std::fflush(f) == 0;
+    // 改名前先落盘：否则掉电后可能得到改名已生效、内容却为空的文件
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    // rename 在 Windows 下不覆盖已存在的文件；MoveFileEx 可原子替换（路径与 fopen 一样按本地代码页解释）
+    ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    // POSIX rename 本身即原子替换目标，不能先删除旧文件（删除与改名之间崩溃会丢失全部数据）
+    ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok) std::remove(tmp.c_str());
+    return ok;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+
+// 原子替换写文件：先写同目录下的 path + ".tmp" 并落盘，再改名覆盖 path。
+// 读者（如 Prometheus 抓取、下次启动加载快照）只会看到旧文件或完整的新文件，
+// 任何时刻都不会出现文件缺失或只写了一半。失败时返回 false，原文件保持不变。
+bool writeFileAtomically(const std::string& path, const std::string& contents);
@@ -1,9 +1,14 @@
 #include "Client.h"
 #include <nlohmann/json.hpp>
 #include "logger.h"
+#include "LocalTransport.h"
 #include <QElapsedTimer>
 #include <QCoreApplication>
 #include <sstream>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <unordered_map>
 
 
 using nlohmann::json;
@@ -12,18 +17,66 @@ class Client::Impl {
 public:
     QString ip;
     int port;
-    QTcpSocket* socket;
+    // 本地套接字名：非空时优先经 QLocalSocket 连接（同机免走 TCP 协议栈），连接失败退回 TCP
+    std::string localSocketName;
+    QTcpSocket* tcpSocket;
+    QLocalSocket* localSocket;
+    QIODevice* socket; // 当前使用的连接：tcpSocket 或 localSocket
     bool connected;
+    WireMode wireMode;
+    // 请求的响应编码：非 Json 时每次建立 Framed 连接后发送 SET_ENCODING 握手
+    WireEncoding encoding = WireEncoding::Json;
+    // 响应压缩阈值：非 0 时每次建立 Framed 连接后发送 SET_COMPRESSION 握手
+    size_t compressMinBytes = 0;
+
+    // 进程内通道：Server 与本 Client 同进程时由 CLTconnectToServer 选用，此时不使用 socket
+    bool allowLocal = true;
+    std::shared_ptr<LocalTransport> local;
+
+    // 异步网络线程（首次 CLTsubmitAsync 时启动）
+    std::thread netThread;
+    std::mutex asyncMutex;
+    std::condition_variable asyncCv;
+    std::deque<std::function<void(Client&)>> asyncTasks;
+    bool asyncStopping = false;
+
+    void asyncLoop(WireMode mode, bool inProcess, std::string localName, WireEncoding enc, size_t compressMin);
+    void stopAsync();
 
     Impl(const std::string& ip_, int port_)
-        : ip("127.0.0.1"), port(8888), socket(new QTcpSocket), connected(false) {} // 强制使用127.0.0.1:8888
+        : ip("127.0.0.1"), port(8888), tcpSocket(new QTcpSocket), localSocket(new QLocalSocket),
+          socket(tcpSocket), connected(false), wireMode(WireMode::Framed) {} // 强制使用127.0.0.1:8888
+
+    // 建立连接：配置了本地套接字时先尝试它，失败再连 TCP；成功后 socket 指向所用连接，并按需协商响应编码与压缩
+    bool openSocket(int timeoutMs);
+    // 发送 SET_ENCODING / SET_COMPRESSION 握手；服务端不支持时保持未压缩的文本 JSON
+    // （服务端只在握手成功后才发送二进制或压缩响应）
+    void negotiateOptions(int timeoutMs);
+    // 发送一条连接级选项命令并等待响应；服务端返回错误或超时时返回 false
+    bool sendOption(const std::string& command, int timeoutMs);
+    // 断开当前连接（未连接时不做任何事）
+    void closeSocket(int timeoutMs);
+    // 立即中止当前连接并清空接收缓冲（线路数据已失去同步时使用）
+    void abortSocket();
+    bool socketConnected() const;
+
+    // Framed 模式下每个请求带一个 id（FlagCorrelated），响应按 id 匹配
+    uint32_t nextCorrelationId = 0;
+    // 已收到但尚未切出的字节（可能含下一帧的开头）
+    QByteArray rxBuffer;
+
+    // 写出请求；失败时轻量重连并重试一次
+    bool writeWithRetry(const QByteArray& data);
+    // Legacy：读到数据后等待 100ms 无新数据即视为响应结束
+    QByteArray readLegacyResponse(int timeLimitMs);
+    // Framed：读取响应帧，按 id 填入 out[pending[id]]，直到 pending 为空或超时；
+    // 未知 id 的帧（先前超时请求的迟到响应）被丢弃
+    void readFramedResponses(std::unordered_map<uint32_t, size_t>& pending, std::vector<std::string>& out, int timeLimitMs);
 
     ~Impl() {
-        if (socket) {
-            socket->disconnectFromHost();
-            socket->waitForDisconnected(1000);
-            delete socket;
-        }
+        closeSocket(1000);
+        delete tcpSocket;
+        delete localSocket;
     }
 };
 
@@ -31,16 +84,81 @@ Client::Client(const std::string& ip, int port)
     : pImpl(new Impl("127.0.0.1", 8888)) {} // 强制使用127.0.0.1:8888
 
 Client::~Client() {
+    pImpl->stopAsync();
     CLTdisconnect();
     delete pImpl;
 }
 
+// 网络线程：在本线程内创建工作 Client，使其 socket 归属本线程，阻塞式 waitFor* 可正常使用
+void Client::Impl::asyncLoop(WireMode mode, bool inProcess, std::string localName, WireEncoding enc, size_t compressMin) {
+    Client worker(ip.toStdString(), port);
+    worker.CLTsetWireMode(mode);
+    worker.CLTsetEncoding(enc);
+    worker.CLTsetCompression(compressMin);
+    worker.CLTsetInProcess(inProcess);
+    worker.CLTsetLocalSocket(localName);
+    if (!worker.CLTconnectToServer()) {
+        Logger::instance().warn("Client async thread: initial connect failed, will retry per request");
+    }
+    for (;;) {
+        std::function<void(Client&)> task;
+        {
+            std::unique_lock<std::mutex> lk(asyncMutex);
+            asyncCv.wait(lk, [this] { return asyncStopping || !asyncTasks.empty(); });
+            if (asyncStopping) return;
+            task = std::move(asyncTasks.front());
+            asyncTasks.pop_front();
+        }
+        try {
+            if (!worker.CLTisConnectionActive()) worker.CLTreconnect();
+            task(worker);
+        }
+        catch (const std::exception& e) {
+            Logger::instance().fail(std::string("Client async task threw: ") + e.what());
+        }
+        catch (...) {
+            Logger::instance().fail("Client async task threw unknown exception");
+        }
+    }
+}
+
+void Client::Impl::stopAsync() {
+    {
+        std::lock_guard<std::mutex> lk(asyncMutex);
+        asyncStopping = true;
+        asyncTasks.clear();
+    }
+    asyncCv.notify_all();
+    if (netThread.joinable()) netThread.join();
+}
+
+bool Client::CLTsubmitAsync(std::function<void(Client&)> task) {
+    if (!task) return false;
+    std::lock_guard<std::mutex> lk(pImpl->asyncMutex);
+    if (pImpl->asyncStopping) return false;
+    if (!pImpl->netThread.joinable()) {
+        pImpl->netThread = std::thread(&Impl::asyncLoop, pImpl, pImpl->wireMode, pImpl->allowLocal, pImpl->localSocketName, pImpl->encoding,
+                                      pImpl->compressMinBytes);
+    }
+    pImpl->asyncTasks.push_back(std::move(task));
+    pImpl->asyncCv.notify_one();
+    return true;
+}
+
 bool Client::CLTconnectToServer() {
     QMutexLocker lock(&requestMutex);
     if (pImpl->connected) return true;
 
-    pImpl->socket->connectToHost(QHostAddress(pImpl->ip), pImpl->port);
-    if (!pImpl->socket->waitForConnected(3000)) {
+    if (pImpl->allowLocal) {
+        pImpl->local = LocalTransport::find(pImpl->port);
+        if (pImpl->local) {
+            Logger::instance().info("Client: 使用进程内通道连接本进程 Server，端口 " + std::to_string(pImpl->port));
+            pImpl->connected = true;
+            return true;
+        }
+    }
+
+    if (!pImpl->openSocket(3000)) {
         qWarning() << "Connect failed, error:" << pImpl->socket->errorString();
         pImpl->connected = false;
         return false;
@@ -49,22 +167,98 @@ bool Client::CLTconnectToServer() {
     return true;
 }
 
+bool Client::Impl::openSocket(int timeoutMs) {
+    if (!localSocketName.empty()) {
+        localSocket->connectToServer(QString::fromStdString(localSocketName));
+        if (localSocket->waitForConnected(timeoutMs)) {
+            socket = localSocket;
+            negotiateOptions(timeoutMs);
+            return true;
+        }
+        Logger::instance().warn("Client: 本地套接字 " + localSocketName + " 连接失败（" +
+            localSocket->errorString().toStdString() + "），改用 TCP");
+        localSocket->abort();
+    }
+    socket = tcpSocket;
+    tcpSocket->connectToHost(QHostAddress(ip), port);
+    if (!tcpSocket->waitForConnected(timeoutMs)) return false;
+    negotiateOptions(timeoutMs);
+    return true;
+}
+
+void Client::Impl::negotiateOptions(int timeoutMs) {
+    if (wireMode != WireMode::Framed) return;
+    if (encoding != WireEncoding::Json && !sendOption(std::string("SET_ENCODING ") + WireFrame::encodingName(encoding), timeoutMs)) {
+        Logger::instance().warn(std::string("Client: 服务端不支持 ") + WireFrame::encodingName(encoding) + " 响应编码，使用文本 JSON");
+    }
+    if (compressMinBytes != 0 && !sendOption("SET_COMPRESSION zlib " + std::to_string(compressMinBytes), timeoutMs)) {
+        Logger::instance().warn("Client: 服务端不支持响应压缩，使用未压缩响应");
+    }
+}
+
+bool Client::Impl::sendOption(const std::string& command, int timeoutMs) {
+    const uint32_t id = ++nextCorrelationId;
+    const std::string frame = WireFrame::encodeCorrelated(id, command);
+    if (socket->write(frame.data(), static_cast<qint64>(frame.size())) < 0) return false;
+    std::unordered_map<uint32_t, size_t> pending{ { id, 0 } };
+    std::vector<std::string> out(1);
+    readFramedResponses(pending, out, timeoutMs);
+    json r = Client::CLTdecodeResponse(out[0], false);
+    return r.is_object() && !r.contains("error");
+}
+
+void Client::Impl::closeSocket(int timeoutMs) {
+    if (socket == localSocket) {
+        if (localSocket->state() == QLocalSocket::UnconnectedState) return;
+        localSocket->disconnectFromServer();
+        if (localSocket->state() != QLocalSocket::UnconnectedState) localSocket->waitForDisconnected(timeoutMs);
+        return;
+    }
+    if (tcpSocket->state() == QAbstractSocket::UnconnectedState) return;
+    tcpSocket->disconnectFromHost();
+    if (tcpSocket->state() == QAbstractSocket::ConnectedState) {
+        tcpSocket->waitForDisconnected(timeoutMs);
+    }
+    else {
+        qDebug() << "Cannot waitForDisconnected in state:" << tcpSocket->state();
+    }
+}
+
+void Client::Impl::abortSocket() {
+    if (socket == localSocket) localSocket->abort();
+    else tcpSocket->abort();
+    connected = false;
+    rxBuffer.clear();
+}
+
+bool Client::Impl::socketConnected() const {
+    if (socket == localSocket) return localSocket->state() == QLocalSocket::ConnectedState;
+    return tcpSocket->state() == QAbstractSocket::ConnectedState;
+}
+
 bool Client::CLTreconnect() {
     QMutexLocker lock(&requestMutex);
+    // 进程内通道仍可用则无需重连；已关闭（本进程 Server 已停止）时重新查找，找不到再走 TCP
+    if (pImpl->local && pImpl->local->isOpen()) {
+        pImpl->connected = true;
+        return true;
+    }
+    pImpl->local.reset();
+    if (pImpl->allowLocal) {
+        pImpl->local = LocalTransport::find(pImpl->port);
+        if (pImpl->local) {
+            pImpl->connected = true;
+            return true;
+        }
+    }
     // 先尝试断开连接
     if (pImpl->connected) {
-        pImpl->socket->disconnectFromHost();
-        if (pImpl->socket->state() == QAbstractSocket::ConnectedState) {
-            pImpl->socket->waitForDisconnected(3000);
-        }
-        else {
-            qDebug() << "Cannot waitForDisconnected in state:" << pImpl->socket->state();
-        }
+        pImpl->closeSocket(3000);
         pImpl->connected = false;
     }
-    // 尝试重新连接
-    pImpl->socket->connectToHost(QHostAddress(pImpl->ip), pImpl->port);
-    if (!pImpl->socket->waitForConnected(5000)) {
+    pImpl->rxBuffer.clear();
+    // 尝试重新连接（配置了本地套接字时仍优先本地套接字）
+    if (!pImpl->openSocket(5000)) {
         qDebug() << "Connection failed:" << pImpl->socket->errorString();
         Logger::instance().fail("Socket连接失败: " + pImpl->socket->errorString().toStdString());
         return false;
@@ -75,139 +269,428 @@ bool Client::CLTreconnect() {
 
 void Client::CLTdisconnect() {
     QMutexLocker lock(&requestMutex);
+    if (pImpl->local) {
+        pImpl->local.reset();
+        pImpl->connected = false;
+        return;
+    }
     if (pImpl->connected) {
-        pImpl->socket->disconnectFromHost();
-        if (pImpl->socket->state() == QAbstractSocket::ConnectedState) {
-            pImpl->socket->waitForDisconnected(3000);
-        } else {
-            qDebug() << "Cannot waitForDisconnected in state:" << pImpl->socket->state();
-        }
+        pImpl->closeSocket(3000);
         pImpl->connected = false;
     }
+    pImpl->rxBuffer.clear();
 }
 
 bool Client::CLTisConnectionActive() const {
     return pImpl->connected;
 }
 
-std::string Client::CLTsendRequest(const std::string& request) {
+void Client::CLTsetWireMode(WireMode mode) {
     QMutexLocker lock(&requestMutex);
+    // 客户端只能明确选择一种模式
+    pImpl->wireMode = (mode == WireMode::Legacy) ? WireMode::Legacy : WireMode::Framed;
+}
 
-    auto trim = [](const std::string& s) {
-        const char* ws = " \t\n\r";
-        size_t b = s.find_first_not_of(ws);
-        if (b == std::string::npos) return std::string();
-        size_t e = s.find_last_not_of(ws);
-        return s.substr(b, e - b + 1);
-        };
+WireMode Client::CLTwireMode() const {
+    return pImpl->wireMode;
+}
 
-    std::string reqStr = trim(request);
-    if (reqStr.empty()) {
-        qWarning() << "CLTsendRequest: empty request";
-        return "";
+void Client::CLTsetInProcess(bool allowed) {
+    QMutexLocker lock(&requestMutex);
+    pImpl->allowLocal = allowed;
+}
+
+bool Client::CLTisInProcess() const {
+    return pImpl->local != nullptr;
+}
+
+void Client::CLTsetEncoding(WireEncoding encoding) {
+    QMutexLocker lock(&requestMutex);
+    pImpl->encoding = encoding;
+}
+
+WireEncoding Client::CLTencoding() const {
+    return pImpl->encoding;
+}
+
+void Client::CLTsetCompression(size_t minBytes) {
+    QMutexLocker lock(&requestMutex);
+    pImpl->compressMinBytes = minBytes;
+}
+
+size_t Client::CLTcompression() const {
+    return pImpl->compressMinBytes;
+}
+
+json Client::CLTdecodeResponse(const std::string& resp, bool allowExceptions) {
+    if (!resp.empty()) {
+        // 二进制响应以帧标志位字节开头（见 readFramedResponses），文本 JSON 不会以控制字符开头
+        const uint8_t tag = static_cast<uint8_t>(resp[0]);
+        if (tag == WireFrame::FlagCbor) return json::from_cbor(resp.begin() + 1, resp.end(), true, allowExceptions);
+        if (tag == WireFrame::FlagMsgPack) return json::from_msgpack(resp.begin() + 1, resp.end(), true, allowExceptions);
     }
+    return json::parse(resp, nullptr, allowExceptions);
+}
 
-    // normalize and ensure single newline terminator
-    std::string formatted = reqStr;
-    if (formatted.back() != '\n') formatted.push_back('\n');
+std::string Client::CLTresponseText(const std::string& resp) {
+    if (resp.empty()) return resp;
+    const uint8_t tag = static_cast<uint8_t>(resp[0]);
+    if (tag != WireFrame::FlagCbor && tag != WireFrame::FlagMsgPack) return resp;
+    json j = CLTdecodeResponse(resp, false);
+    return j.is_discarded() ? std::string() : j.dump();
+}
 
-    if (!pImpl->connected) {
-        qWarning() << "Not connected to server";
-        return "";
+void Client::CLTsetLocalSocket(const std::string& name) {
+    QMutexLocker lock(&requestMutex);
+    pImpl->localSocketName = name;
+}
+
+std::string Client::CLTlocalSocket() const {
+    return pImpl->localSocketName;
+}
+
+QByteArray Client::Impl::readLegacyResponse(int timeLimitMs) {
+    QByteArray resp;
+    const int chunkMs = 200;
+    QElapsedTimer timer; timer.start();
+
+    while (timer.elapsed() < timeLimitMs) {
+        if (socket->bytesAvailable() > 0) {
+            resp += socket->readAll();
+            while (socket->waitForReadyRead(100)) resp += socket->readAll();
+            break;
+        }
+        if (socket->waitForReadyRead(chunkMs)) {
+            resp += socket->readAll();
+            while (socket->waitForReadyRead(100)) resp += socket->readAll();
+            break;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
     }
+    return resp;
+}
+
+void Client::Impl::readFramedResponses(std::unordered_map<uint32_t, size_t>& pending, std::vector<std::string>& out, int timeLimitMs) {
+    QElapsedTimer timer; timer.start();
 
-    QByteArray qreq = QByteArray::fromStdString(formatted);
+    while (!pending.empty()) {
+        if (socket->bytesAvailable() > 0) rxBuffer += socket->readAll();
+
+        // 切出缓冲区内的全部完整帧
+        size_t offset = 0;
+        std::string payload;
+        uint8_t flags = 0;
+        for (;;) {
+            auto r = WireFrame::tryDecode(rxBuffer.constData(), static_cast<size_t>(rxBuffer.size()), offset, payload, flags);
+            if (r == WireFrame::DecodeResult::NeedMore) break;
+            if (r == WireFrame::DecodeResult::Error) {
+                // 帧边界已无法确定，继续读同一连接会把后续数据误当作帧头与请求 id：
+                // 丢弃连接，未收到的响应全部按失败（空串）返回，并重连供后续请求使用
+                qWarning() << "readFramedResponses: invalid frame header, dropping connection with" << pending.size() << "responses pending";
+                pending.clear();
+                abortSocket();
+                connected = openSocket(3000);
+                if (!connected) qWarning() << "readFramedResponses: reconnect failed:" << socket->errorString();
+                return;
+            }
+            uint32_t id = 0;
+            if (!(flags & WireFrame::FlagCorrelated) || !WireFrame::takeCorrelationId(payload, id)) {
+                qWarning() << "readFramedResponses: dropping frame without request id";
+                continue;
+            }
+            auto it = pending.find(id);
+            if (it == pending.end()) {
+                qWarning() << "readFramedResponses: dropping late response for request id" << id;
+                continue;
+            }
+            // 压缩的 payload 先解压，再按编码标志位处理
+            if (flags & WireFrame::FlagCompressed) {
+                const QByteArray plain = qUncompress(reinterpret_cast<const uchar*>(payload.data()), static_cast<qsizetype>(payload.size()));
+                if (plain.isEmpty()) {
+                    qWarning() << "readFramedResponses: failed to decompress response for request id" << id;
+                    payload.clear();
+                } else {
+                    payload.assign(plain.constData(), static_cast<size_t>(plain.size()));
+                }
+            }
+            // 二进制响应保留原始字节，前加一个标志位字节，由 CLTdecodeResponse 直接解码而不经文本
+            const uint8_t encodingFlag = flags & WireFrame::EncodingFlags;
+            if (encodingFlag && !payload.empty()) payload.insert(payload.begin(), static_cast<char>(encodingFlag));
+            out[it->second] = std::move(payload);
+            pending.erase(it);
+        }
+        if (offset > 0) rxBuffer.remove(0, static_cast<qsizetype>(offset));
+        if (pending.empty()) break;
 
-    // try write, on failure try one reconnect+retry
+        int remaining = timeLimitMs - static_cast<int>(timer.elapsed());
+        if (remaining <= 0) break;
+        if (!socket->waitForReadyRead(remaining)) {
+            if (!socketConnected()) break;
+        }
+    }
+    if (!pending.empty()) qWarning() << "readFramedResponses:" << pending.size() << "responses missing, buffered" << rxBuffer.size() << "bytes";
+}
+
+bool Client::Impl::writeWithRetry(const QByteArray& data) {
     qint64 sent = -1;
     for (int attempt = 0; attempt < 2; ++attempt) {
-        sent = pImpl->socket->write(qreq);
+        sent = socket->write(data);
         qDebug() << "CLTsendRequest: write returned" << sent << "(attempt" << attempt + 1 << ")";
         if (sent == -1) {
-            qWarning() << "Send failed, socket error:" << pImpl->socket->errorString();
+            qWarning() << "Send failed, socket error:" << socket->errorString();
             // lightweight reconnect
-            pImpl->socket->disconnectFromHost();
-            if (pImpl->socket->state() == QAbstractSocket::ConnectedState) pImpl->socket->waitForDisconnected(1000);
-            pImpl->connected = false;
-            pImpl->socket->connectToHost(QHostAddress(pImpl->ip), pImpl->port);
-            if (!pImpl->socket->waitForConnected(3000)) {
-                qDebug() << "Reconnect attempt failed:" << pImpl->socket->errorString();
+            closeSocket(1000);
+            connected = false;
+            rxBuffer.clear();
+            if (!openSocket(3000)) {
+                qDebug() << "Reconnect attempt failed:" << socket->errorString();
                 continue;
             }
-            pImpl->connected = true;
+            connected = true;
             continue;
         }
         break;
     }
-
     if (sent == -1) {
         qWarning() << "CLTsendRequest: all send attempts failed";
-        return "";
+        return false;
     }
+    if (!socket->waitForBytesWritten(2000)) {
+        qWarning() << "waitForBytesWritten timed out or failed:" << socket->errorString();
+    }
+    return true;
+}
+
+static std::string trimRequest(const std::string& s) {
+    const char* ws = " \t\n\r";
+    size_t b = s.find_first_not_of(ws);
+    if (b == std::string::npos) return std::string();
+    size_t e = s.find_last_not_of(ws);
+    return s.substr(b, e - b + 1);
+}
+
+std::string Client::CLTsendRequest(const std::string& request) {
+    QMutexLocker lock(&requestMutex);
 
-    if (!pImpl->socket->waitForBytesWritten(2000)) {
-        qWarning() << "waitForBytesWritten timed out or failed:" << pImpl->socket->errorString();
+    std::string reqStr = trimRequest(request);
+    if (reqStr.empty()) {
+        qWarning() << "CLTsendRequest: empty request";
+        return "";
     }
 
-    QByteArray resp;
-    const int timeLimitMs = 8000;
-    const int chunkMs = 200;
-    QElapsedTimer timer; timer.start();
+    // 进程内通道 / Framed：单个请求即只有一项的流水线
+    if (pImpl->local || pImpl->wireMode == WireMode::Framed) return CLTsendRequests({ reqStr }).front();
 
-    while (timer.elapsed() < timeLimitMs) {
-        if (pImpl->socket->bytesAvailable() > 0) {
-            resp += pImpl->socket->readAll();
-            while (pImpl->socket->waitForReadyRead(100)) resp += pImpl->socket->readAll();
-            break;
-        }
-        if (pImpl->socket->waitForReadyRead(chunkMs)) {
-            resp += pImpl->socket->readAll();
-            while (pImpl->socket->waitForReadyRead(100)) resp += pImpl->socket->readAll();
-            break;
-        }
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    // normalize and ensure single newline terminator
+    std::string formatted = reqStr;
+    if (formatted.back() != '\n') formatted.push_back('\n');
+
+    if (!pImpl->connected) {
+        qWarning() << "Not connected to server";
+        return "";
     }
 
+    if (!pImpl->writeWithRetry(QByteArray::fromStdString(formatted))) return "";
+
+    const int timeLimitMs = 8000;
+    QByteArray resp = pImpl->readLegacyResponse(timeLimitMs);
+
     if (resp.isEmpty()) {
         qWarning("No response from server after total wait");
-        qDebug() << "final socket state:" << pImpl->socket->state() << "error:" << pImpl->socket->errorString();
+        qDebug() << "final socket connected:" << pImpl->socketConnected() << "error:" << pImpl->socket->errorString();
         return "";
     }
 
     QString s = QString::fromUtf8(resp);
     QString trimmed = s.trimmed();
-    qDebug() << "CLTsendRequest: request:" << QString::fromStdString(formatted).trimmed();
+    qDebug() << "CLTsendRequest: request:" << QString::fromStdString(reqStr);
     qDebug() << "CLTsendRequest: received (len)" << resp.size() << ", trimmed len:" << trimmed.toUtf8().size();
 
     return trimmed.toStdString();
 }
 
+std::vector<std::string> Client::CLTsendRequests(const std::vector<std::string>& requests) {
+    QMutexLocker lock(&requestMutex);
+    std::vector<std::string> out(requests.size());
+    const int timeLimitMs = 8000;
+
+    if (pImpl->local) {
+        // 进程内：请求移入 Call 交给服务端，全部提交后再逐个等待，响应直接移出，不经 socket
+        std::vector<LocalTransport::CallPtr> calls(requests.size());
+        bool closed = false;
+        for (size_t i = 0; i < requests.size() && !closed; ++i) {
+            std::string reqStr = trimRequest(requests[i]);
+            if (reqStr.empty()) continue;
+            auto call = std::make_shared<LocalTransport::Call>(std::move(reqStr));
+            if (pImpl->local->submit(call)) calls[i] = std::move(call);
+            else closed = true;
+        }
+        QElapsedTimer timer; timer.start();
+        for (size_t i = 0; i < calls.size(); ++i) {
+            if (!calls[i]) continue;
+            int remaining = timeLimitMs - static_cast<int>(timer.elapsed());
+            if (calls[i]->wait(remaining > 0 ? remaining : 0)) out[i] = calls[i]->takeResponse();
+            else qWarning() << "CLTsendRequests: in-process request timed out at index" << i;
+        }
+        if (closed) {
+            // 本进程 Server 已停止：下次请求前由 CLTreconnect 改走 TCP
+            Logger::instance().warn("Client: 进程内通道已关闭");
+            pImpl->local.reset();
+            pImpl->connected = false;
+        }
+        return out;
+    }
+
+    if (pImpl->wireMode != WireMode::Framed) {
+        // 旧版协议无法区分响应归属，只能逐条往返
+        for (size_t i = 0; i < requests.size(); ++i) out[i] = CLTsendRequest(requests[i]);
+        return out;
+    }
+
+    if (!pImpl->connected) {
+        qWarning() << "Not connected to server";
+        return out;
+    }
+
+    // 全部请求编码后一次写出，响应按 id 匹配
+    std::unordered_map<uint32_t, size_t> pending;
+    QByteArray wire;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        std::string reqStr = trimRequest(requests[i]);
+        if (reqStr.empty()) {
+            qWarning() << "CLTsendRequests: empty request at index" << i;
+            continue;
+        }
+        const uint32_t id = ++pImpl->nextCorrelationId;
+        std::string frame = WireFrame::encodeCorrelated(id, reqStr);
+        if (frame.empty()) {
+            qWarning() << "CLTsendRequests: request too large for a frame:" << reqStr.size();
+            continue;
+        }
+        wire.append(frame.data(), static_cast<qsizetype>(frame.size()));
+        pending[id] = i;
+    }
+    if (pending.empty()) return out;
+    if (!pImpl->writeWithRetry(wire)) return out;
+
+    pImpl->readFramedResponses(pending, out, timeLimitMs);
+
+    for (auto& r : out) {
+        if (!r.empty() && (static_cast<uint8_t>(r[0]) & WireFrame::EncodingFlags)) continue; // 二进制响应不可裁剪
+        r = trimRequest(r);
+    }
+    return out;
+}
+
+// ---------------- 批量请求 ----------------
+size_t Client::Batch::add(const std::string& cmd, const nlohmann::json& args) {
+    std::string line = cmd;
+    if (args.is_string()) {
+        const std::string& text = args.get_ref<const std::string&>();
+        if (!text.empty()) line += " " + text;
+    }
+    else if (!args.is_null()) {
+        line += " " + args.dump();
+    }
+    lines_.push_back(std::move(line));
+    return lines_.size() - 1;
+}
+
+size_t Client::Batch::saveCartWithPolicy(const TemporaryCart& cart, const std::string& policyJson) {
+    return add("SAVE_CART", CLTcartPayload(cart, policyJson));
+}
+
+size_t Client::Batch::addSettledOrder(const Order& order) {
+    return add("ADD_SETTLED_ORDER", CLTorderPayload(order));
+}
+
+Client::BatchResult Client::CLTpipeline(const Batch& batch) {
+    BatchResult result;
+    result.responses = CLTsendRequests(batch.lines());
+    for (size_t i = 0; i < result.responses.size(); ++i) {
+        if (result.responses[i].empty()) {
+            result.error = "no_response";
+            result.failedIndex = static_cast<int>(i);
+            break;
+        }
+    }
+    result.ok = result.error.empty();
+    return result;
+}
+
+Client::BatchResult Client::CLTbatch(const Batch& batch) {
+    BatchResult result;
+    // 出错时各子响应为空串，调用方可直接按下标取用
+    result.responses.resize(batch.size());
+    if (batch.empty()) { result.ok = true; return result; }
+
+    json req;
+    req["transaction"] = batch.transactional();
+    req["requests"] = batch.lines();
+    std::string resp = CLTsendRequest("BATCH " + req.dump());
+    if (resp.empty()) { result.error = "no_response"; return result; }
+
+    json j = CLTdecodeResponse(resp, false);
+    if (j.is_discarded() || !j.is_object()) {
+        result.error = "invalid_response";
+        Logger::instance().fail("BATCH 响应解析失败: " + CLTresponseText(resp).substr(0, 256));
+        return result;
+    }
+    if (!j.contains("responses") && j.value("error", std::string("")) == "UNKNOWN_COMMAND" && !batch.transactional()) {
+        // 旧版服务端：逐条发送
+        Logger::instance().warn("CLTbatch: 服务端不支持 BATCH，改为逐条发送");
+        for (size_t i = 0; i < batch.size(); ++i) result.responses[i] = CLTsendRequest(batch.lines()[i]);
+        result.ok = true;
+        return result;
+    }
+    if (j.contains("error")) {
+        result.error = j["error"].is_string() ? j["error"].get<std::string>() : j["error"].dump();
+        result.failedIndex = j.value("failed_index", -1);
+        Logger::instance().warn("BATCH 返回错误: " + result.error);
+    }
+    if (j.contains("responses") && j["responses"].is_array()) {
+        const json& arr = j["responses"];
+        for (size_t i = 0; i < arr.size() && i < batch.size(); ++i) {
+            result.responses[i] = arr[i].is_string() ? arr[i].get<std::string>() : arr[i].dump();
+        }
+    }
+    result.ok = result.error.empty();
+    return result;
+}
+
 // ---------------- 商品相关 ----------------
 std::vector<Good> Client::CLTgetAllGoods() {
+    return CLTparseGoods(CLTsendRequest("GET_ALL_GOODS"));
+}
+
+static void appendGoods(const json& arr, std::vector<Good>& goods) {
+    for (const auto& it : arr) {
+        if (!it.is_object()) continue;
+        try {
+            int id = it.value("id", 0);
+            std::string name = it.value("name", std::string(""));
+            double price = it.value("price", 0.0);
+            int stock = it.value("stock", 0);
+            std::string category = it.value("category", std::string(""));
+            goods.emplace_back(id, name, price, stock, category);
+        }
+        catch (...) {
+            Logger::instance().warn("解析商品条目失败: " + it.dump());
+        }
+    }
+}
+
+std::vector<Good> Client::CLTparseGoods(const std::string& resp) {
     std::vector<Good> goods;
-    std::string resp = CLTsendRequest("GET_ALL_GOODS");
     if (resp.empty()) return goods;
     try {
-        auto j = json::parse(resp);
+        auto j = CLTdecodeResponse(resp);
         if (j.is_object() && j.contains("error")) {
             Logger::instance().fail("GET_ALL_GOODS 返回错误: " + j.dump());
             return goods;
         }
         json arr = j.is_array() ? j : (j.contains("data") && j["data"].is_array() ? j["data"] : json::array());
-        for (const auto& it : arr) {
-            if (!it.is_object()) continue;
-            try {
-                int id = it.value("id", 0);
-                std::string name = it.value("name", std::string(""));
-                double price = it.value("price", 0.0);
-                int stock = it.value("stock", 0);
-                std::string category = it.value("category", std::string(""));
-                goods.emplace_back(id, name, price, stock, category);
-            }
-            catch (...) {
-                Logger::instance().warn("解析商品条目失败: " + it.dump());
-            }
-        }
+        appendGoods(arr, goods);
     }
     catch (const std::exception& e) {
         Logger::instance().fail(std::string("GET_ALL_GOODS 解析失败: ") + e.what());
@@ -221,7 +704,7 @@ bool Client::CLTupdateGood(int id, const std::string& name, double price, int st
     std::string resp = CLTsendRequest(std::string("UPDATE_GOOD ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) {
             Logger::instance().fail("UPDATE_GOOD 返回错误: " + r.dump());
             return false;
@@ -240,7 +723,7 @@ bool Client::CLTaddGood(const std::string& name, double price, int stock, const
     std::string resp = CLTsendRequest(std::string("ADD_GOOD ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) {
             Logger::instance().fail("ADD_GOOD 返回错误: " + r.dump());
             return false;
@@ -254,10 +737,13 @@ bool Client::CLTaddGood(const std::string& name, double price, int stock, const
 }
 
 bool Client::CLTgetGoodById(int id, Good& outGood) {
-    std::string resp = CLTsendRequest(std::string("GET_GOOD_BY_ID ") + std::to_string(id));
+    return CLTparseGood(CLTsendRequest(std::string("GET_GOOD_BY_ID ") + std::to_string(id)), outGood);
+}
+
+bool Client::CLTparseGood(const std::string& resp, Good& outGood) {
     if (resp.empty()) return false;
     try {
-        auto j = json::parse(resp);
+        auto j = CLTdecodeResponse(resp);
         if (j.is_object() && j.contains("error")) {
             Logger::instance().fail("GET_GOOD_BY_ID 返回错误: " + j.dump());
             return false;
@@ -276,7 +762,7 @@ bool Client::CLTdeleteGood(int id) {
     std::string resp = CLTsendRequest(std::string("DELETE_GOOD ") + std::to_string(id));
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "deleted";
     }
     catch (...) {
@@ -291,7 +777,7 @@ std::vector<Good> Client::CLTsearchGoodsByCategory(const std::string& category)
     std::string resp = CLTsendRequest(std::string("SEARCH_GOODS_BY_CATEGORY ") + j.dump());
     if (resp.empty()) return goods;
     try {
-        auto arr = json::parse(resp);
+        auto arr = CLTdecodeResponse(resp);
         if (arr.is_object() && arr.contains("error")) {
             Logger::instance().fail("SEARCH_GOODS_BY_CATEGORY 返回错误: " + arr.dump());
             return goods;
@@ -314,20 +800,27 @@ std::vector<Good> Client::CLTsearchGoodsByCategory(const std::string& category)
 
 // ---------------- 用户相关 ----------------
 std::vector<User> Client::CLTgetAllAccounts() {
+    return CLTparseAccounts(CLTsendRequest("GET_ALL_ACCOUNTS"));
+}
+
+static void appendAccounts(const json& arr, std::vector<User>& users) {
+    for (const auto& it : arr) {
+        try {
+            users.emplace_back(it.value("phone", std::string("")), it.value("password", std::string("")), it.value("address", std::string("")));
+        }
+        catch (...) {
+            Logger::instance().warn("解析用户条目失败: " + it.dump());
+        }
+    }
+}
+
+std::vector<User> Client::CLTparseAccounts(const std::string& resp) {
     std::vector<User> users;
-    std::string resp = CLTsendRequest("GET_ALL_ACCOUNTS");
     if (resp.empty()) return users;
     try {
-        auto arr = json::parse(resp);
+        auto arr = CLTdecodeResponse(resp);
         if (!arr.is_array()) { Logger::instance().fail("GET_ALL_ACCOUNTS 响应不是数组"); return users; }
-        for (const auto& it : arr) {
-            try {
-                users.emplace_back(it.value("phone", std::string("")), it.value("password", std::string("")), it.value("address", std::string("")));
-            }
-            catch (...) {
-                Logger::instance().warn("解析用户条目失败: " + it.dump());
-            }
-        }
+        appendAccounts(arr, users);
     }
     catch (...) {
         Logger::instance().fail("GET_ALL_ACCOUNTS 解析失败");
@@ -340,7 +833,7 @@ bool Client::CLTlogin(const std::string& phone, const std::string& password) {
     std::string resp = CLTsendRequest(std::string("LOGIN ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) { Logger::instance().fail("LOGIN 返回错误: " + r.dump()); return false; }
         return r.value("result", std::string("")) == "ok";
     }
@@ -355,7 +848,7 @@ bool Client::CLTupdateAccountPassword(const std::string& userId, const std::stri
     std::string resp = CLTsendRequest(std::string("UPDATE_ACCOUNT_PASSWORD ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) { Logger::instance().fail("UPDATE_ACCOUNT_PASSWORD 返回错误: " + r.dump()); return false; }
         return r.value("result", std::string("")) == "updated";
     }
@@ -370,7 +863,7 @@ bool Client::CLTdeleteAccount(const std::string& phone, const std::string& passw
     std::string resp = CLTsendRequest(std::string("DELETE_ACCOUNT ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "deleted";
     }
     catch (...) {
@@ -384,7 +877,7 @@ bool Client::CLTaddAccount(const std::string& phone, const std::string& password
     std::string resp = CLTsendRequest(std::string("ADD_ACCOUNT ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "added";
     }
     catch (...) {
@@ -403,7 +896,8 @@ bool Client::CLTupdateUser(const std::string& phone, const std::string& password
         std::string resp = CLTsendRequest(req);
         if (resp.empty()) return false;
         // 视为成功如果没有 error 字段
-        return resp.find("\"error\"") == std::string::npos;
+        json r = CLTdecodeResponse(resp, false);
+        return !(r.is_object() && r.contains("error"));
     }
     catch (...) {
         return false;
@@ -412,18 +906,23 @@ bool Client::CLTupdateUser(const std::string& phone, const std::string& password
 
 // ---------------- 购物车相关 ----------------
 TemporaryCart Client::CLTgetCartForUser(const std::string& userPhone) {
-    TemporaryCart cart;
     // 记录请求
     Logger::instance().info(std::string("CLTgetCartForUser: request for userPhone=") + userPhone);
     std::string resp = CLTsendRequest(std::string("GET_CART ") + userPhone);
     if (resp.empty()) {
         Logger::instance().info(std::string("CLTgetCartForUser: empty response for userPhone=") + userPhone);
-        return cart;
+        return TemporaryCart();
     }
+    return CLTparseCart(resp);
+}
+
+TemporaryCart Client::CLTparseCart(const std::string& resp) {
+    TemporaryCart cart;
+    if (resp.empty()) return cart;
     // 记录原始响应以便排查
-    Logger::instance().info(std::string("CLTgetCartForUser: raw response: ") + resp);
+    Logger::instance().info(std::string("CLTgetCartForUser: raw response: ") + CLTresponseText(resp));
     try {
-        auto j = json::parse(resp);
+        auto j = CLTdecodeResponse(resp);
         // 若包含 error，则记录并返回空 cart
         if (j.is_object() && j.contains("error")) {
             Logger::instance().warn(std::string("CLTgetCartForUser: server returned error: ") + j.dump());
@@ -469,48 +968,51 @@ TemporaryCart Client::CLTgetCartForUser(const std::string& userPhone) {
     return cart;
 }
 
-bool Client::CLTsaveCartForUserWithPolicy(const TemporaryCart& cart, const std::string& policyJson) {
-    try {
-        nlohmann::json j;
-        // 假定 TemporaryCart 能序列化为 JSON（若没有，请按字段组装）
-        nlohmann::json cartJson;
-        cartJson["cart_id"] = cart.cart_id;
-        cartJson["discount_amount"] = cart.discount_amount;
-        cartJson["discount_policy"] = cart.discount_policy;
-        cartJson["final_amount"] = cart.final_amount;
-        cartJson["is_converted"] = cart.is_converted;
-        cartJson["shipping_address"] = cart.shipping_address;
-        cartJson["total_amount"] = cart.total_amount;
-        cartJson["user_phone"] = cart.user_phone;
-        // items
-        cartJson["items"] = nlohmann::json::array();
-        for (const auto &it : cart.items) {
-            nlohmann::json item;
-            item["good_id"] = it.good_id;
-            item["good_name"] = it.good_name;
-            item["price"] = it.price;
-            item["quantity"] = it.quantity;
-            item["subtotal"] = it.subtotal;
-            cartJson["items"].push_back(item);
-        }
-
-        // 把 policy JSON 放到 cartJson["policy"]（如果 policyJson 非空）
-        if (!policyJson.empty()) {
-            try {
-                cartJson["policy"] = nlohmann::json::parse(policyJson);
-            } catch (...) {
-                cartJson["policy"] = policyJson; // 保底字符串
-            }
+nlohmann::json Client::CLTcartPayload(const TemporaryCart& cart, const std::string& policyJson) {
+    nlohmann::json j;
+    // 假定 TemporaryCart 能序列化为 JSON（若没有，请按字段组装）
+    nlohmann::json cartJson;
+    cartJson["cart_id"] = cart.cart_id;
+    cartJson["discount_amount"] = cart.discount_amount;
+    cartJson["discount_policy"] = cart.discount_policy;
+    cartJson["final_amount"] = cart.final_amount;
+    cartJson["is_converted"] = cart.is_converted;
+    cartJson["shipping_address"] = cart.shipping_address;
+    cartJson["total_amount"] = cart.total_amount;
+    cartJson["user_phone"] = cart.user_phone;
+    // items
+    cartJson["items"] = nlohmann::json::array();
+    for (const auto &it : cart.items) {
+        nlohmann::json item;
+        item["good_id"] = it.good_id;
+        item["good_name"] = it.good_name;
+        item["price"] = it.price;
+        item["quantity"] = it.quantity;
+        item["subtotal"] = it.subtotal;
+        cartJson["items"].push_back(item);
+    }
+
+    // 把 policy JSON 放到 cartJson["policy"]（如果 policyJson 非空）
+    if (!policyJson.empty()) {
+        try {
+            cartJson["policy"] = nlohmann::json::parse(policyJson);
+        } catch (...) {
+            cartJson["policy"] = policyJson; // 保底字符串
         }
+    }
 
-        j["cart"] = cartJson;
-        j["userPhone"] = cart.user_phone;
+    j["cart"] = cartJson;
+    j["userPhone"] = cart.user_phone;
+    return j;
+}
 
+bool Client::CLTsaveCartForUserWithPolicy(const TemporaryCart& cart, const std::string& policyJson) {
+    try {
         // 使用服务端支持的命令名 SAVE_CART
-        std::string req = std::string("SAVE_CART ") + j.dump();
+        std::string req = std::string("SAVE_CART ") + CLTcartPayload(cart, policyJson).dump();
         std::string resp = CLTsendRequest(req);
         if (resp.empty()) return false;
-        auto r = nlohmann::json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "saved";
     } catch (const std::exception& ex) {
         Logger::instance().fail(std::string("CLTsaveCartForUserWithPolicy exception: ") + ex.what());
@@ -528,7 +1030,7 @@ bool Client::CLTaddToCart(const std::string& userPhone, int productId, const std
     std::string resp = CLTsendRequest(std::string("ADD_TO_CART ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) { Logger::instance().fail("ADD_TO_CART 返回错误: " + r.dump()); return false; }
         return r.value("result", std::string("")) == "ok";
     }
@@ -543,7 +1045,7 @@ bool Client::CLTupdateCartItem(const std::string& userPhone, int productId, int
     std::string resp = CLTsendRequest(std::string("UPDATE_CART_ITEM ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "updated";
     }
     catch (...) {
@@ -557,7 +1059,7 @@ bool Client::CLTremoveFromCart(const std::string& userPhone, int productId) {
     std::string resp = CLTsendRequest(std::string("REMOVE_FROM_CART ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "removed";
     }
     catch (...) {
@@ -570,7 +1072,7 @@ bool Client::CLTupdateCartForPromotions(const std::string& userPhone) {
     std::string resp = CLTsendRequest(std::string("UPDATE_CART_FOR_PROMOTIONS ") + userPhone);
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) { Logger::instance().fail("UPDATE_CART_FOR_PROMOTIONS 返回错误: " + r.dump()); return false; }
         return true;
     }
@@ -581,37 +1083,40 @@ bool Client::CLTupdateCartForPromotions(const std::string& userPhone) {
 }
 
 // ---------------- 订单相关 ----------------
+nlohmann::json Client::CLTorderPayload(const Order& order) {
+    nlohmann::json payload;
+    payload["orderId"] = order.getOrderId();
+    payload["userPhone"] = order.getUserPhone();
+    payload["status"] = order.getStatus();
+    payload["discountPolicy"] = order.getDiscountPolicy();
+    // 把金额字段显式传给服务器，避免服务端忽略客户端计算结果
+    payload["total_amount"] = order.getTotalAmount();
+    payload["discount_amount"] = order.getDiscountAmount();
+    payload["final_amount"] = order.getFinalAmount();
+
+    // 加上收货地址
+    payload["shipping_address"] = order.getShippingAddress();
+
+    payload["items"] = nlohmann::json::array();
+    for (const auto& it : order.getItems()) {
+        nlohmann::json ji;
+        ji["productId"] = it.getGoodId();
+        ji["productName"] = it.getGoodName();
+        ji["price"] = it.getPrice();
+        ji["quantity"] = it.getQuantity();
+        ji["subtotal"] = it.getSubtotal();
+        payload["items"].push_back(ji);
+    }
+    return payload;
+}
+
 bool Client::CLTaddSettledOrder(const Order& order) {
     try {
-        nlohmann::json payload;
-        payload["orderId"] = order.getOrderId();
-        payload["userPhone"] = order.getUserPhone();
-        payload["status"] = order.getStatus();
-        payload["discountPolicy"] = order.getDiscountPolicy();
-        // 把金额字段显式传给服务器，避免服务端忽略客户端计算结果
-        payload["total_amount"] = order.getTotalAmount();
-        payload["discount_amount"] = order.getDiscountAmount();
-        payload["final_amount"] = order.getFinalAmount();
-
-        // 加上收货地址
-        payload["shipping_address"] = order.getShippingAddress();
-
-        payload["items"] = nlohmann::json::array();
-        for (const auto& it : order.getItems()) {
-            nlohmann::json ji;
-            ji["productId"] = it.getGoodId();
-            ji["productName"] = it.getGoodName();
-            ji["price"] = it.getPrice();
-            ji["quantity"] = it.getQuantity();
-            ji["subtotal"] = it.getSubtotal();
-            payload["items"].push_back(ji);
-        }
-
         // 发送为文本命令：与服务端其它命令一致的格式
-        std::string respStr = CLTsendRequest(std::string("ADD_SETTLED_ORDER ") + payload.dump());
+        std::string respStr = CLTsendRequest(std::string("ADD_SETTLED_ORDER ") + CLTorderPayload(order).dump());
         if (respStr.empty()) return false;
 
-        auto resp = nlohmann::json::parse(respStr);
+        auto resp = CLTdecodeResponse(respStr);
         if (resp.is_object() && resp.contains("result")) {
             std::string r = resp.value("result", std::string(""));
             return (r == "added" || r == "ok" || r == "saved");
@@ -649,7 +1154,7 @@ bool Client::CLTaddSettledOrderRaw(const std::string& orderId, const std::string
     std::string resp = CLTsendRequest(std::string("ADD_SETTLED_ORDER ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "added";
     }
     catch (...) {
@@ -659,77 +1164,85 @@ bool Client::CLTaddSettledOrderRaw(const std::string& orderId, const std::string
 }
 
 std::vector<Order> Client::CLTgetAllOrders(const std::string& userPhone) {
-    std::vector<Order> out;
     json j; j["userPhone"] = userPhone;
-    std::string resp = CLTsendRequest(std::string("GET_ALL_ORDERS ") + (userPhone.empty() ? std::string("{}") : j.dump()));
-    if (resp.empty()) return out;
-    try {
-        auto arr = json::parse(resp);
-        if (!arr.is_array()) { Logger::instance().fail("GET_ALL_ORDERS 响应不是数组"); return out; }
-        for (const auto& e : arr) {
-            std::string oid = e.value("order_id", e.value("orderId", std::string("")));
-            int status = e.value("status", 0);
-            double final_amount = e.value("final_amount", e.value("finalAmount", 0.0));
-            double total_amount = e.value("total_amount", e.value("totalAmount", 0.0));
-            std::string user_phone = e.value("user_phone", e.value("userPhone", std::string("")));
-            // 新增：尝试读取 shipping_address（兼容 snake_case / camelCase）
-            std::string shipping_address = e.value("shipping_address", e.value("shippingAddress", std::string("")));
-            // 兼容不同字段名：如果服务器只返回 final_amount，则将其作为 total_amount 的回退值
-            if ((total_amount == 0.0) && (final_amount != 0.0)) {
-                total_amount = final_amount;
-            }
+    return CLTparseOrders(CLTsendRequest(std::string("GET_ALL_ORDERS ") + (userPhone.empty() ? std::string("{}") : j.dump())));
+}
 
-            Order o(TemporaryCart(), oid, status);
-            o.setFinalAmount(final_amount);
-            o.setTotalAmount(total_amount);
-            if (!user_phone.empty()) o.setUserPhone(user_phone);
-            if (!shipping_address.empty()) o.setShippingAddress(shipping_address);
-
-            // 尝试解析 items（如果服务器在列表响应中包含简要的 items 信息）
-            std::vector<OrderItem> items;
-            if (e.contains("items") && e["items"].is_array()) {
-                for (const auto& it : e["items"]) {
-                    try {
-                        OrderItem oi;
-                        // 兼容不同字段命名（good_id / productId，good_name / productName）
-                        if (it.contains("good_id")) oi.setGoodId(it.value("good_id", 0));
-                        else if (it.contains("productId")) oi.setGoodId(it.value("productId", 0));
-                        if (it.contains("good_name")) oi.setGoodName(it.value("good_name", std::string("")));
-                        else if (it.contains("productName")) oi.setGoodName(it.value("productName", std::string("")));
-                        // 价格/数量/小计
-                        double price = it.value("price", 0.0);
-                        int qty = it.value("quantity", it.value("qty", 0));
-                        double subtotal = it.value("subtotal", price * qty);
-                        oi.setPrice(price);
-                        oi.setQuantity(qty);
-                        oi.setSubtotal(subtotal);
-                        oi.setOrderId(oid);
-                        items.push_back(oi);
-                    }
-                    catch (...) {
-                        Logger::instance().warn("GET_ALL_ORDERS: 解析某个订单项失败");
-                        continue;
-                    }
+// 列表响应中的订单（兼容 snake_case / camelCase 字段名）；解析失败抛出异常，已解析的订单保留在 out 中
+static void appendOrders(const json& arr, std::vector<Order>& out) {
+    for (const auto& e : arr) {
+        std::string oid = e.value("order_id", e.value("orderId", std::string("")));
+        int status = e.value("status", 0);
+        double final_amount = e.value("final_amount", e.value("finalAmount", 0.0));
+        double total_amount = e.value("total_amount", e.value("totalAmount", 0.0));
+        std::string user_phone = e.value("user_phone", e.value("userPhone", std::string("")));
+        // 新增：尝试读取 shipping_address（兼容 snake_case / camelCase）
+        std::string shipping_address = e.value("shipping_address", e.value("shippingAddress", std::string("")));
+        // 兼容不同字段名：如果服务器只返回 final_amount，则将其作为 total_amount 的回退值
+        if ((total_amount == 0.0) && (final_amount != 0.0)) {
+            total_amount = final_amount;
+        }
+
+        Order o(TemporaryCart(), oid, status);
+        o.setFinalAmount(final_amount);
+        o.setTotalAmount(total_amount);
+        if (!user_phone.empty()) o.setUserPhone(user_phone);
+        if (!shipping_address.empty()) o.setShippingAddress(shipping_address);
+
+        // 尝试解析 items（如果服务器在列表响应中包含简要的 items 信息）
+        std::vector<OrderItem> items;
+        if (e.contains("items") && e["items"].is_array()) {
+            for (const auto& it : e["items"]) {
+                try {
+                    OrderItem oi;
+                    // 兼容不同字段命名（good_id / productId，good_name / productName）
+                    if (it.contains("good_id")) oi.setGoodId(it.value("good_id", 0));
+                    else if (it.contains("productId")) oi.setGoodId(it.value("productId", 0));
+                    if (it.contains("good_name")) oi.setGoodName(it.value("good_name", std::string("")));
+                    else if (it.contains("productName")) oi.setGoodName(it.value("productName", std::string("")));
+                    // 价格/数量/小计
+                    double price = it.value("price", 0.0);
+                    int qty = it.value("quantity", it.value("qty", 0));
+                    double subtotal = it.value("subtotal", price * qty);
+                    oi.setPrice(price);
+                    oi.setQuantity(qty);
+                    oi.setSubtotal(subtotal);
+                    oi.setOrderId(oid);
+                    items.push_back(oi);
+                }
+                catch (...) {
+                    Logger::instance().warn("GET_ALL_ORDERS: 解析某个订单项失败");
+                    continue;
                 }
             }
-            else {
-                // 有时服务器返回 items_count / count 字段而非数组，尝试读取
-                int count = 0;
-                if (e.contains("items_count")) count = e.value("items_count", 0);
-                else if (e.contains("count")) count = e.value("count", 0);
-                if (count > 0) {
-                    items.reserve(count);
-                    for (int i = 0; i < count; ++i) {
-                        OrderItem oi;
-                        oi.setOrderId(oid);
-                        items.push_back(oi);
-                    }
+        }
+        else {
+            // 有时服务器返回 items_count / count 字段而非数组，尝试读取
+            int count = 0;
+            if (e.contains("items_count")) count = e.value("items_count", 0);
+            else if (e.contains("count")) count = e.value("count", 0);
+            if (count > 0) {
+                items.reserve(count);
+                for (int i = 0; i < count; ++i) {
+                    OrderItem oi;
+                    oi.setOrderId(oid);
+                    items.push_back(oi);
                 }
             }
-
-            if (!items.empty()) o.setItems(items);
-            out.push_back(o);
         }
+
+        if (!items.empty()) o.setItems(items);
+        out.push_back(o);
+    }
+}
+
+std::vector<Order> Client::CLTparseOrders(const std::string& resp) {
+    std::vector<Order> out;
+    if (resp.empty()) return out;
+    try {
+        auto arr = CLTdecodeResponse(resp);
+        if (!arr.is_array()) { Logger::instance().fail("GET_ALL_ORDERS 响应不是数组"); return out; }
+        appendOrders(arr, out);
     }
     catch (...) {
         Logger::instance().fail("GET_ALL_ORDERS 解析失败");
@@ -737,12 +1250,122 @@ std::vector<Order> Client::CLTgetAllOrders(const std::string& userPhone) {
     return out;
 }
 
+// ---------------- 分页 ----------------
+// 分页响应的公共部分：解码并校验 {"has_more","items","next_after_id"}，错误响应返回 false
+static bool decodePage(const std::string& resp, const char* cmd, json& page) {
+    if (resp.empty()) return false;
+    try {
+        page = Client::CLTdecodeResponse(resp);
+    }
+    catch (const std::exception& e) {
+        Logger::instance().fail(std::string(cmd) + " 解析失败: " + e.what());
+        return false;
+    }
+    if (!page.is_object() || page.contains("error") || !page.contains("items") || !page["items"].is_array()) {
+        Logger::instance().fail(std::string(cmd) + " 返回错误: " + page.dump());
+        return false;
+    }
+    return true;
+}
+
+static json goodsPageJson(const Client::GoodsFilter& filter, int afterId, int limit) {
+    json j; j["after_id"] = afterId; j["limit"] = limit;
+    if (!filter.name.empty()) j["name"] = filter.name;
+    if (!filter.category.empty()) j["category"] = filter.category;
+    if (filter.minPrice > 0.0) j["min_price"] = filter.minPrice;
+    if (filter.maxPrice >= 0.0) j["max_price"] = filter.maxPrice;
+    return j;
+}
+
+size_t Client::Batch::getGoodsPage(int afterId, int limit, const GoodsFilter& filter) {
+    return add("GET_GOODS_PAGE", goodsPageJson(filter, afterId, limit));
+}
+
+Client::GoodsPage Client::CLTgetGoodsPage(int afterId, int limit, const GoodsFilter& filter) {
+    return CLTparseGoodsPage(CLTsendRequest("GET_GOODS_PAGE " + goodsPageJson(filter, afterId, limit).dump()));
+}
+
+Client::GoodsPage Client::CLTparseGoodsPage(const std::string& resp) {
+    GoodsPage page;
+    json j;
+    if (!decodePage(resp, "GET_GOODS_PAGE", j)) return page;
+    appendGoods(j["items"], page.items);
+    page.hasMore = j.value("has_more", false);
+    if (j.contains("next_after_id") && j["next_after_id"].is_number_integer()) page.nextAfter = j["next_after_id"].get<int>();
+    return page;
+}
+
+static json accountsPageJson(const std::string& phone, const std::string& afterPhone, int limit) {
+    json j; j["after_id"] = afterPhone; j["limit"] = limit;
+    if (!phone.empty()) j["phone"] = phone;
+    return j;
+}
+
+size_t Client::Batch::getAccountsPage(const std::string& afterPhone, int limit, const std::string& phone) {
+    return add("GET_ACCOUNTS_PAGE", accountsPageJson(phone, afterPhone, limit));
+}
+
+Client::AccountsPage Client::CLTgetAccountsPage(const std::string& afterPhone, int limit, const std::string& phone) {
+    return CLTparseAccountsPage(CLTsendRequest("GET_ACCOUNTS_PAGE " + accountsPageJson(phone, afterPhone, limit).dump()));
+}
+
+Client::AccountsPage Client::CLTparseAccountsPage(const std::string& resp) {
+    AccountsPage page;
+    json j;
+    if (!decodePage(resp, "GET_ACCOUNTS_PAGE", j)) return page;
+    appendAccounts(j["items"], page.items);
+    page.hasMore = j.value("has_more", false);
+    if (j.contains("next_after_id") && j["next_after_id"].is_string()) page.nextAfter = j["next_after_id"].get<std::string>();
+    return page;
+}
+
+Client::OrdersPage Client::CLTgetOrdersPage(const std::string& afterOrderId, int limit) {
+    json j; j["after_id"] = afterOrderId; j["limit"] = limit;
+    return CLTparseOrdersPage(CLTsendRequest("GET_ORDERS_PAGE " + j.dump()));
+}
+
+static json orderQueryJson(const Client::OrderFilter& filter, const std::string& afterOrderId, int limit) {
+    json j; j["after_id"] = afterOrderId; j["limit"] = limit;
+    if (!filter.userPhone.empty()) j["userPhone"] = filter.userPhone;
+    if (!filter.statuses.empty()) j["statuses"] = filter.statuses;
+    if (!filter.from.empty()) j["from"] = filter.from;
+    if (!filter.to.empty()) j["to"] = filter.to;
+    return j;
+}
+
+size_t Client::Batch::queryOrders(const OrderFilter& filter, const std::string& afterOrderId, int limit) {
+    return add("QUERY_ORDERS", orderQueryJson(filter, afterOrderId, limit));
+}
+
+Client::OrdersPage Client::CLTqueryOrders(const OrderFilter& filter, const std::string& afterOrderId, int limit) {
+    return CLTparseOrdersPage(CLTsendRequest("QUERY_ORDERS " + orderQueryJson(filter, afterOrderId, limit).dump()));
+}
+
+Client::OrdersPage Client::CLTparseOrdersPage(const std::string& resp) {
+    OrdersPage page;
+    json j;
+    if (!decodePage(resp, "GET_ORDERS_PAGE", j)) return page;
+    try {
+        appendOrders(j["items"], page.items);
+    }
+    catch (...) {
+        Logger::instance().fail("GET_ORDERS_PAGE 解析失败");
+        return page;
+    }
+    page.hasMore = j.value("has_more", false);
+    if (j.contains("next_after_id") && j["next_after_id"].is_string()) page.nextAfter = j["next_after_id"].get<std::string>();
+    return page;
+}
+
 bool Client::CLTgetOrderDetail(const std::string& orderId, const std::string& userPhone, Order& outOrder) {
     json j; j["orderId"] = orderId; j["userPhone"] = userPhone;
-    std::string resp = CLTsendRequest(std::string("GET_ORDER_DETAIL ") + j.dump());
+    return CLTparseOrderDetail(CLTsendRequest(std::string("GET_ORDER_DETAIL ") + j.dump()), outOrder);
+}
+
+bool Client::CLTparseOrderDetail(const std::string& resp, Order& outOrder) {
     if (resp.empty()) return false;
     try {
-        auto jo = json::parse(resp);
+        auto jo = CLTdecodeResponse(resp);
         if (jo.is_object() && jo.contains("error")) { Logger::instance().fail("GET_ORDER_DETAIL 返回错误: " + jo.dump()); return false; }
         // 填充 Order
         outOrder = Order(); // reset
@@ -764,7 +1387,7 @@ bool Client::CLTgetOrderDetail(const std::string& orderId, const std::string& us
                 if (it.contains("price")) oi.setPrice(it.value("price", 0.0));
                 if (it.contains("quantity")) oi.setQuantity(it.value("quantity", 0));
                 if (it.contains("subtotal")) oi.setSubtotal(it.value("subtotal", 0.0));
-                oi.setOrderId(orderId);
+                oi.setOrderId(outOrder.getOrderId());
                 items.push_back(oi);
             }
         }
@@ -796,7 +1419,7 @@ bool Client::CLTupdateOrderStatus(const std::string& orderId, const std::string&
     std::string resp = CLTsendRequest(std::string("UPDATE_ORDER_STATUS ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "updated";
     }
     catch (...) {
@@ -818,7 +1441,7 @@ bool Client::CLTreturnSettledOrder(const std::string& orderId, const std::string
     std::string resp = CLTsendRequest(std::string("RETURN_SETTLED_ORDER ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) { Logger::instance().fail("RETURN_SETTLED_ORDER 返回错误: " + r.dump()); return false; }
         return true;
     }
@@ -841,7 +1464,7 @@ bool Client::CLTrepairSettledOrder(const std::string& orderId, const std::string
     std::string resp = CLTsendRequest(std::string("REPAIR_SETTLED_ORDER ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("error")) { Logger::instance().fail("REPAIR_SETTLED_ORDER 返回错误: " + r.dump()); return false;
         }
         return true;
@@ -865,7 +1488,7 @@ bool Client::CLTdeleteSettledOrder(const std::string& orderId, const std::string
     std::string resp = CLTsendRequest(std::string("DELETE_SETTLED_ORDER ") + j.dump());
     if (resp.empty()) return false;
     try {
-        auto r = json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         return r.value("result", std::string("")) == "deleted";
     }
     catch (...) {
@@ -880,7 +1503,7 @@ std::vector<std::shared_ptr<PromotionStrategy>> Client::CLTgetAllPromotions() {
     std::string resp = CLTsendRequest("GET_ALL_PROMOTIONS");
     if (resp.empty()) return out;
     try {
-        auto arr = nlohmann::json::parse(resp);
+        auto arr = CLTdecodeResponse(resp);
         if (!arr.is_array()) return out;
         for (const auto& e : arr) {
             try {
@@ -904,7 +1527,7 @@ std::vector<std::shared_ptr<PromotionStrategy>> Client::CLTgetPromotionsByProduc
     std::string resp = CLTsendRequest(req);
     if (resp.empty()) return out;
     try {
-        auto arr = nlohmann::json::parse(resp);
+        auto arr = CLTdecodeResponse(resp);
         if (!arr.is_array()) return out;
         for (const auto& e : arr) {
             try {
@@ -923,7 +1546,7 @@ bool Client::CLTaddPromotion(const nlohmann::json& promotion) {
         std::string req = std::string("ADD_PROMOTION ") + promotion.dump();
         std::string resp = CLTsendRequest(req);
         if (resp.empty()) return false;
-        auto j = nlohmann::json::parse(resp);
+        auto j = CLTdecodeResponse(resp);
         if (j.is_object() && j.contains("result") && j["result"] == "added") return true;
         return false;
     } catch (...) {
@@ -939,7 +1562,7 @@ bool Client::CLTupdatePromotion(const std::string& name, const nlohmann::json& p
         std::string req = std::string("UPDATE_PROMOTION ") + j.dump();
         std::string resp = CLTsendRequest(req);
         if (resp.empty()) return false;
-        auto r = nlohmann::json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("result")) {
             std::string res = r.value("result", std::string(""));
             // 接受 updated 或 renamed 为成功
@@ -959,7 +1582,7 @@ bool Client::CLTdeletePromotion(const std::string& name) {
         std::string req = std::string("DELETE_PROMOTION ") + j.dump();
         std::string resp = CLTsendRequest(req);
         if (resp.empty()) return false;
-        auto r = nlohmann::json::parse(resp);
+        auto r = CLTdecodeResponse(resp);
         if (r.is_object() && r.contains("result") && r["result"] == "deleted") return true;
         return false;
     } catch (...) {
@@ -969,14 +1592,17 @@ bool Client::CLTdeletePromotion(const std::string& name) {
 }
 
 std::vector<nlohmann::json> Client::CLTgetAllPromotionsRaw() {
+    return CLTparsePromotionsRaw(CLTsendRequest("GET_ALL_PROMOTIONS"));
+}
+
+std::vector<nlohmann::json> Client::CLTparsePromotionsRaw(const std::string& resp) {
     std::vector<nlohmann::json> out;
     try {
-        std::string resp = CLTsendRequest("GET_ALL_PROMOTIONS");
         if (resp.empty()) {
             Logger::instance().info("CLTgetAllPromotionsRaw: empty response");
             return out;
         }
-        auto arr = nlohmann::json::parse(resp);
+        auto arr = CLTdecodeResponse(resp);
         if (!arr.is_array()) {
             Logger::instance().warn("CLTgetAllPromotionsRaw: response is not an array: " + arr.dump());
             return out;
@@ -3,6 +3,10 @@
 #include <vector>
 #include <map>
 #include <mutex>
+#include <memory>
+#include <functional>
+#include <future>
+#include <utility>
 #include "good.h"
 #include "user.h"
 #include "cartItem.h"
@@ -12,10 +16,15 @@
 #include "TemporaryCart.h"
 #include "logger.h"
 #include "admin.h"
+#include "WireProtocol.h"
 #include <QTcpSocket>
+#include <QLocalSocket>
 #include <QHostAddress>
 #include <QMutexLocker>
 #include <QString>
+#include <QObject>
+#include <QPointer>
+#include <QMetaObject>
 #include <QByteArray>
 #include <nlohmann/json.hpp>
 
@@ -25,6 +34,10 @@ private:
     Impl* pImpl;
     std::recursive_mutex requestMutex;
 
+    // 请求体构造（单条请求与 Batch 共用）
+    static nlohmann::json CLTcartPayload(const TemporaryCart& cart, const std::string& policyJson);
+    static nlohmann::json CLTorderPayload(const Order& order);
+
 public:
     Client(const std::string& ip = "127.0.0.1", int port = 8888);
     ~Client();
@@ -39,11 +52,192 @@ public:
     void CLTdisconnect();
     bool CLTisConnectionActive() const;
 
+    // 线路协议：默认 Framed（长度前缀帧，收齐即返回）；连接旧版服务端时设为 Legacy
+    void CLTsetWireMode(WireMode mode);
+    WireMode CLTwireMode() const;
+
+    // 进程内通道：默认开启，连接时若本进程内已有 Server 在同一端口注册则不走 TCP（需在连接前设置）
+    void CLTsetInProcess(bool allowed);
+    bool CLTisInProcess() const;
+
+    // 本地套接字：非空时经 QLocalSocket 连接同名的 Server 端点（Server::SERsetLocalSocket），
+    // 协议与 TCP 完全相同；连接失败时退回 TCP。空表示只用 TCP（需在连接前设置）
+    void CLTsetLocalSocket(const std::string& name);
+    std::string CLTlocalSocket() const;
+
+    // 响应编码：默认文本 JSON；设为 Cbor/MessagePack 后每次建立 Framed 连接时与服务端协商（SET_ENCODING），
+    // 服务端不支持时保持文本（需在连接前设置；进程内通道与 Legacy 模式始终为文本）
+    void CLTsetEncoding(WireEncoding encoding);
+    WireEncoding CLTencoding() const;
+
+    // 响应压缩：minBytes 非 0 时每次建立 Framed 连接时协商 SET_COMPRESSION，服务端对不小于该字节数的响应做 zlib 压缩，
+    // 接收时透明解压；0 表示不压缩（默认）。需在连接前设置；进程内通道与 Legacy 模式始终不压缩
+    void CLTsetCompression(size_t minBytes);
+    size_t CLTcompression() const;
+
+    // 返回的响应串可能是二进制编码（首字节为 WireFrame::FlagCbor/FlagMsgPack，其后为编码数据），
+    // 应经 CLTdecodeResponse 解析而非直接 json::parse；CLTresponseText 转为文本 JSON（用于日志）
+    static nlohmann::json CLTdecodeResponse(const std::string& resp, bool allowExceptions = true);
+    static std::string CLTresponseText(const std::string& resp);
+
     std::string CLTsendRequest(const std::string& request);
+    // 流水线：Framed 模式下全部请求带 id 一次写出，响应按 id 匹配（服务端可并行处理、乱序返回），
+    // 总耗时约为一次往返；返回值与 requests 一一对应，失败/超时的项为空串。Legacy 模式下逐条发送
+    std::vector<std::string> CLTsendRequests(const std::vector<std::string>& requests);
+
+    // 订单筛选条件（对应 QUERY_ORDERS），空字段表示不限；
+    // 时间为 yyyyMMddHHmmsszzz 或其前缀（本地时间，与订单号中的时间戳同格式），两端都包含
+    struct OrderFilter {
+        std::string userPhone;
+        std::vector<int> statuses;
+        std::string from;
+        std::string to;
+    };
+    // 商品筛选条件（GET_GOODS_PAGE 的可选参数），空字段表示不限；名称、分类为部分匹配（不区分大小写），价格含两端
+    struct GoodsFilter {
+        std::string name;
+        std::string category;
+        double minPrice = 0.0;
+        double maxPrice = -1.0; // 小于 0 表示不限
+    };
+
+    // ---------------- 批量请求 ----------------
+    // 把多条命令合并为一次 BATCH 请求（一次往返）；add* 返回该子请求在结果中的下标
+    class Batch {
+    public:
+        // transactional=true 时服务端在同一数据库事务内执行全部子请求，任一失败则整体回滚
+        explicit Batch(bool transactional = false) : transactional_(transactional) {}
+
+        // args 为 null 时只发送命令名；字符串按原样作为纯文本参数，其余按 JSON 发送
+        size_t add(const std::string& cmd, const nlohmann::json& args = nlohmann::json());
+        size_t getAllGoods() { return add("GET_ALL_GOODS"); }
+        size_t getGoodById(int id) { return add("GET_GOOD_BY_ID", std::to_string(id)); }
+        size_t getCart(const std::string& userPhone) { return add("GET_CART", userPhone); }
+        size_t getAllOrders(const std::string& userPhone = "") {
+            return add("GET_ALL_ORDERS", userPhone.empty() ? nlohmann::json::object() : nlohmann::json{ {"userPhone", userPhone} });
+        }
+        size_t getAllPromotions() { return add("GET_ALL_PROMOTIONS"); }
+        size_t getAllAccounts() { return add("GET_ALL_ACCOUNTS"); }
+        size_t getGoodsPage(int afterId, int limit) { return getGoodsPage(afterId, limit, GoodsFilter()); }
+        size_t getGoodsPage(int afterId, int limit, const GoodsFilter& filter);
+        size_t getAccountsPage(const std::string& afterPhone, int limit, const std::string& phone = std::string());
+        size_t getOrdersPage(const std::string& afterOrderId, int limit) {
+            return add("GET_ORDERS_PAGE", nlohmann::json{ {"after_id", afterOrderId}, {"limit", limit} });
+        }
+        size_t queryOrders(const OrderFilter& filter, const std::string& afterOrderId, int limit);
+        size_t getOrderDetail(const std::string& orderId, const std::string& userPhone) {
+            return add("GET_ORDER_DETAIL", nlohmann::json{ {"orderId", orderId}, {"userPhone", userPhone} });
+        }
+        // 写请求：请求体与 CLTsaveCartForUserWithPolicy / CLTaddSettledOrder 相同
+        size_t saveCartWithPolicy(const TemporaryCart& cart, const std::string& policyJson);
+        size_t addSettledOrder(const Order& order);
+
+        size_t size() const { return lines_.size(); }
+        bool empty() const { return lines_.empty(); }
+        bool transactional() const { return transactional_; }
+        // 每条子请求的 "CMD args" 文本
+        const std::vector<std::string>& lines() const { return lines_; }
+
+    private:
+        bool transactional_;
+        std::vector<std::string> lines_;
+    };
+
+    struct BatchResult {
+        bool ok = false;                    // 已收到响应（事务模式下还要求已提交）
+        std::string error;                  // 顶层错误（如 batch_rolled_back），成功时为空
+        int failedIndex = -1;               // 事务回滚时导致失败的子请求下标
+        std::vector<std::string> responses; // 与 Batch 中的子请求一一对应的原始响应，可交给下面的 CLTparse* 解析
+        const std::string& operator[](size_t i) const { return responses.at(i); }
+    };
+
+    // 发送 BATCH；服务端不支持 BATCH（旧版本）且非事务模式时退化为逐条发送
+    BatchResult CLTbatch(const Batch& batch);
+    // 以流水线方式发送 Batch 中的子请求（各自独立，忽略 transactional）：
+    // 与 CLTbatch 相比服务端可在多个工作线程上并行执行；任一项无响应时 ok=false、failedIndex 为其下标
+    BatchResult CLTpipeline(const Batch& batch);
+
+    // 键集分页的一页：nextAfter 为请求下一页时的游标（本页最后一项的主键），hasMore 为 false 表示已到末尾
+    template <typename T, typename Key>
+    struct Page {
+        std::vector<T> items;
+        Key nextAfter{};
+        bool hasMore = false;
+    };
+    using GoodsPage = Page<Good, int>;
+    using AccountsPage = Page<User, std::string>;
+    using OrdersPage = Page<Order, std::string>;
+
+    // 响应解析（与对应的 CLTget* 行为一致），用于解析批量结果中的单条响应
+    static std::vector<Good> CLTparseGoods(const std::string& resp);
+    static bool CLTparseGood(const std::string& resp, Good& outGood);
+    static TemporaryCart CLTparseCart(const std::string& resp);
+    static std::vector<Order> CLTparseOrders(const std::string& resp);
+    static std::vector<nlohmann::json> CLTparsePromotionsRaw(const std::string& resp);
+    static std::vector<User> CLTparseAccounts(const std::string& resp);
+    static GoodsPage CLTparseGoodsPage(const std::string& resp);
+    static AccountsPage CLTparseAccountsPage(const std::string& resp);
+    static OrdersPage CLTparseOrdersPage(const std::string& resp);
+    static bool CLTparseOrderDetail(const std::string& resp, Order& outOrder);
+
+    // ---------------- 异步调用 ----------------
+    // 异步请求在独立的网络线程上执行：该线程持有自己的 Client（独立连接，线路协议与本对象一致），
+    // 任务按提交顺序串行执行，调用方（UI 线程）不会被阻塞。
+    // 提交任务；网络线程首次使用时启动。Client 析构后提交的任务被丢弃并返回 false
+    bool CLTsubmitAsync(std::function<void(Client&)> task);
+
+    // 回调形式：call(Client&) 在网络线程执行，done(result) 回到 context 所在线程执行；
+    // context 已销毁时结果被丢弃（窗口关闭后不会回调到已释放的对象）
+    template<class Call, class Done>
+    bool CLTasync(QObject* context, Call call, Done done) {
+        QPointer<QObject> guard(context);
+        return CLTsubmitAsync([call, done, guard](Client& worker) mutable {
+            using Result = decltype(call(worker));
+            auto result = std::make_shared<Result>(call(worker));
+            if (!guard) return;
+            QMetaObject::invokeMethod(guard.data(), [done, result, guard]() mutable {
+                if (guard) done(std::move(*result));
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    // future 形式：适用于非 UI 调用方
+    template<class Call>
+    auto CLTasync(Call call) -> std::future<decltype(call(std::declval<Client&>()))> {
+        using Result = decltype(call(std::declval<Client&>()));
+        auto promise = std::make_shared<std::promise<Result>>();
+        std::future<Result> future = promise->get_future();
+        CLTsubmitAsync([call, promise](Client& worker) mutable {
+            try { promise->set_value(call(worker)); }
+            catch (...) { promise->set_exception(std::current_exception()); }
+        });
+        return future;
+    }
+
+    // 常用调用的异步版本（回调形式）；其余调用可直接通过 CLTasync 包装
+    bool CLTgetAllGoodsAsync(QObject* context, std::function<void(std::vector<Good>)> done) {
+        return CLTasync(context, [](Client& c) { return c.CLTgetAllGoods(); }, std::move(done));
+    }
+    bool CLTgetAllOrdersAsync(QObject* context, const std::string& userPhone, std::function<void(std::vector<Order>)> done) {
+        return CLTasync(context, [userPhone](Client& c) { return c.CLTgetAllOrders(userPhone); }, std::move(done));
+    }
+    bool CLTgetCartForUserAsync(QObject* context, const std::string& userPhone, std::function<void(TemporaryCart)> done) {
+        return CLTasync(context, [userPhone](Client& c) { return c.CLTgetCartForUser(userPhone); }, std::move(done));
+    }
+    bool CLTaddSettledOrderAsync(QObject* context, const Order& order, std::function<void(bool)> done) {
+        return CLTasync(context, [order](Client& c) { return c.CLTaddSettledOrder(order); }, std::move(done));
+    }
+    bool CLTsaveCartForUserWithPolicyAsync(QObject* context, const TemporaryCart& cart, const std::string& policyJson, std::function<void(bool)> done) {
+        return CLTasync(context, [cart, policyJson](Client& c) { return c.CLTsaveCartForUserWithPolicy(cart, policyJson); }, std::move(done));
+    }
 
     // ---------------- 商品相关（对应 Server 的商品 API） ----------------
     // 对应 SERgetAllGoods
     std::vector<Good> CLTgetAllGoods();
+    // 对应 SERgetGoodsPage：id 大于 afterId 的至多 limit 个商品（按 id 升序），afterId 为 0 时取第一页；
+    // 筛选在服务端进行，各页只含满足 filter 的商品
+    GoodsPage CLTgetGoodsPage(int afterId, int limit) { return CLTgetGoodsPage(afterId, limit, GoodsFilter()); }
+    GoodsPage CLTgetGoodsPage(int afterId, int limit, const GoodsFilter& filter);
     // 对应 SERupdateGood
     bool CLTupdateGood(int id, const std::string& name, double price, int stock, const std::string& category);
     // 对应 SERaddGood
@@ -58,6 +252,8 @@ public:
     // ---------------- 用户相关（对应 Server 的用户 API） ----------------
     // 对应 SERgetAllAccounts
     std::vector<User> CLTgetAllAccounts();
+    // 对应 SERgetAccountsPage：按手机号升序，afterPhone 为空时取第一页；phone 非空时只返回手机号包含它的用户
+    AccountsPage CLTgetAccountsPage(const std::string& afterPhone, int limit, const std::string& phone = std::string());
     // 对应 SERlogin
     bool CLTlogin(const std::string& phone, const std::string& password);
     // 对应 SERupdateAccountPassword
@@ -86,6 +282,10 @@ public:
     // ---------------- 订单相关（对应 Server 的订单 API） ----------------
     // 对应 SERgetAllOrders
     std::vector<Order> CLTgetAllOrders(const std::string& userPhone = "");
+    // 对应 SERgetOrdersPage：按订单号倒序（最新在前），afterOrderId 为空时取第一页；只含订单头
+    OrdersPage CLTgetOrdersPage(const std::string& afterOrderId, int limit);
+    // 对应 SERqueryOrders：在服务端按 filter 筛选后分页，排序与游标同 CLTgetOrdersPage；结果用 CLTparseOrdersPage 解析
+    OrdersPage CLTqueryOrders(const OrderFilter& filter, const std::string& afterOrderId, int limit);
     // 对应 SERgetOrderDetail
     bool CLTgetOrderDetail(const std::string& orderId, const std::string& userPhone, Order& outOrder);
     // 对应 SERupdateOrderStatus
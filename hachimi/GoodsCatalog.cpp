@@ -0,0 +1,164 @@
+#include "GoodsCatalog.h"
+#include <algorithm>
+#include <mutex>
+
+static void bump(std::atomic<uint64_t>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool GoodsCatalog::isFresh() const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    if (!loaded_) return false;
+    if (maxAgeMs_ <= 0) return true;
+    return std::chrono::steady_clock::now() - loadedAt_ < std::chrono::milliseconds(maxAgeMs_);
+}
+
+uint64_t GoodsCatalog::version() const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    return version_;
+}
+
+bool GoodsCatalog::reset(const std::vector<Good>& goods, uint64_t expectedVersion) {
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    if (version_ != expectedVersion) return false;
+    byId_.clear();
+    byCategory_.clear();
+    for (const auto& g : goods) indexLocked(g);
+    loaded_ = true;
+    loadedAt_ = std::chrono::steady_clock::now();
+    ++version_;
+    ++reloads_;
+    return true;
+}
+
+void GoodsCatalog::invalidate() {
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    loaded_ = false;
+    ++version_;
+}
+
+bool GoodsCatalog::find(int id, Good& out) const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    auto it = byId_.find(id);
+    if (it == byId_.end()) {
+        bump(misses_);
+        return false;
+    }
+    out = it->second;
+    bump(hits_);
+    return true;
+}
+
+std::vector<Good> GoodsCatalog::all() const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    std::vector<Good> goods;
+    goods.reserve(byId_.size());
+    for (const auto& kv : byId_) goods.push_back(kv.second);
+    bump(hits_);
+    return goods;
+}
+
+size_t GoodsCatalog::forEach(const std::function<void(const Good&)>& fn) const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    for (const auto& kv : byId_) fn(kv.second);
+    bump(hits_);
+    return byId_.size();
+}
+
+std::vector<Good> GoodsCatalog::page(int afterId, size_t limit, bool descending,
+                                     const std::function<bool(const Good&)>& filter) const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    std::vector<Good> goods;
+    goods.reserve((std::min)(limit, byId_.size()));
+    auto take = [&](const Good& g) {
+        if (!filter || filter(g)) goods.push_back(g);
+    };
+    if (!descending) {
+        for (auto it = afterId > 0 ? byId_.upper_bound(afterId) : byId_.begin(); it != byId_.end() && goods.size() < limit; ++it) {
+            take(it->second);
+        }
+    } else {
+        auto it = afterId > 0 ? byId_.lower_bound(afterId) : byId_.end();
+        while (it != byId_.begin() && goods.size() < limit) take((--it)->second);
+    }
+    bump(hits_);
+    return goods;
+}
+
+std::vector<Good> GoodsCatalog::byCategory(const std::string& category) const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    std::vector<Good> goods;
+    auto it = byCategory_.find(category);
+    if (it != byCategory_.end()) {
+        goods.reserve(it->second.size());
+        for (int id : it->second) goods.push_back(byId_.at(id));
+    }
+    bump(hits_);
+    return goods;
+}
+
+void GoodsCatalog::recordMiss() const {
+    bump(misses_);
+}
+
+void GoodsCatalog::upsert(const Good& g) {
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    unindexLocked(g.getId());
+    indexLocked(g);
+    ++version_;
+}
+
+void GoodsCatalog::erase(int id) {
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    unindexLocked(id);
+    ++version_;
+}
+
+void GoodsCatalog::setStock(int id, int stock) {
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    auto it = byId_.find(id);
+    if (it != byId_.end()) {
+        const Good& g = it->second;
+        it->second = Good(g.getId(), g.getName(), g.getPrice(), stock, g.getCategory());
+    }
+    ++version_;
+}
+
+void GoodsCatalog::adjustStock(int id, int delta) {
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    auto it = byId_.find(id);
+    if (it != byId_.end()) {
+        const Good& g = it->second;
+        int stock = g.getStock() + delta;
+        if (stock < 0) stock = 0;
+        it->second = Good(g.getId(), g.getName(), g.getPrice(), stock, g.getCategory());
+    }
+    ++version_;
+}
+
+GoodsCatalog::Stats GoodsCatalog::stats() const {
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    Stats s;
+    s.hits = hits_.load(std::memory_order_relaxed);
+    s.misses = misses_.load(std::memory_order_relaxed);
+    s.reloads = reloads_;
+    s.size = byId_.size();
+    s.loaded = loaded_;
+    return s;
+}
+
+void GoodsCatalog::indexLocked(const Good& g) {
+    byId_[g.getId()] = g;
+    byCategory_[g.getCategory()].insert(g.getId());
+}
+
+void GoodsCatalog::unindexLocked(int id) {
+    auto it = byId_.find(id);
+    if (it == byId_.end()) return;
+    auto cit = byCategory_.find(it->second.getCategory());
+    if (cit != byCategory_.end()) {
+        cit->second.erase(id);
+        if (cit->second.empty()) byCategory_.erase(cit);
+    }
+    byId_.erase(it);
+}
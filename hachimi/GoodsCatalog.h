@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "good.h"
+
+// 服务端商品目录缓存
+// - 按 id（有序，与 DTBloadAllGoods 的主键顺序一致）和按分类建立索引
+// - 由 Server 在增删改商品、扣减/恢复库存时同步写入（write-through）
+// - 读多写少：读操作持共享锁，可被多个工作线程并发执行
+// - 整表加载在锁外完成，通过版本号避免旧数据覆盖加载期间发生的写入
+class GoodsCatalog {
+public:
+    struct Stats {
+        uint64_t hits = 0;     // 由缓存直接返回的读请求
+        uint64_t misses = 0;   // 需要回源数据库的读请求
+        uint64_t reloads = 0;  // 整表加载次数
+        size_t size = 0;       // 当前缓存的商品数
+        bool loaded = false;
+    };
+
+    explicit GoodsCatalog(int maxAgeMs = 60000) : maxAgeMs_(maxAgeMs) {}
+
+    // 是否已加载且未超过最大存活时间（超时后由调用方整表重新加载，兜底外部直接改库的情况）
+    bool isFresh() const;
+    // 当前版本号；整表加载前读取，加载后传给 reset
+    uint64_t version() const;
+    // 用整表数据替换缓存；若加载期间发生过写入（版本号变化）则放弃并返回 false
+    bool reset(const std::vector<Good>& goods, uint64_t expectedVersion);
+    void invalidate();
+
+    // 读取；命中/未命中计入统计
+    bool find(int id, Good& out) const;
+    std::vector<Good> all() const;
+    // 持共享锁按 id 顺序逐个回调，不复制整表（用于流式输出大列表）；回调内不得再调用本对象的写方法
+    size_t forEach(const std::function<void(const Good&)>& fn) const;
+    // 按 id 分页：afterId（不含）之后至多 limit 个，afterId <= 0 时从头（倒序时从尾）开始。
+    // filter 非空时只收集满足条件的商品，扫描到凑满一页为止
+    std::vector<Good> page(int afterId, size_t limit, bool descending = false,
+                           const std::function<bool(const Good&)>& filter = nullptr) const;
+    std::vector<Good> byCategory(const std::string& category) const;
+    // 调用方因缓存不可用而回源数据库时记一次未命中
+    void recordMiss() const;
+
+    // 写入（write-through）
+    void upsert(const Good& g);
+    void erase(int id);
+    void setStock(int id, int stock);
+    void adjustStock(int id, int delta);
+
+    Stats stats() const;
+
+private:
+    void indexLocked(const Good& g);
+    void unindexLocked(int id);
+
+    mutable std::shared_mutex mtx_;
+    std::map<int, Good> byId_;
+    std::unordered_map<std::string, std::set<int>> byCategory_;
+    bool loaded_ = false;
+    uint64_t version_ = 0;
+    std::chrono::steady_clock::time_point loadedAt_;
+    int maxAgeMs_;
+
+    // 读操作只持共享锁，计数器用原子变量
+    mutable std::atomic<uint64_t> hits_{ 0 };
+    mutable std::atomic<uint64_t> misses_{ 0 };
+    uint64_t reloads_ = 0;
+};
@@ -0,0 +1,443 @@
+#include "JsonStreamWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <nlohmann/json.hpp>
+
+static size_t utf8SequenceLength(const unsigned char* p, size_t avail);
+
+void JsonStreamWriter::separate() {
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (containers_.empty()) return;
+    Container& c = containers_.back();
+    if (encoding_ == WireEncoding::Json && c.count) out_.push_back(',');
+    ++c.count;
+}
+
+void JsonStreamWriter::begin(bool object) {
+    separate();
+    Container c;
+    switch (encoding_) {
+    case WireEncoding::Json:
+        out_.push_back(object ? '{' : '[');
+        break;
+    case WireEncoding::Cbor:
+        out_.push_back(static_cast<char>(object ? 0xBF : 0x9F)); // 不定长 map / array
+        break;
+    case WireEncoding::MessagePack:
+        // 先写 map32/array32 头占位，end() 时回填个数
+        c.header = out_.size();
+        out_.push_back(static_cast<char>(object ? 0xDF : 0xDD));
+        out_.append(4, '\0');
+        break;
+    }
+    containers_.push_back(c);
+}
+
+void JsonStreamWriter::end(bool object) {
+    Container c;
+    if (!containers_.empty()) {
+        c = containers_.back();
+        containers_.pop_back();
+    }
+    switch (encoding_) {
+    case WireEncoding::Json:
+        out_.push_back(object ? '}' : ']');
+        break;
+    case WireEncoding::Cbor:
+        out_.push_back(static_cast<char>(0xFF));
+        break;
+    case WireEncoding::MessagePack: {
+        // 回填为最短的头（fix 类型、16 位或 32 位个数），移除多余的占位字节
+        char head[5];
+        size_t len;
+        if (c.count < 16) {
+            head[0] = static_cast<char>((object ? 0x80 : 0x90) | c.count);
+            len = 1;
+        }
+        else if (c.count <= 0xFFFF) {
+            head[0] = static_cast<char>(object ? 0xDE : 0xDC);
+            len = 3;
+        }
+        else {
+            head[0] = static_cast<char>(object ? 0xDF : 0xDD);
+            len = 5;
+        }
+        for (size_t i = 1; i < len; ++i) head[i] = static_cast<char>(c.count >> (8 * (len - 1 - i)));
+        out_.replace(c.header, 5, head, len);
+        break;
+    }
+    }
+}
+
+JsonStreamWriter& JsonStreamWriter::beginArray() {
+    begin(false);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::endArray() {
+    end(false);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::beginObject() {
+    begin(true);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::endObject() {
+    end(true);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::key(const std::string& k) {
+    separate();
+    writeString(k.data(), k.size());
+    if (encoding_ == WireEncoding::Json) out_.push_back(':');
+    afterKey_ = true;
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(const std::string& v) {
+    separate();
+    writeString(v.data(), v.size());
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(const char* v) {
+    if (!v) return null();
+    separate();
+    writeString(v, std::strlen(v));
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(int v) {
+    return value(static_cast<int64_t>(v));
+}
+
+JsonStreamWriter& JsonStreamWriter::value(int64_t v) {
+    if (v >= 0) return value(static_cast<uint64_t>(v));
+    separate();
+    switch (encoding_) {
+    case WireEncoding::Json: {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, res.ptr);
+        break;
+    }
+    case WireEncoding::Cbor:
+        cborHead(1, static_cast<uint64_t>(-(v + 1))); // 负整数 n 编码为 -1 - n
+        break;
+    case WireEncoding::MessagePack:
+        msgpackSigned(v);
+        break;
+    }
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(uint64_t v) {
+    separate();
+    switch (encoding_) {
+    case WireEncoding::Json: {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, res.ptr);
+        break;
+    }
+    case WireEncoding::Cbor:
+        cborHead(0, v);
+        break;
+    case WireEncoding::MessagePack:
+        msgpackUnsigned(v);
+        break;
+    }
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(double v) {
+    if (!std::isfinite(v)) return null();
+    separate();
+    if (encoding_ == WireEncoding::Json) {
+        // 直接使用 dump() 的浮点格式化（Grisu2 最短往返表示，整数值带 ".0"，指数阈值与 %g 类似），
+        // 保证价格等字段的文本与改用写出器之前逐字节相同
+        char buf[64];
+        char* end = nlohmann::detail::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, static_cast<size_t>(end - buf));
+        return *this;
+    }
+    // 与 to_cbor / to_msgpack 相同：能无损表示为 float 时用单精度
+    const bool cbor = encoding_ == WireEncoding::Cbor;
+    const float f = static_cast<float>(v);
+    if (v >= static_cast<double>(std::numeric_limits<float>::lowest()) &&
+        v <= static_cast<double>((std::numeric_limits<float>::max)()) && static_cast<double>(f) == v) {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        out_.push_back(static_cast<char>(cbor ? 0xFA : 0xCA));
+        appendBigEndian(bits, 4);
+    }
+    else {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        out_.push_back(static_cast<char>(cbor ? 0xFB : 0xCB));
+        appendBigEndian(bits, 8);
+    }
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(bool v) {
+    separate();
+    switch (encoding_) {
+    case WireEncoding::Json: out_.append(v ? "true" : "false"); break;
+    case WireEncoding::Cbor: out_.push_back(static_cast<char>(v ? 0xF5 : 0xF4)); break;
+    case WireEncoding::MessagePack: out_.push_back(static_cast<char>(v ? 0xC3 : 0xC2)); break;
+    }
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::null() {
+    separate();
+    switch (encoding_) {
+    case WireEncoding::Json: out_.append("null"); break;
+    case WireEncoding::Cbor: out_.push_back(static_cast<char>(0xF6)); break;
+    case WireEncoding::MessagePack: out_.push_back(static_cast<char>(0xC0)); break;
+    }
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::raw(const std::string& json) {
+    separate();
+    if (encoding_ == WireEncoding::Json) out_.append(json);
+    else if (!transcode(json, out_, encoding_)) writeString(json.data(), json.size());
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::rawOrString(const std::string& json) {
+    if (encoding_ != WireEncoding::Json) return raw(json); // 转写失败时 raw 本身退回为字符串
+    if (nlohmann::json::accept(json)) return raw(json);
+    return value(json);
+}
+
+namespace {
+// 把 nlohmann 的 SAX 事件直接转给写出器：JSON 文本转为二进制编码时不经过 DOM
+class TranscodeSax {
+public:
+    explicit TranscodeSax(JsonStreamWriter& w) : w_(w) {}
+    bool null() { w_.null(); return true; }
+    bool boolean(bool v) { w_.value(v); return true; }
+    bool number_integer(nlohmann::json::number_integer_t v) { w_.value(static_cast<int64_t>(v)); return true; }
+    bool number_unsigned(nlohmann::json::number_unsigned_t v) { w_.value(static_cast<uint64_t>(v)); return true; }
+    bool number_float(nlohmann::json::number_float_t v, const std::string&) { w_.value(static_cast<double>(v)); return true; }
+    bool string(std::string& v) { w_.value(v); return true; }
+    bool binary(nlohmann::json::binary_t&) { w_.null(); return true; } // JSON 文本中不会出现
+    bool start_object(std::size_t) { w_.beginObject(); return true; }
+    bool key(std::string& k) { w_.key(k); return true; }
+    bool end_object() { w_.endObject(); return true; }
+    bool start_array(std::size_t) { w_.beginArray(); return true; }
+    bool end_array() { w_.endArray(); return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) { return false; }
+
+private:
+    JsonStreamWriter& w_;
+};
+}
+
+bool JsonStreamWriter::transcode(const std::string& json, std::string& out, WireEncoding encoding) {
+    const size_t mark = out.size();
+    JsonStreamWriter w(out, encoding);
+    TranscodeSax sax(w);
+    if (nlohmann::json::sax_parse(json, &sax)) return true;
+    out.resize(mark);
+    return false;
+}
+
+void JsonStreamWriter::writeString(const char* s, size_t len) {
+    if (encoding_ == WireEncoding::Json) {
+        appendString(out_, s, len);
+        return;
+    }
+    // 二进制编码的字符串直接写出 UTF-8 字节；含非法字节时先替换为 U+FFFD（长度随之变化）
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    size_t i = 0;
+    while (i < len) {
+        if (p[i] < 0x80) { ++i; continue; }
+        const size_t n = utf8SequenceLength(p + i, len - i);
+        if (!n) break;
+        i += n;
+    }
+    std::string fixed;
+    if (i < len) {
+        fixed.assign(s, i);
+        while (i < len) {
+            const size_t n = p[i] < 0x80 ? 1 : utf8SequenceLength(p + i, len - i);
+            if (n) fixed.append(s + i, n);
+            else fixed.append("\xEF\xBF\xBD");
+            i += n ? n : 1;
+        }
+        s = fixed.data();
+        len = fixed.size();
+    }
+    if (encoding_ == WireEncoding::Cbor) {
+        cborHead(3, len);
+    }
+    else if (len < 32) {
+        out_.push_back(static_cast<char>(0xA0 | len));
+    }
+    else if (len <= 0xFF) {
+        out_.push_back(static_cast<char>(0xD9));
+        appendBigEndian(len, 1);
+    }
+    else if (len <= 0xFFFF) {
+        out_.push_back(static_cast<char>(0xDA));
+        appendBigEndian(len, 2);
+    }
+    else {
+        out_.push_back(static_cast<char>(0xDB));
+        appendBigEndian(len, 4);
+    }
+    out_.append(s, len);
+}
+
+void JsonStreamWriter::cborHead(uint8_t major, uint64_t n) {
+    const uint8_t m = static_cast<uint8_t>(major << 5);
+    if (n < 24) {
+        out_.push_back(static_cast<char>(m | n));
+    }
+    else if (n <= 0xFF) {
+        out_.push_back(static_cast<char>(m | 24));
+        appendBigEndian(n, 1);
+    }
+    else if (n <= 0xFFFF) {
+        out_.push_back(static_cast<char>(m | 25));
+        appendBigEndian(n, 2);
+    }
+    else if (n <= 0xFFFFFFFFu) {
+        out_.push_back(static_cast<char>(m | 26));
+        appendBigEndian(n, 4);
+    }
+    else {
+        out_.push_back(static_cast<char>(m | 27));
+        appendBigEndian(n, 8);
+    }
+}
+
+void JsonStreamWriter::msgpackUnsigned(uint64_t n) {
+    if (n < 128) {
+        out_.push_back(static_cast<char>(n)); // positive fixint
+    }
+    else if (n <= 0xFF) {
+        out_.push_back(static_cast<char>(0xCC));
+        appendBigEndian(n, 1);
+    }
+    else if (n <= 0xFFFF) {
+        out_.push_back(static_cast<char>(0xCD));
+        appendBigEndian(n, 2);
+    }
+    else if (n <= 0xFFFFFFFFu) {
+        out_.push_back(static_cast<char>(0xCE));
+        appendBigEndian(n, 4);
+    }
+    else {
+        out_.push_back(static_cast<char>(0xCF));
+        appendBigEndian(n, 8);
+    }
+}
+
+void JsonStreamWriter::msgpackSigned(int64_t n) {
+    const uint64_t bits = static_cast<uint64_t>(n);
+    if (n >= -32) {
+        out_.push_back(static_cast<char>(bits)); // negative fixint
+    }
+    else if (n >= std::numeric_limits<int8_t>::min()) {
+        out_.push_back(static_cast<char>(0xD0));
+        appendBigEndian(bits, 1);
+    }
+    else if (n >= std::numeric_limits<int16_t>::min()) {
+        out_.push_back(static_cast<char>(0xD1));
+        appendBigEndian(bits, 2);
+    }
+    else if (n >= std::numeric_limits<int32_t>::min()) {
+        out_.push_back(static_cast<char>(0xD2));
+        appendBigEndian(bits, 4);
+    }
+    else {
+        out_.push_back(static_cast<char>(0xD3));
+        appendBigEndian(bits, 8);
+    }
+}
+
+void JsonStreamWriter::appendBigEndian(uint64_t n, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) out_.push_back(static_cast<char>(n >> (8 * i)));
+}
+
+// 合法 UTF-8 序列的长度；非法时返回 0
+static size_t utf8SequenceLength(const unsigned char* p, size_t avail) {
+    const unsigned char c = p[0];
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF; // 第二字节的允许范围（排除过长编码与代理区）
+    if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) {
+        len = 3;
+        if (c == 0xE0) lo = 0xA0;
+        else if (c == 0xED) hi = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4) {
+        len = 4;
+        if (c == 0xF0) lo = 0x90;
+        else if (c == 0xF4) hi = 0x8F;
+    }
+    else return 0;
+    if (avail < len) return 0;
+    if (p[1] < lo || p[1] > hi) return 0;
+    for (size_t i = 2; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    return len;
+}
+
+void JsonStreamWriter::appendString(std::string& out, const char* s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    out.push_back('"');
+    size_t run = 0; // 尚未追加的、无需转义的字节起点
+    size_t i = 0;
+    while (i < len) {
+        const unsigned char c = p[i];
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80) {
+            ++i;
+            continue;
+        }
+        if (c >= 0x80) {
+            const size_t n = utf8SequenceLength(p + i, len - i);
+            if (n) {
+                i += n;
+                continue;
+            }
+        }
+        out.append(s + run, i - run);
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if (c < 0x20) {
+                const char esc[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F] };
+                out.append(esc, sizeof(esc));
+            } else {
+                out.append("\xEF\xBF\xBD"); // 非法 UTF-8 字节
+            }
+            break;
+        }
+        ++i;
+        run = i;
+    }
+    out.append(s + run, len - run);
+    out.push_back('"');
+}
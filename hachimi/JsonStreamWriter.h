@@ -0,0 +1,89 @@
+#pragma once
+#include "WireProtocol.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 流式 JSON 写出器：直接把 JSON 值追加到调用方的输出串，不构造 nlohmann::json DOM。
+// 用于大列表响应（商品/订单/账户/促销）。省掉的是 DOM 及其逐节点分配，并非流式发送：
+// 整个响应仍先完整写进一个 std::string 再交给发送队列，峰值内存随响应大小线性增长（约为输出本身）。
+//
+// 输出编码由构造参数决定，调用方式完全相同：
+//   Json：与 nlohmann::json::dump() 逐字节相同（紧凑、字符串中非 ASCII 原样输出、浮点数用同一格式化）；
+//   Cbor：数组/对象用不定长编码（0x9F/0xBF ... 0xFF），无需预知元素个数；
+//   MessagePack：容器头先占 5 字节，结束时回填个数并压缩为最短的头。
+// 二进制编码的标量与 json::to_cbor / to_msgpack 的选择一致（最短整数、可无损表示为 float 的用单精度），
+// 客户端用 json::from_cbor / from_msgpack 解码得到与文本 JSON 相同的值。
+// 无效的 UTF-8 字节一律替换为 U+FFFD，而不是像 dump() 那样抛异常。
+//
+//   std::string out;
+//   JsonStreamWriter w(out);            // 或 JsonStreamWriter w(out, WireEncoding::Cbor)
+//   w.beginArray();
+//   for (...) { w.beginObject(); w.field("id", id); w.field("name", name); w.endObject(); }
+//   w.endArray();
+//
+// 调用顺序由调用方保证（对象内 key 与值交替），写出器不做完整性校验。
+class JsonStreamWriter {
+public:
+    explicit JsonStreamWriter(std::string& out, WireEncoding encoding = WireEncoding::Json)
+        : out_(out), encoding_(encoding) {}
+
+    WireEncoding encoding() const { return encoding_; }
+
+    JsonStreamWriter& beginArray();
+    JsonStreamWriter& endArray();
+    JsonStreamWriter& beginObject();
+    JsonStreamWriter& endObject();
+    JsonStreamWriter& key(const std::string& k);
+
+    JsonStreamWriter& value(const std::string& v);
+    JsonStreamWriter& value(const char* v);
+    JsonStreamWriter& value(int v);
+    JsonStreamWriter& value(int64_t v);
+    JsonStreamWriter& value(uint64_t v);
+    JsonStreamWriter& value(double v); // NaN/Inf 输出为 null，与 dump() 相同
+    JsonStreamWriter& value(bool v);
+    JsonStreamWriter& null();
+    // 追加一段已序列化好的 JSON 值（如 policy_detail 中保存的 JSON 文本）。
+    // Json 编码下原样追加、不做校验；二进制编码下逐个 SAX 事件转写（不建 DOM），非法 JSON 作为字符串写出
+    JsonStreamWriter& raw(const std::string& json);
+    // 合法 JSON 按 raw 嵌入，否则作为字符串值写出
+    JsonStreamWriter& rawOrString(const std::string& json);
+
+    template <typename T>
+    JsonStreamWriter& field(const std::string& k, const T& v) {
+        key(k);
+        return value(v);
+    }
+
+    // 把 JSON 文本转写为 encoding 编码追加到 out（经 SAX 解析，不建 DOM）；
+    // 不是合法 JSON 时 out 保持不变并返回 false
+    static bool transcode(const std::string& json, std::string& out, WireEncoding encoding);
+
+    // 追加转义后的 JSON 字符串（含引号）
+    static void appendString(std::string& out, const char* s, size_t len);
+
+private:
+    struct Container {
+        size_t count = 0;  // 已写入的元素数（对象为键值对数）
+        size_t header = 0; // MessagePack：容器头在 out_ 中的位置，结束时回填
+    };
+
+    // 写值或 key 之前补逗号，并为所在容器计数
+    void separate();
+    void begin(bool object);
+    void end(bool object);
+    // 按当前编码写出字符串（不含 separate）
+    void writeString(const char* s, size_t len);
+    // CBOR 的类型字节与长度/数值（major 为高 3 位）
+    void cborHead(uint8_t major, uint64_t n);
+    // MessagePack 的无符号/有符号整数
+    void msgpackUnsigned(uint64_t n);
+    void msgpackSigned(int64_t n);
+    void appendBigEndian(uint64_t n, int bytes);
+
+    std::string& out_;
+    WireEncoding encoding_;
+    std::vector<Container> containers_;
+    bool afterKey_ = false;
+};
@@ -0,0 +1,185 @@
+#include "LocalTransport.h"
+#include <chrono>
+#include <unordered_map>
+
+// ---------------- Call ----------------
+
+void LocalTransport::Call::complete(std::string resp) {
+    response_ = std::move(resp);
+    std::lock_guard<std::mutex> lk(mtx_);
+    done_.store(true, std::memory_order_release);
+    cv_.notify_all();
+}
+
+bool LocalTransport::Call::wait(int timeoutMs) {
+    if (done()) return true;
+    std::unique_lock<std::mutex> lk(mtx_);
+    return cv_.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this] { return done(); });
+}
+
+// ---------------- 注册表 ----------------
+
+static std::mutex& registryMutex() {
+    static std::mutex m;
+    return m;
+}
+
+static std::unordered_map<int, std::shared_ptr<LocalTransport>>& registry() {
+    static std::unordered_map<int, std::shared_ptr<LocalTransport>> r;
+    return r;
+}
+
+std::shared_ptr<LocalTransport> LocalTransport::listen(int port, Handler handler, size_t capacity) {
+    auto channel = std::make_shared<LocalTransport>(std::move(handler), capacity);
+    std::shared_ptr<LocalTransport> previous;
+    {
+        std::lock_guard<std::mutex> lk(registryMutex());
+        auto& slot = registry()[port];
+        previous = std::move(slot);
+        slot = channel;
+    }
+    if (previous) previous->close();
+    return channel;
+}
+
+std::shared_ptr<LocalTransport> LocalTransport::find(int port) {
+    std::lock_guard<std::mutex> lk(registryMutex());
+    auto it = registry().find(port);
+    if (it == registry().end() || !it->second->isOpen()) return nullptr;
+    return it->second;
+}
+
+void LocalTransport::unlisten(int port) {
+    std::shared_ptr<LocalTransport> channel;
+    {
+        std::lock_guard<std::mutex> lk(registryMutex());
+        auto it = registry().find(port);
+        if (it == registry().end()) return;
+        channel = std::move(it->second);
+        registry().erase(it);
+    }
+    channel->close();
+}
+
+// ---------------- 通道 ----------------
+
+LocalTransport::LocalTransport(Handler handler, size_t capacity) : handler_(std::move(handler)) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    cells_.reset(new Cell[cap]);
+    for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    mask_ = cap - 1;
+    thread_ = std::thread([this]() { dispatchLoop(); });
+}
+
+LocalTransport::~LocalTransport() {
+    close();
+}
+
+bool LocalTransport::tryPush(const CallPtr& call) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& c = cells_[pos & mask_];
+        size_t seq = c.seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                c.call = call;
+                c.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// 仅分发线程调用（分发线程退出后由 close() 调用）
+bool LocalTransport::tryPop(CallPtr& out) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell& c = cells_[pos & mask_];
+    size_t seq = c.seq.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) return false;
+    out = std::move(c.call);
+    c.seq.store(pos + mask_ + 1, std::memory_order_release);
+    tail_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LocalTransport::submit(const CallPtr& call) {
+    if (!call) return false;
+    // 先登记再检查 closed_（与 close() 中的置位、等待配对）：要么这里看到已关闭而不入队，
+    // 要么 close() 等本次入队结束后把它取出完成，不会有调用滞留在队列中
+    submitting_.fetch_add(1);
+    bool pushed = false;
+    if (!closed_.load()) {
+        while (!(pushed = tryPush(call))) {
+            if (!isOpen()) break;
+            std::this_thread::yield();
+        }
+    }
+    if (pushed) {
+        // 入队（release 写 seq）与读取 sleeping_ 之间需要全屏障，否则两者可能重排而漏掉唤醒；
+        // 与 dispatchLoop 中 sleeping_ 置位后的屏障配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load()) {
+            std::lock_guard<std::mutex> lk(sleepMtx_);
+            sleepCv_.notify_one();
+        }
+    }
+    submitting_.fetch_sub(1);
+    return pushed;
+}
+
+void LocalTransport::dispatchLoop() {
+    CallPtr call;
+    for (;;) {
+        while (tryPop(call)) {
+            if (!closed_.load(std::memory_order_acquire) && handler_) handler_(std::move(call));
+            else call->complete(std::string());
+            call.reset();
+        }
+        if (closed_.load(std::memory_order_acquire)) break;
+
+        std::unique_lock<std::mutex> lk(sleepMtx_);
+        sleeping_.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 置位后复查：提交方若在置位前入队，这里能看到；若在置位后入队，它会看到 sleeping_ 并通知
+        const size_t pos = tail_.load(std::memory_order_relaxed);
+        const bool pending = static_cast<intptr_t>(cells_[pos & mask_].seq.load()) - static_cast<intptr_t>(pos + 1) >= 0;
+        if (!pending && !closed_.load()) {
+            sleepCv_.wait_for(lk, std::chrono::milliseconds(100));
+        }
+        sleeping_.store(false);
+    }
+    // 关闭后仍可能有提交方在关闭前一刻入队的调用
+    while (tryPop(call)) {
+        call->complete(std::string());
+        call.reset();
+    }
+}
+
+void LocalTransport::close() {
+    closed_.store(true); // seq_cst：与 submit() 中登记后的检查配对
+    {
+        std::lock_guard<std::mutex> lk(sleepMtx_);
+        sleepCv_.notify_all();
+    }
+    std::lock_guard<std::mutex> lk(joinMtx_);
+    if (thread_.joinable()) {
+        if (thread_.get_id() == std::this_thread::get_id()) thread_.detach(); // 处理函数内释放了最后一个引用
+        else thread_.join();
+    }
+    // 分发线程已退出（或当前就在分发线程上）：等关闭前已通过检查的提交方入队完毕，
+    // 再把分发线程最后一次清空之后才入队的调用以空响应完成
+    while (submitting_.load() > 0) std::this_thread::yield();
+    CallPtr call;
+    while (tryPop(call)) {
+        call->complete(std::string());
+        call.reset();
+    }
+}
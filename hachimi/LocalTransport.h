@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// 进程内传输：Client 与 Server 位于同一进程时绕过回环 TCP
+// - Server 在 SERstart 时按端口注册一个通道，Client 连接时先按端口查找，找到即改走该通道
+// - 请求/响应以 std::string 移动方式在线程间传递：不经 socket，也不再做 QByteArray/QString 往返转换
+// - 提交走无锁有界队列（多生产者/单消费者），由通道的分发线程取出交给 Server 的处理函数
+class LocalTransport {
+public:
+    // 一次调用：Client 填入 request，Server 处理后调用 complete() 移入 response 并唤醒等待者
+    class Call {
+    public:
+        explicit Call(std::string req) : request(std::move(req)) {}
+        std::string request;
+
+        void complete(std::string resp);
+        // 等待完成；超时返回 false
+        bool wait(int timeoutMs);
+        bool done() const { return done_.load(std::memory_order_acquire); }
+        // 仅在 done() 之后调用
+        std::string takeResponse() { return std::move(response_); }
+
+    private:
+        std::string response_;
+        std::atomic<bool> done_{ false };
+        std::mutex mtx_;
+        std::condition_variable cv_;
+    };
+    using CallPtr = std::shared_ptr<Call>;
+    using Handler = std::function<void(CallPtr)>;
+
+    // 为 port 注册通道并启动分发线程（已有同端口通道时先关闭旧通道）
+    static std::shared_ptr<LocalTransport> listen(int port, Handler handler, size_t capacity = 1024);
+    // 查找 port 上的通道；不存在或已关闭时返回空
+    static std::shared_ptr<LocalTransport> find(int port);
+    // 注销并关闭 port 上的通道
+    static void unlisten(int port);
+
+    explicit LocalTransport(Handler handler, size_t capacity);
+    ~LocalTransport();
+    LocalTransport(const LocalTransport&) = delete;
+    LocalTransport& operator=(const LocalTransport&) = delete;
+
+    // 提交一次调用；队列已满时短暂让出重试，通道已关闭时返回 false
+    bool submit(const CallPtr& call);
+    bool isOpen() const { return !closed_.load(std::memory_order_acquire); }
+    // 停止分发线程；队列中尚未分发的调用以空响应完成
+    void close();
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{ 0 };
+        CallPtr call;
+    };
+    bool tryPush(const CallPtr& call);
+    bool tryPop(CallPtr& out);
+    void dispatchLoop();
+
+    Handler handler_;
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{ 0 }; // 下一个写入位置（提交方）
+    alignas(64) std::atomic<size_t> tail_{ 0 }; // 下一个读取位置（分发线程）
+
+    std::atomic<bool> closed_{ false };
+    std::atomic<int> submitting_{ 0 }; // 正在 submit() 中的提交方数
+    // 分发线程空闲时置位后休眠；提交方仅在其置位时才加锁通知，常态下提交路径不加锁
+    std::atomic<bool> sleeping_{ false };
+    std::mutex sleepMtx_;
+    std::condition_variable sleepCv_;
+    std::mutex joinMtx_;
+    std::thread thread_;
+};
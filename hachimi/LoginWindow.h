@@ -6,7 +6,7 @@
 #include <vector>
 #include "user.h"
 #include "userManager.h"
-#include "DatabaseManager.h"
+#include "databaseManager.h"
 #include <functional>
 #include <QElapsedTimer> // 新增：节流计时器
 
@@ -0,0 +1,989 @@
+#include "MemoryStorage.h"
+#include "AtomicFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+using nlohmann::json;
+
+// 本线程持有事务的存储及其撤销日志（回滚期间撤销日志置空，回滚操作本身不再记录）
+static thread_local const MemoryStorage* tlsTxnOwner = nullptr;
+static thread_local std::vector<std::function<void()>>* tlsUndo = nullptr;
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 从游标 after（不含）起按方向遍历有序容器（map 或 set），fn 返回 false 时停止；hasCursor 为 false 时从头（倒序时从尾）开始
+template <typename Ordered, typename Key, typename Fn>
+static void scanFrom(const Ordered& c, const Key& after, bool hasCursor, bool descending, Fn&& fn) {
+    if (!descending) {
+        for (auto it = hasCursor ? c.upper_bound(after) : c.begin(); it != c.end(); ++it) {
+            if (!fn(*it)) return;
+        }
+        return;
+    }
+    auto it = hasCursor ? c.lower_bound(after) : c.end();
+    while (it != c.begin()) {
+        --it;
+        if (!fn(*it)) return;
+    }
+}
+
+// 键集分页：在按主键有序的表上从游标起按方向取至多 limit 行
+template <typename Table, typename Key, typename Fn>
+static void pageRange(const Table& table, const Key& after, bool hasCursor, int limit, bool descending, Fn&& fn) {
+    if (limit <= 0) return;
+    size_t left = static_cast<size_t>(limit);
+    scanFrom(table, after, hasCursor, descending, [&](const typename Table::value_type& kv) {
+        fn(kv.second);
+        return --left > 0;
+    });
+}
+
+// 一次 DTB* 调用：计一次存储操作（含等锁时间），并按需加共享/独占锁。
+// 本线程正持有该存储的事务时已独占，不再加锁
+class MemoryStorage::Guard {
+public:
+    Guard(const MemoryStorage* owner, bool exclusive) : owner_(owner) {
+        if (tlsTxnOwner == owner_) return;
+        if (exclusive) owner_->mtx_.lock();
+        else owner_->mtx_.lock_shared();
+        mode_ = exclusive ? 2 : 1;
+    }
+    ~Guard() {
+        if (mode_ == 2) owner_->mtx_.unlock();
+        else if (mode_ == 1) owner_->mtx_.unlock_shared();
+    }
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+private:
+    Storage::QueryScope scope_;
+    const MemoryStorage* owner_;
+    int mode_ = 0;
+};
+
+// 事务：独占整个存储直到结束；未提交则按撤销日志逆序回滚。
+// 本线程已在同一存储上开启事务时为嵌套作用域，由外层统一提交/回滚
+class MemoryStorage::Txn : public Storage::Transaction {
+public:
+    explicit Txn(MemoryStorage* owner) : owner_(owner) {
+        if (tlsTxnOwner == owner_) { nested_ = true; return; }
+        owner_->mtx_.lock();
+        tlsTxnOwner = owner_;
+        tlsUndo = &undo_;
+    }
+    ~Txn() override {
+        if (nested_) return;
+        tlsUndo = nullptr;
+        if (!committed_) {
+            for (auto it = undo_.rbegin(); it != undo_.rend(); ++it) (*it)();
+        }
+        tlsTxnOwner = nullptr;
+        owner_->mtx_.unlock();
+    }
+    Txn(const Txn&) = delete;
+    Txn& operator=(const Txn&) = delete;
+    bool active() const override { return true; }
+    bool commit() override {
+        if (nested_) return true;
+        committed_ = true;
+        undo_.clear();
+        return true;
+    }
+private:
+    MemoryStorage* owner_;
+    bool nested_ = false;
+    bool committed_ = false;
+    std::vector<std::function<void()>> undo_;
+};
+
+MemoryStorage::MemoryStorage(const std::string& snapshotPath) : snapshotPath_(snapshotPath) {}
+
+MemoryStorage::~MemoryStorage() {
+    DTBflush();
+}
+
+bool MemoryStorage::DTBinitialize() {
+    if (snapshotPath_.empty()) return true;
+    if (!std::ifstream(snapshotPath_).good()) {
+        std::cout << "MemoryStorage: 快照 " << snapshotPath_ << " 不存在，从空数据开始" << std::endl;
+        return true;
+    }
+    if (!DTBloadSnapshot(snapshotPath_)) {
+        // 不再写回该路径，避免用空数据覆盖无法解析的快照
+        std::cerr << "MemoryStorage: 快照 " << snapshotPath_ << " 读取失败，本次运行不写回快照" << std::endl;
+        snapshotPath_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool MemoryStorage::DTBflush() {
+    if (snapshotPath_.empty()) return true;
+    return DTBsaveSnapshot(snapshotPath_);
+}
+
+std::unique_ptr<Storage::Transaction> MemoryStorage::DTBbeginTransaction() {
+    return std::unique_ptr<Storage::Transaction>(new Txn(this));
+}
+
+// ---------------- 撤销日志与索引维护 ----------------
+
+void MemoryStorage::journal(std::function<void()> undo) {
+    if (tlsTxnOwner == this && tlsUndo) tlsUndo->push_back(std::move(undo));
+}
+
+void MemoryStorage::journalGood(int id) {
+    if (tlsTxnOwner != this || !tlsUndo) return;
+    auto it = goods_.find(id);
+    if (it == goods_.end()) journal([this, id]() { goods_.erase(id); });
+    else journal([this, id, old = it->second]() { goods_[id] = old; });
+}
+
+void MemoryStorage::journalUser(const std::string& phone) {
+    if (tlsTxnOwner != this || !tlsUndo) return;
+    auto it = users_.find(phone);
+    if (it == users_.end()) journal([this, phone]() { users_.erase(phone); });
+    else journal([this, phone, old = it->second]() { users_[phone] = old; });
+}
+
+void MemoryStorage::journalOrder(const std::string& orderId) {
+    if (tlsTxnOwner != this || !tlsUndo) return;
+    auto it = orders_.find(orderId);
+    if (it == orders_.end()) journal([this, orderId]() { eraseOrderLocked(orderId); });
+    else journal([this, old = it->second]() { putOrderLocked(old); });
+}
+
+void MemoryStorage::journalCart(const std::string& cartId) {
+    if (tlsTxnOwner != this || !tlsUndo) return;
+    auto it = carts_.find(cartId);
+    if (it == carts_.end()) journal([this, cartId]() { eraseCartLocked(cartId); });
+    else journal([this, old = it->second]() { putCartLocked(old); });
+}
+
+void MemoryStorage::journalPromotion(const std::string& name) {
+    if (tlsTxnOwner != this || !tlsUndo) return;
+    auto it = promotions_.find(name);
+    if (it == promotions_.end()) journal([this, name]() { promotions_.erase(name); });
+    else journal([this, name, old = it->second]() { promotions_[name] = old; });
+}
+
+void MemoryStorage::putOrderLocked(const Order& o) {
+    journalOrder(o.getOrderId());
+    auto it = orders_.find(o.getOrderId());
+    if (it != orders_.end() && it->second.getUserPhone() != o.getUserPhone()) {
+        ordersByUser_[it->second.getUserPhone()].erase(o.getOrderId());
+    }
+    orders_[o.getOrderId()] = o;
+    ordersByUser_[o.getUserPhone()].insert(o.getOrderId());
+}
+
+void MemoryStorage::eraseOrderLocked(const std::string& orderId) {
+    auto it = orders_.find(orderId);
+    if (it == orders_.end()) return;
+    journalOrder(orderId);
+    auto idx = ordersByUser_.find(it->second.getUserPhone());
+    if (idx != ordersByUser_.end()) {
+        idx->second.erase(orderId);
+        if (idx->second.empty()) ordersByUser_.erase(idx);
+    }
+    orders_.erase(it);
+}
+
+void MemoryStorage::putCartLocked(const CartRow& row) {
+    const std::string& cartId = row.cart.cart_id;
+    journalCart(cartId);
+    auto it = carts_.find(cartId);
+    if (it != carts_.end() && it->second.cart.user_phone != row.cart.user_phone) {
+        cartsByUser_[it->second.cart.user_phone].erase(cartId);
+    }
+    carts_[cartId] = row;
+    cartsByUser_[row.cart.user_phone].insert(cartId);
+}
+
+void MemoryStorage::eraseCartLocked(const std::string& cartId) {
+    auto it = carts_.find(cartId);
+    if (it == carts_.end()) return;
+    journalCart(cartId);
+    auto idx = cartsByUser_.find(it->second.cart.user_phone);
+    if (idx != cartsByUser_.end()) {
+        idx->second.erase(cartId);
+        if (idx->second.empty()) cartsByUser_.erase(idx);
+    }
+    carts_.erase(it);
+}
+
+std::vector<CartItem> MemoryStorage::liveCartItems(const TemporaryCart& cart) const {
+    std::vector<CartItem> items;
+    items.reserve(cart.items.size());
+    for (const auto& item : cart.items) {
+        if (item.good_id > 0 && goods_.count(item.good_id)) items.push_back(item);
+    }
+    return items;
+}
+
+// ---------------- 用户 ----------------
+
+bool MemoryStorage::DTBaddUser(const User& u) {
+    Guard g(this, true);
+    if (users_.count(u.getPhone())) {
+        std::cerr << "User with phone " << u.getPhone() << " already exists." << std::endl;
+        return false;
+    }
+    journalUser(u.getPhone());
+    users_[u.getPhone()] = u;
+    return true;
+}
+
+bool MemoryStorage::DTBsaveUser(const User& u) {
+    Guard g(this, true);
+    if (users_.count(u.getPhone())) return false; // 主键冲突
+    journalUser(u.getPhone());
+    users_[u.getPhone()] = u;
+    return true;
+}
+
+bool MemoryStorage::DTBupdateUser(const User& u) {
+    Guard g(this, true);
+    auto it = users_.find(u.getPhone());
+    if (it == users_.end()) {
+        std::cerr << "DTBupdateUser: 未找到匹配用户 phone=" << u.getPhone() << std::endl;
+        return false;
+    }
+    journalUser(u.getPhone());
+    it->second = User(u.getPhone(), u.getPassword(), u.getAddress());
+    return true;
+}
+
+bool MemoryStorage::DTBloadUser(const std::string& phone, User& u) {
+    Guard g(this, false);
+    auto it = users_.find(phone);
+    if (it == users_.end()) return false;
+    u = User(it->second.getPhone(), it->second.getPassword(), it->second.getAddress());
+    return true;
+}
+
+bool MemoryStorage::DTBdeleteUser(const std::string& phone) {
+    Guard g(this, true);
+    if (!users_.count(phone)) {
+        std::cerr << "DTBdeleteUser: 未找到匹配用户 phone=" << phone << std::endl;
+        return false;
+    }
+    journalUser(phone);
+    users_.erase(phone);
+    return true;
+}
+
+std::vector<User> MemoryStorage::DTBloadAllUsers() {
+    Guard g(this, false);
+    std::vector<User> users;
+    users.reserve(users_.size());
+    for (const auto& kv : users_) users.emplace_back(kv.second.getPhone(), kv.second.getPassword(), kv.second.getAddress());
+    std::sort(users.begin(), users.end(), [](const User& a, const User& b) { return a.getPhone() < b.getPhone(); });
+    return users;
+}
+
+std::vector<User> MemoryStorage::DTBloadUsersPage(const std::string& afterPhone, int limit, bool descending) {
+    Guard g(this, false);
+    std::vector<User> users;
+    pageRange(users_, afterPhone, !afterPhone.empty(), limit, descending, [&users](const User& u) {
+        users.emplace_back(u.getPhone(), u.getPassword(), u.getAddress());
+    });
+    return users;
+}
+
+std::vector<User> MemoryStorage::DTBqueryUsers(const std::string& phone, const std::string& afterPhone, int limit, bool descending) {
+    Guard g(this, false);
+    std::vector<User> users;
+    if (limit <= 0) return users;
+    const size_t want = static_cast<size_t>(limit);
+    scanFrom(users_, afterPhone, !afterPhone.empty(), descending, [&](const std::pair<const std::string, User>& kv) {
+        const User& u = kv.second;
+        if (u.getPhone().find(phone) != std::string::npos) users.emplace_back(u.getPhone(), u.getPassword(), u.getAddress());
+        return users.size() < want;
+    });
+    return users;
+}
+
+// ---------------- 商品 ----------------
+
+bool MemoryStorage::DTBsaveGood(const Good& good, int* newId) {
+    Guard g(this, true);
+    const int id = nextGoodId_++; // 与自增主键相同：忽略传入的 id，回滚也不回收
+    journalGood(id);
+    goods_[id] = Good(id, good.getName(), good.getPrice(), good.getStock(), good.getCategory());
+    if (newId) *newId = id;
+    return true;
+}
+
+bool MemoryStorage::DTBupdateGood(const Good& good) {
+    Guard g(this, true);
+    auto it = goods_.find(good.getId());
+    if (it == goods_.end()) return true; // 与 UPDATE 未匹配到行时一致
+    journalGood(good.getId());
+    it->second = good;
+    return true;
+}
+
+bool MemoryStorage::DTBloadGood(int id, Good& out) {
+    Guard g(this, false);
+    auto it = goods_.find(id);
+    if (it == goods_.end()) return false;
+    out = it->second;
+    return true;
+}
+
+bool MemoryStorage::DTBdeleteGood(int id) {
+    Guard g(this, true);
+    if (goods_.count(id)) {
+        journalGood(id);
+        goods_.erase(id);
+    }
+    return true;
+}
+
+std::vector<Good> MemoryStorage::DTBloadAllGoods(bool* ok) {
+    Guard g(this, false);
+    if (ok) *ok = true;
+    std::vector<Good> goods;
+    goods.reserve(goods_.size());
+    for (const auto& kv : goods_) goods.push_back(kv.second);
+    std::sort(goods.begin(), goods.end(), [](const Good& a, const Good& b) { return a.getId() < b.getId(); });
+    return goods;
+}
+
+std::vector<Good> MemoryStorage::DTBloadGoodsPage(int afterId, int limit, bool descending) {
+    Guard g(this, false);
+    std::vector<Good> goods;
+    pageRange(goods_, afterId, afterId > 0, limit, descending, [&goods](const Good& good) { goods.push_back(good); });
+    return goods;
+}
+
+std::vector<Good> MemoryStorage::DTBqueryGoods(const GoodsQuery& q, int afterId, int limit, bool descending) {
+    Guard g(this, false);
+    std::vector<Good> goods;
+    if (limit <= 0) return goods;
+    const size_t want = static_cast<size_t>(limit);
+    scanFrom(goods_, afterId, afterId > 0, descending, [&](const std::pair<const int, Good>& kv) {
+        if (q.matches(kv.second)) goods.push_back(kv.second);
+        return goods.size() < want;
+    });
+    return goods;
+}
+
+std::vector<Good> MemoryStorage::DTBloadGoodsByCategory(const std::string& category) {
+    Guard g(this, false);
+    std::vector<Good> goods;
+    for (const auto& kv : goods_) {
+        if (kv.second.getCategory() == category) goods.push_back(kv.second);
+    }
+    std::sort(goods.begin(), goods.end(), [](const Good& a, const Good& b) { return a.getId() < b.getId(); });
+    return goods;
+}
+
+std::map<int, Good> MemoryStorage::DTBloadGoodsByIds(const std::vector<int>& ids) {
+    Guard g(this, false);
+    std::map<int, Good> goods;
+    for (int id : ids) {
+        auto it = goods_.find(id);
+        if (it != goods_.end()) goods[id] = it->second;
+    }
+    return goods;
+}
+
+bool MemoryStorage::DTBupdateGoodStock(int good_id, int new_stock) {
+    Guard g(this, true);
+    auto it = goods_.find(good_id);
+    if (it == goods_.end()) return true;
+    journalGood(good_id);
+    const Good& old = it->second;
+    it->second = Good(old.getId(), old.getName(), old.getPrice(), new_stock, old.getCategory());
+    return true;
+}
+
+// ---------------- 订单 ----------------
+
+// 订单项的 order_id 以订单为准（与 MySQL 后端写入时一致）
+static Order normalizedOrder(const Order& o) {
+    Order copy = o;
+    std::vector<OrderItem> items = o.getItems();
+    for (auto& item : items) item.setOrderId(o.getOrderId());
+    copy.setItems(items);
+    return copy;
+}
+
+bool MemoryStorage::DTBsaveOrder(const Order& o) {
+    Guard g(this, true);
+    if (orders_.count(o.getOrderId())) {
+        std::cerr << "MemoryStorage: duplicate order_id " << o.getOrderId() << std::endl;
+        return false;
+    }
+    putOrderLocked(normalizedOrder(o));
+    return true;
+}
+
+Storage::OrderSaveResult MemoryStorage::DTBsaveOrderWithStock(const Order& o) {
+    OrderSaveResult r;
+    Guard g(this, true);
+
+    // 合并同一商品的购买数量，校验全部通过后才写入
+    std::map<int, int> wanted;
+    for (const auto& item : o.getItems()) wanted[item.getGoodId()] += item.getQuantity();
+    for (const auto& kv : wanted) {
+        auto it = goods_.find(kv.first);
+        if (it == goods_.end()) {
+            r.status = OrderSaveResult::GoodNotFound;
+            r.goodId = kv.first;
+            return r;
+        }
+        if (kv.second > it->second.getStock()) {
+            r.status = OrderSaveResult::StockExceeded;
+            r.goodId = kv.first;
+            r.available = it->second.getStock();
+            r.requested = kv.second;
+            return r;
+        }
+    }
+    if (orders_.count(o.getOrderId())) {
+        std::cerr << "MemoryStorage: duplicate order_id " << o.getOrderId() << std::endl;
+        return r;
+    }
+
+    putOrderLocked(normalizedOrder(o));
+    for (const auto& kv : wanted) {
+        if (kv.second <= 0) continue;
+        journalGood(kv.first);
+        Good& good = goods_[kv.first];
+        good = Good(good.getId(), good.getName(), good.getPrice(), good.getStock() - kv.second, good.getCategory());
+    }
+    r.status = OrderSaveResult::Ok;
+    return r;
+}
+
+bool MemoryStorage::DTBupdateOrder(const Order& o) {
+    Guard g(this, true);
+    if (!orders_.count(o.getOrderId())) return true;
+    putOrderLocked(normalizedOrder(o));
+    return true;
+}
+
+bool MemoryStorage::DTBupdateOrderStatus(const std::string& order_id, int status) {
+    Guard g(this, true);
+    auto it = orders_.find(order_id);
+    if (it == orders_.end()) return true;
+    journalOrder(order_id);
+    it->second.setStatus(status);
+    return true;
+}
+
+bool MemoryStorage::DTBloadOrder(const std::string& order_id, Order& o) {
+    Guard g(this, false);
+    auto it = orders_.find(order_id);
+    if (it == orders_.end()) return false;
+    o = it->second;
+    return true;
+}
+
+bool MemoryStorage::DTBdeleteOrder(const std::string& order_id) {
+    Guard g(this, true);
+    eraseOrderLocked(order_id);
+    return true;
+}
+
+std::vector<Order> MemoryStorage::DTBloadOrdersByUser(const std::string& user_phone) {
+    Guard g(this, false);
+    std::vector<Order> orders;
+    auto idx = ordersByUser_.find(user_phone);
+    if (idx == ordersByUser_.end()) return orders;
+    orders.reserve(idx->second.size());
+    for (const auto& id : idx->second) {
+        auto it = orders_.find(id);
+        if (it != orders_.end()) orders.push_back(it->second);
+    }
+    return orders;
+}
+
+std::vector<Order> MemoryStorage::DTBloadOrdersByStatus(int status) {
+    Guard g(this, false);
+    std::vector<Order> orders;
+    for (const auto& kv : orders_) {
+        if (kv.second.getStatus() == status) orders.push_back(kv.second);
+    }
+    std::sort(orders.begin(), orders.end(), [](const Order& a, const Order& b) { return a.getOrderId() < b.getOrderId(); });
+    return orders;
+}
+
+std::vector<Order> MemoryStorage::DTBloadRecentOrders(int limit) {
+    Guard g(this, false);
+    std::vector<Order> orders;
+    if (limit <= 0) return orders;
+    std::vector<const std::string*> ids;
+    ids.reserve(orders_.size());
+    for (const auto& kv : orders_) ids.push_back(&kv.first);
+    const size_t n = (std::min)(ids.size(), static_cast<size_t>(limit));
+    std::partial_sort(ids.begin(), ids.begin() + n, ids.end(),
+        [](const std::string* a, const std::string* b) { return *a > *b; });
+    orders.reserve(n);
+    for (size_t i = 0; i < n; ++i) orders.push_back(orders_.at(*ids[i]));
+    return orders;
+}
+
+std::vector<Order> MemoryStorage::DTBloadOrdersPage(const std::string& afterOrderId, int limit, bool descending) {
+    Guard g(this, false);
+    std::vector<Order> orders;
+    pageRange(orders_, afterOrderId, !afterOrderId.empty(), limit, descending, [&orders](const Order& o) {
+        orders.push_back(o);
+        orders.back().setItems(std::vector<OrderItem>()); // 与 MySQL 后端一致：列表只含订单头
+    });
+    return orders;
+}
+
+std::vector<Order> MemoryStorage::DTBqueryOrders(const OrderQuery& q, const std::string& afterOrderId, int limit, bool descending) {
+    Guard g(this, false);
+    std::vector<Order> orders;
+    if (limit <= 0) return orders;
+    const size_t want = static_cast<size_t>(limit);
+    auto take = [&](const Order& o) {
+        if (q.matches(o)) {
+            orders.push_back(o);
+            orders.back().setItems(std::vector<OrderItem>());
+        }
+        return orders.size() < want;
+    };
+    if (q.userPhone.empty()) {
+        scanFrom(orders_, afterOrderId, !afterOrderId.empty(), descending,
+            [&take](const std::pair<const std::string, Order>& kv) { return take(kv.second); });
+        return orders;
+    }
+    // 指定用户时只遍历该用户的订单号索引（同样按 order_id 有序）
+    auto idx = ordersByUser_.find(q.userPhone);
+    if (idx == ordersByUser_.end()) return orders;
+    scanFrom(idx->second, afterOrderId, !afterOrderId.empty(), descending, [&](const std::string& id) {
+        auto it = orders_.find(id);
+        return it == orders_.end() || take(it->second);
+    });
+    return orders;
+}
+
+// ---------------- 订单项 ----------------
+
+bool MemoryStorage::DTBsaveOrderItem(const OrderItem& item) {
+    Guard g(this, true);
+    auto it = orders_.find(item.getOrderId());
+    if (it == orders_.end()) return false; // 外键：订单必须存在
+    journalOrder(item.getOrderId());
+    std::vector<OrderItem> items = it->second.getItems();
+    items.push_back(item);
+    it->second.setItems(items);
+    return true;
+}
+
+bool MemoryStorage::DTBupdateOrderItem(const OrderItem& item) {
+    Guard g(this, true);
+    auto it = orders_.find(item.getOrderId());
+    if (it == orders_.end()) return true;
+    journalOrder(item.getOrderId());
+    std::vector<OrderItem> items = it->second.getItems();
+    for (auto& existing : items) {
+        if (existing.getGoodId() == item.getGoodId()) existing = item;
+    }
+    it->second.setItems(items);
+    return true;
+}
+
+std::vector<OrderItem> MemoryStorage::DTBloadOrderItems(const std::string& order_id) {
+    Guard g(this, false);
+    auto it = orders_.find(order_id);
+    return it == orders_.end() ? std::vector<OrderItem>() : it->second.getItems();
+}
+
+std::map<std::string, std::vector<OrderItem>> MemoryStorage::DTBloadOrderItemsByOrders(const std::vector<std::string>& order_ids) {
+    Guard g(this, false);
+    std::map<std::string, std::vector<OrderItem>> grouped;
+    for (const auto& id : order_ids) {
+        auto it = orders_.find(id);
+        if (it != orders_.end() && !it->second.getItems().empty()) grouped[id] = it->second.getItems();
+    }
+    return grouped;
+}
+
+bool MemoryStorage::DTBdeleteOrderItems(const std::string& order_id) {
+    Guard g(this, true);
+    auto it = orders_.find(order_id);
+    if (it == orders_.end()) return true;
+    journalOrder(order_id);
+    it->second.setItems(std::vector<OrderItem>());
+    return true;
+}
+
+// ---------------- 购物车 ----------------
+
+bool MemoryStorage::DTBloadTemporaryCart(const std::string& cart_id, TemporaryCart& cart) {
+    Guard g(this, false);
+    auto it = carts_.find(cart_id);
+    if (it == carts_.end()) return false;
+    cart = it->second.cart;
+    cart.items = liveCartItems(it->second.cart);
+    return true;
+}
+
+bool MemoryStorage::DTBloadTemporaryCartByUserPhone(const std::string& userPhone, TemporaryCart& outCart) {
+    Guard g(this, false);
+    auto idx = cartsByUser_.find(userPhone);
+    if (idx == cartsByUser_.end() || idx->second.empty()) return false;
+    auto it = carts_.find(*idx->second.rbegin());
+    if (it == carts_.end()) return false;
+    outCart = it->second.cart;
+    outCart.items = liveCartItems(it->second.cart);
+    return true;
+}
+
+bool MemoryStorage::DTBdeleteTemporaryCart(const std::string& cart_id) {
+    Guard g(this, true);
+    eraseCartLocked(cart_id);
+    return true;
+}
+
+bool MemoryStorage::DTBsaveTemporaryCart(const TemporaryCart& cart) {
+    Guard g(this, true);
+    // 已存在时静默返回 false：SERsaveCart 总是先尝试保存、失败再更新，这是普通的购物车更新路径
+    if (carts_.count(cart.cart_id)) return false;
+    CartRow row;
+    row.cart = cart;
+    row.updatedMs = nowMs();
+    putCartLocked(row);
+    return true;
+}
+
+bool MemoryStorage::DTBupdateTemporaryCart(const TemporaryCart& cart) {
+    Guard g(this, true);
+    if (!carts_.count(cart.cart_id)) return true;
+    CartRow row;
+    row.cart = cart;
+    row.updatedMs = nowMs();
+    putCartLocked(row);
+    return true;
+}
+
+std::vector<TemporaryCart> MemoryStorage::DTBloadExpiredCarts() {
+    Guard g(this, false);
+    std::vector<TemporaryCart> carts;
+    const int64_t cutoff = nowMs() - 24LL * 3600 * 1000;
+    for (const auto& kv : carts_) {
+        if (kv.second.cart.is_converted || kv.second.updatedMs >= cutoff) continue;
+        TemporaryCart cart = kv.second.cart;
+        cart.items = liveCartItems(kv.second.cart);
+        carts.push_back(std::move(cart));
+    }
+    return carts;
+}
+
+bool MemoryStorage::DTBcleanupExpiredCarts() {
+    Guard g(this, true);
+    const int64_t cutoff = nowMs() - 24LL * 3600 * 1000;
+    std::vector<std::string> expired;
+    for (const auto& kv : carts_) {
+        if (!kv.second.cart.is_converted && kv.second.updatedMs < cutoff) expired.push_back(kv.first);
+    }
+    for (const auto& id : expired) eraseCartLocked(id);
+    return true;
+}
+
+bool MemoryStorage::DTBsaveCartItem(const CartItem& item, const std::string& cart_id) {
+    Guard g(this, true);
+    auto it = carts_.find(cart_id);
+    if (it == carts_.end()) return false; // 外键：购物车必须存在
+    for (const auto& existing : it->second.cart.items) {
+        if (existing.good_id == item.good_id) return false; // (cart_id, good_id) 主键冲突
+    }
+    journalCart(cart_id);
+    it->second.cart.items.push_back(item);
+    it->second.updatedMs = nowMs();
+    return true;
+}
+
+bool MemoryStorage::DTBupdateCartItem(const CartItem& item, const std::string& cart_id) {
+    Guard g(this, true);
+    auto it = carts_.find(cart_id);
+    if (it == carts_.end()) return true;
+    journalCart(cart_id);
+    for (auto& existing : it->second.cart.items) {
+        if (existing.good_id == item.good_id) existing = item;
+    }
+    it->second.updatedMs = nowMs();
+    return true;
+}
+
+bool MemoryStorage::DTBdeleteCartItem(int good_id, const std::string& cart_id) {
+    Guard g(this, true);
+    auto it = carts_.find(cart_id);
+    if (it == carts_.end()) return true;
+    journalCart(cart_id);
+    auto& items = it->second.cart.items;
+    items.erase(std::remove_if(items.begin(), items.end(), [good_id](const CartItem& c) { return c.good_id == good_id; }), items.end());
+    it->second.updatedMs = nowMs();
+    return true;
+}
+
+bool MemoryStorage::DTBdeleteAllCartItems(const std::string& cart_id) {
+    Guard g(this, true);
+    auto it = carts_.find(cart_id);
+    if (it == carts_.end()) return true;
+    journalCart(cart_id);
+    it->second.cart.items.clear();
+    it->second.updatedMs = nowMs();
+    return true;
+}
+
+std::vector<CartItem> MemoryStorage::DTBloadCartItems(const std::string& cart_id) {
+    Guard g(this, false);
+    auto it = carts_.find(cart_id);
+    return it == carts_.end() ? std::vector<CartItem>() : liveCartItems(it->second.cart);
+}
+
+// ---------------- 促销策略 ----------------
+
+bool MemoryStorage::DTBsavePromotionStrategy(const std::string& name, const std::string& /*type*/,
+    const std::string& config, const std::string& /*conditions*/) {
+    Guard g(this, true);
+    if (promotions_.count(name)) return false;
+    journalPromotion(name);
+    PromotionRow row;
+    row.id = nextPromotionId_++;
+    row.policyDetail = config;
+    promotions_[name] = row;
+    return true;
+}
+
+bool MemoryStorage::DTBupdatePromotionStrategy(const std::string& /*name*/, bool /*is_active*/) {
+    // 与 MySQL 后端一致：表中没有 is_active 字段
+    return true;
+}
+
+static std::map<std::string, std::string> promotionRowMap(const std::string& name, int id, const std::string& policy) {
+    std::map<std::string, std::string> entry;
+    entry["id"] = std::to_string(id);
+    entry["name"] = name;
+    entry["policy_detail"] = policy;
+    return entry;
+}
+
+std::map<std::string, std::string> MemoryStorage::DTBloadPromotionStrategy(const std::string& name) {
+    Guard g(this, false);
+    auto it = promotions_.find(name);
+    if (it == promotions_.end()) return std::map<std::string, std::string>();
+    return promotionRowMap(it->first, it->second.id, it->second.policyDetail);
+}
+
+std::vector<std::map<std::string, std::string>> MemoryStorage::DTBloadAllPromotionStrategies(bool /*active_only*/) {
+    Guard g(this, false);
+    std::vector<std::map<std::string, std::string>> out;
+    std::vector<std::pair<int, const std::string*>> byId;
+    byId.reserve(promotions_.size());
+    for (const auto& kv : promotions_) byId.emplace_back(kv.second.id, &kv.first);
+    std::sort(byId.begin(), byId.end());
+    out.reserve(byId.size());
+    for (const auto& p : byId) {
+        const PromotionRow& row = promotions_.at(*p.second);
+        out.push_back(promotionRowMap(*p.second, row.id, row.policyDetail));
+    }
+    return out;
+}
+
+bool MemoryStorage::DTBupdatePromotionStrategyDetail(const std::string& name, const std::string& policy_detail) {
+    Guard g(this, true);
+    auto it = promotions_.find(name);
+    if (it == promotions_.end()) return false;
+    journalPromotion(name);
+    it->second.policyDetail = policy_detail;
+    return true;
+}
+
+bool MemoryStorage::DTBdeletePromotionStrategy(const std::string& name) {
+    Guard g(this, true);
+    if (promotions_.count(name)) {
+        journalPromotion(name);
+        promotions_.erase(name);
+    }
+    return true;
+}
+
+// ---------------- 快照 ----------------
+
+static json orderItemsJson(const std::vector<OrderItem>& items) {
+    json arr = json::array();
+    for (const auto& it : items) {
+        arr.push_back({ {"good_id", it.getGoodId()}, {"good_name", it.getGoodName()}, {"price", it.getPrice()},
+                        {"quantity", it.getQuantity()}, {"subtotal", it.getSubtotal()} });
+    }
+    return arr;
+}
+
+static json cartItemsJson(const std::vector<CartItem>& items) {
+    json arr = json::array();
+    for (const auto& it : items) {
+        arr.push_back({ {"good_id", it.good_id}, {"good_name", it.good_name}, {"price", it.price},
+                        {"quantity", it.quantity}, {"subtotal", it.subtotal} });
+    }
+    return arr;
+}
+
+bool MemoryStorage::DTBsaveSnapshot(const std::string& path) const {
+    json root;
+    {
+        Guard g(this, false);
+        root["version"] = 1;
+        root["next_good_id"] = nextGoodId_;
+        root["next_promotion_id"] = nextPromotionId_;
+        json goods = json::array();
+        for (const auto& kv : goods_) {
+            const Good& g = kv.second;
+            goods.push_back({ {"id", g.getId()}, {"name", g.getName()}, {"price", g.getPrice()},
+                              {"stock", g.getStock()}, {"category", g.getCategory()} });
+        }
+        root["goods"] = std::move(goods);
+        json users = json::array();
+        for (const auto& kv : users_) {
+            users.push_back({ {"phone", kv.second.getPhone()}, {"password", kv.second.getPassword()}, {"address", kv.second.getAddress()} });
+        }
+        root["users"] = std::move(users);
+        json orders = json::array();
+        for (const auto& kv : orders_) {
+            const Order& o = kv.second;
+            orders.push_back({ {"order_id", o.getOrderId()}, {"user_phone", o.getUserPhone()},
+                               {"shipping_address", o.getShippingAddress()}, {"status", o.getStatus()},
+                               {"discount_policy", o.getDiscountPolicy()}, {"total_amount", o.getTotalAmount()},
+                               {"discount_amount", o.getDiscountAmount()}, {"final_amount", o.getFinalAmount()},
+                               {"items", orderItemsJson(o.getItems())} });
+        }
+        root["orders"] = std::move(orders);
+        json carts = json::array();
+        for (const auto& kv : carts_) {
+            const TemporaryCart& c = kv.second.cart;
+            carts.push_back({ {"cart_id", c.cart_id}, {"user_phone", c.user_phone},
+                              {"shipping_address", c.shipping_address}, {"discount_policy", c.discount_policy},
+                              {"total_amount", c.total_amount}, {"discount_amount", c.discount_amount},
+                              {"final_amount", c.final_amount}, {"is_converted", c.is_converted},
+                              {"updated_ms", kv.second.updatedMs}, {"items", cartItemsJson(c.items)} });
+        }
+        root["carts"] = std::move(carts);
+        json promotions = json::array();
+        for (const auto& kv : promotions_) {
+            promotions.push_back({ {"id", kv.second.id}, {"name", kv.first}, {"policy_detail", kv.second.policyDetail} });
+        }
+        root["promotions"] = std::move(promotions);
+    }
+
+    // 先写临时文件再原子替换，中途退出或崩溃都不会留下半个快照或丢失旧快照
+    if (!writeFileAtomically(path, root.dump())) {
+        std::cerr << "MemoryStorage: 快照写入失败 " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MemoryStorage::DTBloadSnapshot(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    std::map<int, Good> goods;
+    std::map<std::string, User> users;
+    std::vector<Order> orders;
+    std::vector<CartRow> carts;
+    std::map<std::string, PromotionRow> promotions;
+    int nextGoodId = 1, nextPromotionId = 1;
+    try {
+        json root = json::parse(in);
+        for (const auto& j : root.value("goods", json::array())) {
+            const int id = j.at("id").get<int>();
+            goods[id] = Good(id, j.value("name", ""), j.value("price", 0.0), j.value("stock", 0), j.value("category", ""));
+            nextGoodId = (std::max)(nextGoodId, id + 1);
+        }
+        for (const auto& j : root.value("users", json::array())) {
+            const std::string phone = j.at("phone").get<std::string>();
+            users[phone] = User(phone, j.value("password", ""), j.value("address", ""));
+        }
+        for (const auto& j : root.value("orders", json::array())) {
+            Order o;
+            o.setOrderId(j.at("order_id").get<std::string>());
+            o.setUserPhone(j.value("user_phone", ""));
+            o.setShippingAddress(j.value("shipping_address", ""));
+            o.setStatus(j.value("status", 0));
+            o.setDiscountPolicy(j.value("discount_policy", ""));
+            o.setTotalAmount(j.value("total_amount", 0.0));
+            o.setDiscountAmount(j.value("discount_amount", 0.0));
+            o.setFinalAmount(j.value("final_amount", 0.0));
+            std::vector<OrderItem> items;
+            for (const auto& ji : j.value("items", json::array())) {
+                OrderItem item;
+                item.setOrderId(o.getOrderId());
+                item.setGoodId(ji.value("good_id", 0));
+                item.setGoodName(ji.value("good_name", ""));
+                item.setPrice(ji.value("price", 0.0));
+                item.setQuantity(ji.value("quantity", 0));
+                item.setSubtotal(ji.value("subtotal", 0.0));
+                items.push_back(item);
+            }
+            o.setItems(items);
+            orders.push_back(std::move(o));
+        }
+        for (const auto& j : root.value("carts", json::array())) {
+            CartRow row;
+            TemporaryCart& c = row.cart;
+            c.cart_id = j.at("cart_id").get<std::string>();
+            c.user_phone = j.value("user_phone", "");
+            c.shipping_address = j.value("shipping_address", "");
+            c.discount_policy = j.value("discount_policy", "");
+            c.total_amount = j.value("total_amount", 0.0);
+            c.discount_amount = j.value("discount_amount", 0.0);
+            c.final_amount = j.value("final_amount", 0.0);
+            c.is_converted = j.value("is_converted", false);
+            row.updatedMs = j.value("updated_ms", static_cast<int64_t>(0));
+            for (const auto& ji : j.value("items", json::array())) {
+                CartItem item;
+                item.good_id = ji.value("good_id", 0);
+                item.good_name = ji.value("good_name", "");
+                item.price = ji.value("price", 0.0);
+                item.quantity = ji.value("quantity", 0);
+                item.subtotal = ji.value("subtotal", 0.0);
+                c.items.push_back(item);
+            }
+            carts.push_back(std::move(row));
+        }
+        for (const auto& j : root.value("promotions", json::array())) {
+            PromotionRow row;
+            row.id = j.value("id", 0);
+            row.policyDetail = j.value("policy_detail", "");
+            promotions[j.at("name").get<std::string>()] = row;
+            nextPromotionId = (std::max)(nextPromotionId, row.id + 1);
+        }
+        nextGoodId = (std::max)(nextGoodId, root.value("next_good_id", 1));
+        nextPromotionId = (std::max)(nextPromotionId, root.value("next_promotion_id", 1));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "MemoryStorage: 快照解析失败 " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    Guard g(this, true);
+    goods_ = std::move(goods);
+    users_ = std::move(users);
+    nextGoodId_ = nextGoodId;
+    nextPromotionId_ = nextPromotionId;
+    promotions_ = std::move(promotions);
+    orders_.clear();
+    ordersByUser_.clear();
+    for (const auto& o : orders) putOrderLocked(o);
+    carts_.clear();
+    cartsByUser_.clear();
+    for (const auto& row : carts) putCartLocked(row);
+    std::cout << "MemoryStorage: 已从快照载入 " << goods_.size() << " 个商品、" << users_.size() << " 个用户、"
+              << orders_.size() << " 个订单、" << carts_.size() << " 个购物车" << std::endl;
+    return true;
+}
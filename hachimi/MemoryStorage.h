@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Storage.h"
+
+// 内存存储后端：全部数据保存在进程内的表中，用于无 MySQL 环境下的测试与压测，
+// 也可与 MySQL 后端对比，区分服务端自身耗时与数据库耗时
+// - 索引：商品 id、用户手机号、订单号（有序，分页时直接定位游标）、用户 -> 订单、用户 -> 购物车
+// - 并发：读写锁；事务（DTBbeginTransaction）期间独占整个存储，写操作记录撤销日志，未提交则按日志回滚
+// - 持久化（可选）：构造时给出快照路径，则 DTBinitialize 时读取、DTBflush 与析构时以 JSON 写出
+class MemoryStorage : public Storage {
+public:
+    explicit MemoryStorage(const std::string& snapshotPath = std::string());
+    ~MemoryStorage() override;
+    MemoryStorage(const MemoryStorage&) = delete;
+    MemoryStorage& operator=(const MemoryStorage&) = delete;
+
+    bool DTBinitialize() override;
+    bool DTBisConnected() const override { return true; }
+    bool DTBisThreadSafe() const override { return true; }
+    bool DTBflush() override;
+
+    std::unique_ptr<Storage::Transaction> DTBbeginTransaction() override;
+
+    // 快照：写出先写临时文件再改名；读取失败时保留当前数据
+    bool DTBsaveSnapshot(const std::string& path) const;
+    bool DTBloadSnapshot(const std::string& path);
+
+    // 用户管理
+    bool DTBaddUser(const User& u) override;
+    bool DTBsaveUser(const User& u) override;
+    bool DTBupdateUser(const User& u) override;
+    bool DTBloadUser(const std::string& phone, User& u) override;
+    bool DTBdeleteUser(const std::string& phone) override;
+    std::vector<User> DTBloadAllUsers() override;
+    std::vector<User> DTBloadUsersPage(const std::string& afterPhone, int limit, bool descending = false) override;
+    std::vector<User> DTBqueryUsers(const std::string& phone, const std::string& afterPhone, int limit, bool descending = false) override;
+
+    // 商品管理
+    bool DTBsaveGood(const Good& g, int* newId = nullptr) override;
+    bool DTBupdateGood(const Good& g) override;
+    bool DTBloadGood(int id, Good& g) override;
+    bool DTBdeleteGood(int id) override;
+    std::vector<Good> DTBloadAllGoods(bool* ok = nullptr) override;
+    std::vector<Good> DTBloadGoodsPage(int afterId, int limit, bool descending = false) override;
+    std::vector<Good> DTBqueryGoods(const GoodsQuery& q, int afterId, int limit, bool descending = false) override;
+    std::vector<Good> DTBloadGoodsByCategory(const std::string& category) override;
+    std::map<int, Good> DTBloadGoodsByIds(const std::vector<int>& ids) override;
+    bool DTBupdateGoodStock(int good_id, int new_stock) override;
+
+    // 订单管理
+    bool DTBsaveOrder(const Order& o) override;
+    OrderSaveResult DTBsaveOrderWithStock(const Order& o) override;
+    bool DTBupdateOrder(const Order& o) override;
+    bool DTBupdateOrderStatus(const std::string& order_id, int status) override;
+    bool DTBloadOrder(const std::string& order_id, Order& o) override;
+    bool DTBdeleteOrder(const std::string& order_id) override;
+    std::vector<Order> DTBloadOrdersByUser(const std::string& user_phone) override;
+    std::vector<Order> DTBloadOrdersByStatus(int status) override;
+    std::vector<Order> DTBloadRecentOrders(int limit = 50) override;
+    std::vector<Order> DTBloadOrdersPage(const std::string& afterOrderId, int limit, bool descending = true) override;
+    std::vector<Order> DTBqueryOrders(const OrderQuery& q, const std::string& afterOrderId, int limit, bool descending = true) override;
+
+    // 订单项管理
+    bool DTBsaveOrderItem(const OrderItem& item) override;
+    bool DTBupdateOrderItem(const OrderItem& item) override;
+    std::vector<OrderItem> DTBloadOrderItems(const std::string& order_id) override;
+    std::map<std::string, std::vector<OrderItem>> DTBloadOrderItemsByOrders(const std::vector<std::string>& order_ids) override;
+    bool DTBdeleteOrderItems(const std::string& order_id) override;
+
+    // 临时购物车管理
+    bool DTBloadTemporaryCart(const std::string& cart_id, TemporaryCart& cart) override;
+    bool DTBloadTemporaryCartByUserPhone(const std::string& userPhone, TemporaryCart& outCart) override;
+    bool DTBdeleteTemporaryCart(const std::string& cart_id) override;
+    bool DTBsaveTemporaryCart(const TemporaryCart& cart) override;
+    bool DTBupdateTemporaryCart(const TemporaryCart& cart) override;
+    std::vector<TemporaryCart> DTBloadExpiredCarts() override;
+    bool DTBcleanupExpiredCarts() override;
+
+    // 购物车项管理
+    bool DTBsaveCartItem(const CartItem& item, const std::string& cart_id) override;
+    bool DTBupdateCartItem(const CartItem& item, const std::string& cart_id) override;
+    bool DTBdeleteCartItem(int good_id, const std::string& cart_id) override;
+    bool DTBdeleteAllCartItems(const std::string& cart_id) override;
+    std::vector<CartItem> DTBloadCartItems(const std::string& cart_id) override;
+
+    // 促销策略
+    bool DTBsavePromotionStrategy(const std::string& name, const std::string& type,
+        const std::string& config, const std::string& conditions = "") override;
+    bool DTBupdatePromotionStrategy(const std::string& name, bool is_active) override;
+    std::map<std::string, std::string> DTBloadPromotionStrategy(const std::string& name) override;
+    std::vector<std::map<std::string, std::string>> DTBloadAllPromotionStrategies(bool active_only = true) override;
+    bool DTBupdatePromotionStrategyDetail(const std::string& name, const std::string& policy_detail) override;
+    bool DTBdeletePromotionStrategy(const std::string& name) override;
+
+private:
+    class Guard;
+    class Txn;
+
+    struct CartRow {
+        TemporaryCart cart;
+        int64_t updatedMs = 0; // 最后更新时间（毫秒时间戳），用于过期判断
+    };
+    struct PromotionRow {
+        int id = 0;
+        std::string policyDetail;
+    };
+
+    // 以下 *Locked 方法要求调用方已持有写锁（或处于本线程的事务中）；
+    // 修改前把旧值写入撤销日志，二级索引随主表一起维护
+    void putOrderLocked(const Order& o);
+    void eraseOrderLocked(const std::string& orderId);
+    void putCartLocked(const CartRow& row);
+    void eraseCartLocked(const std::string& cartId);
+    void journalGood(int id);
+    void journalUser(const std::string& phone);
+    void journalOrder(const std::string& orderId);
+    void journalCart(const std::string& cartId);
+    void journalPromotion(const std::string& name);
+    void journal(std::function<void()> undo);
+    // 过滤掉引用了已删除商品的购物车项（MySQL 后端读取时删除这些项；商品 id 不会复用，过滤与删除对读取方等价）
+    std::vector<CartItem> liveCartItems(const TemporaryCart& cart) const;
+
+    std::string snapshotPath_;
+    mutable std::shared_mutex mtx_;
+
+    std::map<int, Good> goods_;
+    int nextGoodId_ = 1;
+    std::map<std::string, User> users_;
+    std::map<std::string, Order> orders_;                                 // 订单项保存在 Order 内
+    std::unordered_map<std::string, std::set<std::string>> ordersByUser_; // 手机号 -> 订单号
+    std::unordered_map<std::string, CartRow> carts_;
+    std::unordered_map<std::string, std::set<std::string>> cartsByUser_;  // 手机号 -> 购物车 id（最大者为最新）
+    std::map<std::string, PromotionRow> promotions_;                      // 按名称
+    int nextPromotionId_ = 1;
+};
@@ -0,0 +1,107 @@
+#include "PromotionIndex.h"
+#include <algorithm>
+
+std::vector<PromotionIndex::RulePtr> PromotionIndex::Snapshot::rulesFor(int productId) const {
+    auto it = byProduct.find(productId);
+    if (it == byProduct.end()) return global;
+    // 两个列表均按 seq 有序，归并以保持数据库顺序
+    std::vector<RulePtr> out;
+    out.reserve(global.size() + it->second.size());
+    std::merge(global.begin(), global.end(), it->second.begin(), it->second.end(), std::back_inserter(out),
+        [](const RulePtr& a, const RulePtr& b) { return a->seq < b->seq; });
+    return out;
+}
+
+double PromotionIndex::Snapshot::bestSubtotal(int productId, double price, int quantity) const {
+    double best = price * static_cast<double>(quantity);
+    auto consider = [&](const std::vector<RulePtr>& rules) {
+        for (const auto& r : rules) {
+            if (!r->strategy) continue;
+            try {
+                double applied = r->strategy->apply(price, quantity);
+                if (applied < best) best = applied;
+            }
+            catch (...) {
+                // 单条策略应用失败则跳过
+            }
+        }
+    };
+    consider(global);
+    auto it = byProduct.find(productId);
+    if (it != byProduct.end()) consider(it->second);
+    return best;
+}
+
+std::shared_ptr<const PromotionIndex::Snapshot> PromotionIndex::compile(const std::vector<std::map<std::string, std::string>>& rows) {
+    auto snap = std::make_shared<Snapshot>();
+    size_t seq = 0;
+    for (const auto& m : rows) {
+        auto pd = m.find("policy_detail");
+        if (pd == m.end()) continue;
+        auto rule = std::make_shared<Rule>();
+        try {
+            rule->policy = nlohmann::json::parse(pd->second);
+        }
+        catch (...) {
+            continue;
+        }
+        if (!rule->policy.is_object()) continue;
+        rule->seq = seq++;
+        rule->id = m.count("id") ? m.at("id") : "";
+        rule->name = m.count("name") ? m.at("name") : "";
+        rule->global = rule->policy.contains("scope") && rule->policy["scope"].is_string() && rule->policy["scope"] == "global";
+        try {
+            rule->strategy = PromotionStrategy::fromJson(rule->policy);
+        }
+        catch (...) {
+            rule->strategy.reset();
+        }
+
+        RulePtr ptr = rule;
+        snap->rules.push_back(ptr);
+        if (ptr->global) {
+            // 全局规则已对所有商品生效，不再进入倒排索引
+            snap->global.push_back(ptr);
+            continue;
+        }
+        if (ptr->policy.contains("product_ids") && ptr->policy["product_ids"].is_array()) {
+            for (const auto& pid : ptr->policy["product_ids"]) {
+                int id = 0;
+                if (pid.is_number_integer()) id = pid.get<int>();
+                else if (pid.is_number()) id = static_cast<int>(pid.get<double>());
+                else if (pid.is_string()) {
+                    try { id = std::stoi(pid.get<std::string>()); }
+                    catch (...) { continue; }
+                }
+                else continue;
+                auto& list = snap->byProduct[id];
+                // 同一规则重复列出同一商品时只登记一次
+                if (list.empty() || list.back() != ptr) list.push_back(ptr);
+            }
+        }
+    }
+    return snap;
+}
+
+std::shared_ptr<const PromotionIndex::Snapshot> PromotionIndex::snapshot() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return current_;
+}
+
+uint64_t PromotionIndex::generation() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return generation_;
+}
+
+bool PromotionIndex::publish(std::shared_ptr<const Snapshot> snap, uint64_t expectedGeneration) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (generation_ != expectedGeneration) return false;
+    current_ = std::move(snap);
+    return true;
+}
+
+void PromotionIndex::invalidate() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    current_.reset();
+    ++generation_;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "PromotionStrategy.h"
+
+// 编译后的促销索引
+// - 每条 promotionstrategy 记录的 policy_detail 只解析一次，编译为 Rule（含 PromotionStrategy 对象）
+// - 倒排索引：商品 id -> 适用规则；scope 为 global 的规则单独成表
+// - 数据以不可变快照发布，读方拿到快照后无需持锁；只有促销增删改时才重建
+class PromotionIndex {
+public:
+    struct Rule {
+        size_t seq = 0;             // 在数据库结果中的顺序，用于保持返回顺序
+        std::string id;
+        std::string name;
+        nlohmann::json policy;      // 解析后的 policy_detail
+        std::shared_ptr<PromotionStrategy> strategy; // 无法识别的类型为空（仍会出现在查询结果中，但不参与计算）
+        bool global = false;
+    };
+    using RulePtr = std::shared_ptr<const Rule>;
+
+    struct Snapshot {
+        std::vector<RulePtr> rules;
+        std::vector<RulePtr> global;
+        std::unordered_map<int, std::vector<RulePtr>> byProduct;
+
+        // 适用于某商品的规则（全局 + 指定商品），按数据库顺序
+        std::vector<RulePtr> rulesFor(int productId) const;
+        // 该商品在所有适用规则下的最低小计；无适用规则时为原价小计
+        double bestSubtotal(int productId, double price, int quantity) const;
+    };
+
+    // 由 DTBloadAllPromotionStrategies 的结果编译快照（解析失败的记录被跳过）
+    static std::shared_ptr<const Snapshot> compile(const std::vector<std::map<std::string, std::string>>& rows);
+
+    // 当前快照；未构建或已失效时返回 nullptr
+    std::shared_ptr<const Snapshot> snapshot() const;
+    uint64_t generation() const;
+    // 用新快照替换；若期间发生过 invalidate（代数变化）则放弃并返回 false
+    bool publish(std::shared_ptr<const Snapshot> snap, uint64_t expectedGeneration);
+    void invalidate();
+
+private:
+    mutable std::mutex mtx_;
+    std::shared_ptr<const Snapshot> current_;
+    uint64_t generation_ = 0;
+};
@@ -0,0 +1,96 @@
+#include "RequestWorkerPool.h"
+
+RequestWorkerPool::RequestWorkerPool(int threadCount, std::function<void()> onThreadStart, std::function<void()> onThreadStop)
+    : onThreadStart_(std::move(onThreadStart)), onThreadStop_(std::move(onThreadStop)) {
+    if (threadCount < 1) threadCount = 1;
+    workers_.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+RequestWorkerPool::~RequestWorkerPool() {
+    stop();
+}
+
+bool RequestWorkerPool::submit(uint64_t connectionKey, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (stopping_) return false;
+        Strand& st = strands_[connectionKey];
+        st.pending.push_back(std::move(task));
+        if (st.active) return true; // 由当前执行该连接的线程在完成后继续调度
+        st.active = true;
+        ready_.push_back(connectionKey);
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void RequestWorkerPool::dropConnection(uint64_t connectionKey) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = strands_.find(connectionKey);
+    if (it == strands_.end()) return;
+    it->second.pending.clear();
+    // 未在执行的连接直接移除；就绪队列中的残留 key 在取出时因找不到 strand 而被跳过
+    if (!it->second.active) strands_.erase(it);
+}
+
+void RequestWorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (stopping_ && workers_.empty()) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+    workers_.clear();
+    std::lock_guard<std::mutex> lock(mtx_);
+    strands_.clear();
+    ready_.clear();
+}
+
+void RequestWorkerPool::workerLoop() {
+    if (onThreadStart_) onThreadStart_();
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true) {
+        cv_.wait(lock, [this]() { return stopping_ || !ready_.empty(); });
+        if (stopping_) break;
+
+        uint64_t key = ready_.front();
+        ready_.pop_front();
+        auto it = strands_.find(key);
+        if (it == strands_.end()) continue;
+        if (it->second.pending.empty()) {
+            // 连接已被 dropConnection 清空
+            strands_.erase(it);
+            continue;
+        }
+        Task task = std::move(it->second.pending.front());
+        it->second.pending.pop_front();
+
+        lock.unlock();
+        try {
+            task();
+        } catch (...) {
+            // 任务内部应自行处理异常；此处兜底避免工作线程退出
+        }
+        lock.lock();
+
+        // 同一连接的后续任务重新排到就绪队列尾部，避免一个繁忙连接独占工作线程
+        it = strands_.find(key);
+        if (it == strands_.end()) continue;
+        if (it->second.pending.empty()) {
+            strands_.erase(it);
+        } else {
+            ready_.push_back(key);
+            cv_.notify_one();
+        }
+    }
+    lock.unlock();
+
+    if (onThreadStop_) onThreadStop_();
+}
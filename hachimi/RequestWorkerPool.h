@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 请求处理线程池
+// - 任务按连接 key 串行执行（同一连接的请求保持先后顺序），不同连接可并行
+// - onThreadStart/onThreadStop 在每个工作线程启动/退出时于该线程内调用，
+//   用于创建/销毁线程私有资源（例如每线程一个 DatabaseManager 连接）
+class RequestWorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    RequestWorkerPool(int threadCount, std::function<void()> onThreadStart = nullptr, std::function<void()> onThreadStop = nullptr);
+    ~RequestWorkerPool();
+
+    RequestWorkerPool(const RequestWorkerPool&) = delete;
+    RequestWorkerPool& operator=(const RequestWorkerPool&) = delete;
+
+    // 提交某连接的任务；停止后提交的任务被丢弃并返回 false
+    bool submit(uint64_t connectionKey, Task task);
+    // 连接断开后丢弃其尚未执行的任务（正在执行的任务不受影响）
+    void dropConnection(uint64_t connectionKey);
+    // 停止并等待全部工作线程退出（未执行的任务被丢弃）
+    void stop();
+
+    int threadCount() const { return static_cast<int>(workers_.size()); }
+
+private:
+    // 每个连接一条串行队列；active 表示该连接已在就绪队列中或正在某个工作线程上执行
+    struct Strand {
+        std::deque<Task> pending;
+        bool active = false;
+    };
+
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::function<void()> onThreadStart_;
+    std::function<void()> onThreadStop_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::unordered_map<uint64_t, Strand> strands_;
+    std::deque<uint64_t> ready_; // 有待执行任务且当前未在执行的连接
+    bool stopping_ = false;
+};
@@ -1,11 +1,16 @@
 #include "Server.h"
+#include "JsonStreamWriter.h"
 #include "logger.h"
 #include <QHostAddress>
+#include <QByteArray>
 #include <nlohmann/json.hpp>
 #include <qdatetime.h>
+#include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <random>
 #include <sstream>
+#include <QTimer>
 #include <fstream> // 为了 std::ofstream
 // --- 增强日志与失败请求记录（添加到 Server.cpp，放在顶部辅助函数区）---
 #include <sys/stat.h>
@@ -30,7 +35,7 @@ static void ensureDirExists(const std::string& dir) {
 static double computeFinalFromPolicy(const nlohmann::json& policy, const nlohmann::json& items, double originalTotal);
 static std::string derivePolicyName(const nlohmann::json& policy);
 
-static void recalcCartTotalsImpl_local(TemporaryCart& cart, const nlohmann::json& policy, DatabaseManager* dbManager) {
+static void recalcCartTotalsImpl_local(TemporaryCart& cart, const nlohmann::json& policy, const PromotionIndex::Snapshot* promotions) {
     // 计算原总额
     double original_total = 0.0;
     nlohmann::json itemsJson = nlohmann::json::array();
@@ -63,59 +68,11 @@ static void recalcCartTotalsImpl_local(TemporaryCart& cart, const nlohmann::json
         }
     }
     else {
-        // 否则使用服务端现有的促销引擎（按单品查询最佳策略）
+        // 否则使用服务端编译好的促销索引（按单品取最佳策略）；没有索引时按原价
         new_total = 0.0;
-
-        // 如果没有 dbManager，则无法查询数据库促销，直接按原价
-        std::vector<std::map<std::string, std::string>> rows;
-        if (dbManager) {
-            try {
-                rows = dbManager->DTBloadAllPromotionStrategies(false);
-            }
-            catch (...) {
-                rows.clear();
-            }
-        }
-
-        for (auto& it : cart.items) {
-            double bestSubtotal = it.price * static_cast<double>(it.quantity);
-
-            // 如果有 db 数据，则解析并尝试应用适配该商品的策略
-            if (!rows.empty()) {
-                for (const auto& m : rows) {
-                    try {
-                        if (!m.count("policy_detail")) continue;
-                        json p = json::parse(m.at("policy_detail"));
-                        bool applies = false;
-                        // 全局适用
-                        if (p.contains("scope") && p["scope"].is_string() && p["scope"] == "global") applies = true;
-                        // 按 product_ids 匹配
-                        if (p.contains("product_ids") && p["product_ids"].is_array()) {
-                            for (const auto& pid : p["product_ids"]) {
-                                if (pid.is_number() && pid.get<int>() == it.good_id) { applies = true; break; }
-                                if (pid.is_string()) {
-                                    try { if (std::stoi(pid.get<std::string>()) == it.good_id) { applies = true; break; } }
-                                    catch (...) {}
-                                }
-                            }
-                        }
-                        if (!applies) continue;
-
-                        // 应用策略（使用 PromotionStrategy 辅助）
-                        json pol = p;
-                        auto strat = PromotionStrategy::fromJson(pol);
-                        double applied = strat->apply(it.price, it.quantity);
-                        if (applied < bestSubtotal) bestSubtotal = applied;
-                    }
-                    catch (...) {
-                        // 单条策略解析/应用失败则跳过
-                        continue;
-                    }
-                }
-            }
-
-            // 如果没有 dbManager 或没有匹配策略，则 bestSubtotal 保持原值
-            new_total += bestSubtotal;
+        for (const auto& it : cart.items) {
+            new_total += promotions ? promotions->bestSubtotal(it.good_id, it.price, it.quantity)
+                                    : it.price * static_cast<double>(it.quantity);
         }
     }
 
@@ -155,8 +112,8 @@ static nlohmann::json orderToJson(const Order& o) {
     return jo;
 }
 
-static bool saveOrderWithLogging(DatabaseManager* db, const Order& o, const nlohmann::json& rawRequestJson = nlohmann::json()) {
-    Logger::instance().info(std::string("Server: attempt DTBsaveOrder order_id=") + o.getOrderId() + " user=" + o.getUserPhone());
+static bool saveOrderWithLogging(Storage* db, const Order& o, const nlohmann::json& rawRequestJson = nlohmann::json()) {
+    LOG_INFO(Server, std::string("Server: attempt DTBsaveOrder order_id=") + o.getOrderId() + " user=" + o.getUserPhone());
     bool ok = db->DTBsaveOrder(o);
     if (!ok) {
         Logger::instance().fail(std::string("Server: DTBsaveOrder FAILED for order_id=") + o.getOrderId());
@@ -172,7 +129,7 @@ static bool saveOrderWithLogging(DatabaseManager* db, const Order& o, const nloh
             if (ofs.is_open()) {
                 ofs << out.dump(4);
                 ofs.close();
-                Logger::instance().info(std::string("Server: dumped failed order to ") + fname);
+                LOG_INFO(Server, std::string("Server: dumped failed order to ") + fname);
             } else {
                 Logger::instance().fail(std::string("Server: unable to open file to write failed order: ") + fname);
             }
@@ -180,36 +137,98 @@ static bool saveOrderWithLogging(DatabaseManager* db, const Order& o, const nloh
             Logger::instance().fail(std::string("Server: exception while writing failed order: ") + ex.what());
         }
     } else {
-        Logger::instance().info(std::string("Server: DTBsaveOrder succeeded order_id=") + o.getOrderId());
+        LOG_INFO(Server, std::string("Server: DTBsaveOrder succeeded order_id=") + o.getOrderId());
     }
     return ok;
 }
 
 using nlohmann::json;
 
+// 工作线程私有的数据库连接（MYSQL* 不能跨线程共享）
+static thread_local Storage* tlsWorkerDb = nullptr;
+
+// 事务 BATCH 执行期间，本线程对商品目录的写入先记在这里，提交成功后才应用、回滚则丢弃，
+// 以免其他工作线程读到未提交的商品与库存
+static thread_local std::vector<std::function<void()>>* tlsPendingCatalog = nullptr;
+
+static void catalogWrite(std::function<void()> op) {
+    if (tlsPendingCatalog) tlsPendingCatalog->push_back(std::move(op));
+    else op();
+}
+
+// 当前请求的响应编码（SERhandleRequest 按 Framed 连接协商的编码设置）。列表命令与 BATCH 按它直接写出
+// CBOR/MessagePack（见 encodedReply），其余响应仍为 JSON 文本，由 SERencodeResponse 转写
+static thread_local WireEncoding tlsReplyEncoding = WireEncoding::Json;
+// 本次响应已按 tlsReplyEncoding 直接编码；此时 tlsReplyFailed 为其是否为错误响应（二进制无法再按文本判断）
+static thread_local bool tlsReplyEncoded = false;
+static thread_local bool tlsReplyFailed = false;
+
+// 返回按 tlsReplyEncoding 写出的响应并登记为已编码
+static std::string encodedReply(std::string out, bool failed = false) {
+    tlsReplyEncoded = tlsReplyEncoding != WireEncoding::Json;
+    tlsReplyFailed = failed;
+    return out;
+}
+
 Server::Server(int port)
-    : port(port), server(nullptr)
+    : Server(port, "127.0.0.1", "root", "a5B3#eF7hJ", "remake", 3306) {}
+
+Server::Server(int port, const std::string& dbHost, const std::string& dbUser, const std::string& dbPassword,
+               const std::string& dbName, unsigned int dbPort)
+    : port(port), server(nullptr),
+      dbHost(dbHost), dbUser(dbUser), dbPassword(dbPassword), dbName(dbName), dbPort(dbPort)
 {
-    dbManager = new DatabaseManager("127.0.0.1", "root", "a5B3#eF7hJ", "remake", 3306);
+    SERregisterCommands();
+    dbManager = new DatabaseManager(dbHost, dbUser, dbPassword, dbName, dbPort);
     if (!dbManager->DTBinitialize()) {
         Logger::instance().fail("Server: DatabaseManager 初始化失败，DTBconnect 返回 false");
     } else {
-        Logger::instance().info("Server: DatabaseManager 已连接。");
+        LOG_INFO(Server, "Server: DatabaseManager 已连接。");
+    }
+}
+
+Server::Server(int port, Storage* storage)
+    : dbManager(storage), port(port), server(nullptr), dbPort(0)
+{
+    SERregisterCommands();
+    if (dbManager && !dbManager->DTBisConnected() && !dbManager->DTBinitialize()) {
+        Logger::instance().fail("Server: 存储后端初始化失败");
     }
 }
 
 Server::~Server() {
+    // 先关闭进程内通道（等待其分发线程退出），再停止工作线程，确保不再有请求使用数据库或回投响应
+    if (localTransport) {
+        LocalTransport::unlisten(port);
+        localTransport.reset();
+    }
+    if (workerPool) {
+        workerPool->stop();
+        delete workerPool;
+        workerPool = nullptr;
+    }
+    delete metricsTimer;
+    metricsTimer = nullptr;
     if (server) {
         server->close();
         delete server;
         server = nullptr;
     }
+    if (localServer) {
+        localServer->close();
+        delete localServer;
+        localServer = nullptr;
+    }
     if (dbManager) {
         delete dbManager;
         dbManager = nullptr;
     }
 }
 
+Storage* Server::db() const {
+    return tlsWorkerDb ? tlsWorkerDb : dbManager;
+}
+
 std::string Server::generateCartId(const std::string& userPhone) {
     // 格式: cYYYYMMDDHHMMSSmmm_<hex-rand>
     // 使用 QDateTime 获取可读的年月日时分秒与毫秒，保留随机后缀以避免冲突
@@ -231,62 +250,827 @@ std::string Server::generateCartId(const std::string& userPhone) {
 void Server::SERstart() {
     if (!server) {
         server = new QTcpServer();
-        // 只监听127.0.0.1:8888
-        if (!server->listen(QHostAddress("127.0.0.1"), port)) {
+        // 默认只监听 127.0.0.1（SERsetListenAddress 可改为其他地址，如 0.0.0.0）
+        if (!server->listen(QHostAddress(QString::fromStdString(listenAddress)), port)) {
             qDebug() << "服务器监听失败";
+            Logger::instance().fail("Server: 监听 " + listenAddress + ":" + std::to_string(port) + " 失败: " + server->errorString().toStdString());
             return;
         }
-        qDebug() << "服务器已监听端口:" << port << " 地址: 127.0.0.1";
+        qDebug() << "服务器已监听端口:" << port << " 地址:" << QString::fromStdString(listenAddress);
+
+        // 连接池只对 MySQL 后端有意义
+        DatabaseManager* mysql = dynamic_cast<DatabaseManager*>(dbManager);
+        if (dbPoolSize > 0 && mysql && !mysql->DTBisPooled()) {
+            mysql->DTBsetPoolSize(dbPoolSize);
+            if (!mysql->DTBisConnected() && !mysql->DTBinitialize()) {
+                Logger::instance().fail("Server: 数据库连接池初始化失败，后台将持续重连");
+            } else {
+                LOG_INFO(Server, "Server: 数据库连接池已启用，容量 " + std::to_string(dbPoolSize));
+            }
+        }
+
+        if (workerThreads > 0 && !workerPool) {
+            // 非池化的 MySQL 后端下每个工作线程在启动时建立自己的数据库连接，退出时关闭；
+            // 可被多线程共用的后端（连接池、内存引擎）由工作线程直接共享 dbManager
+            const bool shared = !mysql || mysql->DTBisThreadSafe();
+            workerPool = new RequestWorkerPool(workerThreads,
+                [this, shared]() {
+                    if (shared) return;
+                    tlsWorkerDb = new DatabaseManager(dbHost, dbUser, dbPassword, dbName, dbPort);
+                    if (!tlsWorkerDb->DTBinitialize()) {
+                        Logger::instance().fail("Server worker: DatabaseManager 初始化失败，将在请求时重试");
+                    }
+                },
+                []() {
+                    delete tlsWorkerDb;
+                    tlsWorkerDb = nullptr;
+                });
+            LOG_INFO(Server, "Server: 已启动 " + std::to_string(workerThreads) + " 个请求处理线程");
+        }
+
+        localTransport = LocalTransport::listen(port, [this](LocalTransport::CallPtr call) { SERdispatchLocal(std::move(call)); });
+
+        if (!metricsExportPath.empty() && metricsExportIntervalMs > 0 && !metricsTimer) {
+            metricsTimer = new QTimer();
+            QObject::connect(metricsTimer, &QTimer::timeout, [this]() { SERexportMetrics(); });
+            metricsTimer->start(metricsExportIntervalMs);
+        }
 
         QObject::connect(server, &QTcpServer::newConnection, [this]() {
             while (server->hasPendingConnections()) {
-                QTcpSocket* clientSocket = server->nextPendingConnection();
-                QObject::connect(clientSocket, &QTcpSocket::readyRead, [this, clientSocket]() {
-                    QByteArray data = clientSocket->readAll();
-                    // Log raw received data for debugging
-                    qDebug() << "Server received raw:" << data;
-                    QString reqStr = QString::fromUtf8(data).trimmed();
-                    qDebug() << "Server processed request string:" << reqStr;
-
-                    // 记录到 Logger：每接收到一次请求就记录一条信息
-                    try {
-                        std::string recv = reqStr.toStdString();
-                        // 截断过长日志，避免 log 被淹没
-                        const size_t MaxLogLen = 1024;
-                        if (recv.size() > MaxLogLen) recv = recv.substr(0, MaxLogLen) + "...(truncated)";
-                        Logger::instance().info(std::string("Server received request: ") + recv);
-                    } catch (...) {
-                        // 记录异常不影响主流程
-                        Logger::instance().warn("Server: failed to log received request (exception)");
+                SERaddConnection(server->nextPendingConnection());
+            }
+        });
+
+        if (!localSocketName.empty() && !localServer) {
+            localServer = new QLocalServer();
+            const QString name = QString::fromStdString(localSocketName);
+            // 上次异常退出可能留下套接字文件，不先移除会导致 listen 失败
+            QLocalServer::removeServer(name);
+            if (!localServer->listen(name)) {
+                Logger::instance().fail("Server: 本地套接字监听失败 " + localSocketName + ": " + localServer->errorString().toStdString());
+                delete localServer;
+                localServer = nullptr;
+            } else {
+                LOG_INFO(Server, "Server: 本地套接字已监听 " + localServer->fullServerName().toStdString());
+                QObject::connect(localServer, &QLocalServer::newConnection, [this]() {
+                    while (localServer->hasPendingConnections()) {
+                        SERaddConnection(localServer->nextPendingConnection());
                     }
+                });
+            }
+        }
+    }
+}
 
-                    std::string response = SERprocessRequest(reqStr.toStdString());
+// TCP 与本地套接字的连接关闭/刷新接口不在 QIODevice 上，按实际类型分派
+static void closeConnection(QIODevice* socket) {
+    if (auto* tcp = qobject_cast<QTcpSocket*>(socket)) tcp->disconnectFromHost();
+    else if (auto* local = qobject_cast<QLocalSocket*>(socket)) local->disconnectFromServer();
+}
 
-                    // 记录将要发送的响应（摘要）
-                    try {
-                        std::string respSummary = response;
-                        const size_t MaxRespLog = 1024;
-                        if (respSummary.size() > MaxRespLog) respSummary = respSummary.substr(0, MaxRespLog) + "...(truncated)";
-                        Logger::instance().info(std::string("Server sending response (len=") + std::to_string(response.size()) + "): " + respSummary);
-                    } catch (...) {
-                        Logger::instance().warn("Server: failed to log response (exception)");
-                    }
+static void flushConnection(QIODevice* socket) {
+    if (auto* tcp = qobject_cast<QTcpSocket*>(socket)) tcp->flush();
+    else if (auto* local = qobject_cast<QLocalSocket*>(socket)) local->flush();
+}
 
-                    // write back response (may be empty)
-                    QByteArray out = QByteArray::fromStdString(response);
-                    clientSocket->write(out);
-                    clientSocket->flush();
-                });
-                QObject::connect(clientSocket, &QTcpSocket::disconnected, clientSocket, &QTcpSocket::deleteLater);
+void Server::SERaddConnection(QIODevice* clientSocket) {
+    if (!clientSocket) return;
+    auto state = std::make_shared<ConnectionState>();
+    state->id = ++nextConnectionId;
+    state->mode = wireMode;
+    connections[state->id] = clientSocket;
+    QObject::connect(clientSocket, &QIODevice::readyRead, [this, clientSocket, state]() {
+        SERonReadyRead(clientSocket, *state);
+    });
+    const uint64_t id = state->id;
+    QObject::connect(clientSocket, &QIODevice::bytesWritten, [this, id](qint64) {
+        SERdrainConnection(id);
+    });
+    auto onDisconnected = [this, state]() {
+        connections.erase(state->id);
+        pendingOutput.erase(state->id);
+        if (workerPool) workerPool->dropConnection(state->id);
+    };
+    if (auto* tcp = qobject_cast<QTcpSocket*>(clientSocket)) {
+        QObject::connect(tcp, &QTcpSocket::disconnected, onDisconnected);
+        QObject::connect(tcp, &QTcpSocket::disconnected, tcp, &QTcpSocket::deleteLater);
+    } else if (auto* local = qobject_cast<QLocalSocket*>(clientSocket)) {
+        QObject::connect(local, &QLocalSocket::disconnected, onDisconnected);
+        QObject::connect(local, &QLocalSocket::disconnected, local, &QLocalSocket::deleteLater);
+    }
+}
+
+void Server::SERonReadyRead(QIODevice* clientSocket, ConnectionState& state) {
+    QByteArray data = clientSocket->readAll();
+    if (data.isEmpty()) return;
+    // Log raw received data for debugging（仅 server=debug 时）
+    if (Logger::instance().enabled(Logger::Level::DEBUG, Logger::Subsystem::Server)) {
+        qDebug() << "Server received raw:" << data;
+    }
+
+    // Auto 模式：按该连接收到的首字节判定新旧客户端，判定后固定
+    if (state.mode == WireMode::Auto) {
+        const unsigned char first = static_cast<unsigned char>(data.at(0));
+        state.mode = WireFrame::looksFramed(first) ? WireMode::Framed : WireMode::Legacy;
+    }
+
+    if (state.mode == WireMode::Legacy) {
+        // 旧版客户端：一次 readAll 即一个完整请求，响应不加帧头
+        QString reqStr = QString::fromUtf8(data).trimmed();
+        ReplyRoute route;
+        route.connectionId = state.id;
+        route.mode = WireMode::Legacy;
+        SERdispatch(route, reqStr.toStdString());
+        return;
+    }
+
+    // Framed：累积到连接缓冲区，切出所有完整帧，残余半帧留待下次 readyRead
+    state.buffer.append(data);
+    size_t offset = 0;
+    std::string payload;
+    uint8_t flags = 0;
+    while (true) {
+        auto r = WireFrame::tryDecode(state.buffer.constData(), static_cast<size_t>(state.buffer.size()), offset, payload, flags,
+                                         WireFrame::RequestFlags);
+        if (r == WireFrame::DecodeResult::NeedMore) break;
+        if (r == WireFrame::DecodeResult::Error) {
+            Logger::instance().fail("Server: 非法帧头，断开连接");
+            state.buffer.clear();
+            closeConnection(clientSocket);
+            return;
+        }
+        ReplyRoute route;
+        route.connectionId = state.id;
+        route.mode = WireMode::Framed;
+        route.encoding = state.encoding;
+        if (flags & WireFrame::FlagCorrelated) {
+            route.correlated = true;
+            if (!WireFrame::takeCorrelationId(payload, route.correlationId)) {
+                Logger::instance().fail("Server: 带请求 id 的帧长度不足，断开连接");
+                state.buffer.clear();
+                closeConnection(clientSocket);
+                return;
             }
-        });
+        }
+        route.compressMinBytes = state.compressMinBytes;
+        if (SERhandleConnectionOption(state, route, payload)) continue;
+        SERdispatch(route, payload);
     }
+    if (offset > 0) state.buffer.remove(0, static_cast<qsizetype>(offset));
+}
+
+void Server::SERdispatch(const ReplyRoute& route, const std::string& request) {
+    if (!workerPool) {
+        ReplyRoute encoded = route;
+        std::string response = SERbuildReply(encoded, request);
+        SERwriteResponse(encoded, std::move(response));
+        return;
+    }
+    // 未带 id 的请求以连接 id 为 key，在线程池中串行执行，响应经队列回到 I/O 线程按序写回；
+    // 带 id 的请求各用独立 key（最高位置 1，与连接 key 不冲突），可并行执行。
+    // 连接断开时 dropConnection 只丢弃前者，后者照常执行，其响应在写回时因连接不存在而丢弃
+    uint64_t key = route.connectionId;
+    if (route.correlated) key = (1ull << 63) | (route.connectionId << 32) | route.correlationId;
+    workerPool->submit(key, [this, route, request]() {
+        ReplyRoute encoded = route;
+        std::string response = SERbuildReply(encoded, request); // 在工作线程编码、压缩，不占用 I/O 线程
+        QMetaObject::invokeMethod(this, [this, encoded, response = std::move(response)]() mutable {
+            SERwriteResponse(encoded, std::move(response));
+        }, Qt::QueuedConnection);
+    });
+}
+
+void Server::SERdispatchReply(const ReplyRoute& route, std::string response) {
+    if (!workerPool || route.correlated) {
+        SERwriteResponse(route, std::move(response));
+        return;
+    }
+    // 经同一连接 key 排队，排在此前未带 id 的请求之后写回
+    workerPool->submit(route.connectionId, [this, route, response = std::move(response)]() {
+        QMetaObject::invokeMethod(this, [this, route, response]() mutable {
+            SERwriteResponse(route, std::move(response));
+        }, Qt::QueuedConnection);
+    });
+}
+
+// 连接级选项命令：request 以 cmd 开头（其后为空白或结束）时取出去除首尾空白的参数
+static bool takeOptionArgs(const std::string& request, const std::string& cmd, std::string& rest) {
+    if (request.compare(0, cmd.size(), cmd) != 0) return false;
+    if (request.size() > cmd.size() && !std::isspace(static_cast<unsigned char>(request[cmd.size()]))) return false;
+    rest = request.substr(cmd.size());
+    rest.erase(0, rest.find_first_not_of(" \t\r\n"));
+    rest.erase(rest.find_last_not_of(" \t\r\n") + 1);
+    return true;
+}
+
+// SET_COMPRESSION 参数："zlib [最小字节数]"、"none"，或 {"algorithm":"zlib","min_bytes":4096}。
+// 成功时 minBytes 为压缩阈值（0 表示关闭）
+static bool parseCompressionArgs(const std::string& rest, size_t& minBytes) {
+    std::string name;
+    long long threshold = static_cast<long long>(WireFrame::DefaultCompressMinBytes);
+    try {
+        Server::CommandArgs args(rest);
+        if (args.isObject()) {
+            name = args.str("algorithm");
+            threshold = args.json.value("min_bytes", threshold);
+        } else {
+            std::istringstream iss(args.raw);
+            std::string t;
+            iss >> name;
+            if (iss >> t) threshold = std::stoll(t);
+        }
+    }
+    catch (...) {
+        return false;
+    }
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (name == "none" || name == "off") {
+        minBytes = 0;
+        return true;
+    }
+    if (name != "zlib" || threshold <= 0) return false;
+    minBytes = static_cast<size_t>(threshold);
+    return true;
+}
+
+bool Server::SERhandleConnectionOption(ConnectionState& state, const ReplyRoute& route, const std::string& request) {
+    std::string rest;
+    nlohmann::json r;
+    if (takeOptionArgs(request, "SET_ENCODING", rest)) {
+        std::string name;
+        try { name = CommandArgs(std::move(rest)).strOrRaw("encoding"); }
+        catch (const CommandError&) {}
+        WireEncoding encoding;
+        if (!WireFrame::parseEncoding(name, encoding)) {
+            SERdispatchReply(route, SERerrorResponse("unknown_encoding", "支持 json/cbor/msgpack"));
+            return true;
+        }
+        // 握手响应仍按切换前的编码（route.encoding）返回；此后收到的请求按新编码响应
+        state.encoding = encoding;
+        r["encoding"] = WireFrame::encodingName(encoding);
+        LOG_DEBUG(Server, std::string("Server: 连接 ") + std::to_string(state.id) + " 响应编码切换为 " + WireFrame::encodingName(encoding));
+    }
+    else if (takeOptionArgs(request, "SET_COMPRESSION", rest)) {
+        size_t minBytes = 0;
+        if (!parseCompressionArgs(rest, minBytes)) {
+            SERdispatchReply(route, SERerrorResponse("unknown_compression", "支持 zlib [最小字节数] / none"));
+            return true;
+        }
+        state.compressMinBytes = minBytes;
+        r["compression"] = minBytes ? "zlib" : "none";
+        if (minBytes) r["min_bytes"] = minBytes;
+        LOG_DEBUG(Server, "Server: 连接 " + std::to_string(state.id) + " 响应压缩阈值 " + std::to_string(minBytes));
+    }
+    else {
+        return false;
+    }
+    r["result"] = "ok";
+    ReplyRoute reply = route;
+    std::string response = r.dump();
+    SERencodeResponse(reply, response);
+    SERdispatchReply(reply, std::move(response));
+    return true;
+}
+
+void Server::SERencodeResponse(ReplyRoute& route, std::string& response, int compressLevel, bool preEncoded) {
+    route.payloadFlags = 0;
+    if (route.mode != WireMode::Framed || response.empty()) return;
+    if (preEncoded) {
+        route.payloadFlags = WireFrame::encodingFlag(route.encoding);
+    }
+    else if (route.encoding != WireEncoding::Json) {
+        // 错误、单个对象等小响应：经 SAX 逐事件转写，不建 DOM；不是 JSON 时为纯文本响应，原样发送
+        std::string encoded;
+        encoded.reserve(response.size());
+        if (JsonStreamWriter::transcode(response, encoded, route.encoding)) {
+            response.swap(encoded);
+            route.payloadFlags = WireFrame::encodingFlag(route.encoding);
+        }
+    }
+    if (route.compressMinBytes == 0 || response.size() < route.compressMinBytes) return;
+    const QByteArray packed = qCompress(reinterpret_cast<const uchar*>(response.data()),
+                                        static_cast<qsizetype>(response.size()), compressLevel);
+    if (packed.isEmpty() || static_cast<size_t>(packed.size()) >= response.size()) return;
+    response.assign(packed.constData(), static_cast<size_t>(packed.size()));
+    route.payloadFlags |= WireFrame::FlagCompressed;
+}
+
+// 可复用编码结果的请求：仅无参数的 GET_ALL_GOODS（内容只取决于商品目录）
+static bool isCacheableReply(const std::string& request) {
+    static const std::string Cmd = "GET_ALL_GOODS";
+    const size_t begin = request.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return false;
+    const size_t end = request.find_last_not_of(" \t\r\n") + 1;
+    return end - begin == Cmd.size() && request.compare(begin, Cmd.size(), Cmd) == 0;
+}
+
+std::string Server::SERbuildReply(ReplyRoute& route, const std::string& request) {
+    // 只缓存需要压缩的 Framed 响应：未压缩时重新生成的开销与复制缓存相当
+    if (route.mode != WireMode::Framed || route.compressMinBytes == 0 || !isCacheableReply(request)) {
+        return SERhandleRequest(request, &route);
+    }
+
+    const auto startedAt = std::chrono::steady_clock::now();
+    std::string key = "GET_ALL_GOODS";
+    key.push_back('\0');
+    key += WireFrame::encodingName(route.encoding);
+    key.push_back('\0');
+    key += std::to_string(route.compressMinBytes);
+
+    const bool catalogReady = SERensureCatalog();
+    const uint64_t version = goodsCatalog.version();
+    if (catalogReady) {
+        std::string payload;
+        bool hit = false;
+        {
+            std::lock_guard<std::mutex> lock(replyCacheMutex);
+            auto it = replyCache.find(key);
+            if (it != replyCache.end() && it->second.version == version) {
+                payload = it->second.payload;
+                route.payloadFlags = it->second.flags;
+                hit = true;
+            }
+        }
+        if (hit) {
+            ++replyCacheHits;
+            const uint64_t elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - startedAt).count());
+            // 与 SERhandleRequest 一致：bytes_out 为实际发送的（编码、压缩后的）字节数
+            metrics.record("GET_ALL_GOODS", request.size(), payload.size(), elapsedUs, 0, false);
+            return payload;
+        }
+    }
+
+    // 缓存的响应会被多次发送，压缩级别取默认值（6）以换取更小的体积
+    bool failed = false;
+    std::string response = SERhandleRequest(request, &route, catalogReady ? -1 : 1, &failed);
+    // 生成期间若有商品写入（版本号变化），结果可能已过期，不缓存
+    if (catalogReady && !failed && goodsCatalog.version() == version) {
+        std::lock_guard<std::mutex> lock(replyCacheMutex);
+        if (replyCache.size() >= MaxCachedReplies && replyCache.find(key) == replyCache.end()) replyCache.clear();
+        CachedReply& entry = replyCache[key];
+        entry.version = version;
+        entry.payload = response;
+        entry.flags = route.payloadFlags;
+    }
+    return response;
+}
+
+// 在通道分发线程调用。进程内请求彼此独立（与带 id 的帧相同），各用独立 key（次高位置 1）以便并行；
+// 未启用线程池时投递到 Server 所在线程处理，与 TCP 请求同样串行
+void Server::SERdispatchLocal(LocalTransport::CallPtr call) {
+    if (workerPool) {
+        const uint64_t key = (1ull << 62) | ++nextLocalCallId;
+        if (!workerPool->submit(key, [this, call]() { call->complete(SERhandleRequest(call->request)); })) {
+            call->complete(std::string());
+        }
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this, call]() { call->complete(SERhandleRequest(call->request)); }, Qt::QueuedConnection);
+}
+
+// 分块写出：每次交给 socket 的最大字节数，以及 socket 写缓冲超过多少时暂停、等待 bytesWritten
+static constexpr size_t WriteChunkSize = 64 * 1024;
+static constexpr qint64 WriteHighWater = 256 * 1024;
+
+void Server::SERwriteResponse(const ReplyRoute& route, std::string response) {
+    if (connections.find(route.connectionId) == connections.end()) {
+        Logger::instance().warn("Server: 连接已断开，丢弃响应 connection=" + std::to_string(route.connectionId));
+        return;
+    }
+    std::string header;
+    if (route.mode == WireMode::Framed) {
+        uint8_t flags = route.payloadFlags;
+        auto writeHeader = [&route, &header, &flags](size_t len) {
+            header.clear();
+            return route.correlated ? WireFrame::writeCorrelatedHeader(header, route.correlationId, len, flags)
+                                    : WireFrame::writeHeader(header, len, flags);
+        };
+        if (!writeHeader(response.size())) {
+            nlohmann::json e; e["error"] = "response_too_large"; e["size"] = response.size();
+            response = e.dump();
+            flags = 0;
+            writeHeader(response.size());
+        }
+    }
+    // Legacy 模式下直接写回正文（可能为空）
+    PendingOutput& out = pendingOutput[route.connectionId];
+    if (!header.empty()) out.chunks.push_back(std::move(header));
+    if (!response.empty()) out.chunks.push_back(std::move(response));
+    SERdrainConnection(route.connectionId);
+}
+
+void Server::SERdrainConnection(uint64_t connectionId) {
+    auto conn = connections.find(connectionId);
+    auto pending = pendingOutput.find(connectionId);
+    if (conn == connections.end() || pending == pendingOutput.end()) return;
+    QIODevice* clientSocket = conn->second;
+    PendingOutput& out = pending->second;
+    while (!out.chunks.empty() && clientSocket->bytesToWrite() < WriteHighWater) {
+        const std::string& front = out.chunks.front();
+        const size_t n = (std::min)(front.size() - out.offset, WriteChunkSize);
+        const qint64 written = clientSocket->write(front.data() + out.offset, static_cast<qint64>(n));
+        if (written <= 0) break; // socket 出错，剩余数据在断开时随连接一并丢弃
+        out.offset += static_cast<size_t>(written);
+        if (out.offset >= front.size()) {
+            out.chunks.pop_front();
+            out.offset = 0;
+        }
+    }
+    if (out.chunks.empty()) pendingOutput.erase(pending);
+    flushConnection(clientSocket);
+}
+
+std::string Server::SERhandleRequest(const std::string& request, ReplyRoute* route, int compressLevel, bool* failed) {
+    // 请求/响应追踪日志按采样率记录（Logger::setRequestSampleRate），未命中采样或 server 级别高于 INFO 时不构造任何字符串
+    Logger& logger = Logger::instance();
+    const bool traced = logger.enabled(Logger::Level::INFO, Logger::Subsystem::Server) && logger.sampleRequest();
+    // 截断过长日志，避免 log 被淹没
+    const size_t MaxLogLen = 1024;
+    if (traced) {
+        try {
+            std::string recv = request.size() > MaxLogLen ? request.substr(0, MaxLogLen) + "...(truncated)" : request;
+            logger.log(Logger::Level::INFO, Logger::Subsystem::Server, std::string("Server received request: ") + recv);
+        } catch (...) {
+            // 记录异常不影响主流程
+            logger.warn("Server: failed to log received request (exception)");
+        }
+    }
+
+    // 列表命令与 BATCH 按连接协商的编码直接写出响应（见 encodedReply）
+    tlsReplyEncoding = route && route->mode == WireMode::Framed ? route->encoding : WireEncoding::Json;
+    tlsReplyEncoded = false;
+    struct ReplyEncodingScope {
+        ~ReplyEncodingScope() { tlsReplyEncoding = WireEncoding::Json; tlsReplyEncoded = false; }
+    } replyEncodingScope;
+
+    Storage::DTBresetQueryCount();
+    const auto startedAt = std::chrono::steady_clock::now();
+    std::string response = SERprocessRequest(request);
+    const bool preEncoded = tlsReplyEncoded;
+    const uint64_t elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startedAt).count());
+    const uint64_t queryCount = Storage::DTBqueryCount();
+
+    // 按命令统计（命令名与 SERprocessRequest 的解析一致：首个空白前的部分）
+    const size_t cmdBegin = request.find_first_not_of(" \t\r\n");
+    const std::string cmd = cmdBegin == std::string::npos ? std::string()
+        : request.substr(cmdBegin, request.find_first_of(" \t\r\n", cmdBegin) - cmdBegin);
+    const bool isError = preEncoded ? tlsReplyFailed : ServerMetrics::isErrorResponse(response);
+    if (failed) *failed = isError;
+
+    // 记录将要发送的响应（摘要）
+    try {
+        if (traced) {
+            std::string respSummary = preEncoded ? std::string("(binary)")
+                : response.size() > MaxLogLen ? response.substr(0, MaxLogLen) + "...(truncated)" : response;
+            logger.log(Logger::Level::INFO, Logger::Subsystem::Server, std::string("Server sending response (len=") + std::to_string(response.size()) +
+                ", queries=" + std::to_string(queryCount) + "): " + respSummary);
+        }
+        // 单个请求的 SQL 语句数超过阈值时告警，便于发现 N+1 查询回归
+        if (queryCount > MaxQueriesPerRequest) {
+            Logger::instance().warn("Server: 请求 " + cmd + " 发出了 " + std::to_string(queryCount) + " 条 SQL（阈值 " + std::to_string(MaxQueriesPerRequest) + "）");
+        }
+    } catch (...) {
+        Logger::instance().warn("Server: failed to log response (exception)");
+    }
+    if (route) SERencodeResponse(*route, response, compressLevel, preEncoded);
+    metrics.record(cmd, request.size(), response.size(), elapsedUs, Storage::DTBqueryTimeUs(), isError);
+    return response;
 }
 
 void Server::SERstop() {
     if (server) {
         server->close();
     }
+    if (localServer) {
+        localServer->close();
+    }
+    // 先注销进程内通道，之后的同进程请求不再进入线程池
+    if (localTransport) {
+        LocalTransport::unlisten(port);
+        localTransport.reset();
+    }
+    if (workerPool) {
+        workerPool->stop();
+        delete workerPool;
+        workerPool = nullptr;
+    }
+    if (metricsTimer) {
+        metricsTimer->stop();
+        delete metricsTimer;
+        metricsTimer = nullptr;
+    }
+    if (!metricsExportPath.empty()) SERexportMetrics();
+    LOG_INFO(Server, "Server: 商品目录缓存统计 " + SERgetCatalogStats());
+    // 工作线程已全部退出，写出内存引擎的快照（MySQL 后端为空操作）
+    if (dbManager && !dbManager->DTBflush()) {
+        Logger::instance().fail("Server: 存储后端写出失败");
+    }
+    DatabaseManager* mysql = dynamic_cast<DatabaseManager*>(dbManager);
+    if (mysql && mysql->DTBisPooled() && Logger::instance().enabled(Logger::Level::INFO, Logger::Subsystem::Server)) {
+        DatabaseManager::PoolStats st = mysql->DTBpoolStats();
+        std::ostringstream oss;
+        oss << "Server: 连接池统计 leases=" << st.leases << " waits=" << st.waits
+            << " timeouts=" << st.timeouts << " reconnects=" << st.reconnects
+            << " pingFailures=" << st.pingFailures
+            << " avgWaitMs=" << (st.leases ? st.totalWaitMs / st.leases : 0.0)
+            << " maxWaitMs=" << st.maxWaitMs;
+        LOG_INFO(Server, oss.str());
+    }
+}
+
+// ---------------- 命令分发 ----------------
+
+std::string Server::SERerrorResponse(const std::string& error, const std::string& message) {
+    nlohmann::json e;
+    e["error"] = error;
+    if (!message.empty()) e["message"] = message;
+    return e.dump();
+}
+
+Server::CommandArgs::CommandArgs(std::string rest) : raw(std::move(rest)) {
+    if (!raw.empty() && (raw.front() == '{' || raw.front() == '[')) {
+        try { json = nlohmann::json::parse(raw); }
+        catch (const nlohmann::json::exception& e) { throw CommandError("参数解析失败", e.what()); }
+    }
+}
+
+const nlohmann::json& Server::CommandArgs::object() const {
+    if (!json.is_object()) throw CommandError("参数缺失或格式错误");
+    return json;
+}
+
+std::string Server::CommandArgs::str(const char* key, const std::string& def) const {
+    return json.is_object() ? json.value(key, def) : def;
+}
+
+int Server::CommandArgs::integer(const char* key, int def) const {
+    return json.is_object() ? json.value(key, def) : def;
+}
+
+double Server::CommandArgs::number(const char* key, double def) const {
+    return json.is_object() ? json.value(key, def) : def;
+}
+
+std::string Server::CommandArgs::strOrRaw(const char* key) const {
+    return json.is_object() ? json.value(key, std::string()) : raw;
+}
+
+std::string Server::CommandArgs::strOrToken(const char* key, size_t index) const {
+    if (json.is_object()) return json.value(key, std::string());
+    std::istringstream iss(raw);
+    std::string tok;
+    for (size_t i = 0; i <= index; ++i) {
+        if (!(iss >> tok)) return std::string();
+    }
+    return tok;
+}
+
+int Server::CommandArgs::intOrRaw(const char* key) const {
+    if (json.is_object()) return json.value(key, 0);
+    if (raw.empty()) throw CommandError("参数缺失或格式错误");
+    try { return std::stoi(raw); }
+    catch (...) { throw CommandError("参数解析失败", "invalid integer: " + raw); }
+}
+
+// 分页参数：{"after_id":游标,"limit":N,"order":"asc|desc"}，均可省略（省略时取第一页）。
+// limit 缺省为 DefaultPageSize，超过 MaxPageSize 时截断
+static constexpr int DefaultPageSize = 100;
+static constexpr int MaxPageSize = 1000;
+
+static int pageLimit(const Server::CommandArgs& a) {
+    if (!a.isObject() || !a.json.contains("limit")) return DefaultPageSize;
+    const nlohmann::json& v = a.json["limit"];
+    if (!v.is_number_integer() || v.get<int64_t>() <= 0) throw Server::CommandError("invalid_limit", "limit 必须为正整数");
+    return static_cast<int>((std::min)(v.get<int64_t>(), static_cast<int64_t>(MaxPageSize)));
+}
+
+static bool pageDescending(const Server::CommandArgs& a, bool byDefault) {
+    const std::string order = a.str("order");
+    if (order.empty()) return byDefault;
+    if (order == "asc") return false;
+    if (order == "desc") return true;
+    throw Server::CommandError("invalid_order", "order 只支持 asc/desc");
+}
+
+static int pageCursorInt(const Server::CommandArgs& a) {
+    if (!a.isObject() || !a.json.contains("after_id") || a.json["after_id"].is_null()) return 0;
+    const nlohmann::json& v = a.json["after_id"];
+    if (!v.is_number_integer()) throw Server::CommandError("invalid_cursor", "after_id 必须为整数");
+    return v.get<int>();
+}
+
+static std::string pageCursorString(const Server::CommandArgs& a) {
+    if (!a.isObject() || !a.json.contains("after_id") || a.json["after_id"].is_null()) return std::string();
+    const nlohmann::json& v = a.json["after_id"];
+    if (!v.is_string()) throw Server::CommandError("invalid_cursor", "after_id 必须为字符串");
+    return v.get<std::string>();
+}
+
+// 订单时间边界：yyyyMMddHHmmsszzz 或其前缀（与订单号中的时间戳同格式），缺省为不限
+static std::string orderTimeBound(const Server::CommandArgs& a, const char* key) {
+    const std::string v = a.str(key);
+    if (v.size() > 17 || v.find_first_not_of("0123456789") != std::string::npos) {
+        throw Server::CommandError("invalid_time_range", std::string(key) + " 必须为 yyyyMMddHHmmsszzz 或其前缀");
+    }
+    return v;
+}
+
+// {"name":"苹果","category":"水果","min_price":1,"max_price":20} 及分页参数，条件均可省略
+static Storage::GoodsQuery goodsQueryArgs(const Server::CommandArgs& a) {
+    Storage::GoodsQuery q;
+    if (!a.isObject()) return q;
+    q.name = a.str("name");
+    q.category = a.str("category");
+    q.minPrice = a.number("min_price", 0.0);
+    q.maxPrice = a.number("max_price", -1.0);
+    if (q.maxPrice >= 0.0 && q.maxPrice < q.minPrice) std::swap(q.minPrice, q.maxPrice);
+    return q;
+}
+
+// {"userPhone":"138...","statuses":[1,2],"from":"20240101","to":"20241231"} 及分页参数，条件均可省略
+static Storage::OrderQuery orderQueryArgs(const Server::CommandArgs& a) {
+    Storage::OrderQuery q;
+    if (!a.isObject()) return q;
+    q.userPhone = a.str("userPhone");
+    if (a.json.contains("statuses") && !a.json["statuses"].is_null()) {
+        const nlohmann::json& v = a.json["statuses"];
+        if (!v.is_array()) throw Server::CommandError("invalid_status", "statuses 必须为整数数组");
+        for (const auto& s : v) {
+            if (!s.is_number_integer()) throw Server::CommandError("invalid_status", "statuses 必须为整数数组");
+            q.statuses.push_back(s.get<int>());
+        }
+    }
+    q.fromTime = orderTimeBound(a, "from");
+    q.toTime = orderTimeBound(a, "to");
+    return q;
+}
+
+void Server::SERregisterCommand(const std::string& name, CommandHandler handler) {
+    commandTable[name] = std::move(handler);
+}
+
+void Server::SERregisterCommands() {
+    using Args = CommandArgs;
+    auto& reg = commandTable;
+    reg.reserve(64);
+
+    reg["socket_test_hello"] = [](const Args&) { return std::string("socket_test_hello"); };
+
+    // ----- 商品相关 -----
+    reg["GET_ALL_GOODS"] = [this](const Args&) { return SERgetAllGoods(); };
+    // 键集分页，按 id 排序：{"after_id":123,"limit":100,"order":"asc"}，可附带筛选条件（见 goodsQueryArgs）
+    reg["GET_GOODS_PAGE"] = [this](const Args& a) {
+        return SERgetGoodsPage(pageCursorInt(a), pageLimit(a), pageDescending(a, false), goodsQueryArgs(a));
+    };
+    // 参数为单个 id 或 {"id":123}
+    reg["GET_GOOD_BY_ID"] = [this](const Args& a) { return SERgetGoodById(a.intOrRaw("id")); };
+    // {"name":"n","price":1.2,"stock":10,"category":"c"}
+    reg["ADD_GOOD"] = [this](const Args& a) {
+        a.object();
+        return SERaddGood(a.str("name"), a.number("price"), a.integer("stock"), a.str("category"));
+    };
+    // {"id":1,"name":"n",...}
+    reg["UPDATE_GOOD"] = [this](const Args& a) {
+        a.object();
+        return SERupdateGood(a.integer("id"), a.str("name"), a.number("price"), a.integer("stock"), a.str("category"));
+    };
+    reg["DELETE_GOOD"] = [this](const Args& a) { return SERdeleteGood(a.intOrRaw("id")); };
+    // 参数为分类名或 {"category":"c"}
+    reg["SEARCH_GOODS_BY_CATEGORY"] = [this](const Args& a) { return SERsearchGoodsByCategory(a.strOrRaw("category")); };
+    reg["GET_CATALOG_STATS"] = [this](const Args&) { return SERgetCatalogStats(); };
+    reg["GET_METRICS"] = [this](const Args&) { return SERgetMetrics(); };
+    // 运行时调整日志级别/采样，如 "SET_LOG_LEVEL warn,server=info,sample=100"；无参数时仅返回当前配置
+    reg["SET_LOG_LEVEL"] = [](const Args& a) {
+        nlohmann::json res;
+        if (!a.raw.empty() && !Logger::instance().configure(a.raw)) res["warning"] = "部分配置项无法识别";
+        res["success"] = true;
+        res["config"] = Logger::instance().describeConfig();
+        return res.dump();
+    };
+
+    // ----- 账号相关 -----
+    reg["GET_ALL_ACCOUNTS"] = [this](const Args&) { return SERgetAllAccounts(); };
+    // 键集分页，按手机号排序：{"after_id":"138...","limit":100,"order":"asc"}；"phone":"138" 时只返回手机号包含它的用户
+    reg["GET_ACCOUNTS_PAGE"] = [this](const Args& a) {
+        return SERgetAccountsPage(pageCursorString(a), pageLimit(a), pageDescending(a, false), a.str("phone"));
+    };
+    // "phone pwd" 或 {"phone":..,"password":..}
+    reg["LOGIN"] = [this](const Args& a) { return SERlogin(a.strOrToken("phone", 0), a.strOrToken("password", 1)); };
+    reg["ADD_ACCOUNT"] = [this](const Args& a) {
+        a.object();
+        return SERaddAccount(a.str("phone"), a.str("password"), a.str("address"));
+    };
+    reg["UPDATE_ACCOUNT_PASSWORD"] = [this](const Args& a) {
+        a.object();
+        return SERupdateAccountPassword(a.str("userId"), a.str("oldPassword"), a.str("newPassword"));
+    };
+    reg["DELETE_ACCOUNT"] = [this](const Args& a) {
+        a.object();
+        return SERdeleteAccount(a.str("phone"), a.str("password"));
+    };
+    reg["UPDATE_USER"] = [this](const Args& a) {
+        a.object();
+        return SERupdateUser(a.str("phone"), a.str("password"), a.str("address"));
+    };
+
+    // ----- 订单相关 -----
+    // 参数为 userPhone 或 {"userPhone":"..."}
+    reg["GET_ALL_ORDERS"] = [this](const Args& a) { return SERgetAllOrders(a.strOrRaw("userPhone")); };
+    // 键集分页，按订单号排序，默认倒序（最新在前）：{"after_id":"c2024...","limit":100,"order":"desc"}
+    reg["GET_ORDERS_PAGE"] = [this](const Args& a) {
+        return SERgetOrdersPage(pageCursorString(a), pageLimit(a), pageDescending(a, true));
+    };
+    // 按手机号/状态集合/下单时间范围筛选后分页，参数见 orderQueryArgs，分页同 GET_ORDERS_PAGE
+    reg["QUERY_ORDERS"] = [this](const Args& a) {
+        return SERqueryOrders(orderQueryArgs(a), pageCursorString(a), pageLimit(a), pageDescending(a, true));
+    };
+    // "orderId userPhone" 或 JSON
+    reg["GET_ORDER_DETAIL"] = [this](const Args& a) {
+        return SERgetOrderDetail(a.strOrToken("orderId", 0), a.strOrToken("userPhone", 1));
+    };
+    // {"orderId":"..","userPhone":"..","newStatus":2}
+    reg["UPDATE_ORDER_STATUS"] = [this](const Args& a) {
+        return SERupdateOrderStatus(a.str("orderId"), a.str("userPhone"), a.integer("newStatus"));
+    };
+    reg["ADD_SETTLED_ORDER"] = [this](const Args& a) { return SERaddSettledOrderFromJson(a.json); };
+    reg["RETURN_SETTLED_ORDER"] = [this](const Args& a) { return SERreturnSettledOrder(a.str("orderId"), a.str("userPhone")); };
+    reg["REPAIR_SETTLED_ORDER"] = [this](const Args& a) { return SERrepairSettledOrder(a.str("orderId"), a.str("userPhone")); };
+    reg["DELETE_SETTLED_ORDER"] = [this](const Args& a) { return SERdeleteSettledOrder(a.str("orderId"), a.str("userPhone")); };
+
+    // ----- 购物车相关 -----
+    // 兼容客户端发送的字段名：userPhone/productId/productName/price/quantity
+    reg["ADD_TO_CART"] = [this](const Args& a) {
+        if (!a.isObject()) throw CommandError("invalid_payload");
+        return SERaddToCart(a.str("userPhone"), a.integer("productId"), a.str("productName"), a.number("price"), a.integer("quantity"));
+    };
+    reg["UPDATE_CART_ITEM"] = [this](const Args& a) {
+        if (!a.isObject()) throw CommandError("invalid_payload");
+        return SERupdateCartItem(a.str("userPhone"), a.integer("productId"), a.integer("quantity"));
+    };
+    reg["REMOVE_FROM_CART"] = [this](const Args& a) {
+        if (!a.isObject()) throw CommandError("invalid_payload");
+        return SERremoveFromCart(a.str("userPhone"), a.integer("productId"));
+    };
+    // 参数为 userPhone 或 {"userPhone":"..."}
+    reg["GET_CART"] = [this](const Args& a) { return SERgetCart(a.strOrRaw("userPhone")); };
+    // "userPhone <jsonCart>" 或 {"userPhone":"..","cart":{...}} / {"userPhone":"..","cartData":"..."}
+    reg["SAVE_CART"] = [this](const Args& a) {
+        if (a.isObject()) {
+            std::string phone = a.str("userPhone");
+            if (!phone.empty() && a.json.contains("cart")) return SERsaveCartObject(phone, a.json["cart"]).dump();
+            if (!phone.empty() && a.json.contains("cartData")) return SERsaveCart(phone, a.str("cartData"));
+            throw CommandError("参数缺失");
+        }
+        auto p = a.raw.find(' ');
+        if (p == std::string::npos) throw CommandError("参数缺失");
+        std::string cartJson = a.raw.substr(p + 1);
+        cartJson.erase(0, cartJson.find_first_not_of(" \t\r\n"));
+        return SERsaveCart(a.raw.substr(0, p), cartJson);
+    };
+    reg["SAVE_CART_WITH_POLICY"] = [this](const Args& a) {
+        if (!a.isObject()) throw CommandError("invalid_payload");
+        return SERsaveCartWithPolicy(a.json);
+    };
+
+    // 响应编码/压缩握手在 Framed 连接的 I/O 线程处理（SERhandleConnectionOption）；
+    // 到达这里说明是 Legacy 连接、进程内通道或 BATCH 子请求，只能使用未压缩的文本 JSON
+    reg["SET_ENCODING"] = [](const Args& a) {
+        const std::string name = a.strOrRaw("encoding");
+        WireEncoding encoding;
+        if (!WireFrame::parseEncoding(name, encoding)) throw CommandError("unknown_encoding", "支持 json/cbor/msgpack");
+        if (encoding != WireEncoding::Json) throw CommandError("encoding_unavailable", "二进制编码只能在 Framed 连接上协商");
+        nlohmann::json r; r["result"] = "ok"; r["encoding"] = "json";
+        return r.dump();
+    };
+    reg["SET_COMPRESSION"] = [](const Args& a) {
+        std::string name = a.strOrToken("algorithm", 0);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (name == "zlib") throw CommandError("compression_unavailable", "压缩只能在 Framed 连接上协商");
+        if (name != "none" && name != "off") throw CommandError("unknown_compression", "支持 zlib [最小字节数] / none");
+        nlohmann::json r; r["result"] = "ok"; r["compression"] = "none";
+        return r.dump();
+    };
+
+    // ----- 促销相关 -----
+    reg["GET_ALL_PROMOTIONS"] = [this](const Args&) { return SERgetAllPromotions(); };
+    reg["GET_PROMOTIONS_BY_PRODUCT_ID"] = [this](const Args& a) { return SERgetPromotionsByProductId(a.intOrRaw("productId")); };
+    // 参数为 userPhone 或 {"userPhone":"..."}
+    reg["UPDATE_CART_FOR_PROMOTIONS"] = [this](const Args& a) { return SERupdateCartForPromotions(a.strOrRaw("userPhone")); };
+    // 管理员增删改：{ "name": "...", "policy": { ... } , "type": "...", "conditions": "..." }
+    reg["ADD_PROMOTION"] = [this](const Args& a) { return SERaddPromotion(a.object()); };
+    reg["UPDATE_PROMOTION"] = [this](const Args& a) { return SERupdatePromotion(a.object()); };
+    reg["DELETE_PROMOTION"] = [this](const Args& a) {
+        std::string name = a.str("name");
+        if (name.empty()) throw CommandError("missing_name");
+        return SERdeletePromotion(name);
+    };
+
+    // ----- 批量 -----
+    // {"transaction":bool,"requests":["GET_ALL_GOODS", {"cmd":"GET_CART","args":{"userPhone":"..."}}, ...]}
+    reg["BATCH"] = [this](const Args& a) { return SERbatch(a.object()); };
 }
 
 std::string Server::SERprocessRequest(const std::string& request) {
@@ -309,591 +1093,457 @@ std::string Server::SERprocessRequest(const std::string& request) {
             rest = trim(request.substr(pos + 1));
         }
 
-        // 统一记录已解析的命令与有效负载摘要
-        try {
-            std::string payload = rest;
-            const size_t MaxPayloadLog = 512;
-            if (payload.size() > MaxPayloadLog) payload = payload.substr(0, MaxPayloadLog) + "...(truncated)";
-            Logger::instance().info(std::string("Server::SERprocessRequest: cmd=") + (cmd.empty() ? "<empty>" : cmd)
-                                    + " payload=" + (payload.empty() ? "<none>" : payload));
-        } catch (...) {
-            Logger::instance().warn("Server::SERprocessRequest: failed to log command/payload");
-        }
-
-        // 简单命令
-        if (cmd == "socket_test_hello") {
-            return "socket_test_hello";
-        }
-        if (cmd == "GET_ALL_GOODS") {
-            Logger::instance().info("Server 收到请求: GET_ALL_GOODS");
-            return SERgetAllGoods();
-        }
-        if (cmd == "GET_ALL_ACCOUNTS") {
-            Logger::instance().info("Server 收到请求: GET_ALL_ACCOUNTS");
-            return SERgetAllAccounts();
-        }
-
-        // Helper to parse JSON payload if provided
-        auto parseJson = [&](const std::string& s) -> nlohmann::json {
-            if (s.empty()) return nlohmann::json();
-            if (s.front() == '{' || s.front() == '[') return nlohmann::json::parse(s);
-            return nlohmann::json();
-            };
-
-        // ----- 商品相关 -----
-        if (cmd == "GET_GOOD_BY_ID") {
-            // rest 可以是单个 id 或 json {"id":123}
+        // 统一记录已解析的命令与有效负载摘要（server=debug 时）
+        if (Logger::instance().enabled(Logger::Level::DEBUG, Logger::Subsystem::Server)) {
             try {
-                if (rest.empty()) return "MISSING_PARAMETER";
-                if (rest.front() == '{') {
-                    auto j = parseJson(rest);
-                    return SERgetGoodById(j.value("id", 0));
-                }
-                else {
-                    int id = std::stoi(rest);
-                    return SERgetGoodById(id);
-                }
+                std::string payload = rest;
+                const size_t MaxPayloadLog = 512;
+                if (payload.size() > MaxPayloadLog) payload = payload.substr(0, MaxPayloadLog) + "...(truncated)";
+                Logger::instance().log(Logger::Level::DEBUG, Logger::Subsystem::Server,
+                    std::string("Server::SERprocessRequest: cmd=") + (cmd.empty() ? "<empty>" : cmd)
+                    + " payload=" + (payload.empty() ? "<none>" : payload));
+            } catch (...) {
+                Logger::instance().warn("Server::SERprocessRequest: failed to log command/payload");
             }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
         }
-        if (cmd == "ADD_GOOD") {
-            // rest 应为 json {"name":"n","price":1.2,"stock":10,"category":"c"}
-            try {
-                auto j = parseJson(rest);
-                if (j.is_object()) {
-                    return SERaddGood(j.value("name", std::string("")),
-                        j.value("price", 0.0),
-                        j.value("stock", 0),
-                        j.value("category", std::string("")));
-                }
-                nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump();
-            }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
+
+        auto it = commandTable.find(cmd);
+        if (it == commandTable.end()) {
+            Logger::instance().warn("Server 收到未知请求: " + request);
+            nlohmann::json r; r["error"] = "UNKNOWN_COMMAND"; r["request"] = request;
+            return r.dump();
         }
-        if (cmd == "UPDATE_GOOD") {
-            // rest json {"id":1,"name":"n",...}
-            try {
-                auto j = parseJson(rest);
-                if (j.is_object()) {
-                    return SERupdateGood(j.value("id", 0),
-                        j.value("name", std::string("")),
-                        j.value("price", 0.0),
-                        j.value("stock", 0),
-                        j.value("category", std::string("")));
-                }
-                nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump();
+        return it->second(CommandArgs(std::move(rest)));
+    }
+    catch (const CommandError& e) {
+        return SERerrorResponse(e.code(), e.what());
+    }
+    catch (const nlohmann::json::exception& e) {
+        return SERerrorResponse("参数解析失败", e.what());
+    }
+    catch (const std::exception& e) {
+        Logger::instance().fail(std::string("Server 处理请求异常: ") + e.what() + ", 请求内容: " + request);
+        return SERerrorResponse("exception", e.what());
+    }
+    catch (...) {
+        Logger::instance().fail("Server 处理请求发生未知异常, 请求内容: " + request);
+        return SERerrorResponse("unknown_exception");
+    }
+}
+
+// BATCH：子请求依次经 SERprocessRequest 分发，响应按原顺序放入 "responses"（合法 JSON 原样嵌入，否则作为字符串）。
+// transaction=true 时所有子请求共用一个数据库事务：遇到第一个错误响应即停止，其后的子请求不再执行，
+// 事务回滚，并在顶层返回 {"error":"batch_rolled_back","failed_index":i,...}
+std::string Server::SERbatch(const nlohmann::json& j) {
+    if (!j.contains("requests") || !j["requests"].is_array()) throw CommandError("missing_requests");
+    const nlohmann::json& reqs = j["requests"];
+    if (reqs.size() > MaxBatchRequests) {
+        throw CommandError("batch_too_large", "at most " + std::to_string(MaxBatchRequests) + " requests per batch");
+    }
+    const bool transactional = j.value("transaction", false);
+
+    // 先把全部子请求还原为 "CMD args" 文本，格式错误时整批拒绝而不是执行到一半
+    std::vector<std::string> lines;
+    lines.reserve(reqs.size());
+    for (const auto& r : reqs) {
+        std::string line;
+        if (r.is_string()) {
+            line = r.get<std::string>();
+        }
+        else if (r.is_object() && r.contains("cmd") && r["cmd"].is_string()) {
+            line = r["cmd"].get<std::string>();
+            if (r.contains("args") && !r["args"].is_null()) {
+                line += ' ';
+                line += r["args"].is_string() ? r["args"].get<std::string>() : r["args"].dump();
             }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
         }
-        if (cmd == "DELETE_GOOD") {
-            try {
-                if (rest.front() == '{') {
-                    auto j = parseJson(rest);
-                    return SERdeleteGood(j.value("id", 0));
-                }
-                else {
-                    int id = std::stoi(rest);
-                    return SERdeleteGood(id);
-                }
-            }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
+        else {
+            throw CommandError("invalid_batch_entry", r.dump());
+        }
+        const size_t b = line.find_first_not_of(" \t\r\n");
+        const size_t e = b == std::string::npos ? b : line.find_first_of(" \t\r\n", b);
+        if (b != std::string::npos && line.compare(b, e == std::string::npos ? std::string::npos : e - b, "BATCH") == 0) {
+            throw CommandError("nested_batch");
+        }
+        lines.push_back(std::move(line));
+    }
+
+    std::unique_ptr<Storage::Transaction> txn;
+    if (transactional) {
+        if (!db() || (!db()->DTBisConnected() && !db()->DTBinitialize())) return SERerrorResponse("数据库未连接");
+        txn = db()->DTBbeginTransaction();
+        if (!txn->active()) return SERerrorResponse("transaction_failed");
+    }
+
+    std::vector<std::string> responses;
+    responses.reserve(lines.size());
+    long failedIndex = -1;
+    std::vector<std::function<void()>> pendingCatalog;
+    const WireEncoding encoding = tlsReplyEncoding;
+    {
+        // 事务期间商品目录的写入暂存，提交后再应用（见 catalogWrite）。
+        // 子响应一律生成 JSON 文本（需按文本判断错误），整体在下面按连接编码一次写出
+        struct PendingScope {
+            explicit PendingScope(std::vector<std::function<void()>>* ops) { if (ops) tlsPendingCatalog = ops; tlsReplyEncoding = WireEncoding::Json; }
+            ~PendingScope() { tlsPendingCatalog = nullptr; }
+        } scope(txn ? &pendingCatalog : nullptr);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (failedIndex >= 0) break;
+            responses.push_back(SERprocessRequest(lines[i]));
+            if (transactional && ServerMetrics::isErrorResponse(responses.back())) failedIndex = static_cast<long>(i);
+        }
+    }
+
+    // 子响应已是序列化好的 JSON 文本：JSON 编码下校验后原样拼入，二进制编码下逐个转写，都不建 DOM
+    tlsReplyEncoding = encoding;
+    tlsReplyEncoded = false;
+    std::string out;
+    size_t total = 64;
+    for (const auto& r : responses) total += r.size() + 1;
+    out.reserve(total);
+    JsonStreamWriter w(out, encoding);
+    bool rolledBack = false;
+    w.beginObject();
+    if (txn) {
+        if (failedIndex < 0 && txn->commit()) {
+            for (auto& op : pendingCatalog) op();
+            w.field("committed", true);
         }
-        if (cmd == "SEARCH_GOODS_BY_CATEGORY") {
-            // rest: category string or json {"category":"c"}
-            if (rest.front() == '{') {
-                auto j = parseJson(rest);
-                return SERsearchGoodsByCategory(j.value("category", std::string("")));
+        else {
+            txn.reset(); // 回滚，暂存的商品目录写入随之丢弃
+            rolledBack = true;
+            // 促销索引由子命令直接重建，可能与回滚后的数据库不一致，重新加载
+            SERreloadPromotions();
+            w.field("committed", false);
+            w.field("error", "batch_rolled_back");
+            if (failedIndex >= 0) w.field("failed_index", static_cast<int64_t>(failedIndex));
+            Logger::instance().warn("Server BATCH: 事务已回滚, failed_index=" + std::to_string(failedIndex));
+        }
+    }
+    w.key("responses").beginArray();
+    for (const auto& r : responses) w.rawOrString(r);
+    for (size_t i = responses.size(); i < lines.size(); ++i) {
+        w.beginObject().field("error", "batch_aborted").endObject();
+    }
+    w.endArray();
+    w.endObject();
+    return encodedReply(std::move(out), rolledBack);
+}
+
+// ADD_SETTLED_ORDER：完整订单（含 items 数组）在服务端重算金额后与扣减库存同一事务保存；否则按旧版单商品格式处理
+std::string Server::SERaddSettledOrderFromJson(const nlohmann::json& j) {
+    try {
+        // 如果客户端发来完整 items 数组，按完整订单处理
+        if (j.is_object() && j.contains("items") && j["items"].is_array()) {
+            TemporaryCart cart;
+            // 接受多种命名风格：优先 camelCase, 回退 snake_case
+            cart.cart_id = j.value("orderId", j.value("order_id", std::string("")));
+            cart.user_phone = j.value("userPhone", j.value("user_phone", std::string("")));
+            cart.shipping_address = j.value("shippingAddress", j.value("shipping_address", std::string("")));
+            cart.discount_policy = j.value("discountPolicy", std::string(""));
+            cart.items.clear();
+            double total = 0.0;
+            for (const auto& it : j["items"]) {
+                CartItem ci;
+                ci.good_id = it.value("productId", 0);
+                ci.good_name = it.value("productName", std::string(""));
+                ci.price = it.value("price", 0.0);
+                ci.quantity = it.value("quantity", 0);
+                ci.subtotal = it.value("subtotal", ci.price * ci.quantity);
+                if (ci.subtotal <= 0.0) ci.subtotal = ci.price * ci.quantity;
+                total += ci.subtotal;
+                cart.items.push_back(ci);
             }
-            else {
-                return SERsearchGoodsByCategory(rest);
+            // 库存校验在保存订单的事务内统一进行（见 DTBsaveOrderWithStock）
+
+            cart.total_amount = total;
+            cart.final_amount = total;
+            cart.discount_amount = 0.0;
+            cart.is_converted = false;
+
+            // 尝试提取客户端随请求传来的 policy（兼容多种字段名）
+            nlohmann::json providedPolicy;
+            if (j.contains("policy")) providedPolicy = j["policy"];
+            else if (j.contains("policy_detail")) {
+                try { providedPolicy = nlohmann::json::parse(j.value("policy_detail", std::string(""))); } catch (...) { providedPolicy = nlohmann::json(); }
+            } else if (j.contains("policy_str")) {
+                try { providedPolicy = nlohmann::json::parse(j.value("policy_str", std::string(""))); } catch (...) { providedPolicy = nlohmann::json(); }
+            } else {
+                providedPolicy = nlohmann::json();
             }
-        }
 
-        // ----- 账号相关 -----
-        if (cmd == "LOGIN") {
-            try {
-                if (rest.front() == '{') {
-                    auto j = parseJson(rest);
-                    return SERlogin(j.value("phone", std::string("")), j.value("password", std::string("")));
+            // 优先：如果客户端提供了 final_amount/discount_amount 字段，则尊重（但仍可校验）；
+            // 次优：如果服务器上已经为该用户保存了 TemporaryCart（相同 cart_id），使用服务器保存的 final_amount（更可信）
+            // 否则：根据 providedPolicy 或服务端促销引擎计算 final_amount
+            bool usedServerSavedCart = false;
+            if (j.contains("final_amount") && j.contains("discount_amount")) {
+                // 客户端显式发送了金额（通常来自客户端本地计算或从服务器读取后传回）
+                cart.final_amount = j.value("final_amount", cart.total_amount);
+                cart.discount_amount = j.value("discount_amount", 0.0);
+                if (cart.discount_policy.empty()) cart.discount_policy = j.value("discountPolicy", cart.discount_policy);
+            } else {
+                // 尝试加载服务器端已保存的购物车（按用户手机号），若存在且 cart_id 匹配并含 final_amount，则使用之（更可信）
+                TemporaryCart savedCart;
+                if (db() && db()->DTBisConnected() && db()->DTBloadTemporaryCartByUserPhone(cart.user_phone, savedCart)) {
+                    if (!savedCart.cart_id.empty() && savedCart.cart_id == cart.cart_id && savedCart.final_amount > 0.0) {
+                        cart.final_amount = savedCart.final_amount;
+                        cart.discount_amount = savedCart.discount_amount;
+                        if (cart.discount_policy.empty()) cart.discount_policy = savedCart.discount_policy;
+                        usedServerSavedCart = true;
+                    }
                 }
-                else {
-                    std::istringstream iss(rest);
-                    std::string phone, pwd;
-                    iss >> phone >> pwd;
-                    return SERlogin(phone, pwd);
+                if (!usedServerSavedCart) {
+                    // 没有服务器保存的结果，按优先级：providedPolicy（若为 object）-> 服务端促销引擎进行逐项匹配
+                    SERrecalcCartTotals(cart, providedPolicy);
                 }
             }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "ADD_ACCOUNT") {
-            try {
-                auto j = parseJson(rest);
-                if (j.is_object()) return SERaddAccount(j.value("phone", std::string("")), j.value("password", std::string("")),j.value("address",std::string("")));
-                nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump();
-            }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "UPDATE_ACCOUNT_PASSWORD") {
-            try {
-                auto j = parseJson(rest);
-                if (j.is_object()) return SERupdateAccountPassword(j.value("userId", std::string("")), j.value("oldPassword", std::string("")), j.value("newPassword", std::string("")));
-                nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump();
-            }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "DELETE_ACCOUNT") {
-            try {
-                auto j = parseJson(rest);
-                if (j.is_object()) return SERdeleteAccount(j.value("phone", std::string("")), j.value("password", std::string("")));
-                nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump();
-            }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "GET_ALL_ACCOUNTS") {
-            return SERgetAllAccounts();
-        }
-        if (cmd == "UPDATE_USER") {
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) { nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump(); }
-                return SERupdateUser(j.value("phone", std::string("")), j.value("password", std::string("")), j.value("address", std::string("")));
-            } catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-
-        // ----- 订单相关 -----
-        if (cmd == "GET_ALL_ORDERS") {
-            // rest: userPhone or json {"userPhone":"..."}
-            if (rest.front() == '{') {
-                auto j = parseJson(rest);
-                return SERgetAllOrders(j.value("userPhone", std::string("")));
-            }
-            else {
-                return SERgetAllOrders(rest);
-            }
-        }
-        if (cmd == "GET_ORDER_DETAIL") {
-            // rest: "orderId userPhone" or json
-            if (rest.front() == '{') {
-                auto j = parseJson(rest);
-                return SERgetOrderDetail(j.value("orderId", std::string("")), j.value("userPhone", std::string("")));
-            }
-            else {
-                std::istringstream iss(rest); std::string orderId, userPhone; iss >> orderId >> userPhone;
-                return SERgetOrderDetail(orderId, userPhone);
-            }
-        }
-        if (cmd == "UPDATE_ORDER_STATUS") {
-            // json required: {"orderId":"..","userPhone":"..","newStatus":2}
-            auto j = parseJson(rest);
-            return SERupdateOrderStatus(j.value("orderId", std::string("")), j.value("userPhone", std::string("")), j.value("newStatus", 0));
-        }
-        if (cmd == "ADD_SETTLED_ORDER") {
-            // 在 ADD_SETTLED_ORDER 处理分支的 try 块顶部添加此行，定义 stockChecks 变量
-            struct StockCheck {
-                int productId;
-                int requested;
-                int available;
-            };
-            std::vector<StockCheck> stockChecks;
-            try {
-                auto j = parseJson(rest);
-                // 如果客户端发来完整 items 数组，按完整订单处理
-                if (j.is_object() && j.contains("items") && j["items"].is_array()) {
-                    TemporaryCart cart;
-                    // 接受多种命名风格：优先 camelCase, 回退 snake_case
-                    cart.cart_id = j.value("orderId", j.value("order_id", std::string("")));
-                    cart.user_phone = j.value("userPhone", j.value("user_phone", std::string("")));
-                    cart.shipping_address = j.value("shippingAddress", j.value("shipping_address", std::string("")));
-                    cart.discount_policy = j.value("discountPolicy", std::string(""));
-                    cart.items.clear();
-                    double total = 0.0;
-                    for (const auto& it : j["items"]) {
-                        CartItem ci;
-                        ci.good_id = it.value("productId", 0);
-                        ci.good_name = it.value("productName", std::string(""));
-                        ci.price = it.value("price", 0.0);
-                        ci.quantity = it.value("quantity", 0);
-                        ci.subtotal = it.value("subtotal", ci.price * ci.quantity);
-                        if (ci.subtotal <= 0.0) ci.subtotal = ci.price * ci.quantity;
-                        total += ci.subtotal;
-                        cart.items.push_back(ci);
-
-                        // 检查库存可用性（延迟到保存前统一检查）
-                        Good gtmp;
-                        int avail = -1;
-                        if (dbManager && dbManager->DTBisConnected() && dbManager->DTBloadGood(ci.good_id, gtmp)) {
-                            avail = gtmp.getStock();
-                        }
-                        stockChecks.push_back({ci.good_id, ci.quantity, avail});
-                    }
-                    // 进行库存可用性校验
-                    for (const auto& sc : stockChecks) {
-                        if (sc.available < 0) {
-                            nlohmann::json r; r["error"] = "good_not_found"; r["productId"] = sc.productId; return r.dump();
-                        }
-                        if ((long long)sc.requested > (long long)sc.available) {
-                            nlohmann::json r; r["error"] = "stock_exceeded"; r["productId"] = sc.productId; r["available"] = sc.available; r["requested"] = sc.requested; return r.dump();
-                        }
-                    }
 
-                    cart.total_amount = total;
-                    cart.final_amount = total;
-                    cart.discount_amount = 0.0;
-                    cart.is_converted = false;
-
-                    // 尝试提取客户端随请求传来的 policy（兼容多种字段名）
-                    nlohmann::json providedPolicy;
-                    if (j.contains("policy")) providedPolicy = j["policy"];
-                    else if (j.contains("policy_detail")) {
-                        try { providedPolicy = nlohmann::json::parse(j.value("policy_detail", std::string(""))); } catch (...) { providedPolicy = nlohmann::json(); }
-                    } else if (j.contains("policy_str")) {
-                        try { providedPolicy = nlohmann::json::parse(j.value("policy_str", std::string(""))); } catch (...) { providedPolicy = nlohmann::json(); }
-                    } else {
-                        providedPolicy = nlohmann::json();
-                    }
+            // 构造 Order 并填充 items
+            Order o(cart, cart.cart_id, j.value("status", 1));
+
+            // 显式补全 userPhone / shippingAddress，避免 Order 构造/DB 保存遗漏
+            if (!cart.user_phone.empty()) o.setUserPhone(cart.user_phone);
+            if (!cart.shipping_address.empty()) o.setShippingAddress(cart.shipping_address);
+
+            o.setDiscountPolicy(cart.discount_policy);
+            o.setTotalAmount(cart.total_amount);
+            o.setDiscountAmount(cart.discount_amount);
+            o.setFinalAmount(cart.final_amount);
+
+            std::vector<OrderItem> orderItems;
+            for (const auto& ci : cart.items) {
+                OrderItem oi;
+                oi.setOrderId(cart.cart_id);
+                oi.setGoodId(ci.good_id);
+                oi.setGoodName(ci.good_name);
+                oi.setPrice(ci.price);
+                oi.setQuantity(ci.quantity);
+                oi.setSubtotal(ci.subtotal);
+                orderItems.push_back(oi);
+            }
+            o.setItems(orderItems);
 
-                    // 优先：如果客户端提供了 final_amount/discount_amount 字段，则尊重（但仍可校验）；
-                    // 次优：如果服务器上已经为该用户保存了 TemporaryCart（相同 cart_id），使用服务器保存的 final_amount（更可信）
-                    // 否则：根据 providedPolicy 或服务端促销引擎计算 final_amount
-                    bool usedServerSavedCart = false;
-                    if (j.contains("final_amount") && j.contains("discount_amount")) {
-                        // 客户端显式发送了金额（通常来自客户端本地计算或从服务器读取后传回）
-                        cart.final_amount = j.value("final_amount", cart.total_amount);
-                        cart.discount_amount = j.value("discount_amount", 0.0);
-                        if (cart.discount_policy.empty()) cart.discount_policy = j.value("discountPolicy", cart.discount_policy);
-                    } else {
-                        // 尝试加载服务器端已保存的购物车（按用户手机号），若存在且 cart_id 匹配并含 final_amount，则使用之（更可信）
-                        TemporaryCart savedCart;
-                        if (dbManager && dbManager->DTBisConnected() && dbManager->DTBloadTemporaryCartByUserPhone(cart.user_phone, savedCart)) {
-                            if (!savedCart.cart_id.empty() && savedCart.cart_id == cart.cart_id && savedCart.final_amount > 0.0) {
-                                cart.final_amount = savedCart.final_amount;
-                                cart.discount_amount = savedCart.discount_amount;
-                                if (cart.discount_policy.empty()) cart.discount_policy = savedCart.discount_policy;
-                                usedServerSavedCart = true;
-                            }
-                        }
-                        if (!usedServerSavedCart) {
-                            // 没有服务器保存的结果，按优先级：providedPolicy（若为 object）-> 服务端促销引擎进行逐项匹配
-                            Server::recalcCartTotalsImpl(cart, providedPolicy, dbManager);
-                        }
-                    }
+            // 保存订单前再次确保数据库连接可用
+            if (!db()->DTBisConnected() && !db()->DTBinitialize()) {
+                nlohmann::json r; r["error"] = "database_unavailable"; return r.dump();
+            }
 
-                    // 构造 Order 并填充 items
-                    Order o(cart, cart.cart_id, j.value("status", 1));
-
-                    // 显式补全 userPhone / shippingAddress，避免 Order 构造/DB 保存遗漏
-                    if (!cart.user_phone.empty()) o.setUserPhone(cart.user_phone);
-                    if (!cart.shipping_address.empty()) o.setShippingAddress(cart.shipping_address);
-
-                    o.setDiscountPolicy(cart.discount_policy);
-                    o.setTotalAmount(cart.total_amount);
-                    o.setDiscountAmount(cart.discount_amount);
-                    o.setFinalAmount(cart.final_amount);
-
-                    std::vector<OrderItem> orderItems;
-                    for (const auto& ci : cart.items) {
-                        OrderItem oi;
-                        oi.setOrderId(cart.cart_id);
-                        oi.setGoodId(ci.good_id);
-                        oi.setGoodName(ci.good_name);
-                        oi.setPrice(ci.price);
-                        oi.setQuantity(ci.quantity);
-                        oi.setSubtotal(ci.subtotal);
-                        orderItems.push_back(oi);
-                    }
-                    o.setItems(orderItems);
+            // 保存订单、订单项并扣减库存（单个事务，失败整体回滚）
+            std::string saveError = SERsaveOrderWithStock(o);
+            if (!saveError.empty()) return saveError;
 
-                    // 保存订单前再次确保数据库连接可用
-                    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) {
-                        nlohmann::json r; r["error"] = "database_unavailable"; return r.dump();
-                    }
+            nlohmann::json ok; ok["result"] = "added"; ok["order_id"] = o.getOrderId();
+            return ok.dump();
+        }
+        // 否则兼容旧格式（单个商品字段）
+        if (!j.is_object()) throw CommandError("参数缺失或格式错误");
+        return SERaddSettledOrder(
+            j.value("orderId", std::string("")),
+            j.value("productName", std::string("")),
+            j.value("productId", 0),
+            j.value("quantity", 0),
+            j.value("userPhone", std::string("")),
+            j.value("status", 0),
+            j.value("discountPolicy", std::string("")));
+    } catch (const CommandError&) {
+        throw;
+    } catch (const std::exception& e) {
+        Logger::instance().fail(std::string("Server ADD_SETTLED_ORDER 异常: ") + e.what());
+        return SERerrorResponse("添加失败", e.what());
+    } catch (...) {
+        return SERerrorResponse("添加失败", "未知异常");
+    }
+}
 
-                    // 保存订单
-                    if (!dbManager->DTBsaveOrder(o)) {
-                        nlohmann::json r; r["error"] = "保存失败"; return r.dump();
-                    }
+// SAVE_CART_WITH_POLICY：{"userPhone":..,"cart":{...},"policyJson":"..."}
+std::string Server::SERsaveCartWithPolicy(const nlohmann::json& j) {
+    try {
+        std::string userPhone = j.value("userPhone", std::string());
+        if (userPhone.empty()) return SERerrorResponse("missing_userPhone");
+        if (!j.contains("cart") || !j["cart"].is_object()) return SERerrorResponse("missing_cart");
+
+        // 客户端同时传来 policyJson（字符串）时优先于 cart 内的 policy；解析失败视为无策略
+        nlohmann::json policy;
+        const nlohmann::json* policyOverride = nullptr;
+        std::string policyJsonStr = j.value("policyJson", std::string());
+        if (!policyJsonStr.empty()) {
+            policy = nlohmann::json::parse(policyJsonStr, nullptr, false);
+            if (policy.is_discarded()) policy = nlohmann::json();
+            policyOverride = &policy;
+        }
+
+        LOG_INFO(Server, "Server: handling SAVE_CART_WITH_POLICY for userPhone=" + userPhone);
+        // 直接使用请求中已解析的 cart 对象，不再 dump 后交给 SERsaveCart 重新解析
+        return SERsaveCartObject(userPhone, j["cart"], policyOverride).dump();
+    } catch (const std::exception& ex) {
+        Logger::instance().fail(std::string("Server SAVE_CART_WITH_POLICY 异常: ") + ex.what());
+        return SERerrorResponse("exception", ex.what());
+    } catch (...) {
+        return SERerrorResponse("unknown_exception");
+    }
+}
 
-                    // 保存成功后，更新每个商品库存；若任一更新失败，尝试回滚已保存的订单
-                    bool stockUpdateFailed = false;
-                    for (const auto& it : o.getItems()) {
-                        Good g;
-                        if (!dbManager->DTBloadGood(it.getGoodId(), g)) {
-                            Logger::instance().warn("Server SERaddSettledOrder: 无法加载商品以更新库存 good_id=" + std::to_string(it.getGoodId()));
-                            stockUpdateFailed = true;
-                            break;
-                        }
-                        int newStock = g.getStock() - it.getQuantity();
-                        if (newStock < 0) newStock = 0;
-                        if (!dbManager->DTBupdateGoodStock(it.getGoodId(), newStock)) {
-                            Logger::instance().warn("Server SERaddSettledOrder: 更新库存失败 good_id=" + std::to_string(it.getGoodId()));
-                            stockUpdateFailed = true;
-                            break;
-                        } else {
-                            Logger::instance().info("Server SERaddSettledOrder: 减库存 good_id=" + std::to_string(it.getGoodId()) + " -> " + std::to_string(newStock));
-                        }
-                    }
+//good
+bool Server::SERensureCatalog() {
+    if (goodsCatalog.isFresh()) return true;
+    // 加载期间若有并发写入，reset 会放弃本次结果，重试一次
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        goodsCatalog.recordMiss();
+        uint64_t ver = goodsCatalog.version();
+        bool ok = false;
+        std::vector<Good> goods = db()->DTBloadAllGoods(&ok);
+        if (!ok) return false; // 查询失败；商品表为空时照常缓存空目录
+        if (goodsCatalog.reset(goods, ver)) {
+            LOG_INFO(Server, "Server: 商品目录缓存已加载 " + std::to_string(goods.size()) + " 个商品");
+            return true;
+        }
+    }
+    return goodsCatalog.isFresh();
+}
 
-                    if (stockUpdateFailed) {
-                        // 尝试回滚：删除已保存的订单
-                        if (!dbManager->DTBdeleteOrder(o.getOrderId())) {
-                            Logger::instance().fail("Server SERaddSettledOrder: 库存更新失败，且订单回滚失败 order_id=" + o.getOrderId());
-                            nlohmann::json r; r["error"] = "stock_update_and_rollback_failed"; r["order_id"] = o.getOrderId(); return r.dump();
-                        }
-                        Logger::instance().info("Server SERaddSettledOrder: 库存更新失败，已回滚订单 order_id=" + o.getOrderId());
-                        nlohmann::json r; r["error"] = "stock_update_failed"; r["message"] = "库存更新失败，订单已回滚"; r["order_id"] = o.getOrderId(); return r.dump();
-                    }
+bool Server::SERloadGood(int id, Good& g) {
+    if (SERensureCatalog() && goodsCatalog.find(id, g)) return true;
+    // 未命中（如其他途径新增的商品）：查库并回填
+    if (!db()->DTBloadGood(id, g)) return false;
+    catalogWrite([this, g] { goodsCatalog.upsert(g); });
+    return true;
+}
 
-                    nlohmann::json ok; ok["result"] = "added"; ok["order_id"] = o.getOrderId();
-                    return ok.dump();
-                }
-                // 否则兼容旧格式（单个商品字段）
-                else {
-                    auto j2 = parseJson(rest);
-                    return SERaddSettledOrder(
-                        j2.value("orderId", std::string("")),
-                        j2.value("productName", std::string("")),
-                        j2.value("productId", 0),
-                        j2.value("quantity", 0),
-                        j2.value("userPhone", std::string("")),
-                        j2.value("status", 0),
-                        j2.value("discountPolicy", std::string("")));
-                }
-            } catch (const std::exception& e) {
-                Logger::instance().fail(std::string("Server ADD_SETTLED_ORDER 异常: ") + e.what());
-                nlohmann::json err; err["error"] = "添加失败"; err["message"] = e.what(); return err.dump();
-            } catch (...) {
-                nlohmann::json err; err["error"] = "添加失败"; err["message"] = "未知异常"; return err.dump();
-            }
-        }
-        if (cmd == "RETURN_SETTLED_ORDER") {
-            auto j = parseJson(rest);
-            return SERreturnSettledOrder(j.value("orderId", std::string("")), j.value("userPhone", std::string("")));
-        }
-        if (cmd == "REPAIR_SETTLED_ORDER") {
-            auto j = parseJson(rest);
-            return SERrepairSettledOrder(j.value("orderId", std::string("")), j.value("userPhone", std::string("")));
-        }
-        if (cmd == "DELETE_SETTLED_ORDER") {
-            auto j = parseJson(rest);
-            return SERdeleteSettledOrder(j.value("orderId", std::string("")), j.value("userPhone", std::string("")));
-        }
+std::string Server::SERgetCatalogStats() {
+    GoodsCatalog::Stats st = goodsCatalog.stats();
+    nlohmann::json j;
+    j["loaded"] = st.loaded;
+    j["size"] = st.size;
+    j["hits"] = st.hits;
+    j["misses"] = st.misses;
+    j["reloads"] = st.reloads;
+    uint64_t total = st.hits + st.misses;
+    j["hit_ratio"] = total ? static_cast<double>(st.hits) / static_cast<double>(total) : 0.0;
+    j["reply_cache_hits"] = replyCacheHits.load();
+    return j.dump();
+}
 
-        // ----- 购物车相关 -----
-        if (cmd == "ADD_TO_CART") {
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) { nlohmann::json e; e["error"] = "invalid_payload"; return e.dump(); }
-                // 兼容客户端发送的字段名：userPhone/productId/productName/price/quantity
-                std::string userPhone = j.value("userPhone", std::string(""));
-                int productId = j.value("productId", 0);
-                std::string productName = j.value("productName", std::string(""));
-                double price = j.value("price", 0.0);
-                int quantity = j.value("quantity", 0);
-                // 调用已经实现的服务器端处理函数
-                return SERaddToCart(userPhone, productId, productName, price, quantity);
-            } catch (...) {
-                nlohmann::json e; e["error"] = "参数解析失败"; return e.dump();
-            }
-        }
-        if (cmd == "UPDATE_CART_ITEM") {
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) { nlohmann::json e; e["error"] = "invalid_payload"; return e.dump(); }
-                std::string userPhone = j.value("userPhone", std::string(""));
-                int productId = j.value("productId", 0);
-                int quantity = j.value("quantity", 0);
-                return SERupdateCartItem(userPhone, productId, quantity);
-            }
-            catch (...) {
-                nlohmann::json e; e["error"] = "参数解析失败"; return e.dump();
-            }
-        }
-        // 在 SERprocessRequest() 内“----- 购物车相关 -----”区块，紧跟 UPDATE_CART_ITEM 分支之后新增：
-        if (cmd == "REMOVE_FROM_CART") {
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) { nlohmann::json e; e["error"] = "invalid_payload"; return e.dump(); }
-                std::string userPhone = j.value("userPhone", std::string(""));
-                int productId = j.value("productId", 0);
-                return SERremoveFromCart(userPhone, productId);
-            }
-            catch (...) {
-                nlohmann::json e; e["error"] = "参数解析失败"; return e.dump();
-            }
-        }
-        if (cmd == "GET_CART") {
-            // rest: userPhone 或 json {"userPhone":"..."}
-            if (!rest.empty() && rest.front() == '{') {
-                auto j = parseJson(rest);
-                return SERgetCart(j.value("userPhone", std::string("")));
-            } else {
-                return SERgetCart(rest);
-            }
-        }
-        if (cmd == "SAVE_CART") {
-            // rest: userPhone <jsonCart>  或 json {"userPhone":"..","cart":{...}}
-            if (!rest.empty() && rest.front() == '{') {
-                auto j = parseJson(rest);
-                std::string phone = j.value("userPhone", std::string(""));
-                if (!phone.empty() && j.contains("cart")) {
-                    return SERsaveCart(phone, j["cart"].dump());
-                }
-                else if (!phone.empty() && j.contains("cartData")) {
-                    return SERsaveCart(phone, j.value("cartData", std::string("")));
-                }
-                nlohmann::json e; e["error"] = "参数缺失"; return e.dump();
-            }
-            else {
-                // split first token as phone, rest as json
-                auto p2 = rest.find(' ');
-                if (p2 == std::string::npos) return "MISSING_PARAMETERS";
-                std::string phone = trim(rest.substr(0, p2));
-                std::string cartJson = trim(rest.substr(p2 + 1));
-                return SERsaveCart(phone, cartJson);
-            }
-        }
-        if (cmd == "SAVE_CART_WITH_POLICY") {
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) {
-                    nlohmann::json e; e["error"] = "invalid_payload"; return e.dump();
-                }
-                std::string userPhone = j.value("userPhone", std::string());
-                if (userPhone.empty()) {
-                    nlohmann::json e; e["error"] = "missing_userPhone"; return e.dump();
-                }
-                if (!j.contains("cart") || !j["cart"].is_object()) {
-                    nlohmann::json e; e["error"] = "missing_cart"; return e.dump();
-                }
+std::string Server::SERgetMetrics() {
+    return metrics.toJson().dump();
+}
 
-                nlohmann::json cartObj = j["cart"];
+bool Server::SERexportMetrics() {
+    if (metricsExportPath.empty()) return false;
+    if (!metrics.writePrometheusFile(metricsExportPath)) {
+        Logger::instance().warn("Server: 写入指标文件失败 " + metricsExportPath);
+        return false;
+    }
+    return true;
+}
 
-                // 如果客户端同时传来 policyJson（字符串），解析并放入 cartObj["policy"]
-                std::string policyJsonStr = j.value("policyJson", std::string());
-                if (!policyJsonStr.empty()) {
-                    try {
-                        cartObj["policy"] = nlohmann::json::parse(policyJsonStr);
-                    } catch (...) {
-                        // 若解析失败，则保留为字符串形式（SERsaveCart 内部也会容错）
-                        cartObj["policy"] = policyJsonStr;
-                    }
-                }
+// 列表行的 JSON 输出（字段按键名排序，与 json::dump() 的结果逐字节相同），整表与分页响应共用
+static void writeGoodJson(JsonStreamWriter& w, const Good& g) {
+    w.beginObject();
+    w.field("category", g.getCategory());
+    w.field("id", g.getId());
+    w.field("name", g.getName());
+    w.field("price", g.getPrice());
+    w.field("stock", g.getStock());
+    w.endObject();
+}
 
-                Logger::instance().info("Server: handling SAVE_CART_WITH_POLICY for userPhone=" + userPhone);
-                // 复用现有保存逻辑（SERsaveCart 会从 cart JSON 中提取 policy 并调用 recalc）
-                return SERsaveCart(userPhone, cartObj.dump());
-            } catch (const std::exception& ex) {
-                Logger::instance().fail(std::string("Server SAVE_CART_WITH_POLICY 异常: ") + ex.what());
-                nlohmann::json err; err["error"] = "exception"; err["message"] = ex.what(); return err.dump();
-            } catch (...) {
-                nlohmann::json err; err["error"] = "unknown_exception"; return err.dump();
-            }
-        }
+static void writeAccountJson(JsonStreamWriter& w, const User& u) {
+    w.beginObject();
+    w.field("address", u.getAddress());
+    w.field("password", u.getPassword());
+    w.field("phone", u.getPhone());
+    w.endObject();
+}
 
-        // promotion - not implemented but allow calls
-        if (cmd == "GET_ALL_PROMOTIONS") return SERgetAllPromotions();
-        if (cmd == "GET_PROMOTIONS_BY_PRODUCT_ID") {
-            try { int pid = std::stoi(rest); return SERgetPromotionsByProductId(pid); }
-            catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "UPDATE_CART_FOR_PROMOTIONS") {
-            // rest: userPhone 或 json {"userPhone":"..."}
-            if (!rest.empty() && rest.front() == '{') {
-                auto j = parseJson(rest);
-                return SERupdateCartForPromotions(j.value("userPhone", std::string("")));
-            } else {
-                return SERupdateCartForPromotions(rest);
-            }
-        }
-        // Promotion admin operations (管理员增删改查)
-        if (cmd == "ADD_PROMOTION") {
-            // rest: json { "name": "...", "policy": { ... } , "type": "...", "conditions": "..." }
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) { nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump(); }
-                return SERaddPromotion(j);
-            } catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "UPDATE_PROMOTION") {
-            try {
-                auto j = parseJson(rest);
-                if (!j.is_object()) { nlohmann::json e; e["error"] = "参数缺失或格式错误"; return e.dump(); }
-                return SERupdatePromotion(j);
-            } catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
-        if (cmd == "DELETE_PROMOTION") {
-            try {
-                auto j = parseJson(rest);
-                std::string name = j.is_object() ? j.value("name", std::string("")) : std::string();
-                if (name.empty()) { nlohmann::json e; e["error"] = "missing_name"; return e.dump(); }
-                return SERdeletePromotion(name);
-            } catch (...) { nlohmann::json e; e["error"] = "参数解析失败"; return e.dump(); }
-        }
+static void writeOrderSummaryJson(JsonStreamWriter& w, const Order& o) {
+    w.beginObject();
+    // 返回金额信息以便客户端显示或做回退判断
+    w.field("discount_amount", o.getDiscountAmount());
+    w.field("final_amount", o.getFinalAmount());
+    w.field("order_id", o.getOrderId());
+    // 返回收货地址，兼容客户端读取 shipping_address 或 shippingAddress
+    w.field("shipping_address", o.getShippingAddress());
+    w.field("status", o.getStatus());
+    w.field("total_amount", o.getTotalAmount());
+    w.field("user_phone", o.getUserPhone());
+    w.endObject();
+}
 
-        Logger::instance().warn("Server 收到未知请求: " + request);
-        nlohmann::json r; r["error"] = "UNKNOWN_COMMAND"; r["request"] = request;
-        return r.dump();
-    }
-    catch (const std::exception& e) {
-        Logger::instance().fail(std::string("Server 处理请求异常: ") + e.what() + ", 请求内容: " + request);
-        nlohmann::json r; r["error"] = "exception"; r["message"] = e.what(); return r.dump();
-    }
-    catch (...) {
-        Logger::instance().fail("Server 处理请求发生未知异常, 请求内容: " + request);
-        nlohmann::json r; r["error"] = "unknown_exception"; return r.dump();
-    }
+// 分页响应：{"has_more":...,"items":[...],"next_after_id":本页最后一项的主键（空页为 null）}。
+// rows 按 limit + 1 行读取，多出的一行只用于判断 has_more
+template <typename T, typename WriteRow, typename CursorOf>
+static std::string pageResponse(std::vector<T>& rows, int limit, WriteRow writeRow, CursorOf cursorOf) {
+    const bool hasMore = rows.size() > static_cast<size_t>(limit);
+    if (hasMore) rows.erase(rows.begin() + limit, rows.end());
+    std::string out;
+    out.reserve(rows.size() * 128 + 64);
+    JsonStreamWriter w(out, tlsReplyEncoding);
+    w.beginObject();
+    w.field("has_more", hasMore);
+    w.key("items").beginArray();
+    for (const auto& row : rows) writeRow(w, row);
+    w.endArray();
+    w.key("next_after_id");
+    if (rows.empty()) w.null();
+    else w.value(cursorOf(rows.back()));
+    w.endObject();
+    return encodedReply(std::move(out));
 }
 
-//good
 std::string Server::SERgetAllGoods() {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERgetAllGoods: dbManager is null");
         nlohmann::json errorResponse; errorResponse["error"] = "服务器内部错误"; errorResponse["message"] = "dbManager 为空";
         return errorResponse.dump();
     }
-    if (!dbManager->DTBisConnected()) {
+    if (!db()->DTBisConnected()) {
         Logger::instance().warn("Server SERgetAllGoods: dbManager 未连接，尝试重新连接...");
-        if (!dbManager->DTBinitialize()) {
+        if (!db()->DTBinitialize()) {
             Logger::instance().fail("Server SERgetAllGoods: 重新连接数据库失败");
             nlohmann::json errorResponse; errorResponse["error"] = "数据库未连接"; errorResponse["message"] = "无法连接数据库";
             return errorResponse.dump();
         }
     }
 
-    Logger::instance().info(std::string("Server SERgetAllGoods: dbManager ptr = ") +
-        std::to_string(reinterpret_cast<uintptr_t>(reinterpret_cast<void*>(dbManager))) +
-        ", DTBisConnected=" + (dbManager->DTBisConnected() ? "true" : "false"));
+    LOG_DEBUG(Server, std::string("Server SERgetAllGoods: dbManager ptr = ") +
+        std::to_string(reinterpret_cast<uintptr_t>(reinterpret_cast<void*>(db()))) +
+        ", DTBisConnected=" + (db()->DTBisConnected() ? "true" : "false"));
 
     try {
-        std::vector<Good> goods = dbManager->DTBloadAllGoods();
-        if (goods.empty()) {
+        // 逐行写入输出串而不构造 json DOM；目录可用时在目录的共享锁内直接遍历，不复制整表。
+        // 字段按键名排序，输出与原先 json::dump() 的结果逐字节相同
+        std::string jsonStr;
+        JsonStreamWriter w(jsonStr, tlsReplyEncoding);
+        auto writeGood = [&w](const Good& g) { writeGoodJson(w, g); };
+        size_t count = 0;
+        w.beginArray();
+        if (SERensureCatalog()) {
+            jsonStr.reserve(goodsCatalog.stats().size * 96 + 2);
+            count = goodsCatalog.forEach(writeGood);
+        } else {
+            std::vector<Good> goods = db()->DTBloadAllGoods();
+            jsonStr.reserve(goods.size() * 96 + 2);
+            for (const auto& g : goods) writeGood(g);
+            count = goods.size();
+        }
+        w.endArray();
+        if (count == 0) {
             Logger::instance().warn("Server SERgetAllGoods: 查询结果为空，返回提示信息。");
             nlohmann::json msg;
             msg["error"] = "目前没有商品！";
-            Logger::instance().info("Server SERgetAllGoods: 返回JSON内容: " + msg.dump());
+            LOG_DEBUG(Server, "Server SERgetAllGoods: 返回JSON内容: " + msg.dump());
             return msg.dump();
         }
-        nlohmann::json j = nlohmann::json::array();
-        for (const auto& g : goods) {
-            j.push_back({
-                {"id", g.getId()},
-                {"name", g.getName()},
-                {"price", g.getPrice()},
-                {"stock", g.getStock()},
-                {"category", g.getCategory()}
-                });
-        }
-        std::string jsonStr = j.dump();
-        Logger::instance().info("Server SERgetAllGoods: 返回JSON内容: " + jsonStr);
-        Logger::instance().info("Server SERgetAllGoods: 查询到 " + std::to_string(goods.size()) + " 个商品");
-        return jsonStr;
+        if (w.encoding() == WireEncoding::Json) LOG_DEBUG(Server, "Server SERgetAllGoods: 返回JSON内容: " + jsonStr);
+        LOG_INFO(Server, "Server SERgetAllGoods: 查询到 " + std::to_string(count) + " 个商品");
+        return encodedReply(std::move(jsonStr));
     }
     catch (const std::exception& e) {
         nlohmann::json errorResponse;
         errorResponse["error"] = "查询商品失败";
         errorResponse["message"] = e.what();
         Logger::instance().fail(std::string("Server SERgetAllGoods 异常: ") + e.what());
-        Logger::instance().info("Server SERgetAllGoods: 返回JSON内容: " + errorResponse.dump());
+        LOG_DEBUG(Server, "Server SERgetAllGoods: 返回JSON内容: " + errorResponse.dump());
         return errorResponse.dump();
     }
     catch (...) {
@@ -901,20 +1551,45 @@ std::string Server::SERgetAllGoods() {
         errorResponse["error"] = "查询商品失败";
         errorResponse["message"] = "未知异常";
         Logger::instance().fail("Server SERgetAllGoods 发生未知异常。");
-        Logger::instance().info("Server SERgetAllGoods: 返回JSON内容: " + errorResponse.dump());
+        LOG_DEBUG(Server, "Server SERgetAllGoods: 返回JSON内容: " + errorResponse.dump());
         return errorResponse.dump();
     }
 }
 
+std::string Server::SERgetGoodsPage(int afterId, int limit, bool descending, const Storage::GoodsQuery& q) {
+    if (!db()) {
+        Logger::instance().fail("Server SERgetGoodsPage: dbManager is null");
+        nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump();
+    }
+    try {
+        // 目录可用时直接在目录的有序索引上定位游标（有筛选条件时边扫描边过滤），否则回源数据库（同样按主键分页）
+        std::vector<Good> goods;
+        if (SERensureCatalog()) {
+            std::function<bool(const Good&)> filter;
+            if (!q.empty()) filter = [&q](const Good& g) { return q.matches(g); };
+            goods = goodsCatalog.page(afterId, static_cast<size_t>(limit) + 1, descending, filter);
+        }
+        else {
+            goods = q.empty() ? db()->DTBloadGoodsPage(afterId, limit + 1, descending)
+                              : db()->DTBqueryGoods(q, afterId, limit + 1, descending);
+        }
+        return pageResponse(goods, limit, writeGoodJson, [](const Good& g) { return g.getId(); });
+    }
+    catch (const std::exception& e) {
+        Logger::instance().fail(std::string("Server SERgetGoodsPage 异常: ") + e.what());
+        nlohmann::json err; err["error"] = "查询商品失败"; err["message"] = e.what(); return err.dump();
+    }
+}
+
 std::string Server::SERupdateGood(int GoodId, std::string Goodname, double Goodprice, int Goodstock, std::string Goodcategory) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERupdateGoods: dbManager is null");
         nlohmann::json err; err["error"] = "服务器内部错误"; err["message"] = "dbManager 为空";
         return err.dump();
     }
-    if (!dbManager->DTBisConnected()) {
+    if (!db()->DTBisConnected()) {
         Logger::instance().warn("Server SERupdateGoods: dbManager 未连接，尝试重新连接...");
-        if (!dbManager->DTBinitialize()) {
+        if (!db()->DTBinitialize()) {
             Logger::instance().fail("Server SERupdateGoods: 重新连接数据库失败");
             nlohmann::json err; err["error"] = "数据库未连接"; err["message"] = "无法连接数据库";
             return err.dump();
@@ -922,15 +1597,23 @@ std::string Server::SERupdateGood(int GoodId, std::string Goodname, double Goodp
     }
 
     try {
+        // UPDATE 未匹配到行时两种存储都返回 true：先确认商品存在，否则会把不存在的 id 写进商品目录
+        Good existing;
+        if (!SERloadGood(GoodId, existing)) {
+            nlohmann::json res; res["error"] = "未找到商品"; res["id"] = GoodId;
+            Logger::instance().warn("Server SERupdateGoods: 未找到商品 id=" + std::to_string(GoodId));
+            return res.dump();
+        }
         // 使用与 DatabaseManager 兼容的 Good 构造
         Good g(GoodId, Goodname, Goodprice, Goodstock, Goodcategory);
-        bool ok = dbManager->DTBupdateGood(g);
+        bool ok = db()->DTBupdateGood(g);
         if (!ok) {
             Logger::instance().fail("Server SERupdateGoods: 更新商品失败，DB 返回 false");
             nlohmann::json res; res["error"] = "更新失败"; res["message"] = "数据库更新操作失败";
-            Logger::instance().info("Server SERupdateGoods: 返回JSON内容: " + res.dump());
+            LOG_DEBUG(Server, "Server SERupdateGoods: 返回JSON内容: " + res.dump());
             return res.dump();
         }
+        catalogWrite([this, g] { goodsCatalog.upsert(g); });
         nlohmann::json j;
         j["id"] = g.getId();
         j["name"] = g.getName();
@@ -938,13 +1621,13 @@ std::string Server::SERupdateGood(int GoodId, std::string Goodname, double Goodp
         j["stock"] = g.getStock();
         j["category"] = g.getCategory();
         std::string jsonStr = j.dump();
-        Logger::instance().info("Server SERupdateGoods: 更新成功，返回JSON内容: " + jsonStr);
+        LOG_DEBUG(Server, "Server SERupdateGoods: 更新成功，返回JSON内容: " + jsonStr);
         // 可选写入本地文件以便调试
         std::ofstream ofs("localJSONOutPut.json", std::ios::out | std::ios::trunc);
         if (ofs.is_open()) {
             ofs << jsonStr;
             ofs.close();
-            Logger::instance().info("Server SERupdateGoods: 已写入 localJSONOutPut.json");
+            LOG_INFO(Server, "Server SERupdateGoods: 已写入 localJSONOutPut.json");
         }
         return jsonStr;
     }
@@ -961,14 +1644,14 @@ std::string Server::SERupdateGood(int GoodId, std::string Goodname, double Goodp
 }
 
 std::string Server::SERaddGood(const std::string& name, double price, int stock, const std::string& category) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERaddGood: dbManager is null");
         nlohmann::json err; err["error"] = "服务器内部错误"; err["message"] = "dbManager 为空";
         return err.dump();
     }
-    if (!dbManager->DTBisConnected()) {
+    if (!db()->DTBisConnected()) {
         Logger::instance().warn("Server SERaddGood: dbManager 未连接，尝试重新连接...");
-        if (!dbManager->DTBinitialize()) {
+        if (!db()->DTBinitialize()) {
             Logger::instance().fail("Server SERaddGood: 重新连接数据库失败");
             nlohmann::json err; err["error"] = "数据库未连接"; err["message"] = "无法连接数据库";
             return err.dump();
@@ -977,13 +1660,20 @@ std::string Server::SERaddGood(const std::string& name, double price, int stock,
 
     try {
         Good g(0, name, price, stock, category);
-        bool ok = dbManager->DTBsaveGood(g);
+        int newId = 0;
+        bool ok = db()->DTBsaveGood(g, &newId);
         if (!ok) {
             Logger::instance().fail("Server SERaddGood: 添加商品失败，DB 返回 false");
             nlohmann::json res; res["error"] = "添加失败"; res["message"] = "数据库添加操作失败";
-            Logger::instance().info("Server SERaddGood: 返回JSON内容: " + res.dump());
+            LOG_DEBUG(Server, "Server SERaddGood: 返回JSON内容: " + res.dump());
             return res.dump();
         }
+        if (newId > 0) {
+            g = Good(newId, name, price, stock, category);
+            catalogWrite([this, g] { goodsCatalog.upsert(g); });
+        } else {
+            catalogWrite([this] { goodsCatalog.invalidate(); });
+        }
         nlohmann::json j;
         j["id"] = g.getId();
         j["name"] = g.getName();
@@ -991,12 +1681,12 @@ std::string Server::SERaddGood(const std::string& name, double price, int stock,
         j["stock"] = g.getStock();
         j["category"] = g.getCategory();
         std::string jsonStr = j.dump();
-        Logger::instance().info("Server SERaddGood: 添加成功，返回JSON内容: " + jsonStr);
+        LOG_DEBUG(Server, "Server SERaddGood: 添加成功，返回JSON内容: " + jsonStr);
         std::ofstream ofs("localJSONOutPut.json", std::ios::out | std::ios::trunc);
         if (ofs.is_open()) {
             ofs << jsonStr;
             ofs.close();
-            Logger::instance().info("Server SERaddGood: 已写入 localJSONOutPut.json");
+            LOG_INFO(Server, "Server SERaddGood: 已写入 localJSONOutPut.json");
         }
         return jsonStr;
     } catch (const std::exception& e) {
@@ -1011,14 +1701,14 @@ std::string Server::SERaddGood(const std::string& name, double price, int stock,
 }
 
 std::string Server::SERgetGoodById(int id) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERgetGoodById: dbManager is null");
         nlohmann::json err; err["error"] = "服务器内部错误"; err["message"] = "dbManager 为空";
         return err.dump();
     }
-    if (!dbManager->DTBisConnected()) {
+    if (!db()->DTBisConnected()) {
         Logger::instance().warn("Server SERgetGoodById: dbManager 未连接，尝试重新连接...");
-        if (!dbManager->DTBinitialize()) {
+        if (!db()->DTBinitialize()) {
             Logger::instance().fail("Server SERgetGoodById: 重新连接数据库失败");
             nlohmann::json err; err["error"] = "数据库未连接"; err["message"] = "无法连接数据库";
             return err.dump();
@@ -1027,7 +1717,7 @@ std::string Server::SERgetGoodById(int id) {
 
     try {
         Good g;
-        if (!dbManager->DTBloadGood(id, g)) {
+        if (!SERloadGood(id, g)) {
             nlohmann::json res; res["error"] = "未找到商品"; res["id"] = id;
             Logger::instance().warn("Server SERgetGoodById: 未找到商品 id=" + std::to_string(id));
             return res.dump();
@@ -1039,13 +1729,13 @@ std::string Server::SERgetGoodById(int id) {
         j["stock"] = g.getStock();
         j["category"] = g.getCategory();
         std::string jsonStr = j.dump();
-        Logger::instance().info("Server SERgetGoodById: 返回JSON内容: " + jsonStr);
+        LOG_DEBUG(Server, "Server SERgetGoodById: 返回JSON内容: " + jsonStr);
         // 写入本地文件以便调试
         std::ofstream ofs("localJSONOutPut.json", std::ios::out | std::ios::trunc);
         if (ofs.is_open()) {
             ofs << jsonStr;
             ofs.close();
-            Logger::instance().info("Server SERgetGoodById: 已写入 localJSONOutPut.json");
+            LOG_INFO(Server, "Server SERgetGoodById: 已写入 localJSONOutPut.json");
         }
         return jsonStr;
     } catch (const std::exception& e) {
@@ -1060,21 +1750,22 @@ std::string Server::SERgetGoodById(int id) {
 }
 
 std::string Server::SERdeleteGood(int id) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERdeleteGood: dbManager is null");
         nlohmann::json err; err["error"] = "服务器内部错误"; err["message"] = "dbManager 为空";
         return err.dump();
     }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) {
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) {
         Logger::instance().fail("Server SERdeleteGood: 数据库未连接");
         nlohmann::json err; err["error"] = "数据库未连接"; return err.dump();
     }
     try {
-        if (!dbManager->DTBdeleteGood(id)) {
+        if (!db()->DTBdeleteGood(id)) {
             nlohmann::json res; res["error"] = "删除失败"; res["id"] = id; return res.dump();
         }
+        catalogWrite([this, id] { goodsCatalog.erase(id); });
         nlohmann::json ok; ok["result"] = "deleted"; ok["id"] = id;
-        Logger::instance().info("Server SERdeleteGood: 删除商品 id=" + std::to_string(id));
+        LOG_INFO(Server, "Server SERdeleteGood: 删除商品 id=" + std::to_string(id));
         return ok.dump();
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERdeleteGood 异常: ") + e.what());
@@ -1083,20 +1774,20 @@ std::string Server::SERdeleteGood(int id) {
 }
 
 std::string Server::SERsearchGoodsByCategory(const std::string& category) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERsearchGoodsByCategory: dbManager is null");
         nlohmann::json err; err["error"] = "服务器内部错误"; return err.dump();
     }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) {
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) {
         Logger::instance().fail("Server SERsearchGoodsByCategory: 数据库未连接"); nlohmann::json err; err["error"] = "数据库未连接"; return err.dump();
     }
     try {
-        auto goods = dbManager->DTBloadGoodsByCategory(category);
+        auto goods = SERensureCatalog() ? goodsCatalog.byCategory(category) : db()->DTBloadGoodsByCategory(category);
         nlohmann::json arr = nlohmann::json::array();
         for (const auto& g : goods) {
             arr.push_back({{"id", g.getId()}, {"name", g.getName()}, {"price", g.getPrice()}, {"stock", g.getStock()}, {"category", g.getCategory()}});
         }
-        Logger::instance().info("Server SERsearchGoodsByCategory: 返回 " + std::to_string(goods.size()) + " 条");
+        LOG_INFO(Server, "Server SERsearchGoodsByCategory: 返回 " + std::to_string(goods.size()) + " 条");
         return arr.dump();
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERsearchGoodsByCategory 异常: ") + e.what()); nlohmann::json err; err["error"] = "查询失败"; err["message"] = e.what(); return err.dump();
@@ -1105,26 +1796,39 @@ std::string Server::SERsearchGoodsByCategory(const std::string& category) {
 
 // ---------- User / Account APIs ----------
 std::string Server::SERgetAllAccounts() {
-    if (!dbManager) { Logger::instance().fail("Server SERgetAllAccounts: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERgetAllAccounts: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERgetAllAccounts: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERgetAllAccounts: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
-        auto users = dbManager->DTBloadAllUsers();
-        nlohmann::json arr = nlohmann::json::array();
-        for (const auto& u : users) {
-            arr.push_back({{"phone", u.getPhone()}, {"password", u.getPassword()}, {"address", u.getAddress()}});
-        }
-        return arr.dump();
+        auto users = db()->DTBloadAllUsers();
+        std::string out;
+        out.reserve(users.size() * 96 + 2);
+        JsonStreamWriter w(out, tlsReplyEncoding);
+        w.beginArray();
+        for (const auto& u : users) writeAccountJson(w, u);
+        w.endArray();
+        return encodedReply(std::move(out));
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERgetAllAccounts 异常: ") + e.what()); nlohmann::json err; err["error"] = "查询失败"; err["message"] = e.what(); return err.dump();
     }
 }
+std::string Server::SERgetAccountsPage(const std::string& afterPhone, int limit, bool descending, const std::string& phone) {
+    if (!db()) { Logger::instance().fail("Server SERgetAccountsPage: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERgetAccountsPage: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    try {
+        auto users = phone.empty() ? db()->DTBloadUsersPage(afterPhone, limit + 1, descending)
+                                   : db()->DTBqueryUsers(phone, afterPhone, limit + 1, descending);
+        return pageResponse(users, limit, writeAccountJson, [](const User& u) { return u.getPhone(); });
+    } catch (const std::exception& e) {
+        Logger::instance().fail(std::string("Server SERgetAccountsPage 异常: ") + e.what()); nlohmann::json err; err["error"] = "查询失败"; err["message"] = e.what(); return err.dump();
+    }
+}
 
 std::string Server::SERlogin(const std::string& phone, const std::string& password) {
-    if (!dbManager) { Logger::instance().fail("Server SERlogin: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERlogin: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERlogin: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERlogin: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         User u;
-        if (!dbManager->DTBloadUser(phone, u)) {
+        if (!db()->DTBloadUser(phone, u)) {
             nlohmann::json r; r["error"] = "用户不存在"; return r.dump();
         }
         if (u.getPassword() != password) {
@@ -1137,14 +1841,14 @@ std::string Server::SERlogin(const std::string& phone, const std::string& passwo
 }
 
 std::string Server::SERupdateAccountPassword(const std::string& userId, const std::string& oldPassword, const std::string& newPassword) {
-    if (!dbManager) { Logger::instance().fail("Server SERupdateAccountPassword: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERupdateAccountPassword: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERupdateAccountPassword: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERupdateAccountPassword: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         User u;
-        if (!dbManager->DTBloadUser(userId, u)) { nlohmann::json r; r["error"] = "用户不存在"; return r.dump(); }
+        if (!db()->DTBloadUser(userId, u)) { nlohmann::json r; r["error"] = "用户不存在"; return r.dump(); }
         if (u.getPassword() != oldPassword) { nlohmann::json r; r["error"] = "旧密码错误"; return r.dump(); }
         u.setPassword(newPassword);
-        if (!dbManager->DTBupdateUser(u)) { nlohmann::json r; r["error"] = "更新失败"; return r.dump(); }
+        if (!db()->DTBupdateUser(u)) { nlohmann::json r; r["error"] = "更新失败"; return r.dump(); }
         nlohmann::json ok; ok["result"] = "updated"; ok["phone"] = userId; return ok.dump();
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERupdateAccountPassword 异常: ") + e.what()); nlohmann::json err; err["error"] = "更新失败"; err["message"] = e.what(); return err.dump();
@@ -1152,13 +1856,13 @@ std::string Server::SERupdateAccountPassword(const std::string& userId, const st
 }
 
 std::string Server::SERdeleteAccount(const std::string& phone, const std::string& password) {
-    if (!dbManager) { Logger::instance().fail("Server SERdeleteAccount: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERdeleteAccount: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERdeleteAccount: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERdeleteAccount: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         User u;
-        if (!dbManager->DTBloadUser(phone, u)) { nlohmann::json r; r["error"] = "用户不存在"; return r.dump(); }
+        if (!db()->DTBloadUser(phone, u)) { nlohmann::json r; r["error"] = "用户不存在"; return r.dump(); }
         if (u.getPassword() != password) { nlohmann::json r; r["error"] = "密码错误"; return r.dump(); }
-        if (!dbManager->DTBdeleteUser(phone)) { nlohmann::json r; r["error"] = "删除失败"; return r.dump(); }
+        if (!db()->DTBdeleteUser(phone)) { nlohmann::json r; r["error"] = "删除失败"; return r.dump(); }
         nlohmann::json ok; ok["result"] = "deleted"; ok["phone"] = phone; return ok.dump();
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERdeleteAccount 异常: ") + e.what()); nlohmann::json err; err["error"] = "删除失败"; err["message"] = e.what(); return err.dump();
@@ -1166,14 +1870,14 @@ std::string Server::SERdeleteAccount(const std::string& phone, const std::string
 }
 
 std::string Server::SERaddAccount(const std::string& phone, const std::string& password, const std::string& address) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().fail("Server SERaddAccount: dbManager is null");
         nlohmann::json e;
         e["error"] = "服务器内部错误";
         return e.dump();
     }
 
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) {
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) {
         Logger::instance().fail("Server SERaddAccount: 数据库未连接");
         nlohmann::json e;
         e["error"] = "数据库未连接";
@@ -1182,7 +1886,7 @@ std::string Server::SERaddAccount(const std::string& phone, const std::string& p
 
     try {
         User u(phone, password, address);  // 使用传入的address参数
-        if (!dbManager->DTBaddUser(u)) {
+        if (!db()->DTBaddUser(u)) {
             nlohmann::json r;
             r["error"] = "添加失败";
             return r.dump();
@@ -1205,10 +1909,10 @@ std::string Server::SERaddAccount(const std::string& phone, const std::string& p
 }
 
 std::string Server::SERupdateUser(const std::string & phone, const std::string & password, const std::string & address) {
-    if (!dbManager) { Logger::instance().fail("Server SERupdateUser: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-     if (!dbManager->DTBisConnected()) {
+    if (!db()) { Logger::instance().fail("Server SERupdateUser: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+     if (!db()->DTBisConnected()) {
         Logger::instance().warn("Server SERupdateUser: dbManager 未连接，尝试重新连接...");
-        if (!dbManager->DTBinitialize()) {
+        if (!db()->DTBinitialize()) {
             Logger::instance().fail("Server SERupdateUser: 重新连接数据库失败");
             nlohmann::json e; e["error"] = "数据库未连接"; return e.dump();
             
@@ -1217,7 +1921,7 @@ std::string Server::SERupdateUser(const std::string & phone, const std::string &
     }
      try {
         User u(phone, password, address);
-        if (!dbManager->DTBupdateUser(u)) {
+        if (!db()->DTBupdateUser(u)) {
             nlohmann::json r; r["error"] = "更新失败"; return r.dump();
             
         }
@@ -1240,45 +1944,62 @@ std::string Server::SERupdateUser(const std::string & phone, const std::string &
 
 // ---------- 订单相关 ----------
 std::string Server::SERgetAllOrders(const std::string& userPhone) {
-    if (!dbManager) { Logger::instance().fail("Server SERgetAllOrders: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERgetAllOrders: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERgetAllOrders: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERgetAllOrders: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         std::vector<Order> orders;
         if (userPhone.empty()) {
             // 管理员/全局调用：当 userPhone 为空时，返回最近的订单（可改为 DTBloadAllOrders 若实现）
-            orders = dbManager->DTBloadRecentOrders(200);
+            orders = db()->DTBloadRecentOrders(200);
         }
         else {
-            orders = dbManager->DTBloadOrdersByUser(userPhone);
+            orders = db()->DTBloadOrdersByUser(userPhone);
         }
-        nlohmann::json arr = nlohmann::json::array();
-        for (const auto& o : orders) {
-            nlohmann::json jo;
-            jo["order_id"] = o.getOrderId();
-            jo["user_phone"] = o.getUserPhone();
-            // 新增：返回收货地址，兼容客户端读取 shipping_address 或 shippingAddress
-            jo["shipping_address"] = o.getShippingAddress();
-            jo["status"] = o.getStatus();
-            // 返回金额信息以便客户端显示或做回退判断
-            jo["total_amount"] = o.getTotalAmount();
-            jo["discount_amount"] = o.getDiscountAmount();
-            jo["final_amount"] = o.getFinalAmount();
-            arr.push_back(jo);
-        }
-        return arr.dump();
+        std::string out;
+        out.reserve(orders.size() * 192 + 2);
+        JsonStreamWriter w(out, tlsReplyEncoding);
+        w.beginArray();
+        for (const auto& o : orders) writeOrderSummaryJson(w, o);
+        w.endArray();
+        return encodedReply(std::move(out));
     }
     catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERgetAllOrders 异常: ") + e.what());
         nlohmann::json err; err["error"] = "查询失败"; err["message"] = e.what(); return err.dump();
     }
 }
+std::string Server::SERgetOrdersPage(const std::string& afterOrderId, int limit, bool descending) {
+    if (!db()) { Logger::instance().fail("Server SERgetOrdersPage: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERgetOrdersPage: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    try {
+        auto orders = db()->DTBloadOrdersPage(afterOrderId, limit + 1, descending);
+        return pageResponse(orders, limit, writeOrderSummaryJson, [](const Order& o) { return o.getOrderId(); });
+    }
+    catch (const std::exception& e) {
+        Logger::instance().fail(std::string("Server SERgetOrdersPage 异常: ") + e.what());
+        nlohmann::json err; err["error"] = "查询失败"; err["message"] = e.what(); return err.dump();
+    }
+}
+
+std::string Server::SERqueryOrders(const Storage::OrderQuery& q, const std::string& afterOrderId, int limit, bool descending) {
+    if (!db()) { Logger::instance().fail("Server SERqueryOrders: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERqueryOrders: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    try {
+        auto orders = db()->DTBqueryOrders(q, afterOrderId, limit + 1, descending);
+        return pageResponse(orders, limit, writeOrderSummaryJson, [](const Order& o) { return o.getOrderId(); });
+    }
+    catch (const std::exception& e) {
+        Logger::instance().fail(std::string("Server SERqueryOrders 异常: ") + e.what());
+        nlohmann::json err; err["error"] = "查询失败"; err["message"] = e.what(); return err.dump();
+    }
+}
 
 std::string Server::SERgetOrderDetail(const std::string& orderId, const std::string& userPhone) {
-    if (!dbManager) { Logger::instance().fail(std::string("Server SERgetOrderDetail: dbManager is null")); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail(std::string("Server SERgetOrderDetail: 数据库未连接")); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail(std::string("Server SERgetOrderDetail: dbManager is null")); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail(std::string("Server SERgetOrderDetail: 数据库未连接")); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         Order o;
-        if (!dbManager->DTBloadOrder(orderId, o)) { nlohmann::json r; r["error"] = "未找到订单"; return r.dump(); }
+        if (!db()->DTBloadOrder(orderId, o)) { nlohmann::json r; r["error"] = "未找到订单"; return r.dump(); }
 
         // 可选：校验请求手机号与订单手机号是否匹配（如果需要权限控制）
         if (!userPhone.empty() && o.getUserPhone() != userPhone) {
@@ -1318,22 +2039,47 @@ std::string Server::SERgetOrderDetail(const std::string& orderId, const std::str
 }
 
 std::string Server::SERupdateOrderStatus(const std::string& orderId, const std::string& userPhone, int newStatus) {
-    if (!dbManager) { Logger::instance().fail("Server SERupdateOrderStatus: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERupdateOrderStatus: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERupdateOrderStatus: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERupdateOrderStatus: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
-        if (!dbManager->DTBupdateOrderStatus(orderId, newStatus)) { nlohmann::json r; r["error"] = "更新失败"; return r.dump(); }
+        if (!db()->DTBupdateOrderStatus(orderId, newStatus)) { nlohmann::json r; r["error"] = "更新失败"; return r.dump(); }
         nlohmann::json ok; ok["result"] = "updated"; ok["order_id"] = orderId; ok["status"] = newStatus; return ok.dump();
     } catch (const std::exception& e) { Logger::instance().fail(std::string("Server SERupdateOrderStatus 异常: ") + e.what()); nlohmann::json err; err["error"] = "更新失败"; err["message"] = e.what(); return err.dump(); }
 }
 
+// 事务内保存订单并扣减库存；成功返回空串，失败返回错误 JSON
+std::string Server::SERsaveOrderWithStock(const Order& o) {
+    Storage::OrderSaveResult res = db()->DTBsaveOrderWithStock(o);
+    switch (res.status) {
+    case Storage::OrderSaveResult::Ok: {
+        for (const auto& it : o.getItems()) {
+            const int id = it.getGoodId(), delta = -it.getQuantity();
+            catalogWrite([this, id, delta] { goodsCatalog.adjustStock(id, delta); });
+        }
+        LOG_INFO(Server, "Server SERsaveOrderWithStock: 订单已保存并扣减库存 order_id=" + o.getOrderId() + " items=" + std::to_string(o.getItems().size()));
+        return std::string();
+    }
+    case Storage::OrderSaveResult::GoodNotFound: {
+        nlohmann::json r; r["error"] = "good_not_found"; r["productId"] = res.goodId; return r.dump();
+    }
+    case Storage::OrderSaveResult::StockExceeded: {
+        nlohmann::json r; r["error"] = "stock_exceeded"; r["productId"] = res.goodId; r["available"] = res.available; r["requested"] = res.requested; return r.dump();
+    }
+    default: {
+        Logger::instance().fail("Server SERsaveOrderWithStock: 保存订单失败，事务已回滚 order_id=" + o.getOrderId());
+        nlohmann::json r; r["error"] = "保存失败"; r["order_id"] = o.getOrderId(); return r.dump();
+    }
+    }
+}
+
 std::string Server::SERaddSettledOrder(const std::string& orderId, const std::string& productName, int productId,
                                        int quantity, const std::string& userPhone, int status, const std::string& discountPolicy) {
-    if (!dbManager) { Logger::instance().fail("Server SERaddSettledOrder: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERaddSettledOrder: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERaddSettledOrder: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERaddSettledOrder: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         // 旧单项接口：仍要检查库存
         Good g;
-        if (!dbManager->DTBloadGood(productId, g)) { nlohmann::json r; r["error"] = "good_not_found"; return r.dump(); }
+        if (!SERloadGood(productId, g)) { nlohmann::json r; r["error"] = "good_not_found"; return r.dump(); }
         if (quantity > g.getStock()) { nlohmann::json r; r["error"] = "stock_exceeded"; r["available"] = g.getStock(); r["requested"] = quantity; return r.dump(); }
 
         Order o(TemporaryCart(), orderId);
@@ -1344,23 +2090,20 @@ std::string Server::SERaddSettledOrder(const std::string& orderId, const std::st
         o.setDiscountPolicy(discountPolicy);
         OrderItem it; it.setOrderId(orderId); it.setGoodId(productId); it.setGoodName(productName); it.setPrice(g.getPrice()); it.setQuantity(quantity); it.setSubtotal(g.getPrice() * quantity);
         o.setItems({it});
-        // 保存订单并在保存成功后更新库存
-        if (!dbManager->DTBsaveOrder(o)) { nlohmann::json r; r["error"] = "保存失败"; return r.dump(); }
-        // 更新库存（简化：直接用当前库存 - 数量）
-        int newStock = g.getStock() - quantity;
-        if (newStock < 0) newStock = 0;
-        dbManager->DTBupdateGoodStock(productId, newStock);
+        // 保存订单并扣减库存（单个事务）
+        std::string saveError = SERsaveOrderWithStock(o);
+        if (!saveError.empty()) return saveError;
         nlohmann::json ok; ok["result"] = "added"; ok["order_id"] = orderId;
         return ok.dump();
     } catch (const std::exception& e) { Logger::instance().fail(std::string("Server SERaddSettledOrder 异常: ") + e.what()); nlohmann::json err; err["error"] = "添加失败"; err["message"] = e.what(); return err.dump(); }
 }
 
 std::string Server::SERreturnSettledOrder(const std::string& orderId, const std::string& userPhone) {
-    if (!dbManager) { Logger::instance().fail("Server SERreturnSettledOrder: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERreturnSettledOrder: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERreturnSettledOrder: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERreturnSettledOrder: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         Order o;
-        if (!dbManager->DTBloadOrder(orderId, o)) {
+        if (!db()->DTBloadOrder(orderId, o)) {
             nlohmann::json r; r["error"] = "未找到订单"; return r.dump();
         }
         if (!userPhone.empty() && o.getUserPhone() != userPhone) {
@@ -1371,21 +2114,23 @@ std::string Server::SERreturnSettledOrder(const std::string& orderId, const std:
         const int RETURNED_STATUS = 3;
 
         // 更新订单状态为已退货
-        if (!dbManager->DTBupdateOrderStatus(orderId, RETURNED_STATUS)) {
+        if (!db()->DTBupdateOrderStatus(orderId, RETURNED_STATUS)) {
             nlohmann::json r; r["error"] = "更新失败"; r["message"] = "无法设置退货状态"; return r.dump();
         }
 
         // 退货时尝试恢复商品库存（若商品存在）
         for (const auto& it : o.getItems()) {
             Good g;
-            if (dbManager->DTBloadGood(it.getGoodId(), g)) {
+            if (db()->DTBloadGood(it.getGoodId(), g)) {
                 int newStock = g.getStock() + it.getQuantity();
                 // 防护：避免负数（理论上不需要，但保险）
                 if (newStock < 0) newStock = 0;
-                if (!dbManager->DTBupdateGoodStock(it.getGoodId(), newStock)) {
+                if (!db()->DTBupdateGoodStock(it.getGoodId(), newStock)) {
                     Logger::instance().warn("Server SERreturnSettledOrder: 无法更新库存 good_id=" + std::to_string(it.getGoodId()));
                 } else {
-                    Logger::instance().info("Server SERreturnSettledOrder: 恢复库存 good_id=" + std::to_string(it.getGoodId()) + " -> " + std::to_string(newStock));
+                    const int id = it.getGoodId();
+                    catalogWrite([this, id, newStock] { goodsCatalog.setStock(id, newStock); });
+                    LOG_INFO(Server, "Server SERreturnSettledOrder: 恢复库存 good_id=" + std::to_string(it.getGoodId()) + " -> " + std::to_string(newStock));
                 }
             } else {
                 Logger::instance().warn("Server SERreturnSettledOrder: 未找到商品以恢复库存 good_id=" + std::to_string(it.getGoodId()));
@@ -1393,7 +2138,7 @@ std::string Server::SERreturnSettledOrder(const std::string& orderId, const std:
         }
 
         nlohmann::json ok; ok["result"] = "updated"; ok["order_id"] = orderId; ok["status"] = RETURNED_STATUS;
-        Logger::instance().info("Server SERreturnSettledOrder: set status to RETURNED for order " + orderId);
+        LOG_INFO(Server, "Server SERreturnSettledOrder: set status to RETURNED for order " + orderId);
         return ok.dump();
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERreturnSettledOrder 异常: ") + e.what());
@@ -1402,11 +2147,11 @@ std::string Server::SERreturnSettledOrder(const std::string& orderId, const std:
 }
 
 std::string Server::SERrepairSettledOrder(const std::string& orderId, const std::string& userPhone) {
-    if (!dbManager) { Logger::instance().fail("Server SERrepairSettledOrder: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERrepairSettledOrder: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERrepairSettledOrder: dbManager is null"); nlohmann::json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERrepairSettledOrder: 数据库未连接"); nlohmann::json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         Order o;
-        if (!dbManager->DTBloadOrder(orderId, o)) {
+        if (!db()->DTBloadOrder(orderId, o)) {
             nlohmann::json r; r["error"] = "未找到订单"; return r.dump();
         }
         if (!userPhone.empty() && o.getUserPhone() != userPhone) {
@@ -1416,12 +2161,12 @@ std::string Server::SERrepairSettledOrder(const std::string& orderId, const std:
         // 约定维修状态码（如需调整请与项目中的状态定义保持一致）
         const int REPAIR_STATUS = 4;
 
-        if (!dbManager->DTBupdateOrderStatus(orderId, REPAIR_STATUS)) {
+        if (!db()->DTBupdateOrderStatus(orderId, REPAIR_STATUS)) {
             nlohmann::json r; r["error"] = "更新失败"; r["message"] = "无法设置维修状态"; return r.dump();
         }
 
         nlohmann::json ok; ok["result"] = "updated"; ok["order_id"] = orderId; ok["status"] = REPAIR_STATUS;
-        Logger::instance().info("Server SERrepairSettledOrder: set status to REPAIR for order " + orderId);
+        LOG_INFO(Server, "Server SERrepairSettledOrder: set status to REPAIR for order " + orderId);
         return ok.dump();
     } catch (const std::exception& e) {
         Logger::instance().fail(std::string("Server SERrepairSettledOrder 异常: ") + e.what());
@@ -1430,12 +2175,12 @@ std::string Server::SERrepairSettledOrder(const std::string& orderId, const std:
 }
 
 std::string Server::SERdeleteSettledOrder(const std::string& orderId, const std::string& userPhone) {
-    if (!dbManager) { Logger::instance().fail("Server SERdeleteSettledOrder: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERdeleteSettledOrder: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERdeleteSettledOrder: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERdeleteSettledOrder: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         // 验证订单存在并（可选）检查手机号匹配
         Order o;
-        if (!dbManager->DTBloadOrder(orderId, o)) {
+        if (!db()->DTBloadOrder(orderId, o)) {
             json r; r["error"] = "未找到订单"; return r.dump();
         }
         if (!userPhone.empty() && o.getUserPhone() != userPhone) {
@@ -1443,11 +2188,11 @@ std::string Server::SERdeleteSettledOrder(const std::string& orderId, const std:
         }
 
         // 删除订单项与订单
-        if (!dbManager->DTBdeleteOrder(orderId)) {
+        if (!db()->DTBdeleteOrder(orderId)) {
             json r; r["error"] = "删除失败"; return r.dump();
         }
         json ok; ok["result"] = "deleted"; ok["order_id"] = orderId;
-        Logger::instance().info("Server SERdeleteSettledOrder: deleted order " + orderId);
+        LOG_INFO(Server, "Server SERdeleteSettledOrder: deleted order " + orderId);
         return ok.dump();
     }
     catch (const std::exception& ex) {
@@ -1458,11 +2203,11 @@ std::string Server::SERdeleteSettledOrder(const std::string& orderId, const std:
 
 //Cart
 std::string Server::SERgetCart(const std::string& userPhone) {
-    if (!dbManager) { Logger::instance().fail("Server SERgetCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERgetCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERgetCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERgetCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         TemporaryCart cart;
-        if (!dbManager->DTBloadTemporaryCartByUserPhone(userPhone, cart)) {
+        if (!db()->DTBloadTemporaryCartByUserPhone(userPhone, cart)) {
             json r; r["error"] = "未找到购物车"; return r.dump();
         }
         json j;
@@ -1494,10 +2239,19 @@ std::string Server::SERgetCart(const std::string& userPhone) {
 
 
 std::string Server::SERsaveCart(const std::string& userPhone, const std::string& cartData) {
-    if (!dbManager) { Logger::instance().fail("Server SERsaveCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERsaveCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
+    json j = json::parse(cartData, nullptr, false);
+    if (j.is_discarded()) {
+        Logger::instance().fail("Server SERsaveCart: 购物车 JSON 解析失败");
+        json err; err["error"] = "保存失败"; err["message"] = "cart JSON 解析失败"; return err.dump();
+    }
+    return SERsaveCartObject(userPhone, j).dump();
+}
+
+nlohmann::json Server::SERsaveCartObject(const std::string& userPhone, const nlohmann::json& j, const nlohmann::json* policyOverride) {
+    if (!db()) { Logger::instance().fail("Server SERsaveCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e; }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERsaveCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e; }
     try {
-        auto j = json::parse(cartData);
+        if (!j.is_object()) { json r; r["error"] = "保存失败"; r["message"] = "cart 必须是 JSON 对象"; return r; }
         TemporaryCart cart;
         if (j.contains("cart_id") && j["cart_id"].is_string() && !j["cart_id"].get<std::string>().empty()) cart.cart_id = j["cart_id"].get<std::string>();
         else cart.cart_id = generateCartId(userPhone);
@@ -1520,7 +2274,9 @@ std::string Server::SERsaveCart(const std::string& userPhone, const std::string&
 
         // 提取可能随 cartData 一并发送的 policy（兼容多种字段名）
         nlohmann::json parsedPolicy;
-        if (j.contains("policy")) {
+        if (policyOverride) {
+            parsedPolicy = *policyOverride;
+        } else if (j.contains("policy")) {
             parsedPolicy = j["policy"];
         } else if (j.contains("policy_str")) {
             std::string ps = j.value("policy_str", std::string(""));
@@ -1533,31 +2289,31 @@ std::string Server::SERsaveCart(const std::string& userPhone, const std::string&
         }
 
         // 使用可能的 policy 进行 recalc（policy 为空时行为与之前一致）
-        Server::recalcCartTotalsImpl(cart, parsedPolicy, dbManager);
+        SERrecalcCartTotals(cart, parsedPolicy);
 
         // save or update
-        if (!dbManager->DTBsaveTemporaryCart(cart)) {
-            if (!dbManager->DTBupdateTemporaryCart(cart)) {
-                json r; r["error"] = "保存失败"; return r.dump();
+        if (!db()->DTBsaveTemporaryCart(cart)) {
+            if (!db()->DTBupdateTemporaryCart(cart)) {
+                json r; r["error"] = "保存失败"; return r;
             }
         }
-        json ok; ok["result"] = "saved"; ok["cart_id"] = cart.cart_id; return ok.dump();
+        json ok; ok["result"] = "saved"; ok["cart_id"] = cart.cart_id; return ok;
     }
     catch (const std::exception& ex) {
         Logger::instance().fail(std::string("Server SERsaveCart 异常: ") + ex.what());
-        json err; err["error"] = "保存失败"; err["message"] = ex.what(); return err.dump();
+        json err; err["error"] = "保存失败"; err["message"] = ex.what(); return err;
     }
 }
 
 std::string Server::SERaddToCart(const std::string& userPhone, int productId, const std::string& productName, double price, int quantity) {
-    if (!dbManager) { Logger::instance().fail("Server SERaddToCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERaddToCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERaddToCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERaddToCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
         if (quantity <= 0) { json r; r["error"] = "quantity_invalid"; return r.dump(); }
         Good g;
-        if (!dbManager->DTBloadGood(productId, g)) { json r; r["error"] = "good_not_found"; r["id"] = productId; return r.dump(); }
+        if (!SERloadGood(productId, g)) { json r; r["error"] = "good_not_found"; r["id"] = productId; return r.dump(); }
         TemporaryCart cart;
-        bool exists = dbManager->DTBloadTemporaryCartByUserPhone(userPhone, cart);
+        bool exists = db()->DTBloadTemporaryCartByUserPhone(userPhone, cart);
         int existingQty = 0;
         if (exists) {
             for (const auto& it : cart.items) if (it.good_id == productId) existingQty = it.quantity;
@@ -1582,10 +2338,10 @@ std::string Server::SERaddToCart(const std::string& userPhone, int productId, co
         }
         recalcCartTotals(cart);
         if (exists) {
-            if (!dbManager->DTBupdateTemporaryCart(cart)) { json r; r["error"] = "更新购物车失败"; return r.dump(); }
+            if (!db()->DTBupdateTemporaryCart(cart)) { json r; r["error"] = "更新购物车失败"; return r.dump(); }
         }
         else {
-            if (!dbManager->DTBsaveTemporaryCart(cart)) { json r; r["error"] = "保存购物车失败"; return r.dump(); }
+            if (!db()->DTBsaveTemporaryCart(cart)) { json r; r["error"] = "保存购物车失败"; return r.dump(); }
         }
         json ok; ok["result"] = "ok"; ok["cart_id"] = cart.cart_id; return ok.dump();
     }
@@ -1597,14 +2353,14 @@ std::string Server::SERaddToCart(const std::string& userPhone, int productId, co
 
 // 替换整个函数：使 quantity <= 0 时执行删除
 std::string Server::SERupdateCartItem(const std::string& userPhone, int productId, int quantity) {
-    if (!dbManager) { Logger::instance().fail("Server SERupdateCartItem: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERupdateCartItem: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERupdateCartItem: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERupdateCartItem: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
-        Logger::instance().info(std::string("Server SERupdateCartItem: request userPhone=") + userPhone + ", productId=" + std::to_string(productId) + ", quantity=" + std::to_string(quantity));
+        LOG_INFO(Server, std::string("Server SERupdateCartItem: request userPhone=") + userPhone + ", productId=" + std::to_string(productId) + ", quantity=" + std::to_string(quantity));
         if (quantity < 0) { json r; r["error"] = "quantity_invalid"; return r.dump(); }
 
         TemporaryCart cart;
-        if (!dbManager->DTBloadTemporaryCartByUserPhone(userPhone, cart)) {
+        if (!db()->DTBloadTemporaryCartByUserPhone(userPhone, cart)) {
             json r; r["error"] = "未找到购物车";
             Logger::instance().warn("Server SERupdateCartItem: 未找到购物车 for userPhone=" + userPhone);
             return r.dump();
@@ -1621,7 +2377,7 @@ std::string Server::SERupdateCartItem(const std::string& userPhone, int productI
             }
             cart.items.erase(it, cart.items.end());
             recalcCartTotals(cart);
-            if (!dbManager->DTBupdateTemporaryCart(cart)) {
+            if (!db()->DTBupdateTemporaryCart(cart)) {
                 json r; r["error"] = "更新失败";
                 Logger::instance().fail("Server SERupdateCartItem: DTBupdateTemporaryCart 返回 false（删除路径）");
                 return r.dump();
@@ -1632,7 +2388,7 @@ std::string Server::SERupdateCartItem(const std::string& userPhone, int productI
 
         // quantity > 0 => 校验库存并更新数量
         Good g;
-        if (!dbManager->DTBloadGood(productId, g)) { json r; r["error"] = "good_not_found"; return r.dump(); }
+        if (!SERloadGood(productId, g)) { json r; r["error"] = "good_not_found"; return r.dump(); }
         if (quantity > g.getStock()) { json r; r["error"] = "stock_exceeded"; r["available"] = g.getStock(); r["requested"] = quantity; return r.dump(); }
 
         bool found = false;
@@ -1651,7 +2407,7 @@ std::string Server::SERupdateCartItem(const std::string& userPhone, int productI
         }
 
         recalcCartTotals(cart);
-        if (!dbManager->DTBupdateTemporaryCart(cart)) {
+        if (!db()->DTBupdateTemporaryCart(cart)) {
             json r; r["error"] = "更新失败";
             Logger::instance().fail("Server SERupdateCartItem: DTBupdateTemporaryCart 返回 false");
             return r.dump();
@@ -1666,18 +2422,18 @@ std::string Server::SERupdateCartItem(const std::string& userPhone, int productI
 }
 
 std::string Server::SERremoveFromCart(const std::string& userPhone, int productId) {
-    if (!dbManager) { Logger::instance().fail("Server SERremoveFromCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
-    if (!dbManager->DTBisConnected() && !dbManager->DTBinitialize()) { Logger::instance().fail("Server SERremoveFromCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
+    if (!db()) { Logger::instance().fail("Server SERremoveFromCart: dbManager is null"); json e; e["error"] = "服务器内部错误"; return e.dump(); }
+    if (!db()->DTBisConnected() && !db()->DTBinitialize()) { Logger::instance().fail("Server SERremoveFromCart: 数据库未连接"); json e; e["error"] = "数据库未连接"; return e.dump(); }
     try {
-        Logger::instance().info(std::string("Server SERremoveFromCart: request userPhone=") + userPhone + ", productId=" + std::to_string(productId));
+        LOG_INFO(Server, std::string("Server SERremoveFromCart: request userPhone=") + userPhone + ", productId=" + std::to_string(productId));
         TemporaryCart cart;
-        if (!dbManager->DTBloadTemporaryCartByUserPhone(userPhone, cart)) { json r; r["error"] = "未找到购物车"; Logger::instance().warn("Server SERremoveFromCart: 未找到购物车 for userPhone=" + userPhone); return r.dump(); }
+        if (!db()->DTBloadTemporaryCartByUserPhone(userPhone, cart)) { json r; r["error"] = "未找到购物车"; Logger::instance().warn("Server SERremoveFromCart: 未找到购物车 for userPhone=" + userPhone); return r.dump(); }
         auto it = std::remove_if(cart.items.begin(), cart.items.end(), [productId](const CartItem& ci) { return ci.good_id == productId; });
         if (it == cart.items.end()) { json r; r["error"] = "未找到商品"; Logger::instance().warn("Server SERremoveFromCart: 未找到商品 productId=" + std::to_string(productId)); return r.dump(); }
         cart.items.erase(it, cart.items.end());
         recalcCartTotals(cart);
-        if (!dbManager->DTBupdateTemporaryCart(cart)) { json r; r["error"] = "更新失败"; Logger::instance().fail("Server SERremoveFromCart: DTBupdateTemporaryCart 返回 false"); return r.dump(); }
-        json ok; ok["result"] = "removed"; ok["cart_id"] = cart.cart_id; Logger::instance().info(std::string("Server SERremoveFromCart: removed productId=") + std::to_string(productId)); return ok.dump();
+        if (!db()->DTBupdateTemporaryCart(cart)) { json r; r["error"] = "更新失败"; Logger::instance().fail("Server SERremoveFromCart: DTBupdateTemporaryCart 返回 false"); return r.dump(); }
+        json ok; ok["result"] = "removed"; ok["cart_id"] = cart.cart_id; LOG_INFO(Server, std::string("Server SERremoveFromCart: removed productId=") + std::to_string(productId)); return ok.dump();
     }
     catch (const std::exception& ex) {
         Logger::instance().fail(std::string("Server SERremoveFromCart 异常: ") + ex.what());
@@ -1686,28 +2442,60 @@ std::string Server::SERremoveFromCart(const std::string& userPhone, int productI
 }
 
 //promotion
-std::string Server::SERgetAllPromotions() {
-    if (!dbManager) return std::string("{\"error\":\"db not available\"}");
-    auto rows = dbManager->DTBloadAllPromotionStrategies(false);
-    json arr = json::array();
-    for (const auto& m : rows) {
-        json obj;
-        obj["id"] = m.count("id") ? m.at("id") : "";
-        obj["name"] = m.count("name") ? m.at("name") : "";
+std::shared_ptr<const PromotionIndex::Snapshot> Server::SERpromotions() {
+    auto snap = promotionIndex.snapshot();
+    if (snap) return snap;
+    // 尚未构建或已失效：从数据库编译；期间若有促销变更则重试
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        uint64_t gen = promotionIndex.generation();
+        std::shared_ptr<const PromotionIndex::Snapshot> built;
         try {
-            obj["policy"] = m.count("policy_detail") ? json::parse(m.at("policy_detail")) : json();
+            built = PromotionIndex::compile(db()->DTBloadAllPromotionStrategies(false));
+        } catch (const std::exception& ex) {
+            Logger::instance().warn(std::string("Server SERpromotions: 编译促销索引失败: ") + ex.what());
+            return nullptr;
         }
-        catch (...) {
-            obj["policy"] = m.count("policy_detail") ? m.at("policy_detail") : "";
+        if (promotionIndex.publish(built, gen)) {
+            LOG_INFO(Server, "Server: 促销索引已重建，规则 " + std::to_string(built->rules.size()) +
+                " 条（全局 " + std::to_string(built->global.size()) + "，商品 " + std::to_string(built->byProduct.size()) + " 个）");
+            return built;
         }
-        arr.push_back(obj);
+        snap = promotionIndex.snapshot();
+        if (snap) return snap;
     }
-    return arr.dump();
+    return nullptr;
+}
+
+void Server::SERreloadPromotions() {
+    promotionIndex.invalidate();
+    SERpromotions();
+}
+
+std::string Server::SERgetAllPromotions() {
+    if (!db()) return std::string("{\"error\":\"db not available\"}");
+    auto rows = db()->DTBloadAllPromotionStrategies(false);
+    std::string out;
+    JsonStreamWriter w(out, tlsReplyEncoding);
+    w.beginArray();
+    for (const auto& m : rows) {
+        auto get = [&m](const char* k) { auto it = m.find(k); return it == m.end() ? std::string() : it->second; };
+        w.beginObject();
+        w.field("id", get("id"));
+        w.field("name", get("name"));
+        // policy_detail 是合法 JSON 时原样嵌入（不建 DOM），否则作为字符串返回
+        w.key("policy");
+        auto detail = m.find("policy_detail");
+        if (detail == m.end()) w.null();
+        else w.rawOrString(detail->second);
+        w.endObject();
+    }
+    w.endArray();
+    return encodedReply(std::move(out));
 }
 
 // 添加促销：管理员使用。输入 JSON（包含 name 与 policy 字段）
 std::string Server::SERaddPromotion(const nlohmann::json& j) {
-    if (!dbManager) { nlohmann::json e; e["error"] = "db not available"; return e.dump(); }
+    if (!db()) { nlohmann::json e; e["error"] = "db not available"; return e.dump(); }
     try {
         std::string name = j.value("name", std::string(""));
         if (name.empty()) { nlohmann::json e; e["error"] = "missing_name"; return e.dump(); }
@@ -1720,9 +2508,10 @@ std::string Server::SERaddPromotion(const nlohmann::json& j) {
         std::string type = j.value("type", std::string(""));
         std::string conditions = j.value("conditions", std::string(""));
 
-        if (!dbManager->DTBsavePromotionStrategy(name, type, policy, conditions)) {
+        if (!db()->DTBsavePromotionStrategy(name, type, policy, conditions)) {
             nlohmann::json r; r["error"] = "save_failed"; return r.dump();
         }
+        SERreloadPromotions();
         nlohmann::json ok; ok["result"] = "added"; ok["name"] = name; return ok.dump();
     } catch (const std::exception& ex) {
         nlohmann::json err; err["error"] = "exception"; err["message"] = ex.what(); return err.dump();
@@ -1731,7 +2520,7 @@ std::string Server::SERaddPromotion(const nlohmann::json& j) {
 
 // 更新促销（按 name 更新 policy_detail）
 std::string Server::SERupdatePromotion(const nlohmann::json& j) {
-    if (!dbManager) { nlohmann::json e; e["error"] = "db not available"; return e.dump(); }
+    if (!db()) { nlohmann::json e; e["error"] = "db not available"; return e.dump(); }
     try {
         std::string name = j.value("name", std::string(""));
         if (name.empty()) { nlohmann::json e; e["error"] = "missing_name"; return e.dump(); }
@@ -1750,7 +2539,7 @@ std::string Server::SERupdatePromotion(const nlohmann::json& j) {
         // 如果请求包含 new_name 且与现有 name 不同 -> 执行重命名（同时可更新 policy/type/conditions）
         if (!newName.empty() && newName != name) {
             // 读取现有记录以尽量保全未传入的字段
-            std::map<std::string, std::string> existing = dbManager->DTBloadPromotionStrategy(name);
+            std::map<std::string, std::string> existing = db()->DTBloadPromotionStrategy(name);
             if (existing.empty()) {
                 nlohmann::json err; err["error"] = "not_found"; err["message"] = "原策略未找到"; return err.dump();
             }
@@ -1760,22 +2549,24 @@ std::string Server::SERupdatePromotion(const nlohmann::json& j) {
             std::string finalConditions = !conditions.empty() ? conditions : (existing.count("conditions") ? existing.at("conditions") : std::string(""));
 
             // 尝试保存新名字的策略
-            if (!dbManager->DTBsavePromotionStrategy(newName, finalType, finalPolicy, finalConditions)) {
+            if (!db()->DTBsavePromotionStrategy(newName, finalType, finalPolicy, finalConditions)) {
                 nlohmann::json err; err["error"] = "save_new_failed"; err["message"] = "保存新策略名失败"; return err.dump();
             }
             // 尝试删除旧条目（若删除失败，仅记录警告，但返回成功）
-            if (!dbManager->DTBdeletePromotionStrategy(name)) {
+            if (!db()->DTBdeletePromotionStrategy(name)) {
                 Logger::instance().warn("Server SERupdatePromotion: rename succeeded but failed to delete old promotion: " + name);
             }
+            SERreloadPromotions();
             nlohmann::json ok; ok["result"] = "renamed"; ok["old_name"] = name; ok["new_name"] = newName; return ok.dump();
         }
 
         // 否则按原来逻辑更新 policy_detail（如果更新失败则尝试保存）
-        if (!dbManager->DTBupdatePromotionStrategyDetail(name, policy)) {
-            if (!dbManager->DTBsavePromotionStrategy(name, type, policy, conditions)) {
+        if (!db()->DTBupdatePromotionStrategyDetail(name, policy)) {
+            if (!db()->DTBsavePromotionStrategy(name, type, policy, conditions)) {
                 nlohmann::json r; r["error"] = "update_failed"; return r.dump();
             }
         }
+        SERreloadPromotions();
         nlohmann::json ok; ok["result"] = "updated"; ok["name"] = name; return ok.dump();
     } catch (const std::exception& ex) {
         nlohmann::json err; err["error"] = "exception"; err["message"] = ex.what(); return err.dump();
@@ -1786,11 +2577,12 @@ std::string Server::SERupdatePromotion(const nlohmann::json& j) {
 
 // 删除促销（按 name）
 std::string Server::SERdeletePromotion(const std::string& name) {
-    if (!dbManager) { nlohmann::json e; e["error"] = "db not available"; return e.dump(); }
+    if (!db()) { nlohmann::json e; e["error"] = "db not available"; return e.dump(); }
     try {
-        if (!dbManager->DTBdeletePromotionStrategy(name)) {
+        if (!db()->DTBdeletePromotionStrategy(name)) {
             nlohmann::json r; r["error"] = "delete_failed"; return r.dump();
         }
+        SERreloadPromotions();
         nlohmann::json ok; ok["result"] = "deleted"; ok["name"] = name; return ok.dump();
     } catch (const std::exception& ex) {
         nlohmann::json err; err["error"] = "exception"; err["message"] = ex.what(); return err.dump();
@@ -1799,45 +2591,12 @@ std::string Server::SERdeletePromotion(const std::string& name) {
 
 
 std::string Server::SERgetPromotionsByProductId(int productId) {//实际不用的
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().warn("Server SERgetPromotionsByProductId: dbManager is null");
         return std::string("{\"error\":\"db not available\"}");
     }
     try {
-        auto rows = dbManager->DTBloadAllPromotionStrategies(false);
-        json arr = json::array();
-        for (const auto& m : rows) {
-            try {
-                if (!m.count("policy_detail")) continue;
-                json p = json::parse(m.at("policy_detail"));
-                bool applies = false;
-                // 全局适用
-                if (p.contains("scope") && p["scope"].is_string() && p["scope"] == "global") applies = true;
-                // 按 product_ids 匹配
-                if (p.contains("product_ids") && p["product_ids"].is_array()) {
-                    for (const auto& pid : p["product_ids"]) {
-                        if (pid.is_number() && pid.get<int>() == productId) { applies = true; break; }
-                        if (pid.is_string()) {
-                            try { if (std::stoi(pid.get<std::string>()) == productId) { applies = true; break; } }
-                            catch (...) {}
-                        }
-                    }
-                }
-                if (applies) {
-                    json obj;
-                    obj["id"] = m.count("id") ? m.at("id") : "";
-                    obj["name"] = m.count("name") ? m.at("name") : "";
-                    obj["policy"] = p;
-                    arr.push_back(obj);
-                }
-            } catch (const std::exception& ex) {
-                Logger::instance().warn(std::string("Server SERgetPromotionsByProductId: skip policy parse error: ") + ex.what());
-                continue;
-            } catch (...) {
-                continue;
-            }
-        }
-        return arr.dump();
+        return SERpromotionsForProduct(productId).dump();
     } catch (const std::exception& ex) {
         Logger::instance().fail(std::string("Server SERgetPromotionsByProductId 异常: ") + ex.what());
         json err; err["error"] = "exception"; err["message"] = ex.what(); return err.dump();
@@ -1846,44 +2605,41 @@ std::string Server::SERgetPromotionsByProductId(int productId) {//实际不用
     }
 }
 
+nlohmann::json Server::SERpromotionsForProduct(int productId) {
+    json arr = json::array();
+    auto promotions = SERpromotions();
+    if (promotions) {
+        for (const auto& r : promotions->rulesFor(productId)) {
+            json obj;
+            obj["id"] = r->id;
+            obj["name"] = r->name;
+            obj["policy"] = r->policy;
+            arr.push_back(std::move(obj));
+        }
+    }
+    return arr;
+}
+
 std::string Server::SERupdateCartForPromotions(const std::string& userPhone) {
-    if (!dbManager) {
+    if (!db()) {
         Logger::instance().warn("Server SERupdateCartForPromotions: dbManager is null");
         return std::string("{\"error\":\"db not available\"}");
     }
 
     TemporaryCart cart;
-    if (!dbManager->DTBloadTemporaryCartByUserPhone(userPhone, cart)) {
-        Logger::instance().info("Server SERupdateCartForPromotions: cart not found for userPhone=" + userPhone);
+    if (!db()->DTBloadTemporaryCartByUserPhone(userPhone, cart)) {
+        LOG_INFO(Server, "Server SERupdateCartForPromotions: cart not found for userPhone=" + userPhone);
         return std::string("{\"error\":\"cart_not_found\"}");
     }
 
     double original_total = cart.total_amount;
     double new_total = 0.0;
 
-    for (auto& it : cart.items) {
-        double bestSubtotal = it.price * static_cast<double>(it.quantity);
-        try {
-            std::string promoResp = SERgetPromotionsByProductId(it.good_id);
-            json parr = json::parse(promoResp);
-            if (parr.is_array()) {
-                for (const auto& p : parr) {
-                    try {
-                        json policy = p.contains("policy") ? p["policy"] : json::object();
-                        auto strat = PromotionStrategy::fromJson(policy);
-                        double applied = strat->apply(it.price, it.quantity);
-                        if (applied < bestSubtotal) bestSubtotal = applied;
-                    } catch (...) {
-                        // 单条策略解析/应用失败则跳过
-                        continue;
-                    }
-                }
-            }
-        } catch (...) {
-            // 如果 promotions 查询或解析失败，默认使用原始小计
-            Logger::instance().warn("Server SERupdateCartForPromotions: failed to evaluate promotions for good_id=" + std::to_string(it.good_id));
-        }
-        new_total += bestSubtotal;
+    // 促销索引不可用时按原始小计
+    auto promotions = SERpromotions();
+    for (const auto& it : cart.items) {
+        new_total += promotions ? promotions->bestSubtotal(it.good_id, it.price, it.quantity)
+                                : it.price * static_cast<double>(it.quantity);
     }
 
     cart.discount_amount = std::max(0.0, original_total - new_total);
@@ -1891,8 +2647,8 @@ std::string Server::SERupdateCartForPromotions(const std::string& userPhone) {
     cart.total_amount = original_total;
 
     // 尝试更新数据库，失败则尝试插入
-    if (!dbManager->DTBupdateTemporaryCart(cart)) {
-        if (!dbManager->DTBsaveTemporaryCart(cart)) {
+    if (!db()->DTBupdateTemporaryCart(cart)) {
+        if (!db()->DTBsaveTemporaryCart(cart)) {
             Logger::instance().fail("Server SERupdateCartForPromotions: failed to persist updated cart for user " + userPhone);
             json err; err["error"] = "persist_failed"; return err.dump();
         }
@@ -1903,7 +2659,7 @@ std::string Server::SERupdateCartForPromotions(const std::string& userPhone) {
     resp["original_total"] = original_total;
     resp["final_amount"] = cart.final_amount;
     resp["discount_amount"] = cart.discount_amount;
-    Logger::instance().info("Server SERupdateCartForPromotions: updated cart for userPhone=" + userPhone + " original=" + std::to_string(original_total) + " final=" + std::to_string(cart.final_amount));
+    LOG_INFO(Server, "Server SERupdateCartForPromotions: updated cart for userPhone=" + userPhone + " original=" + std::to_string(original_total) + " final=" + std::to_string(cart.final_amount));
     return resp.dump();
 }
 
@@ -1964,15 +2720,25 @@ static std::string derivePolicyName(const nlohmann::json& policy) {
 // ---------- 替换：Server::recalcCartTotals 调用到文件作用域实现 ----------
 void Server::recalcCartTotals(TemporaryCart& cart) {
     // 默认不使用客户端 policy（保留旧行为）
-    // 将当前实例的 dbManager 传入文件作用域实现，避免在文件作用域使用 this
-    Server::recalcCartTotalsImpl(cart, nlohmann::json(), dbManager);
+    SERrecalcCartTotals(cart, nlohmann::json());
+}
+
+void Server::SERrecalcCartTotals(TemporaryCart& cart, const nlohmann::json& policy) {
+    std::shared_ptr<const PromotionIndex::Snapshot> promotions;
+    if (!policy.is_object()) promotions = SERpromotions();
+    recalcCartTotalsImpl_local(cart, policy, promotions.get());
 }
 
 // 添加：确保目录存在的实现（放在文件顶部辅助函数区，靠近其他静态辅助函数）
 
 
 // 添加：实现 Server::recalcCartTotalsImpl，桥接到文件作用域实现 recalcCartTotals
-void Server::recalcCartTotalsImpl(TemporaryCart& cart, const nlohmann::json& policy, DatabaseManager* dbManager) {
-    // 调用局部实现，保留原有逻辑
-    recalcCartTotalsImpl_local(cart, policy, dbManager);
+void Server::recalcCartTotalsImpl(TemporaryCart& cart, const nlohmann::json& policy, Storage* dbManager) {
+    // 无 Server 实例可用：临时从数据库编译一份促销索引
+    std::shared_ptr<const PromotionIndex::Snapshot> promotions;
+    if (!policy.is_object() && dbManager) {
+        try { promotions = PromotionIndex::compile(dbManager->DTBloadAllPromotionStrategies(false)); }
+        catch (...) { promotions.reset(); }
+    }
+    recalcCartTotalsImpl_local(cart, policy, promotions.get());
 }
@@ -7,32 +7,233 @@
 #include "user.h"
 #include "userManager.h"
 #include "databaseManager.h"
+#include "Storage.h"
 #include "PromotionStrategy.h"
 #include "logger.h"
+#include "WireProtocol.h"
+#include "RequestWorkerPool.h"
+#include "GoodsCatalog.h"
+#include "PromotionIndex.h"
+#include "ServerMetrics.h"
+#include "LocalTransport.h"
 
 #include <string>
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <memory>
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <stdexcept>
 
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QHostAddress>
 #include <QObject>
 #include <QDebug>
+#include <QTimer>
 
 // 支持异步多客户端的Server声明
 class Server : public QObject {
     Q_OBJECT
-    DatabaseManager* dbManager;
+public:
+    // 命令参数解码：raw 为命令名之后的原始参数（已去除首尾空白）。
+    // 以 '{' 或 '[' 开头时按 JSON 解析，否则视为纯文本（单个值或空白分隔的多个值）
+    struct CommandArgs {
+        std::string raw;
+        nlohmann::json json; // 纯文本参数时为 null
+
+        explicit CommandArgs(std::string rest);
+
+        bool isObject() const { return json.is_object(); }
+        // 要求参数为 JSON 对象，否则抛出 CommandError("参数缺失或格式错误")
+        const nlohmann::json& object() const;
+        // JSON 对象字段（缺失或非对象参数时返回默认值）
+        std::string str(const char* key, const std::string& def = std::string()) const;
+        int integer(const char* key, int def = 0) const;
+        double number(const char* key, double def = 0.0) const;
+        // JSON 对象时取字段，否则取整个纯文本参数（如 "GET_CART 138..." 与 "GET_CART {"userPhone":...}"）
+        std::string strOrRaw(const char* key) const;
+        // JSON 对象时取字段，否则取第 index 个空白分隔的值（如 "LOGIN phone pwd"）
+        std::string strOrToken(const char* key, size_t index) const;
+        // JSON 对象时取字段，否则把纯文本参数解析为整数（失败抛出 CommandError）
+        int intOrRaw(const char* key) const;
+    };
+
+    // 命令处理中的参数/请求错误；分发器将其转为统一的错误信封 {"error":code,"message":...}
+    class CommandError : public std::runtime_error {
+    public:
+        explicit CommandError(const std::string& code, const std::string& message = std::string())
+            : std::runtime_error(message), code_(code) {}
+        const std::string& code() const { return code_; }
+    private:
+        std::string code_;
+    };
+
+    using CommandHandler = std::function<std::string(const CommandArgs&)>;
+
+    // 统一错误信封
+    static std::string SERerrorResponse(const std::string& error, const std::string& message = std::string());
+
+private:
+    // 存储后端（MySQL 或内存引擎），由 Server 持有
+    Storage* dbManager;
     int port;
+    std::string listenAddress = "127.0.0.1";
     QTcpServer* server;
+    // 可选的本地套接字端点（Unix 下为 AF_UNIX 套接字，Windows 下为命名管道），与 TCP 并存、协议相同
+    std::string localSocketName;
+    QLocalServer* localServer = nullptr;
+    WireMode wireMode = WireMode::Auto;
+
+    // 数据库连接参数（工作线程据此各自建立连接）
+    std::string dbHost;
+    std::string dbUser;
+    std::string dbPassword;
+    std::string dbName;
+    unsigned int dbPort;
+
+    // 工作线程池：workerThreads <= 0 时在 I/O 线程内直接处理请求（旧行为）
+    int workerThreads = 0;
+    RequestWorkerPool* workerPool = nullptr;
+    // 数据库连接池大小：> 0 时 dbManager 切换为池化模式，工作线程共享连接池而非各建一条连接
+    int dbPoolSize = 0;
+
+    // 每个客户端连接的接收状态（Framed 模式下可能一次读到半帧或多帧）
+    struct ConnectionState {
+        uint64_t id = 0;
+        QByteArray buffer;
+        WireMode mode = WireMode::Auto; // Auto 表示尚未根据首字节判定
+        WireEncoding encoding = WireEncoding::Json; // SET_ENCODING 协商的响应编码（仅 Framed）
+        size_t compressMinBytes = 0;                // SET_COMPRESSION 协商的压缩阈值，0 表示不压缩（仅 Framed）
+    };
+    uint64_t nextConnectionId = 0;
+    // 仅在 I/O 线程访问：连接 id -> socket（QTcpSocket 或 QLocalSocket），工作线程回写响应时据此查找（连接已断开则丢弃）
+    std::unordered_map<uint64_t, QIODevice*> connections;
+
+    // 登记新接入的连接（TCP 与本地套接字共用）
+    void SERaddConnection(QIODevice* clientSocket);
+    void SERonReadyRead(QIODevice* clientSocket, ConnectionState& state);
+    // 响应的回写去向：连接、线路模式，以及（带 FlagCorrelated 的请求）需原样带回的请求 id
+    struct ReplyRoute {
+        uint64_t connectionId = 0;
+        WireMode mode = WireMode::Framed;
+        bool correlated = false;
+        uint32_t correlationId = 0;
+        WireEncoding encoding = WireEncoding::Json; // 收到请求时该连接的响应编码
+        size_t compressMinBytes = 0;                // 收到请求时该连接的压缩阈值
+        uint8_t payloadFlags = 0;                   // 实际采用的编码/压缩标志位（由 SERencodeResponse 设置）
+    };
+    // 把一个完整请求交给工作线程池（或直接处理）。未带 id 的请求按连接串行、按原顺序写回；
+    // 带 id 的请求彼此独立，可在多个工作线程上并行执行，完成即写回（可能乱序）
+    void SERdispatch(const ReplyRoute& route, const std::string& request);
+    // 回写 I/O 线程直接生成的响应（如 SET_ENCODING 握手），与同一连接上先前未带 id 的请求保持顺序
+    void SERdispatchReply(const ReplyRoute& route, std::string response);
+    // 处理 Framed 连接上的连接级选项（SET_ENCODING / SET_COMPRESSION）；不是这两条命令时返回 false
+    bool SERhandleConnectionOption(ConnectionState& state, const ReplyRoute& route, const std::string& request);
+    // 按 route.encoding 把 JSON 响应转为 CBOR/MessagePack，再按 route.compressMinBytes 做 zlib 压缩，
+    // 并设置 route.payloadFlags；非 JSON 响应保持文本，压缩后不变小的响应原样发送。
+    // preEncoded 为 true 表示响应已按 route.encoding 直接写出（列表命令、BATCH），只需压缩
+    static void SERencodeResponse(ReplyRoute& route, std::string& response, int compressLevel = 1, bool preEncoded = false);
+    // 处理请求并生成最终 payload（SERhandleRequest + SERencodeResponse），在工作线程执行。
+    // 热点只读响应（GET_ALL_GOODS）在商品目录版本不变时直接复用上次编码、压缩好的结果
+    std::string SERbuildReply(ReplyRoute& route, const std::string& request);
+
+    // 已编码、压缩的热点响应；key 为请求 + 编码 + 压缩阈值，version 为生成时的商品目录版本
+    struct CachedReply {
+        uint64_t version = 0;
+        std::string payload;
+        uint8_t flags = 0;
+    };
+    std::mutex replyCacheMutex;
+    std::unordered_map<std::string, CachedReply> replyCache;
+    std::atomic<uint64_t> replyCacheHits{ 0 };
+    static constexpr size_t MaxCachedReplies = 16;
+    // 响应按值传入并移入发送队列，帧头单独入队，正文不再复制
+    void SERwriteResponse(const ReplyRoute& route, std::string response);
+
+    // 每个连接待写出的数据。大响应分块写入 socket：只在其写缓冲低于水位时追加下一块，
+    // 其余在 bytesWritten 时续写，socket 内部缓冲不会一次性复制整个响应
+    struct PendingOutput {
+        std::deque<std::string> chunks;
+        size_t offset = 0; // chunks.front() 中已交给 socket 的字节数
+    };
+    std::unordered_map<uint64_t, PendingOutput> pendingOutput;
+    void SERdrainConnection(uint64_t connectionId);
+
+    // 进程内通道（SERstart 时按端口注册）：同进程 Client 的请求不经 TCP，直接交给工作线程池
+    std::shared_ptr<LocalTransport> localTransport;
+    uint64_t nextLocalCallId = 0; // 仅通道分发线程访问
+    void SERdispatchLocal(LocalTransport::CallPtr call);
+    // 单个请求发出的 SQL 语句数超过该值时记录告警
+    static constexpr uint64_t MaxQueriesPerRequest = 20;
+
+    // 记录请求/响应日志（含本次请求的 SQL 语句数）并调用 SERprocessRequest，同时按命令记录指标。
+    // route 非空时在记录指标前按其编码、压缩（SERencodeResponse），bytes_out 即实际发送的字节数；
+    // failed 非空时返回响应是否为错误（文本响应按内容判断，直接编码的响应由处理函数登记）
+    std::string SERhandleRequest(const std::string& request, ReplyRoute* route = nullptr, int compressLevel = 1, bool* failed = nullptr);
+
+    // 按命令的请求数/错误数/字节数/延迟直方图（GET_METRICS 返回，亦可定期导出为 Prometheus 文本）
+    ServerMetrics metrics;
+    std::string metricsExportPath;
+    int metricsExportIntervalMs = 0;
+    QTimer* metricsTimer = nullptr;
+
+    // 当前线程使用的数据库连接：工作线程返回其私有连接，否则返回 dbManager（池化模式下总是 dbManager）
+    Storage* db() const;
+
+    // 商品目录缓存：商品读请求由内存返回，增删改与库存变化同步写入
+    GoodsCatalog goodsCatalog;
+    // 确保目录已加载且未过期（必要时从数据库整表加载）；返回 false 表示缓存不可用，调用方应直接查库
+    bool SERensureCatalog();
+    // 按 id 读取商品：优先缓存，未命中时查库并回填
+    bool SERloadGood(int id, Good& g);
+
+    // 编译后的促销索引：仅在促销增删改后重建
+    PromotionIndex promotionIndex;
+    // 当前促销快照（必要时从数据库编译）；数据库不可用时返回空
+    std::shared_ptr<const PromotionIndex::Snapshot> SERpromotions();
+    // 促销变更后调用：使索引失效并立即重建
+    void SERreloadPromotions();
+    // 按 policy（对象时）或促销索引重算购物车金额
+    void SERrecalcCartTotals(TemporaryCart& cart, const nlohmann::json& policy);
+
+    // 在单个事务内保存订单并扣减库存；成功返回空串，否则返回错误 JSON
+    std::string SERsaveOrderWithStock(const Order& o);
+
+    // 命令表：命令名 -> 处理函数，构造时注册内置命令；查找为一次哈希，与命令在表中的位置无关
+    std::unordered_map<std::string, CommandHandler> commandTable;
+    void SERregisterCommands();
+    // 较长的命令处理逻辑
+    std::string SERaddSettledOrderFromJson(const nlohmann::json& j);
+    std::string SERsaveCartWithPolicy(const nlohmann::json& j);
+
+    // 内部类型化接口：参数与结果为已解析的 json 值，只在协议边界（命令表）序列化一次，
+    // 避免处理函数之间 dump 后再 parse
+    // 保存购物车；policyOverride 非空时代替 cart 内的 policy/policy_str/policy_detail
+    nlohmann::json SERsaveCartObject(const std::string& userPhone, const nlohmann::json& cart,
+                                     const nlohmann::json* policyOverride = nullptr);
+    // 对某商品生效的促销规则数组 [{"id","name","policy"}]
+    nlohmann::json SERpromotionsForProduct(int productId);
+
+    // BATCH：一次请求执行多条子命令，可选在同一数据库事务内执行（任一子命令失败则整体回滚）
+    static constexpr size_t MaxBatchRequests = 64;
+    std::string SERbatch(const nlohmann::json& j);
 
     // 生成符合数据库要求的购物车 ID（基于时间 + 随机数，长度 <= 64）
     std::string generateCartId(const std::string& userPhone);
 
 public:
     Server(int port);
+    Server(int port, const std::string& dbHost, const std::string& dbUser, const std::string& dbPassword,
+           const std::string& dbName, unsigned int dbPort);
+    // 使用指定的存储后端（如 MemoryStorage），Server 接管其所有权；未初始化时在此初始化
+    Server(int port, Storage* storage);
     ~Server();
 
     // 启动服务器
@@ -41,18 +242,59 @@ public:
     // 停止服务器
     void SERstop();
 
-    // 处理客户端请求
+    // TCP 端口是否处于监听状态（SERstart 监听失败时为 false）
+    bool SERisListening() const { return server && server->isListening(); }
+
+    // 线路协议模式：Auto（默认，按连接自动识别新旧客户端）/ Legacy / Framed
+    void SERsetWireMode(WireMode mode) { wireMode = mode; }
+    WireMode SERwireMode() const { return wireMode; }
+
+    // TCP 监听地址（需在 SERstart 之前设置），默认只监听 127.0.0.1
+    void SERsetListenAddress(const std::string& address) { listenAddress = address; }
+    const std::string& SERlistenAddress() const { return listenAddress; }
+
+    // 本地套接字端点名（需在 SERstart 之前设置）：非空时除 TCP 外再监听该名称，
+    // 可为名称（如 "hachimi"，Unix 下位于临时目录）或绝对路径（如 "/run/hachimi.sock"）；空表示只监听 TCP
+    void SERsetLocalSocket(const std::string& name) { localSocketName = name; }
+    const std::string& SERlocalSocket() const { return localSocketName; }
+
+    // 工作线程数（需在 SERstart 之前设置）；<= 0 表示不使用线程池
+    void SERsetWorkerThreads(int count) { workerThreads = count; }
+    int SERworkerThreads() const { return workerThreads; }
+
+    // 数据库连接池大小（需在 SERstart 之前设置）；<= 0 表示不使用连接池
+    void SERsetDatabasePoolSize(int size) { dbPoolSize = size; }
+    int SERdatabasePoolSize() const { return dbPoolSize; }
+
+    // 指标导出（需在 SERstart 之前设置）：每 intervalMs 毫秒把指标以 Prometheus 文本格式写入 path；path 为空表示不导出
+    void SERsetMetricsExport(const std::string& path, int intervalMs = 15000) { metricsExportPath = path; metricsExportIntervalMs = intervalMs; }
+    // 立即导出一次；未配置路径或写入失败返回 false
+    bool SERexportMetrics();
+
+    // 注册（或替换）命令处理函数；需在 SERstart 之前调用，运行期间命令表只读
+    void SERregisterCommand(const std::string& name, CommandHandler handler);
+
+    // 处理客户端请求：解析命令名，经命令表分发，参数/处理异常统一转为错误信封
     std::string SERprocessRequest(const std::string& request);
 
     // 业务处理接口
     std::string SERgetAllGoods();
+    // 键集分页：{"has_more":...,"items":[...],"next_after_id":...}，客户端以 next_after_id 请求下一页
+    // q 非空时只返回满足条件的商品（分页游标仍为 id）
+    std::string SERgetGoodsPage(int afterId, int limit, bool descending, const Storage::GoodsQuery& q = Storage::GoodsQuery());
     std::string SERupdateGood(int GoodId, std::string Goodname, double Goodprice, int Goodstock, std::string Goodcategory);
     std::string SERaddGood(const std::string& name, double price, int stock, const std::string& category);
     std::string SERgetGoodById(int id);
     std::string SERdeleteGood(int id);
     std::string SERsearchGoodsByCategory(const std::string& category);
+    // 商品目录缓存命中/未命中统计
+    std::string SERgetCatalogStats();
+    // 按命令的 p50/p95/p99 延迟、数据库耗时与计数
+    std::string SERgetMetrics();
     //user
     std::string SERgetAllAccounts();
+    // phone 非空时只返回手机号包含 phone 的用户
+    std::string SERgetAccountsPage(const std::string& afterPhone, int limit, bool descending, const std::string& phone = std::string());
     std::string SERlogin(const std::string& phone, const std::string& password);
     std::string SERupdateAccountPassword(const std::string& userId, const std::string& oldPassword, const std::string& newPassword);
     std::string SERdeleteAccount(const std::string& phone, const std::string& password);
@@ -60,6 +302,8 @@ public:
     std::string SERupdateUser(const std::string& phone, const std::string& password, const std::string& address);
 	//order
     std::string SERgetAllOrders(const std::string& userPhone);
+    std::string SERgetOrdersPage(const std::string& afterOrderId, int limit, bool descending);
+    std::string SERqueryOrders(const Storage::OrderQuery& q, const std::string& afterOrderId, int limit, bool descending);
     std::string SERgetOrderDetail(const std::string& orderId, const std::string& userPhone);
     std::string SERupdateOrderStatus(const std::string& orderId, const std::string& userPhone, int newStatus);
     std::string SERaddSettledOrder(const std::string& orderId, const std::string& productName, int productId,
@@ -73,7 +317,7 @@ public:
     std::string SERaddToCart(const std::string& userPhone, int productId, const std::string& productName, double price, int quantity);
     std::string SERupdateCartItem(const std::string& userPhone, int productId, int quantity);
     std::string SERremoveFromCart(const std::string& userPhone, int productId);
-    static void recalcCartTotalsImpl(TemporaryCart& cart, const nlohmann::json& policy, DatabaseManager* dbManager);
+    static void recalcCartTotalsImpl(TemporaryCart& cart, const nlohmann::json& policy, Storage* dbManager);
     void recalcCartTotals(TemporaryCart& cart);
 	// promotion
     std::string SERgetAllPromotions();
@@ -0,0 +1,236 @@
+// hachimi-server：无界面的独立服务端入口（CMake 目标，见仓库根目录 CMakeLists.txt）
+// 只依赖 QtCore/QtNetwork 与 MySQL，不创建任何窗口；参数来自命令行或 JSON 配置文件（命令行优先）
+#include <QCoreApplication>
+#include <QTimer>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "logger.h"
+#include "Server.h"
+#include "MemoryStorage.h"
+
+using nlohmann::json;
+
+namespace {
+
+struct ServerConfig {
+    int port = 8888;
+    std::string bind = "127.0.0.1";
+    std::string localSocket;
+    std::string storage = "mysql";
+    std::string snapshot;
+    std::string dbHost = "127.0.0.1";
+    std::string dbUser = "root";
+    std::string dbPassword;
+    std::string dbName = "remake";
+    unsigned int dbPort = 3306;
+    int workers = 4;
+    int dbPool = 4;
+    std::string wire = "auto";
+    std::string metricsFile;
+    int metricsIntervalMs = 15000;
+    std::string log;
+};
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+void printUsage(const char* argv0) {
+    std::cout <<
+        "用法: " << argv0 << " [选项]\n"
+        "  --config <file>            JSON 配置文件（键名同下，去掉前缀并以 _ 代替 -，如 db_host）\n"
+        "  --port <n>                 TCP 端口（默认 8888）\n"
+        "  --bind <addr>              TCP 监听地址（默认 127.0.0.1）\n"
+        "  --local-socket <name>      额外监听的本地套接字名或路径（默认不监听）\n"
+        "  --storage <mysql|memory>   存储后端（默认 mysql；memory 为进程内存储，不需要 MySQL）\n"
+        "  --snapshot <path>          memory 后端的 JSON 快照：启动时读取、退出时写回（默认不持久化）\n"
+        "  --db-host <host>           MySQL 地址（默认 127.0.0.1）\n"
+        "  --db-port <n>              MySQL 端口（默认 3306）\n"
+        "  --db-user <user>           MySQL 用户（默认 root）\n"
+        "  --db-password <pwd>        MySQL 密码（也可用环境变量 HACHIMI_DB_PASSWORD）\n"
+        "  --db-name <name>           数据库名（默认 remake）\n"
+        "  --workers <n>              请求处理线程数（默认 4，0 表示在 I/O 线程内处理）\n"
+        "  --db-pool <n>              数据库连接池大小（默认 4，0 表示每个工作线程独占一条连接）\n"
+        "  --wire <auto|framed|legacy> 线路协议（默认 auto）\n"
+        "  --metrics-file <path>      定期写入 Prometheus 文本格式的指标（默认不写）\n"
+        "  --metrics-interval <ms>    指标导出间隔（默认 15000）\n"
+        "  --log <spec>               日志级别配置，格式同 HACHIMI_LOG（如 warn,server=info）\n"
+        "  --help                     显示本帮助\n";
+}
+
+// 配置文件中的值覆盖默认值；未出现的键保持不变
+bool loadConfigFile(const std::string& path, ServerConfig& cfg) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "无法打开配置文件: " << path << std::endl;
+        return false;
+    }
+    try {
+        json j = json::parse(in);
+        if (!j.is_object()) {
+            std::cerr << "配置文件必须是 JSON 对象: " << path << std::endl;
+            return false;
+        }
+        cfg.port = j.value("port", cfg.port);
+        cfg.bind = j.value("bind", cfg.bind);
+        cfg.localSocket = j.value("local_socket", cfg.localSocket);
+        cfg.storage = j.value("storage", cfg.storage);
+        cfg.snapshot = j.value("snapshot", cfg.snapshot);
+        cfg.dbHost = j.value("db_host", cfg.dbHost);
+        cfg.dbPort = j.value("db_port", cfg.dbPort);
+        cfg.dbUser = j.value("db_user", cfg.dbUser);
+        cfg.dbPassword = j.value("db_password", cfg.dbPassword);
+        cfg.dbName = j.value("db_name", cfg.dbName);
+        cfg.workers = j.value("workers", cfg.workers);
+        cfg.dbPool = j.value("db_pool", cfg.dbPool);
+        cfg.wire = j.value("wire", cfg.wire);
+        cfg.metricsFile = j.value("metrics_file", cfg.metricsFile);
+        cfg.metricsIntervalMs = j.value("metrics_interval_ms", cfg.metricsIntervalMs);
+        cfg.log = j.value("log", cfg.log);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "配置文件解析失败: " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parseInt(const std::string& text, int& out) {
+    try {
+        size_t used = 0;
+        int v = std::stoi(text, &used);
+        if (used != text.size()) return false;
+        out = v;
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+// 返回 0 表示继续启动，1 表示参数错误，2 表示已输出帮助
+int parseArgs(int argc, char* argv[], ServerConfig& cfg) {
+    // 先找 --config，使命令行上的其他选项总能覆盖配置文件
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--config") {
+            if (!loadConfigFile(argv[i + 1], cfg)) return 1;
+        }
+    }
+    if (const char* pwd = std::getenv("HACHIMI_DB_PASSWORD")) cfg.dbPassword = pwd;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string opt = argv[i];
+        if (opt == "--help" || opt == "-h") {
+            printUsage(argv[0]);
+            return 2;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "选项缺少参数或无法识别: " << opt << std::endl;
+            return 1;
+        }
+        const std::string val = argv[++i];
+        int n = 0;
+        bool ok = true;
+        if (opt == "--config") {}
+        else if (opt == "--port") ok = parseInt(val, cfg.port);
+        else if (opt == "--bind") cfg.bind = val;
+        else if (opt == "--local-socket") cfg.localSocket = val;
+        else if (opt == "--storage") cfg.storage = val;
+        else if (opt == "--snapshot") cfg.snapshot = val;
+        else if (opt == "--db-host") cfg.dbHost = val;
+        else if (opt == "--db-port") { ok = parseInt(val, n) && n > 0; if (ok) cfg.dbPort = static_cast<unsigned int>(n); }
+        else if (opt == "--db-user") cfg.dbUser = val;
+        else if (opt == "--db-password") cfg.dbPassword = val;
+        else if (opt == "--db-name") cfg.dbName = val;
+        else if (opt == "--workers") ok = parseInt(val, cfg.workers);
+        else if (opt == "--db-pool") ok = parseInt(val, cfg.dbPool);
+        else if (opt == "--wire") cfg.wire = val;
+        else if (opt == "--metrics-file") cfg.metricsFile = val;
+        else if (opt == "--metrics-interval") ok = parseInt(val, cfg.metricsIntervalMs);
+        else if (opt == "--log") cfg.log = val;
+        else {
+            std::cerr << "未知选项: " << opt << std::endl;
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "选项 " << opt << " 的值无效: " << val << std::endl;
+            return 1;
+        }
+    }
+    if (cfg.port <= 0 || cfg.port > 65535) {
+        std::cerr << "端口超出范围: " << cfg.port << std::endl;
+        return 1;
+    }
+    if (cfg.wire != "auto" && cfg.wire != "framed" && cfg.wire != "legacy") {
+        std::cerr << "--wire 只能是 auto/framed/legacy: " << cfg.wire << std::endl;
+        return 1;
+    }
+    if (cfg.storage != "mysql" && cfg.storage != "memory") {
+        std::cerr << "--storage 只能是 mysql/memory: " << cfg.storage << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    ServerConfig cfg;
+    const int parsed = parseArgs(argc, argv, cfg);
+    if (parsed == 2) return 0;
+    if (parsed != 0) return 1;
+
+    if (!cfg.log.empty() && !Logger::instance().configure(cfg.log)) {
+        std::cerr << "日志配置中含无法识别的项: " << cfg.log << std::endl;
+    }
+    Logger::instance().enableAsync(8192, Logger::OverflowPolicy::Drop, 1000);
+    Logger::instance().info("hachimi-server 启动");
+
+    std::unique_ptr<Server> serverPtr;
+    if (cfg.storage == "memory") {
+        serverPtr.reset(new Server(cfg.port, new MemoryStorage(cfg.snapshot)));
+    } else {
+        serverPtr.reset(new Server(cfg.port, cfg.dbHost, cfg.dbUser, cfg.dbPassword, cfg.dbName, cfg.dbPort));
+    }
+    Server& server = *serverPtr;
+    server.SERsetListenAddress(cfg.bind);
+    server.SERsetLocalSocket(cfg.localSocket);
+    server.SERsetWorkerThreads(cfg.workers);
+    server.SERsetDatabasePoolSize(cfg.dbPool);
+    server.SERsetWireMode(cfg.wire == "framed" ? WireMode::Framed : cfg.wire == "legacy" ? WireMode::Legacy : WireMode::Auto);
+    if (!cfg.metricsFile.empty()) server.SERsetMetricsExport(cfg.metricsFile, cfg.metricsIntervalMs);
+    server.SERstart();
+    if (!server.SERisListening()) {
+        std::cerr << "监听 " << cfg.bind << ":" << cfg.port << " 失败" << std::endl;
+        Logger::instance().disableAsync();
+        return 1;
+    }
+    Logger::instance().info("hachimi-server 监听 " + cfg.bind + ":" + std::to_string(cfg.port) +
+        "，存储 " + cfg.storage + "，工作线程 " + std::to_string(cfg.workers) + "，连接池 " + std::to_string(cfg.dbPool));
+
+    // 信号处理函数只置位标志，由事件循环中的定时器轮询后退出
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    QTimer stopPoll;
+    QObject::connect(&stopPoll, &QTimer::timeout, [&app]() {
+        if (stopRequested) app.quit();
+    });
+    stopPoll.start(200);
+
+    int ret = app.exec();
+
+    server.SERstop();
+    Logger::instance().info("hachimi-server 退出\n");
+    Logger::instance().disableAsync();
+    return ret;
+}
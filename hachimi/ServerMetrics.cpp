@@ -0,0 +1,230 @@
+#include "ServerMetrics.h"
+#include "AtomicFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+// ---------------- LatencyHistogram ----------------
+
+int LatencyHistogram::bucketIndex(uint64_t us) {
+    if (us < static_cast<uint64_t>(SubBuckets)) return static_cast<int>(us);
+    int msb = 63;
+    while (!(us >> msb)) --msb;
+    if (msb >= MaxMagnitude) return BucketCount - 1;
+    const int shift = msb - 4;
+    const int sub = static_cast<int>(us >> shift) - SubBuckets;
+    return SubBuckets + shift * SubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SubBuckets) return static_cast<uint64_t>(index);
+    const int k = index - SubBuckets;
+    const int shift = k / SubBuckets;
+    const int sub = k % SubBuckets;
+    return ((static_cast<uint64_t>(SubBuckets + sub + 1)) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us) {
+    buckets_[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    // 各桶独立读取，与并发 record 之间可能有细微出入，对统计用途足够
+    uint64_t total = 0;
+    for (const auto& b : buckets_) total += b.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    q = (std::min)(1.0, (std::max)(0.0, q));
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return (std::min)(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+// ---------------- ServerMetrics ----------------
+
+static bool isPlainCommandName(const std::string& s) {
+    if (s.empty() || s.size() > 64) return false;
+    for (unsigned char c : s) {
+        if (!(std::isalnum(c) || c == '_')) return false;
+    }
+    return true;
+}
+
+ServerMetrics::CommandStats& ServerMetrics::statsFor(const std::string& command) {
+    const std::string key = isPlainCommandName(command) ? command : std::string("<other>");
+    {
+        std::shared_lock<std::shared_mutex> lk(mtx_);
+        auto it = commands_.find(key);
+        if (it != commands_.end()) return *it->second;
+    }
+    std::unique_lock<std::shared_mutex> lk(mtx_);
+    auto it = commands_.find(key);
+    if (it != commands_.end()) return *it->second;
+    if (commands_.size() >= MaxCommands && key != "<other>") {
+        auto& other = commands_["<other>"];
+        if (!other) other.reset(new CommandStats());
+        return *other;
+    }
+    auto& slot = commands_[key];
+    slot.reset(new CommandStats());
+    return *slot;
+}
+
+void ServerMetrics::record(const std::string& command, size_t bytesIn, size_t bytesOut,
+                           uint64_t latencyUs, uint64_t dbUs, bool error) {
+    CommandStats& st = statsFor(command);
+    st.requests.fetch_add(1, std::memory_order_relaxed);
+    if (error) st.errors.fetch_add(1, std::memory_order_relaxed);
+    st.bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+    st.bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+    st.latency.record(latencyUs);
+    st.dbTime.record(dbUs);
+}
+
+bool ServerMetrics::isErrorResponse(const std::string& response) {
+    const char* p = response.data();
+    const char* const end = p + response.size();
+    auto skipSpace = [end](const char* q) {
+        while (q < end && (*q == ' ' || *q == '\t' || *q == '\n' || *q == '\r')) ++q;
+        return q;
+    };
+    p = skipSpace(p);
+    if (p == end || *p != '{') return false;
+
+    // 扫描整个响应，只在顶层（depth == 1）的键上判断，与键顺序及响应长度无关
+    int depth = 0;
+    bool expectKey = false;
+    while (p < end) {
+        const char c = *p;
+        if (c == '"') {
+            const char* const str = ++p;
+            for (;;) {
+                p = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+                if (!p) return false; // 不完整的 JSON
+                size_t slashes = 0;
+                while (p - slashes > str && p[-1 - static_cast<ptrdiff_t>(slashes)] == '\\') ++slashes;
+                if (slashes % 2 == 0) break; // 未被转义的引号
+                ++p;
+            }
+            const size_t len = static_cast<size_t>(p - str);
+            ++p;
+            if (depth == 1 && expectKey) {
+                expectKey = false;
+                const char* v = skipSpace(p);
+                if (v == end || *v != ':') return false;
+                v = skipSpace(v + 1);
+                const size_t rest = static_cast<size_t>(end - v);
+                if (len == 5 && std::memcmp(str, "error", 5) == 0) {
+                    if (!(rest >= 4 && std::memcmp(v, "null", 4) == 0)) return true;
+                }
+                else if (len == 7 && std::memcmp(str, "success", 7) == 0) {
+                    if (rest >= 5 && std::memcmp(v, "false", 5) == 0) return true;
+                }
+                p = v;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            ++depth;
+            expectKey = depth == 1;
+        }
+        else if (c == '}' || c == ']') {
+            if (--depth == 0) return false;
+        }
+        else if (c == ',' && depth == 1) {
+            expectKey = true;
+        }
+        ++p;
+    }
+    return false;
+}
+
+static nlohmann::json histogramJson(const LatencyHistogram& h) {
+    nlohmann::json j;
+    const uint64_t n = h.count();
+    j["count"] = n;
+    j["mean"] = n ? static_cast<double>(h.sum()) / static_cast<double>(n) : 0.0;
+    j["p50"] = h.percentile(0.50);
+    j["p95"] = h.percentile(0.95);
+    j["p99"] = h.percentile(0.99);
+    j["max"] = h.max();
+    return j;
+}
+
+nlohmann::json ServerMetrics::toJson() const {
+    nlohmann::json out;
+    out["uptime_s"] = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - started_).count();
+    nlohmann::json cmds = nlohmann::json::object();
+    uint64_t requests = 0, errors = 0, bytesIn = 0, bytesOut = 0;
+    {
+        std::shared_lock<std::shared_mutex> lk(mtx_);
+        for (const auto& kv : commands_) {
+            const CommandStats& st = *kv.second;
+            nlohmann::json c;
+            c["requests"] = st.requests.load(std::memory_order_relaxed);
+            c["errors"] = st.errors.load(std::memory_order_relaxed);
+            c["bytes_in"] = st.bytesIn.load(std::memory_order_relaxed);
+            c["bytes_out"] = st.bytesOut.load(std::memory_order_relaxed);
+            c["latency_us"] = histogramJson(st.latency);
+            c["db_us"] = histogramJson(st.dbTime);
+            requests += c["requests"].get<uint64_t>();
+            errors += c["errors"].get<uint64_t>();
+            bytesIn += c["bytes_in"].get<uint64_t>();
+            bytesOut += c["bytes_out"].get<uint64_t>();
+            cmds[kv.first] = std::move(c);
+        }
+    }
+    out["commands"] = std::move(cmds);
+    out["total"] = { {"requests", requests}, {"errors", errors}, {"bytes_in", bytesIn}, {"bytes_out", bytesOut} };
+    return out;
+}
+
+std::string ServerMetrics::toPrometheus() const {
+    // 命令名已限制为 [A-Za-z0-9_] 或 "<other>"，可直接作为标签值
+    std::map<std::string, const CommandStats*> sorted;
+    std::shared_lock<std::shared_mutex> lk(mtx_);
+    for (const auto& kv : commands_) sorted[kv.first] = kv.second.get();
+
+    std::ostringstream o;
+    auto counter = [&](const char* name, const char* help, std::atomic<uint64_t> CommandStats::* field) {
+        o << "# HELP " << name << " " << help << "\n# TYPE " << name << " counter\n";
+        for (const auto& kv : sorted) {
+            o << name << "{command=\"" << kv.first << "\"} " << (kv.second->*field).load(std::memory_order_relaxed) << "\n";
+        }
+    };
+    auto summary = [&](const char* name, const char* help, LatencyHistogram CommandStats::* field) {
+        o << "# HELP " << name << " " << help << "\n# TYPE " << name << " summary\n";
+        for (const auto& kv : sorted) {
+            const LatencyHistogram& h = kv.second->*field;
+            for (double q : { 0.5, 0.95, 0.99 }) {
+                o << name << "{command=\"" << kv.first << "\",quantile=\"" << q << "\"} " << h.percentile(q) << "\n";
+            }
+            o << name << "_sum{command=\"" << kv.first << "\"} " << h.sum() << "\n";
+            o << name << "_count{command=\"" << kv.first << "\"} " << h.count() << "\n";
+        }
+    };
+    counter("hachimi_requests_total", "Requests handled per protocol command.", &CommandStats::requests);
+    counter("hachimi_request_errors_total", "Requests answered with an error envelope.", &CommandStats::errors);
+    counter("hachimi_request_bytes_in_total", "Request payload bytes received.", &CommandStats::bytesIn);
+    counter("hachimi_request_bytes_out_total", "Response payload bytes sent.", &CommandStats::bytesOut);
+    summary("hachimi_request_duration_us", "Request handling latency in microseconds.", &CommandStats::latency);
+    summary("hachimi_db_duration_us", "Time spent in SQL round trips per request, in microseconds.", &CommandStats::dbTime);
+    return o.str();
+}
+
+bool ServerMetrics::writePrometheusFile(const std::string& path) const {
+    return writeFileAtomically(path, toPrometheus());
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+// 延迟直方图（HDR 风格的对数-线性分桶，单位微秒）
+// - 0~15us 每 1us 一桶；之后每个 2 的幂区间再均分 16 桶，相对误差不超过 1/16
+// - 记录只做原子自增，可被多个工作线程并发调用
+class LatencyHistogram {
+public:
+    static constexpr int SubBuckets = 16;
+    static constexpr int MaxMagnitude = 36; // 2^36us 约 19 小时，更大的值计入最后一桶
+    static constexpr int BucketCount = SubBuckets + (MaxMagnitude - 4) * SubBuckets;
+
+    void record(uint64_t us);
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    // q 取 0~1；返回所在桶的上界（无数据时为 0）
+    uint64_t percentile(double q) const;
+
+    static int bucketIndex(uint64_t us);
+    static uint64_t bucketUpperBound(int index);
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> buckets_{};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<uint64_t> sum_{ 0 };
+    std::atomic<uint64_t> max_{ 0 };
+};
+
+// 服务端按协议命令统计：请求数、错误数、收发字节、端到端延迟与其中的数据库耗时
+class ServerMetrics {
+public:
+    struct CommandStats {
+        std::atomic<uint64_t> requests{ 0 };
+        std::atomic<uint64_t> errors{ 0 };
+        std::atomic<uint64_t> bytesIn{ 0 };
+        std::atomic<uint64_t> bytesOut{ 0 };
+        LatencyHistogram latency; // 请求处理总耗时
+        LatencyHistogram dbTime;  // 其中花在 SQL 往返上的时间
+    };
+
+    // 不同命令名的上限；超出后或命令名含非 [A-Za-z0-9_] 字符时归入 "<other>"
+    static constexpr size_t MaxCommands = 128;
+
+    ServerMetrics() : started_(std::chrono::steady_clock::now()) {}
+
+    void record(const std::string& command, size_t bytesIn, size_t bytesOut,
+                uint64_t latencyUs, uint64_t dbUs, bool error);
+
+    // {"uptime_s":..,"commands":{"GET_ALL_GOODS":{"requests":..,"latency_us":{"p50":..}}},"total":{...}}
+    nlohmann::json toJson() const;
+    // Prometheus 文本格式（hachimi_requests_total / hachimi_request_duration_us 等）
+    std::string toPrometheus() const;
+    // 经 writeFileAtomically 原子替换，采集方不会读到半个文件或文件缺失
+    bool writePrometheusFile(const std::string& path) const;
+
+    // 响应是否为错误：顶层有非 null 的 "error"，或 "success" 为 false。
+    // 逐字节扫描完整响应（不构造 DOM），不依赖键顺序；非 JSON 对象视为成功。BATCH 判断子响应也用它
+    static bool isErrorResponse(const std::string& response);
+
+private:
+    CommandStats& statsFor(const std::string& command);
+
+    std::chrono::steady_clock::time_point started_;
+    mutable std::shared_mutex mtx_;
+    std::unordered_map<std::string, std::unique_ptr<CommandStats>> commands_;
+};
@@ -0,0 +1,68 @@
+#include "Storage.h"
+#include <algorithm>
+#include <cstring>
+
+// 本线程发出的存储操作数与耗时（纳秒），按请求重置
+static thread_local uint64_t tlsQueryCount = 0;
+static thread_local uint64_t tlsQueryNanos = 0;
+
+void Storage::DTBresetQueryCount() {
+    tlsQueryCount = 0;
+    tlsQueryNanos = 0;
+}
+
+uint64_t Storage::DTBqueryCount() {
+    return tlsQueryCount;
+}
+
+uint64_t Storage::DTBqueryTimeUs() {
+    return tlsQueryNanos / 1000;
+}
+
+void Storage::DTBaddQueryCount(uint64_t n) {
+    tlsQueryCount += n;
+}
+
+void Storage::DTBaddQueryTime(uint64_t nanos) {
+    tlsQueryNanos += nanos;
+}
+
+void Storage::OrderQuery::idRange(char prefix, std::string& lower, std::string& upper) const {
+    lower = std::string(1, prefix) + fromTime;
+    std::string next = toTime;
+    while (!next.empty() && next.back() == '9') next.pop_back();
+    if (next.empty()) {
+        // 无上限（或全为 9，没有同长度的后继）：取到该前缀的末尾
+        upper = std::string(1, static_cast<char>(prefix + 1));
+        return;
+    }
+    ++next.back();
+    upper = std::string(1, prefix) + next;
+}
+
+// ASCII 字母不区分大小写的子串匹配，needle 为空时总是匹配
+static bool containsIgnoreCase(const std::string& haystack, const std::string& needle) {
+    if (needle.empty()) return true;
+    auto lower = [](unsigned char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : static_cast<char>(c); };
+    auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+        [&lower](char a, char b) { return lower(static_cast<unsigned char>(a)) == lower(static_cast<unsigned char>(b)); });
+    return it != haystack.end();
+}
+
+bool Storage::GoodsQuery::matches(const Good& g) const {
+    if (!containsIgnoreCase(g.getName(), name)) return false;
+    if (!containsIgnoreCase(g.getCategory(), category)) return false;
+    if (g.getPrice() < minPrice) return false;
+    return maxPrice < 0.0 || g.getPrice() <= maxPrice;
+}
+
+bool Storage::OrderQuery::matches(const Order& o) const {
+    if (!userPhone.empty() && o.getUserPhone() != userPhone) return false;
+    if (!statuses.empty() && std::find(statuses.begin(), statuses.end(), o.getStatus()) == statuses.end()) return false;
+    if (!hasTimeRange()) return true;
+    const std::string& id = o.getOrderId();
+    if (id.empty() || std::strchr(OrderIdPrefixes, id[0]) == nullptr) return false;
+    std::string lower, upper;
+    idRange(id[0], lower, upper);
+    return id >= lower && id < upper;
+}
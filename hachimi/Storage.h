@@ -0,0 +1,174 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "user.h"
+#include "good.h"
+#include "order.h"
+#include "orderItem.h"
+#include "TemporaryCart.h"
+#include "cartItem.h"
+
+// 存储后端接口：Server 只经由这里的 DTB* 方法读写数据。
+// 实现：DatabaseManager（MySQL）、MemoryStorage（进程内哈希表，可选快照到磁盘）
+class Storage {
+public:
+    virtual ~Storage() = default;
+
+    // 连接管理
+    virtual bool DTBinitialize() = 0;
+    virtual bool DTBisConnected() const = 0;
+    // 同一实例能否被多个线程并发调用（MySQL 仅在连接池模式下可以，内存引擎总是可以）
+    virtual bool DTBisThreadSafe() const = 0;
+    // 把尚未持久化的数据写出（内存引擎写快照）；无需持久化的实现直接返回 true
+    virtual bool DTBflush() { return true; }
+
+    // 当前线程发出的存储操作数（MySQL 为 SQL 语句数）及其耗时，所有实例合计。
+    // 服务端在每个请求开始时重置、结束时读取，用于发现 N+1 查询并区分服务端耗时与存储耗时
+    static void DTBresetQueryCount();
+    static uint64_t DTBqueryCount();
+    static uint64_t DTBqueryTimeUs();
+    // 供实现方调用：累计本线程的操作数与耗时
+    static void DTBaddQueryCount(uint64_t n = 1);
+    static void DTBaddQueryTime(uint64_t nanos);
+
+    // 计时作用域：构造时计一次操作，析构时累计经过时间
+    class QueryScope {
+    public:
+        QueryScope() : start_(std::chrono::steady_clock::now()) { DTBaddQueryCount(); }
+        ~QueryScope() {
+            DTBaddQueryTime(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count()));
+        }
+        QueryScope(const QueryScope&) = delete;
+        QueryScope& operator=(const QueryScope&) = delete;
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // 跨多次 DTB* 调用的事务：存续期间本线程对同一存储的 DTB* 调用都在该事务内，
+    // commit() 前析构则回滚
+    class Transaction {
+    public:
+        virtual ~Transaction() = default;
+        // 事务已成功开启
+        virtual bool active() const = 0;
+        virtual bool commit() = 0;
+    };
+    virtual std::unique_ptr<Transaction> DTBbeginTransaction() = 0;
+
+    // 用户管理
+    virtual bool DTBaddUser(const User& u) = 0; // 手机号已存在时失败
+    virtual bool DTBsaveUser(const User& u) = 0;
+    virtual bool DTBupdateUser(const User& u) = 0;
+    virtual bool DTBloadUser(const std::string& phone, User& u) = 0;
+    virtual bool DTBdeleteUser(const std::string& phone) = 0;
+    virtual std::vector<User> DTBloadAllUsers() = 0;
+    // 键集分页：按主键排序，取游标（不含）之后至多 limit 行；游标为空串 / 0 表示从第一行开始。
+    // 代价只与 limit 有关，与表大小无关
+    virtual std::vector<User> DTBloadUsersPage(const std::string& afterPhone, int limit, bool descending = false) = 0;
+    // 手机号包含 phone 的用户，按手机号键集分页（见 DTBloadUsersPage）
+    virtual std::vector<User> DTBqueryUsers(const std::string& phone, const std::string& afterPhone, int limit, bool descending = false) = 0;
+
+    // 商品管理
+    virtual bool DTBsaveGood(const Good& g, int* newId = nullptr) = 0; // newId 非空时返回自增 id
+    virtual bool DTBupdateGood(const Good& g) = 0;
+    virtual bool DTBloadGood(int id, Good& g) = 0;
+    virtual bool DTBdeleteGood(int id) = 0;
+    // ok 非空时返回是否查询成功，用于区分“表为空”与“查询失败”（两者都返回空列表）
+    virtual std::vector<Good> DTBloadAllGoods(bool* ok = nullptr) = 0;
+    virtual std::vector<Good> DTBloadGoodsPage(int afterId, int limit, bool descending = false) = 0;
+    // 商品筛选条件，空字段表示不限。名称、分类为部分匹配，ASCII 字母不区分大小写
+    // （与 MySQL 默认 _ci 排序规则下的 LIKE 一致）；价格区间含两端
+    struct GoodsQuery {
+        std::string name;
+        std::string category;
+        double minPrice = 0.0;
+        double maxPrice = -1.0; // 小于 0 表示不限
+        bool empty() const { return name.empty() && category.empty() && minPrice <= 0.0 && maxPrice < 0.0; }
+        bool matches(const Good& g) const;
+    };
+    // 按条件键集分页（见 DTBloadGoodsPage）
+    virtual std::vector<Good> DTBqueryGoods(const GoodsQuery& q, int afterId, int limit, bool descending = false) = 0;
+    virtual std::vector<Good> DTBloadGoodsByCategory(const std::string& category) = 0;
+    virtual std::map<int, Good> DTBloadGoodsByIds(const std::vector<int>& ids) = 0; // 不存在的 id 不出现在结果中
+    virtual bool DTBupdateGoodStock(int good_id, int new_stock) = 0;
+
+    // 订单管理
+    virtual bool DTBsaveOrder(const Order& o) = 0; // 订单头与订单项一并写入
+    // 结算下单：原子地校验库存、写入订单与订单项、扣减库存，任一步失败整体回滚
+    struct OrderSaveResult {
+        enum Status { Ok, DbError, GoodNotFound, StockExceeded };
+        Status status = DbError;
+        int goodId = 0;     // GoodNotFound / StockExceeded 时对应的商品
+        int available = 0;  // StockExceeded：当前库存
+        int requested = 0;  // StockExceeded：订单中该商品的总数量
+    };
+    virtual OrderSaveResult DTBsaveOrderWithStock(const Order& o) = 0;
+    virtual bool DTBupdateOrder(const Order& o) = 0;
+    virtual bool DTBupdateOrderStatus(const std::string& order_id, int status) = 0;
+    virtual bool DTBloadOrder(const std::string& order_id, Order& o) = 0;
+    virtual bool DTBdeleteOrder(const std::string& order_id) = 0;
+    virtual std::vector<Order> DTBloadOrdersByUser(const std::string& user_phone) = 0;
+    virtual std::vector<Order> DTBloadOrdersByStatus(int status) = 0;
+    virtual std::vector<Order> DTBloadRecentOrders(int limit = 50) = 0; // 按 order_id 倒序
+    // 键集分页（见 DTBloadUsersPage），只含订单头、不加载订单项；默认按 order_id 倒序（最新在前）
+    virtual std::vector<Order> DTBloadOrdersPage(const std::string& afterOrderId, int limit, bool descending = true) = 0;
+    // 订单查询条件，空字段表示不限。表中没有下单时间列，时间取自订单号中编码的时间戳：
+    // 订单号 = 单字母前缀（OrderIdPrefixes）+ yyyyMMddHHmmsszzz（本地时间）+ 后缀，
+    // 因此时间范围可换成每个前缀上的一段 order_id 范围，直接走主键索引
+    struct OrderQuery {
+        static constexpr const char* OrderIdPrefixes = "co"; // c：购物车结算，o：客户端直接下单
+        std::string userPhone;
+        std::vector<int> statuses;
+        std::string fromTime; // 下限（含），yyyyMMddHHmmsszzz 或其前缀，如 "20240101"
+        std::string toTime;   // 上限（含），同上；"20241231" 包含当天全部订单
+        bool hasTimeRange() const { return !fromTime.empty() || !toTime.empty(); }
+        // 前缀 prefix 上时间范围对应的 order_id 半开区间 [lower, upper)：lower = 前缀 + fromTime，
+        // upper = 前缀 + toTime 按数字进位的后继（"20241231" -> "20241232"），toTime 为空时为下一个前缀字母。
+        // 边界只含前缀字母与数字，在二进制与 utf8mb4_0900_ai_ci 等排序规则下比较结果相同
+        void idRange(char prefix, std::string& lower, std::string& upper) const;
+        // 与 MySQL 后端的 WHERE 条件等价（同样基于 idRange）；给了时间范围时，订单号不是上述格式的订单不匹配
+        bool matches(const Order& o) const;
+    };
+    // 按条件键集分页（见 DTBloadOrdersPage），只含订单头
+    virtual std::vector<Order> DTBqueryOrders(const OrderQuery& q, const std::string& afterOrderId, int limit, bool descending = true) = 0;
+
+    // 订单项管理
+    virtual bool DTBsaveOrderItem(const OrderItem& item) = 0;
+    virtual bool DTBupdateOrderItem(const OrderItem& item) = 0;
+    virtual std::vector<OrderItem> DTBloadOrderItems(const std::string& order_id) = 0;
+    // 批量读取多个订单的订单项（按 order_id 分组）
+    virtual std::map<std::string, std::vector<OrderItem>> DTBloadOrderItemsByOrders(const std::vector<std::string>& order_ids) = 0;
+    virtual bool DTBdeleteOrderItems(const std::string& order_id) = 0;
+
+    // 临时购物车管理
+    virtual bool DTBloadTemporaryCart(const std::string& cart_id, TemporaryCart& cart) = 0;
+    // 按用户手机号查找最新（cart_id 最大）的临时购物车
+    virtual bool DTBloadTemporaryCartByUserPhone(const std::string& userPhone, TemporaryCart& outCart) = 0;
+    virtual bool DTBdeleteTemporaryCart(const std::string& cart_id) = 0;
+    virtual bool DTBsaveTemporaryCart(const TemporaryCart& cart) = 0;
+    virtual bool DTBupdateTemporaryCart(const TemporaryCart& cart) = 0;
+    // 未转为订单且超过一天未更新的购物车
+    virtual std::vector<TemporaryCart> DTBloadExpiredCarts() = 0;
+    virtual bool DTBcleanupExpiredCarts() = 0;
+
+    // 购物车项管理（读取时跳过并删除引用了已删除商品的项）
+    virtual bool DTBsaveCartItem(const CartItem& item, const std::string& cart_id) = 0;
+    virtual bool DTBupdateCartItem(const CartItem& item, const std::string& cart_id) = 0;
+    virtual bool DTBdeleteCartItem(int good_id, const std::string& cart_id) = 0;
+    virtual bool DTBdeleteAllCartItems(const std::string& cart_id) = 0;
+    virtual std::vector<CartItem> DTBloadCartItems(const std::string& cart_id) = 0;
+
+    // 促销策略：行以 {"id","name","policy_detail"} 表示
+    virtual bool DTBsavePromotionStrategy(const std::string& name, const std::string& type,
+        const std::string& config, const std::string& conditions = "") = 0;
+    virtual bool DTBupdatePromotionStrategy(const std::string& name, bool is_active) = 0;
+    virtual std::map<std::string, std::string> DTBloadPromotionStrategy(const std::string& name) = 0;
+    virtual std::vector<std::map<std::string, std::string>> DTBloadAllPromotionStrategies(bool active_only = true) = 0;
+    virtual bool DTBupdatePromotionStrategyDetail(const std::string& name, const std::string& policy_detail) = 0;
+    virtual bool DTBdeletePromotionStrategy(const std::string& name) = 0;
+};
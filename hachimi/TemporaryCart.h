@@ -3,7 +3,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include "CartItem.h"
+#include "cartItem.h"
 #include "good.h"
 
 
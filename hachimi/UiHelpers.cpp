@@ -0,0 +1,25 @@
+#include "UiHelpers.h"
+#include <QPushButton>
+#include <QDateTime>
+#include <QVariant>
+
+void setButtonLoading(QPushButton* btn, bool loading) {
+    if (!btn) return;
+    if (loading) {
+        if (!btn->property("idleText").isValid()) btn->setProperty("idleText", btn->text());
+        btn->setText("加载中...");
+        btn->setEnabled(false);
+    }
+    else {
+        QVariant idle = btn->property("idleText");
+        if (idle.isValid()) btn->setText(idle.toString());
+        btn->setProperty("idleText", QVariant());
+        btn->setEnabled(true);
+    }
+}
+
+std::string orderFilterTime(const QDateTime& dt, bool upper) {
+    if (!dt.isValid()) return std::string();
+    if (upper ? dt > QDateTime::currentDateTime() : dt <= QDateTime::fromSecsSinceEpoch(0)) return std::string();
+    return dt.toString("yyyyMMddHHmmsszzz").toStdString();
+}
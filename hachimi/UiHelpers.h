@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+class QPushButton;
+class QDateTime;
+
+// 管理端与用户端窗口共用的界面辅助函数
+
+// 异步请求进行中的加载提示：禁用按钮并显示“加载中...”，完成后恢复原文字
+void setButtonLoading(QPushButton* btn, bool loading);
+
+// 筛选控件的时间转为订单号中的时间戳格式；起始为纪元、结束晚于当前时间（控件默认值）时视为不限
+std::string orderFilterTime(const QDateTime& dt, bool upper);
@@ -20,55 +20,16 @@
 #include <QDateTimeEdit> // 新增：日期时间筛选控件
 #include <unordered_set>
 #include "Theme.h"
+#include "UiHelpers.h"
 #include <QStringList> // 添加所需头（用于 QStringList）
-// 统一解析订单ID到 QDateTime（兼容 c*/o*，多种编码）
-static QDateTime parseOrderIdToDateTime(const QString& oid) {
-    QString s = oid.trimmed();
-    if (s.isEmpty()) return QDateTime();
-    if (!s.isEmpty() && s.at(0).isLetter()) s = s.mid(1);
-    int us = s.indexOf('_');
-    if (us > 0) s = s.left(us);
-    auto isAllDigits = [](const QString& t) {
-        for (QChar c : t) if (!c.isDigit()) return false;
-        return true;
-        };
-    int digits = 0;
-    while (digits < s.size() && s.at(digits).isDigit()) ++digits;
-    QString head = s.left(digits);
-    if (head.size() >= 17 && isAllDigits(head.left(17))) {
-        QDateTime dt = QDateTime::fromString(head.left(17), "yyyyMMddHHmmsszzz");
-        if (dt.isValid()) return dt.toLocalTime();
-    }
-    if (head.size() >= 14 && isAllDigits(head.left(14))) {
-        QDateTime dt = QDateTime::fromString(head.left(14), "yyyyMMddHHmmss");
-        if (dt.isValid()) {
-            int ms = 0;
-            if (head.size() >= 17 && isAllDigits(head.mid(14, 3))) {
-                bool ok = false; int v = head.mid(14, 3).toInt(&ok); if (ok) ms = v;
-            }
-            dt = dt.addMSecs(ms);
-            return dt.toLocalTime();
-        }
-    }
-    if (head.size() >= 13 && isAllDigits(head.left(13))) {
-        bool ok = false; qint64 ms = head.left(13).toLongLong(&ok);
-        if (ok) { QDateTime dt = QDateTime::fromMSecsSinceEpoch(ms); if (dt.isValid()) return dt.toLocalTime(); }
-    }
-    if (head.size() >= 10 && isAllDigits(head.left(10))) {
-        bool ok = false; qint64 sec = head.left(10).toLongLong(&ok);
-        if (ok) { QDateTime dt = QDateTime::fromSecsSinceEpoch(sec); if (dt.isValid()) return dt.toLocalTime(); }
-    }
-    QDateTime iso = QDateTime::fromString(s, Qt::ISODate);
-    if (iso.isValid()) return iso.toLocalTime();
-    return QDateTime();
-}
 static constexpr double kCartOriginalLimit = 10000000.0; // 10,000,000
 static double calcOriginalTotal(const TemporaryCart& cart) {
     double s = 0.0;
     for (const auto& it : cart.items) s += it.price * it.quantity;
     return s;
 }
-static bool checkCartStockAndWarn(Client* client, const TemporaryCart& cart, QWidget* parent);
+static QStringList cartStockIssues(Client& client, const TemporaryCart& cart);
+static void fillCartAddress(Client& client, const std::string& phone, TemporaryCart& cart);
 // 在文件顶部 includes 之后加入与 AdminWindow 相同的状态映射辅助函数（UI 文件内局部）
 static QString orderStatusToText(int status) {
     switch (status) {
@@ -329,8 +290,7 @@ UserWindow::UserWindow(const std::string& phone, Client* client, QWidget* parent
     connect(promoTypeBtn, &QPushButton::clicked, this, &UserWindow::onChoosePromoTypeFilter); // 新增
     connect(applyPromoBtn, &QPushButton::clicked, this, &UserWindow::onApplyPromotion);
     connect(clearPromoBtn, &QPushButton::clicked, this, &UserWindow::onClearPromotion);
-    // 初次加载促销
-    refreshPromotions();
+    // 促销列表随构造末尾的 refreshAllInternal 一并加载
 
     tabWidget->addTab(goodsTab, "商品与购物车");
 
@@ -455,8 +415,7 @@ UserWindow::UserWindow(const std::string& phone, Client* client, QWidget* parent
     cartTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
     // 初始加载 —— 使用不带节流的内部实现，避免构造期间连续调用导致弹窗
-    refreshGoodsInternal();
-    refreshCartInternal();
+    refreshAllInternal();
     refreshOrdersInternal();
 
     // 尝试从客户端加载当前用户信息（若可用）
@@ -664,10 +623,22 @@ void UserWindow::refreshGoods() {
 }
 
 // 内部实现（不做节流），原 refreshGoods 的主体逻辑移至此
+// 商品列表在网络线程拉取，返回后在 UI 线程按当前筛选条件填表
 void UserWindow::refreshGoodsInternal() {
-    goodsTable->setRowCount(0);
     if (!client_) return;
-    auto goods = client_->CLTgetAllGoods();
+    const uint64_t seq = ++goodsRequestSeq_;
+    setButtonLoading(refreshGoodsBtn, true);
+    bool submitted = client_->CLTgetAllGoodsAsync(this, [this, seq](std::vector<Good> goods) {
+        if (seq != goodsRequestSeq_) return; // 已有更新的刷新请求
+        setButtonLoading(refreshGoodsBtn, false);
+        populateGoods(goods);
+    });
+    if (!submitted) setButtonLoading(refreshGoodsBtn, false);
+}
+
+// 按当前筛选条件把商品列表填入表格
+void UserWindow::populateGoods(const std::vector<Good>& goods) {
+    goodsTable->setRowCount(0);
 
     // 读取当前筛选条件（注意：当控件不存在时按默认不过滤）
     std::string nameFilter;
@@ -708,6 +679,36 @@ void UserWindow::refreshGoodsInternal() {
     }
 }
 
+// 商品、购物车与促销合并为一次 BATCH 请求（网络线程执行），返回后在 UI 线程依次填充
+void UserWindow::refreshAllInternal() {
+    if (!client_) return;
+    const uint64_t seq = ++goodsRequestSeq_;
+    const std::string phone = phone_;
+    setButtonLoading(refreshGoodsBtn, true);
+    bool submitted = client_->CLTasync(this,
+        [phone](Client& c) {
+            Client::Batch batch;
+            batch.getAllGoods();
+            batch.getCart(phone);
+            batch.getAllPromotions();
+            Client::BatchResult r = c.CLTbatch(batch);
+            TemporaryCart cart = Client::CLTparseCart(r[1]);
+            fillCartAddress(c, phone, cart);
+            return std::make_pair(std::move(r), std::move(cart));
+        },
+        [this, seq](std::pair<Client::BatchResult, TemporaryCart> res) {
+            Client::BatchResult& r = res.first;
+            if (seq == goodsRequestSeq_) {
+                setButtonLoading(refreshGoodsBtn, false);
+                populateGoods(Client::CLTparseGoods(r[0]));
+            }
+            QString appliedName = QString::fromStdString(res.second.discount_policy).trimmed();
+            populateCart(std::move(res.second));
+            populatePromotions(appliedName, Client::CLTparsePromotionsRaw(r[2]));
+        });
+    if (!submitted) setButtonLoading(refreshGoodsBtn, false);
+}
+
 void UserWindow::onApplyGoodsFilter() {
     if (!tryThrottle(this)) return;
     // 直接刷新商品表格即可读取筛选条件并应用
@@ -852,7 +853,7 @@ void UserWindow::refreshCart() {
     refreshCartInternal();
 }
 
-// 不带节流实现
+// 不带节流实现：购物车与促销列表通过一次 BATCH 请求取回
 void UserWindow::refreshCartInternal() {
     cartTable->setRowCount(0);
     if (!client_) {
@@ -861,30 +862,22 @@ void UserWindow::refreshCartInternal() {
     }
 
     Logger::instance().info(std::string("UserWindow::refreshCart: client connection active? ") + (client_->CLTisConnectionActive() ? "true" : "false"));
-    TemporaryCart cart = client_->CLTgetCartForUser(phone_);
-    Logger::instance().info(std::string("UserWindow::refreshCart: got cart_id=") + cart.cart_id + ", items=" + std::to_string(cart.items.size()));
+    Client::Batch batch;
+    batch.getCart(phone_);
+    batch.getAllPromotions();
+    Client::BatchResult r = client_->CLTbatch(batch);
+    TemporaryCart cart = Client::CLTparseCart(r[0]);
+    fillCartAddress(*client_, phone_, cart);
+    QString appliedName = QString::fromStdString(cart.discount_policy).trimmed();
+    populateCart(std::move(cart));
 
-    // 如果购物车没有收货地址，尝试用手机号在账户列表中查找并填充
-    if (cart.shipping_address.empty()) {
-        try {
-            auto users = client_->CLTgetAllAccounts();
-            for (const auto& u : users) {
-                if (u.getPhone() == phone_) {
-                    cart.shipping_address = u.getAddress();
-                    Logger::instance().info(std::string("UserWindow::refreshCart: filled shipping_address from account: ") + cart.shipping_address);
-                    break;
-                }
-            }
-            // 若找到了地址，保存回服务器（避免下次仍为空）
-            if (!cart.shipping_address.empty()) {
-                if (!client_->CLTisConnectionActive()) client_->CLTreconnect();
-                bool saved = client_->CLTsaveCartForUserWithPolicy(cart, std::string());
-                Logger::instance().info(std::string("UserWindow::refreshCart: saved cart with filled address returned ") + (saved ? "true" : "false"));
-            }
-        } catch (...) {
-            Logger::instance().warn("UserWindow::refreshCart: failed to auto-fill shipping_address from accounts");
-        }
-    }
+    // 刷新促销列表
+    populatePromotions(appliedName, Client::CLTparsePromotionsRaw(r[1]));
+}
+
+void UserWindow::populateCart(TemporaryCart cart) {
+    cartTable->setRowCount(0);
+    Logger::instance().info(std::string("UserWindow::refreshCart: got cart_id=") + cart.cart_id + ", items=" + std::to_string(cart.items.size()));
 
     cartTable->setRowCount((int)cart.items.size());
     for (int i = 0; i < (int)cart.items.size(); ++i) {
@@ -896,10 +889,30 @@ void UserWindow::refreshCartInternal() {
         cartTable->setItem(i, 3, new QTableWidgetItem(QString::number(it.quantity)));
         cartTable->setItem(i, 4, new QTableWidgetItem(QString::number(it.subtotal)));
     }
+}
 
-    // 刷新促销列表
-    refreshPromotions();
-}// 替换现有 refreshCart()，在 cart.shipping_address 为空时尝试从账号填充并保存
+// 购物车没有收货地址时，用手机号在账户列表中查找并填充，找到后保存回服务器（避免下次仍为空）。
+// 会发出网络请求：异步刷新在网络线程调用，不在 populateCart 中执行
+static void fillCartAddress(Client& client, const std::string& phone, TemporaryCart& cart) {
+    if (!cart.shipping_address.empty()) return;
+    try {
+        auto users = client.CLTgetAllAccounts();
+        for (const auto& u : users) {
+            if (u.getPhone() == phone) {
+                cart.shipping_address = u.getAddress();
+                Logger::instance().info(std::string("UserWindow::refreshCart: filled shipping_address from account: ") + cart.shipping_address);
+                break;
+            }
+        }
+        if (!cart.shipping_address.empty()) {
+            if (!client.CLTisConnectionActive()) client.CLTreconnect();
+            bool saved = client.CLTsaveCartForUserWithPolicy(cart, std::string());
+            Logger::instance().info(std::string("UserWindow::refreshCart: saved cart with filled address returned ") + (saved ? "true" : "false"));
+        }
+    } catch (...) {
+        Logger::instance().warn("UserWindow::refreshCart: failed to auto-fill shipping_address from accounts");
+    }
+}
 
 void UserWindow::onShowOriginalTotal() {
     refreshCartInternal();
@@ -1027,18 +1040,22 @@ void UserWindow::onShowDiscountedTotal() {
 // 从服务器加载促销 JSON 并填充下拉（只读给用户选择）
 // 从服务器加载促销 JSON 并填充下拉（默认选中 id:0 原价占位）
 void UserWindow::refreshPromotions() {
-    promoCombo->clear();
-    if (!client_) return;
-
-    // 读取购物车当前已应用的促销显示名（若有）
-    QString appliedName;
-    try {
-        TemporaryCart cur = client_->CLTgetCartForUser(phone_);
-        appliedName = QString::fromStdString(cur.discount_policy).trimmed();
+    if (!client_) {
+        promoCombo->clear();
+        return;
     }
-    catch (...) {}
 
-    auto raws = client_->CLTgetAllPromotionsRaw();
+    // 购物车（读取当前已应用的促销显示名）与促销列表一次取回
+    Client::Batch batch;
+    batch.getCart(phone_);
+    batch.getAllPromotions();
+    Client::BatchResult r = client_->CLTbatch(batch);
+    QString appliedName = QString::fromStdString(Client::CLTparseCart(r[0]).discount_policy).trimmed();
+    populatePromotions(appliedName, Client::CLTparsePromotionsRaw(r[1]));
+}
+
+void UserWindow::populatePromotions(const QString& appliedName, const std::vector<nlohmann::json>& raws) {
+    promoCombo->clear();
 
     // 第一项占位（说明文案）
     promoCombo->addItem("-- 默认促销：原价(占位，id:0) --", QString());
@@ -1556,28 +1573,11 @@ void UserWindow::onRemoveCartItem() {
         QMessageBox::warning(this, "删除商品", "删除失败（查看日志）");
     }
 }
-// --- 新增：作用域禁止窗口交互的 RAII 辅助类（放在文件顶部的 helper 区域） ---
-struct ScopedDisableWindow {
-    QWidget* w_;
-    explicit ScopedDisableWindow(QWidget* w) : w_(w) {
-        if (w_) {
-            w_->setEnabled(false);
-            Logger::instance().info("ScopedDisableWindow: window disabled");
-        }
-    }
-    ~ScopedDisableWindow() {
-        if (w_) {
-            w_->setEnabled(true);
-            Logger::instance().info("ScopedDisableWindow: window re-enabled");
-        }
-    }
-    ScopedDisableWindow(const ScopedDisableWindow&) = delete;
-    ScopedDisableWindow& operator=(const ScopedDisableWindow&) = delete;
-};
 
 // cart->order
+// 结算：网络请求（取购物车与促销、库存校验、下单并清空购物车）都在客户端网络线程执行，
+// UI 线程只负责对话框与结果展示；整个结算过程中结算按钮显示“加载中...”
 void UserWindow::onCheckout() {
-    refreshCartInternal();
     if (!tryThrottle(this)) return;
     Logger::instance().info("UserWindow::onCheckout called");
     if (!client_) {
@@ -1585,15 +1585,37 @@ void UserWindow::onCheckout() {
         return;
     }
 
-    ScopedDisableWindow guard(this);
-
-    if (!client_->CLTisConnectionActive()) {
-        Logger::instance().warn("UserWindow::onCheckout: client not connected, attempting reconnect");
-        client_->CLTreconnect();
-    }
+    struct CartSnapshot {
+        TemporaryCart cart;
+        std::vector<nlohmann::json> promotions;
+    };
+    const std::string phone = phone_;
+    setButtonLoading(checkoutBtn, true);
+    bool submitted = client_->CLTasync(this,
+        [phone](Client& c) {
+            Client::Batch batch;
+            batch.getCart(phone);
+            batch.getAllPromotions();
+            Client::BatchResult r = c.CLTbatch(batch);
+            CartSnapshot snap;
+            snap.cart = Client::CLTparseCart(r[0]);
+            fillCartAddress(c, phone, snap.cart);
+            snap.promotions = Client::CLTparsePromotionsRaw(r[1]);
+            return snap;
+        },
+        [this](CartSnapshot snap) {
+            // 先用取回的数据刷新购物车与促销显示，再继续结算
+            QString appliedName = QString::fromStdString(snap.cart.discount_policy).trimmed();
+            populateCart(snap.cart);
+            populatePromotions(appliedName, snap.promotions);
+            continueCheckout(std::move(snap.cart));
+        });
+    if (!submitted) setButtonLoading(checkoutBtn, false);
+}
 
-    TemporaryCart cart = client_->CLTgetCartForUser(phone_);
+void UserWindow::continueCheckout(TemporaryCart cart) {
     if (cart.items.empty()) {
+        setButtonLoading(checkoutBtn, false);
         QMessageBox::information(this, "结算", "购物车为空，无法结算");
         return;
     }
@@ -1604,19 +1626,17 @@ void UserWindow::onCheckout() {
         QString addr = QInputDialog::getText(this, "收货地址", "请输入收货地址：", QLineEdit::Normal, "", &okAddr).trimmed();
         if (!okAddr) {
             Logger::instance().info("UserWindow::onCheckout: user cancelled address input");
+            setButtonLoading(checkoutBtn, false);
             return;
         }
         if (addr.isEmpty()) {
+            setButtonLoading(checkoutBtn, false);
             QMessageBox::warning(this, "结算", "收货地址不能为空");
             return;
         }
         cart.shipping_address = addr.toStdString();
-        // 可选：立即保存（忽略失败，不阻断结算）
-        try {
-            if (!client_->CLTisConnectionActive()) client_->CLTreconnect();
-            client_->CLTsaveCartForUserWithPolicy(cart, std::string());
-        }
-        catch (...) {}
+        // 可选：立即保存（忽略失败，不阻断结算）；网络线程按提交顺序执行，先于后续下单
+        client_->CLTsaveCartForUserWithPolicyAsync(this, cart, std::string(), [](bool) {});
     }
 
     TemporaryCart useCart = cart;
@@ -1625,6 +1645,7 @@ void UserWindow::onCheckout() {
     {
         double originalSum = calcOriginalTotal(useCart);
         if (originalSum > kCartOriginalLimit) {
+            setButtonLoading(checkoutBtn, false);
             QMessageBox::warning(this, "结算", "抱歉金额过高无法结算");
             return;
         }
@@ -1637,13 +1658,29 @@ void UserWindow::onCheckout() {
         }
     }
 
-    double payable = (useCart.final_amount > 0.0) ? useCart.final_amount : useCart.total_amount;
-    if (!checkCartStockAndWarn(client_, useCart, this)) return;
+    // 库存校验在网络线程进行，发现不足就提示并阻止继续
+    bool submitted = client_->CLTasync(this,
+        [useCart](Client& c) { return cartStockIssues(c, useCart); },
+        [this, useCart](QStringList issues) {
+            if (!issues.isEmpty()) {
+                setButtonLoading(checkoutBtn, false);
+                QMessageBox::warning(this, "库存不足",
+                                     "以下商品库存不足，已阻止下单：\n" + issues.join("\n") +
+                                     "\n请在购物车调整数量或移除后重试。");
+                return;
+            }
+            submitCheckout(useCart);
+        });
+    if (!submitted) setButtonLoading(checkoutBtn, false);
+}
 
+void UserWindow::submitCheckout(TemporaryCart useCart) {
+    double payable = (useCart.final_amount > 0.0) ? useCart.final_amount : useCart.total_amount;
     QString confirmMsg = QString("确认结算当前购物车？应付金额：%1\n收货地址：%2")
         .arg(payable).arg(QString::fromStdString(useCart.shipping_address));
     if (QMessageBox::question(this, "确认结算", confirmMsg) != QMessageBox::Yes) {
         Logger::instance().info("UserWindow::onCheckout: user cancelled checkout");
+        setButtonLoading(checkoutBtn, false);
         return;
     }
 
@@ -1654,16 +1691,7 @@ void UserWindow::onCheckout() {
     // 按现有 Order 构造从购物车生成订单（默认状态 1）
     Order order(useCart, newOrderId.toStdString(), 1);
 
-    if (!client_->CLTisConnectionActive()) client_->CLTreconnect();
-    bool added = client_->CLTaddSettledOrder(order);
-    Logger::instance().info(std::string("UserWindow::onCheckout: CLTaddSettledOrder returned ") + (added ? "true" : "false"));
-
-    if (!added) {
-        QMessageBox::warning(this, "结算", "下单失败（请查看日志）");
-        return;
-    }
-
-    // 清空购物车并保存
+    // 清空后的购物车
     TemporaryCart cleared = useCart;
     cleared.items.clear();
     cleared.total_amount = 0.0;
@@ -1671,15 +1699,30 @@ void UserWindow::onCheckout() {
     cleared.discount_amount = 0.0;
     cleared.discount_policy.clear();
 
-    bool saved = client_->CLTsaveCartForUserWithPolicy(cleared, std::string());
-    Logger::instance().info(std::string("UserWindow::onCheckout: clear cart saved=") + (saved ? "true" : "false"));
+    // 下单与清空购物车作为一个事务批量请求提交：任一步失败则服务端整体回滚
+    bool submitted = client_->CLTasync(this,
+        [order, cleared](Client& c) {
+            Client::Batch batch(true);
+            batch.addSettledOrder(order);
+            batch.saveCartWithPolicy(cleared, std::string());
+            Client::BatchResult r = c.CLTbatch(batch);
+            Logger::instance().info(std::string("UserWindow::onCheckout: checkout batch ") + (r.ok ? "committed" : "failed: " + r.error));
+            return r.ok;
+        },
+        [this, newOrderId, payable](bool added) {
+            setButtonLoading(checkoutBtn, false);
+            if (!added) {
+                QMessageBox::warning(this, "结算", "下单失败（请查看日志）");
+                return;
+            }
 
-    QMessageBox::information(this, "结算成功", QString("订单已创建：%1\n实付金额：%2").arg(newOrderId).arg(payable, 0, 'f', 2));
+            QMessageBox::information(this, "结算成功", QString("订单已创建：%1\n实付金额：%2").arg(newOrderId).arg(payable, 0, 'f', 2));
 
-    // 刷新购物车与订单
-    refreshGoodsInternal();
-    refreshCartInternal();
-    refreshOrdersInternal();
+            // 刷新商品、购物车与订单
+            refreshAllInternal();
+            refreshOrdersInternal();
+        });
+    if (!submitted) setButtonLoading(checkoutBtn, false);
 }
 
 //
@@ -1691,59 +1734,47 @@ void UserWindow::refreshOrders() {
 }
 
 // 不带节流实现
+// 订单在网络线程逐页拉取，返回后在 UI 线程填表
 void UserWindow::refreshOrdersInternal() {
     if (!client_) return;
-    orderTable->setRowCount(0);
-
-    // 拉取当前用户的订单（server 支持按 userPhone 查询）
-    auto orders = client_->CLTgetAllOrders(phone_);
 
-    // 时间范围
-    QDateTime start = orderStartEdit ? orderStartEdit->dateTime() : QDateTime::fromSecsSinceEpoch(0);
-    QDateTime end = orderEndEdit ? orderEndEdit->dateTime() : QDateTime::currentDateTime().addYears(10);
-
-    int selStatus = -1;
+    // 状态与时间范围由服务端筛选（QUERY_ORDERS）；单个用户的订单有限，逐页取完
+    Client::OrderFilter filter;
+    filter.userPhone = phone_;
     if (orderStatusFilter) {
         QVariant v = orderStatusFilter->currentData();
-        if (v.isValid()) selStatus = v.toInt();
-    }
-    // 更健壮的 parseOid：支持 "cYYYYMMDDHHmmsszzz_..."，并避免使用已弃用方法
-    auto parseOid = [](const std::string& oidStr) -> QDateTime {
-        QString oid = QString::fromStdString(oidStr).trimmed();
-        if (!oid.startsWith('c')) return QDateTime();
-        if (oid.size() < 18) return QDateTime();
-        QString sub = oid.mid(1, 17); // YYYYMMDDHHmmsszzz
-        QDateTime dt = QDateTime::fromString(sub, "yyyyMMddHHmmsszzz");
-        if (dt.isValid()) { dt = dt.toLocalTime(); return dt; }
-        QString datePart = sub.left(14); // YYYYMMDDHHmmss
-        QString msPart = sub.mid(14, 3); // zzz
-        QDateTime dt2 = QDateTime::fromString(datePart, "yyyyMMddHHmmss");
-        if (!dt2.isValid()) return QDateTime();
-        bool ok = false;
-        int msec = msPart.toInt(&ok);
-        if (!ok) msec = 0;
-        dt2 = dt2.addMSecs(msec);
-        dt2 = dt2.toLocalTime();
-        return dt2;
-    };
-
-    std::vector<Order> filtered;
-    filtered.reserve(orders.size());
-    for (const auto& o : orders) {
-        if (selStatus != -1 && o.getStatus() != selStatus) continue;
-        QDateTime dt = parseOrderIdToDateTime(QString::fromStdString(o.getOrderId()));
-        if (dt.isValid()) {
-            if (dt >= start && dt <= end) filtered.push_back(o);
-        }
-        else {
-            filtered.push_back(o);
-        }
-
-    }
+        if (v.isValid() && v.toInt() != -1) filter.statuses.push_back(v.toInt());
+    }
+    if (orderStartEdit) filter.from = orderFilterTime(orderStartEdit->dateTime(), false);
+    if (orderEndEdit) filter.to = orderFilterTime(orderEndEdit->dateTime(), true);
+
+    const uint64_t seq = ++ordersRequestSeq_;
+    setButtonLoading(refreshOrdersBtn, true);
+    bool submitted = client_->CLTasync(this,
+        [filter](Client& c) {
+            std::vector<Order> orders;
+            std::string after;
+            while (true) {
+                Client::OrdersPage page = c.CLTqueryOrders(filter, after, 500);
+                orders.insert(orders.end(), page.items.begin(), page.items.end());
+                if (!page.hasMore || page.nextAfter.empty()) break;
+                after = page.nextAfter;
+            }
+            return orders;
+        },
+        [this, seq](std::vector<Order> orders) {
+            if (seq != ordersRequestSeq_) return; // 已有更新的刷新请求
+            setButtonLoading(refreshOrdersBtn, false);
+            populateOrders(orders);
+        });
+    if (!submitted) setButtonLoading(refreshOrdersBtn, false);
+}
 
-    orderTable->setRowCount((int)filtered.size());
-    for (int i = 0; i < (int)filtered.size(); i++) {
-        const Order& o = filtered[i];
+// 把订单列表填入表格
+void UserWindow::populateOrders(const std::vector<Order>& orders) {
+    orderTable->setRowCount((int)orders.size());
+    for (int i = 0; i < (int)orders.size(); i++) {
+        const Order& o = orders[i];
         QTableWidgetItem* idItem = new QTableWidgetItem(QString::fromStdString(o.getOrderId()));
         idItem->setData(Qt::UserRole, QString::fromStdString(o.getUserPhone()));
         orderTable->setItem(i, 0, idItem);
@@ -1840,25 +1871,25 @@ void UserWindow::onClearOrdersFilter() {
     refreshOrdersInternal();
 }
 
-// 结算/提交前检查购物车库存，发现不足就提示并阻止继续
-static bool checkCartStockAndWarn(Client* client, const TemporaryCart& cart, QWidget* parent) {
+// 结算前检查购物车库存（网络线程调用），返回库存不足的商品说明；为空表示可以下单
+static QStringList cartStockIssues(Client& client, const TemporaryCart& cart) {
+    // 所有商品的库存一次 BATCH 取回
+    Client::Batch batch;
+    for (const auto& it : cart.items) batch.getGoodById(it.good_id);
+    Client::BatchResult r = client.CLTbatch(batch);
+
     QStringList issues;
-    for (const auto& it : cart.items) {
+    for (size_t i = 0; i < cart.items.size(); ++i) {
+        const CartItem& it = cart.items[i];
         Good g;
-        if (!client->CLTgetGoodById(it.good_id, g)) continue; // 获取失败则跳过校验
+        if (!Client::CLTparseGood(r[i], g)) continue; // 获取失败则跳过校验
         if (g.getStock() < it.quantity) {
             issues << QString("%1(id:%2): 当前库存 %3，已选择 %4")
                       .arg(QString::fromStdString(it.good_name))
                       .arg(it.good_id).arg(g.getStock()).arg(it.quantity);
         }
     }
-    if (!issues.isEmpty()) {
-        QMessageBox::warning(parent, "库存不足",
-                             "以下商品库存不足，已阻止下单：\n" + issues.join("\n") +
-                             "\n请在购物车调整数量或移除后重试。");
-        return false;
-    }
-    return true;
+    return issues;
 }
 
 // 新增槽函数实现
@@ -137,4 +137,21 @@ private:
     void refreshGoodsInternal();
     void refreshCartInternal();
     void refreshOrdersInternal();
+    // 商品、购物车、促销合并为一次批量请求刷新（初始加载与结算后使用）
+    void refreshAllInternal();
+
+    // 用已取回的数据填充界面
+    void populateGoods(const std::vector<Good>& goods);
+    void populateCart(TemporaryCart cart);
+    void populatePromotions(const QString& appliedName, const std::vector<nlohmann::json>& raws);
+    void populateOrders(const std::vector<Order>& orders);
+
+    // 结算第二步（拿到购物车后在 UI 线程继续）
+    void continueCheckout(TemporaryCart cart);
+    // 结算第三步（库存校验通过后确认并提交订单）
+    void submitCheckout(TemporaryCart cart);
+    // 商品刷新序号：只应用最后一次发起的刷新结果
+    uint64_t goodsRequestSeq_ = 0;
+    // 订单刷新序号：同上
+    uint64_t ordersRequestSeq_ = 0;
 };
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Client/Server 线路协议
+//
+// 帧格式（Framed 模式）：
+//   [4 字节大端头][payload]
+//   头的高 8 位为标志位，低 24 位为 payload 长度。
+//   因此单帧最大 16MB。请求只会带 FlagCorrelated，请求帧首字节只可能是 0x00 或 0x01，
+//   而旧版文本协议的请求以命令名或空白（\t \n \r）开头，服务端据此按连接自动识别。
+//
+// 标志位：
+//   0x01 FlagCorrelated：payload 以 4 字节大端请求 id 开头，其后才是请求正文；
+//        服务端对该请求的响应同样置位并带回相同 id。客户端据此在一条连接上同时发出多个请求，
+//        按 id 匹配响应（启用工作线程时响应可能乱序到达）。未置位的请求按连接串行、按序响应。
+//   0x02 FlagCbor / 0x04 FlagMsgPack：仅用于响应，payload（请求 id 之后）为 CBOR / MessagePack 编码的 JSON 值。
+//        连接默认使用文本 JSON；客户端发送 "SET_ENCODING cbor|msgpack|json" 切换此后的响应编码，
+//        握手本身的响应仍按切换前的编码返回。非 JSON 的响应始终以文本返回（不置位）。
+//   0x08 FlagCompressed：仅用于响应，payload（请求 id 之后）为 qCompress 格式（4 字节大端原始长度 + zlib 流），
+//        解压后再按 FlagCbor/FlagMsgPack 解码。客户端发送 "SET_COMPRESSION zlib [最小字节数]" 后，
+//        此后不小于阈值（默认 8KB）且压缩后更小的响应才会压缩；"SET_COMPRESSION none" 关闭。
+//
+// 响应编码（每个连接独立协商，只对 Framed 连接有效）
+enum class WireEncoding {
+    Json,        // 文本 JSON（默认，便于调试）
+    Cbor,
+    MessagePack
+};
+
+// Legacy 模式：旧版无帧文本协议（请求以 '\n' 结尾，一次 readAll 视为一个请求）。
+enum class WireMode {
+    Auto,    // 仅服务端使用：按每个连接的首字节自动判断
+    Legacy,  // 旧版无帧文本
+    Framed   // 长度前缀帧
+};
+
+class WireFrame {
+public:
+    static constexpr size_t HeaderSize = 4;
+    static constexpr uint32_t MaxPayload = 0x00FFFFFFu;
+    static constexpr uint32_t LengthMask = 0x00FFFFFFu;
+
+    static constexpr uint8_t FlagCorrelated = 0x01;
+    static constexpr uint8_t FlagCbor = 0x02;
+    static constexpr uint8_t FlagMsgPack = 0x04;
+    static constexpr uint8_t EncodingFlags = FlagCbor | FlagMsgPack;
+    static constexpr uint8_t FlagCompressed = 0x08;
+    static constexpr uint8_t RequestFlags = FlagCorrelated;                                  // 请求帧可带的标志位
+    static constexpr uint8_t ResponseFlags = FlagCorrelated | EncodingFlags | FlagCompressed; // 响应帧可带的标志位
+    static constexpr size_t DefaultCompressMinBytes = 8 * 1024;
+    static constexpr size_t CorrelationIdSize = 4;
+
+    enum class DecodeResult { NeedMore, Ok, Error };
+
+    // 编码名（SET_ENCODING 的参数）与编码、帧标志位之间的转换
+    static const char* encodingName(WireEncoding e) {
+        return e == WireEncoding::Cbor ? "cbor" : e == WireEncoding::MessagePack ? "msgpack" : "json";
+    }
+    static bool parseEncoding(const std::string& name, WireEncoding& out) {
+        if (name == "json") out = WireEncoding::Json;
+        else if (name == "cbor") out = WireEncoding::Cbor;
+        else if (name == "msgpack" || name == "messagepack") out = WireEncoding::MessagePack;
+        else return false;
+        return true;
+    }
+    static uint8_t encodingFlag(WireEncoding e) {
+        return e == WireEncoding::Cbor ? FlagCbor : e == WireEncoding::MessagePack ? FlagMsgPack : 0;
+    }
+
+    // 判断连接上收到的首字节是否为请求帧头（用于 Auto 模式）：只认请求可带的标志位，
+    // 以换行、制表符等空白开头的旧版文本请求仍判为 Legacy
+    static bool looksFramed(unsigned char firstByte) { return (firstByte & ~RequestFlags) == 0; }
+
+    // 标志位是否只含 allowed 中的位，且 CBOR/MessagePack 不同时置位
+    static bool validFlags(uint8_t flags, uint8_t allowed) {
+        return (flags & ~allowed) == 0 && (flags & EncodingFlags) != EncodingFlags;
+    }
+
+    // 写出帧头（不含 payload），payload 过大时返回 false
+    static bool writeHeader(std::string& out, size_t payloadLen, uint8_t flags = 0) {
+        if (payloadLen > MaxPayload) return false;
+        uint32_t h = (static_cast<uint32_t>(flags) << 24) | static_cast<uint32_t>(payloadLen);
+        out.push_back(static_cast<char>((h >> 24) & 0xFF));
+        out.push_back(static_cast<char>((h >> 16) & 0xFF));
+        out.push_back(static_cast<char>((h >> 8) & 0xFF));
+        out.push_back(static_cast<char>(h & 0xFF));
+        return true;
+    }
+
+    // 写出带请求 id 的帧头（置 FlagCorrelated，其后紧跟 4 字节 id），payloadLen 不含 id；过大时返回 false
+    static bool writeCorrelatedHeader(std::string& out, uint32_t id, size_t payloadLen, uint8_t flags = 0) {
+        if (!writeHeader(out, CorrelationIdSize + payloadLen, flags | FlagCorrelated)) return false;
+        out.push_back(static_cast<char>((id >> 24) & 0xFF));
+        out.push_back(static_cast<char>((id >> 16) & 0xFF));
+        out.push_back(static_cast<char>((id >> 8) & 0xFF));
+        out.push_back(static_cast<char>(id & 0xFF));
+        return true;
+    }
+
+    // 编码完整帧；payload 超过上限时返回空串
+    static std::string encode(const std::string& payload, uint8_t flags = 0) {
+        std::string out;
+        out.reserve(HeaderSize + payload.size());
+        if (!writeHeader(out, payload.size(), flags)) return std::string();
+        out.append(payload);
+        return out;
+    }
+
+    // 编码带请求 id 的帧（置 FlagCorrelated）；payload 超过上限时返回空串
+    static std::string encodeCorrelated(uint32_t id, const std::string& payload, uint8_t flags = 0) {
+        std::string out;
+        out.reserve(HeaderSize + CorrelationIdSize + payload.size());
+        if (!writeCorrelatedHeader(out, id, payload.size(), flags)) return std::string();
+        out.append(payload);
+        return out;
+    }
+
+    // 从 FlagCorrelated 帧的 payload 中取出请求 id 并将其移除；payload 不足 4 字节时返回 false
+    static bool takeCorrelationId(std::string& payload, uint32_t& id) {
+        if (payload.size() < CorrelationIdSize) return false;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(payload.data());
+        id = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+           | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+        payload.erase(0, CorrelationIdSize);
+        return true;
+    }
+
+    // 从 buf[offset] 起尝试切出一个完整帧。
+    // Ok：outPayload/outFlags 被填充，offset 前移到下一帧起点；
+    // NeedMore：数据不足，offset 不变；Error：帧头非法（标志位含 allowedFlags 之外的值）。
+    // 服务端解请求帧时传 RequestFlags，客户端解响应帧用默认值
+    static DecodeResult tryDecode(const char* buf, size_t len, size_t& offset,
+                                  std::string& outPayload, uint8_t& outFlags, uint8_t allowedFlags = ResponseFlags) {
+        if (len - offset < HeaderSize) return DecodeResult::NeedMore;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(buf + offset);
+        uint32_t h = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+                   | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+        uint8_t flags = static_cast<uint8_t>(h >> 24);
+        if (!validFlags(flags, allowedFlags)) return DecodeResult::Error;
+        size_t bodyLen = h & LengthMask;
+        if (len - offset - HeaderSize < bodyLen) return DecodeResult::NeedMore;
+        outPayload.assign(buf + offset + HeaderSize, bodyLen);
+        outFlags = flags;
+        offset += HeaderSize + bodyLen;
+        return DecodeResult::Ok;
+    }
+};
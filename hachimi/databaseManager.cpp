@@ -1,57 +1,151 @@
 #include "databaseManager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// 连接池状态（仅池化模式下存在）
+struct DatabaseManager::Pool {
+	struct IdleConn {
+		MYSQL* conn;
+		std::chrono::steady_clock::time_point lastUsed;
+	};
+
+	int capacity = 0;
+	int leaseTimeoutMs = 3000;
+	int pingIntervalMs = 30000;
+	int idleCheckMs = 1000;
+
+	std::mutex mtx;
+	std::condition_variable available;   // 有连接归还
+	std::condition_variable maintainCv;  // 唤醒后台维护线程
+	std::vector<IdleConn> idle;          // 空闲连接（后进先出，优先复用最近用过的）
+	int inUse = 0;
+	int broken = 0;                      // 已关闭、等待后台重连的槽位
+	bool started = false;
+	bool stopping = false;
+	std::thread maintainer;
+
+	uint64_t leases = 0;
+	uint64_t waits = 0;
+	uint64_t timeouts = 0;
+	uint64_t reconnects = 0;
+	uint64_t pingFailures = 0;
+	double totalWaitMs = 0.0;
+	double maxWaitMs = 0.0;
+};
+
+// 本线程当前持有的租约（所属 DatabaseManager 与连接）
+static thread_local const DatabaseManager* tlsLeaseOwner = nullptr;
+static thread_local MYSQL* tlsLeaseConn = nullptr;
+
+// 每条 SQL 语句（含预处理语句执行与事务控制）计入 Storage 的按线程操作数与耗时，用于发现 N+1 之类的回归
+using QueryTimer = Storage::QueryScope;
+
+static int countedQuery(MYSQL* c, const char* q) {
+	QueryTimer timer;
+	return mysql_query(c, q);
+}
+
+// 连接已断开的错误码（CR_SERVER_GONE_ERROR / CR_SERVER_LOST，见 errmsg.h）
+static bool isConnectionLost(MYSQL* conn) {
+	unsigned int err = mysql_errno(conn);
+	return err == 2006 || err == 2013;
+}
+
+DatabaseManager::ConnectionLease::ConnectionLease(DatabaseManager* owner) : owner_(owner) {
+	if (!owner_->pool_) {
+		conn_ = owner_->connection_;
+		return;
+	}
+	if (tlsLeaseOwner == owner_) {
+		// 嵌套调用：复用外层租约
+		conn_ = tlsLeaseConn;
+		return;
+	}
+	conn_ = owner_->DTBacquire();
+	if (conn_) {
+		acquired_ = true;
+		prevOwner_ = tlsLeaseOwner;
+		prevConn_ = tlsLeaseConn;
+		tlsLeaseOwner = owner_;
+		tlsLeaseConn = conn_;
+	}
+}
+
+DatabaseManager::ConnectionLease::~ConnectionLease() {
+	if (!acquired_) return;
+	tlsLeaseOwner = prevOwner_;
+	tlsLeaseConn = prevConn_;
+	owner_->DTBrelease(conn_);
+}
+
+MYSQL* DatabaseManager::conn() const {
+	if (!pool_) return connection_;
+	return tlsLeaseOwner == this ? tlsLeaseConn : nullptr;
+}
 
 //basic
 
-bool DatabaseManager::DTBconnect() {
-	std::cout << "DatabaseManager::connect() called." << std::endl;
+MYSQL* DatabaseManager::DTBopenConnection() {
 	// 初始化 MYSQL 结构体
-	connection_ = mysql_init(nullptr);
-	if (!connection_) {
+	MYSQL* c = mysql_init(nullptr);
+	if (!c) {
 		std::cerr << "mysql_init failed!" << std::endl;
-		return false;
+		return nullptr;
 	}
 	// 连接数据库
-	if (!mysql_real_connect(connection_, host_.c_str(), user_.c_str(), password_.c_str(),
+	if (!mysql_real_connect(c, host_.c_str(), user_.c_str(), password_.c_str(),
 		database_.c_str(), port_, nullptr, 0)) {
-		std::cerr << "mysql_real_connect failed: " << mysql_error(connection_) << std::endl;
-		mysql_close(connection_);
-		connection_ = nullptr;
-		return false;
+		std::cerr << "mysql_real_connect failed: " << mysql_error(c) << std::endl;
+		mysql_close(c);
+		return nullptr;
 	}
-	return true;
+	return c;
+}
+bool DatabaseManager::DTBconnect() {
+	std::cout << "DatabaseManager::connect() called." << std::endl;
+	connection_ = DTBopenConnection();
+	return connection_ != nullptr;
 }
 void DatabaseManager::DTBdisconnect() {
 	std::cout << "DatabaseManager::disconnect() called." << std::endl;
+	DTBshutdownPool();
 	if (connection_) {
-		mysql_close(connection_);
+		DTBcloseConnection(connection_);
 		connection_ = nullptr;
 	}
 }
 bool DatabaseManager::DTBexecuteQuery(const std::string& query) {
-	if (!connection_) return false;
-	if (mysql_query(connection_, query.c_str()) == 0) {
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	if (countedQuery(lease.get(), query.c_str()) == 0) {
 		return true;
 	}
 	else {
-		std::cerr << "MySQL query error: " << mysql_error(connection_) << std::endl;
+		std::cerr << "MySQL query error: " << mysql_error(lease.get()) << std::endl;
 		return false;
 	}
 }
 MYSQL_RES* DatabaseManager::DTBexecuteSelect(const std::string& query) {
-	if (!connection_) return nullptr;
+	ConnectionLease lease(this);
+	if (!lease) return nullptr;
+	MYSQL* c = lease.get();
 	// 运行查询
-	if (mysql_query(connection_, query.c_str()) != 0) {
-		std::cerr << "MySQL select query error: " << mysql_error(connection_) << " | Query: " << query << std::endl;
+	if (countedQuery(c, query.c_str()) != 0) {
+		std::cerr << "MySQL select query error: " << mysql_error(c) << " | Query: " << query << std::endl;
 		return nullptr;
 	}
 	// 获取结果集
-	MYSQL_RES* result = mysql_store_result(connection_);
+	MYSQL_RES* result = mysql_store_result(c);
 	if (!result) {
 		// 如果没有字段，说明该语句没有返回结果集（如 INSERT/UPDATE），否则说明是错误
-		if (mysql_field_count(connection_) == 0) {
+		if (mysql_field_count(c) == 0) {
 			return nullptr;
 		} else {
-			std::cerr << "MySQL store result failed: " << mysql_error(connection_) << " (errno: " << mysql_errno(connection_) << ") | Query: " << query << std::endl;
+			std::cerr << "MySQL store result failed: " << mysql_error(c) << " (errno: " << mysql_errno(c) << ") | Query: " << query << std::endl;
 			return nullptr;
 		}
 	}
@@ -59,22 +153,487 @@ MYSQL_RES* DatabaseManager::DTBexecuteSelect(const std::string& query) {
 }
 DatabaseManager::DatabaseManager(const std::string& host, const std::string& user,
 	const std::string& password, const std::string& database, unsigned int port)
-	: host_(host), user_(user), password_(password), database_(database), port_(port), connection_(nullptr) {
+	: connection_(nullptr), host_(host), user_(user), password_(password), database_(database), port_(port) {
 	// 注：原代码强制使用127.0.0.1和3306，这里改为使用传入参数以避免连接到错误实例
 }
 DatabaseManager::~DatabaseManager() {
 	DTBdisconnect();
 }
 bool DatabaseManager::DTBinitialize() {
-	return DTBconnect();
+	if (!pool_) return DTBconnect();
+
+	std::unique_lock<std::mutex> lk(pool_->mtx);
+	if (pool_->started) {
+		// 已启动：重连交给后台线程，这里只唤醒它，不阻塞请求
+		if (pool_->broken > 0) pool_->maintainCv.notify_one();
+		return !pool_->idle.empty() || pool_->inUse > 0;
+	}
+	pool_->started = true;
+	pool_->stopping = false;
+	int capacity = pool_->capacity;
+	lk.unlock();
+
+	std::vector<MYSQL*> opened;
+	for (int i = 0; i < capacity; ++i) {
+		MYSQL* c = DTBopenConnection();
+		if (!c) break; // 首条失败通常意味着数据库不可达，其余交给后台重连
+		opened.push_back(c);
+	}
+
+	lk.lock();
+	auto now = std::chrono::steady_clock::now();
+	for (MYSQL* c : opened) pool_->idle.push_back({ c, now });
+	pool_->broken = capacity - static_cast<int>(opened.size());
+	pool_->maintainer = std::thread([this]() { DTBmaintainPool(); });
+	lk.unlock();
+	pool_->available.notify_all();
+	std::cout << "DatabaseManager pool: opened " << opened.size() << "/" << capacity << " connections." << std::endl;
+	return !opened.empty();
 }
 bool DatabaseManager::DTBisConnected() const {
-	return connection_ != nullptr;
+	if (!pool_) return connection_ != nullptr;
+	std::lock_guard<std::mutex> lk(pool_->mtx);
+	return !pool_->idle.empty() || pool_->inUse > 0;
+}
+
+//pool
+
+void DatabaseManager::DTBsetPoolSize(int size, int leaseTimeoutMs, int pingIntervalMs, int idleCheckMs) {
+	if (size <= 0 || pool_) return;
+	bool wasConnected = connection_ != nullptr;
+	if (connection_) {
+		DTBcloseConnection(connection_);
+		connection_ = nullptr;
+	}
+	pool_.reset(new Pool());
+	pool_->capacity = size;
+	pool_->leaseTimeoutMs = leaseTimeoutMs;
+	pool_->pingIntervalMs = pingIntervalMs > 0 ? pingIntervalMs : 30000;
+	pool_->idleCheckMs = idleCheckMs;
+	if (wasConnected) DTBinitialize();
+}
+
+MYSQL* DatabaseManager::DTBacquire() {
+	Pool& p = *pool_;
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::milliseconds(p.leaseTimeoutMs);
+	std::unique_lock<std::mutex> lk(p.mtx);
+	bool waited = false;
+	for (;;) {
+		// 池中没有任何存活连接时立即失败，不在请求路径上等待重连
+		while (p.idle.empty() && !p.stopping && p.inUse > 0) {
+			waited = true;
+			if (p.available.wait_until(lk, deadline) == std::cv_status::timeout && p.idle.empty()) break;
+		}
+		if (p.idle.empty() || p.stopping) {
+			++p.timeouts;
+			if (p.broken > 0) p.maintainCv.notify_one();
+			return nullptr;
+		}
+
+		Pool::IdleConn ic = p.idle.back();
+		p.idle.pop_back();
+		++p.inUse;
+
+		// 空闲较久的连接先探活，避免把已被服务端断开的连接交给调用方
+		bool needPing = p.idleCheckMs >= 0 &&
+			std::chrono::steady_clock::now() - ic.lastUsed >= std::chrono::milliseconds(p.idleCheckMs);
+		if (needPing) {
+			lk.unlock();
+			bool alive = mysql_ping(ic.conn) == 0;
+			if (!alive) DTBcloseConnection(ic.conn);
+			lk.lock();
+			if (!alive) {
+				--p.inUse;
+				++p.broken;
+				++p.pingFailures;
+				p.maintainCv.notify_one();
+				continue;
+			}
+		}
+
+		double waitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		++p.leases;
+		if (waited) ++p.waits;
+		p.totalWaitMs += waitMs;
+		if (waitMs > p.maxWaitMs) p.maxWaitMs = waitMs;
+		return ic.conn;
+	}
+}
+
+void DatabaseManager::DTBrelease(MYSQL* c) {
+	Pool& p = *pool_;
+	// 使用中发现连接已断开：关闭并交给后台重连，不放回空闲队列
+	bool lost = isConnectionLost(c);
+	if (lost) DTBcloseConnection(c);
+	{
+		std::lock_guard<std::mutex> lk(p.mtx);
+		--p.inUse;
+		if (lost) {
+			++p.broken;
+		} else if (p.stopping) {
+			// 连接池已关闭：直接关闭归还的连接
+			DTBcloseConnection(c);
+			++p.broken;
+		} else {
+			p.idle.push_back({ c, std::chrono::steady_clock::now() });
+		}
+	}
+	if (lost) p.maintainCv.notify_one();
+	else p.available.notify_one();
+}
+
+// 后台维护线程：补齐断开的连接，并周期性探活长时间空闲的连接
+void DatabaseManager::DTBmaintainPool() {
+	Pool& p = *pool_;
+	const auto retryDelay = std::chrono::milliseconds(1000);
+	std::unique_lock<std::mutex> lk(p.mtx);
+	while (!p.stopping) {
+		p.maintainCv.wait_for(lk, std::chrono::milliseconds(p.pingIntervalMs),
+			[&p]() { return p.stopping || p.broken > 0; });
+		if (p.stopping) break;
+
+		// 重连
+		bool reconnectFailed = false;
+		while (p.broken > 0 && !p.stopping) {
+			lk.unlock();
+			MYSQL* c = DTBopenConnection();
+			lk.lock();
+			if (!c) { reconnectFailed = true; break; }
+			if (p.stopping) { DTBcloseConnection(c); break; }
+			--p.broken;
+			++p.reconnects;
+			p.idle.push_back({ c, std::chrono::steady_clock::now() });
+			p.available.notify_one();
+		}
+
+		// 探活：取出空闲超过一个周期的连接（计入 inUse，避免租用方误判池已空）
+		auto now = std::chrono::steady_clock::now();
+		std::vector<MYSQL*> stale;
+		for (size_t i = 0; i < p.idle.size();) {
+			if (now - p.idle[i].lastUsed >= std::chrono::milliseconds(p.pingIntervalMs)) {
+				stale.push_back(p.idle[i].conn);
+				p.idle.erase(p.idle.begin() + i);
+			} else {
+				++i;
+			}
+		}
+		if (!stale.empty()) {
+			p.inUse += static_cast<int>(stale.size());
+			lk.unlock();
+			std::vector<bool> alive(stale.size());
+			for (size_t i = 0; i < stale.size(); ++i) {
+				alive[i] = mysql_ping(stale[i]) == 0;
+				if (!alive[i]) DTBcloseConnection(stale[i]);
+			}
+			lk.lock();
+			p.inUse -= static_cast<int>(stale.size());
+			now = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < stale.size(); ++i) {
+				if (alive[i]) {
+					p.idle.insert(p.idle.begin(), { stale[i], now });
+				} else {
+					++p.broken;
+					++p.pingFailures;
+				}
+			}
+			p.available.notify_all();
+		}
+
+		if (reconnectFailed && !p.stopping) {
+			// 数据库仍不可达，稍后重试
+			p.maintainCv.wait_for(lk, retryDelay, [&p]() { return p.stopping; });
+		}
+	}
+	lk.unlock();
+	mysql_thread_end();
+}
+
+void DatabaseManager::DTBshutdownPool() {
+	if (!pool_) return;
+	std::thread maintainer;
+	{
+		std::lock_guard<std::mutex> lk(pool_->mtx);
+		pool_->stopping = true;
+		maintainer.swap(pool_->maintainer);
+	}
+	pool_->maintainCv.notify_all();
+	pool_->available.notify_all();
+	if (maintainer.joinable()) maintainer.join();
+
+	std::lock_guard<std::mutex> lk(pool_->mtx);
+	for (auto& ic : pool_->idle) DTBcloseConnection(ic.conn);
+	pool_->idle.clear();
+	pool_->broken = pool_->capacity - pool_->inUse;
+	pool_->started = false;
+}
+
+DatabaseManager::PoolStats DatabaseManager::DTBpoolStats() const {
+	PoolStats s;
+	if (!pool_) return s;
+	std::lock_guard<std::mutex> lk(pool_->mtx);
+	s.capacity = pool_->capacity;
+	s.idle = static_cast<int>(pool_->idle.size());
+	s.inUse = pool_->inUse;
+	s.broken = pool_->broken;
+	s.leases = pool_->leases;
+	s.waits = pool_->waits;
+	s.timeouts = pool_->timeouts;
+	s.reconnects = pool_->reconnects;
+	s.pingFailures = pool_->pingFailures;
+	s.totalWaitMs = pool_->totalWaitMs;
+	s.maxWaitMs = pool_->maxWaitMs;
+	return s;
+}
+
+static std::string escapeForSql(MYSQL* conn, const std::string& s) {
+	if (!conn) return s;
+	size_t maxLen = s.size() * 2 + 1;
+	char* buf = new char[maxLen];
+	unsigned long len = mysql_real_escape_string(conn, buf, s.c_str(), static_cast<unsigned long>(s.size()));
+	std::string out(buf, buf + len);
+	delete[] buf;
+	return out;
+}
+
+// LIKE '%s%' 子串匹配的字面值：先转义 LIKE 通配符（默认转义符为反斜杠），再做 SQL 字符串转义
+static std::string likeContains(MYSQL* conn, const std::string& s) {
+	std::string pattern;
+	pattern.reserve(s.size() + 2);
+	for (char c : s) {
+		if (c == '%' || c == '_' || c == '\\') pattern += '\\';
+		pattern += c;
+	}
+	return "'%" + escapeForSql(conn, pattern) + "%'";
+}
+
+// 本线程当前处于事务中的连接（用于嵌套调用时复用外层事务）
+static thread_local MYSQL* tlsTxnConn = nullptr;
+
+// 事务作用域：START TRANSACTION，析构时若未提交则回滚。
+// 若本线程已在同一连接上开启事务，则为嵌套作用域：不重复开启也不提交，由外层统一提交/回滚
+class TxnScope {
+public:
+	explicit TxnScope(MYSQL* c) : c_(c) {
+		if (tlsTxnConn == c_) { nested_ = true; begun_ = true; return; }
+		begun_ = countedQuery(c_, "START TRANSACTION") == 0;
+		if (begun_) tlsTxnConn = c_;
+		else std::cerr << "START TRANSACTION failed: " << mysql_error(c_) << std::endl;
+	}
+	~TxnScope() {
+		if (nested_ || !begun_) return;
+		QueryTimer timer;
+		if (!committed_ && mysql_rollback(c_)) {
+			std::cerr << "ROLLBACK failed: " << mysql_error(c_) << std::endl;
+		}
+		tlsTxnConn = nullptr;
+	}
+	TxnScope(const TxnScope&) = delete;
+	TxnScope& operator=(const TxnScope&) = delete;
+	bool begun() const { return begun_; }
+	bool commit() {
+		if (nested_) return true;
+		QueryTimer timer;
+		committed_ = !mysql_commit(c_);
+		if (!committed_) std::cerr << "COMMIT failed: " << mysql_error(c_) << std::endl;
+		return committed_;
+	}
+private:
+	MYSQL* c_;
+	bool nested_ = false;
+	bool begun_ = false;
+	bool committed_ = false;
+};
+
+DatabaseManager::Transaction::Transaction(DatabaseManager* owner)
+	: lease_(new ConnectionLease(owner)) {
+	if (*lease_) txn_.reset(new TxnScope(lease_->get()));
+}
+
+// 先结束事务（未提交则回滚）再归还连接
+DatabaseManager::Transaction::~Transaction() {
+	txn_.reset();
+	lease_.reset();
+}
+
+bool DatabaseManager::Transaction::active() const {
+	return txn_ && txn_->begun();
+}
+
+bool DatabaseManager::Transaction::commit() {
+	return active() && txn_->commit();
+}
+
+std::unique_ptr<Storage::Transaction> DatabaseManager::DTBbeginTransaction() {
+	return std::unique_ptr<Storage::Transaction>(new Transaction(this));
+}
+
+//prepared statements
+
+// 与 StmtId 一一对应
+static const char* const kStatementSql[] = {
+	"SELECT id, name, price, stock, category FROM good WHERE id=?",
+	"SELECT phone, password, address FROM user WHERE phone=?",
+	"SELECT cart_id, user_phone, shipping_address, discount_policy, total_amount, discount_amount, final_amount, is_converted "
+	"FROM temporarycart WHERE user_phone=? ORDER BY cart_id DESC LIMIT 1",
+	"INSERT INTO orderitem (order_id, good_id, good_name, price, quantity, subtotal) VALUES (?, ?, ?, ?, ?, ?)",
+	"INSERT INTO cartitem (cart_id, good_id, good_name, price, quantity, subtotal) VALUES (?, ?, ?, ?, ?, ?)",
+	"UPDATE good SET stock=? WHERE id=?",
+};
+
+static void bindParamInt(MYSQL_BIND& b, const int& v) {
+	std::memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_LONG;
+	b.buffer = const_cast<int*>(&v);
+}
+static void bindParamDouble(MYSQL_BIND& b, const double& v) {
+	std::memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_DOUBLE;
+	b.buffer = const_cast<double*>(&v);
+}
+static void bindParamString(MYSQL_BIND& b, const std::string& s, unsigned long& len) {
+	std::memset(&b, 0, sizeof(b));
+	len = static_cast<unsigned long>(s.size());
+	b.buffer_type = MYSQL_TYPE_STRING;
+	b.buffer = const_cast<char*>(s.data());
+	b.buffer_length = len;
+	b.length = &len;
+}
+
+// MYSQL_BIND::is_null / error 的指向类型：MySQL 8.0 起为 bool，更早的 MySQL 与 MariaDB Connector/C 为 my_bool（char）
+#if defined(MARIADB_BASE_VERSION) || defined(MARIADB_PACKAGE_VERSION_ID) || MYSQL_VERSION_ID < 80000
+typedef my_bool StmtBool;
+#else
+typedef bool StmtBool;
+#endif
+
+// 结果列缓冲：数值列直接按类型接收；字符串列先读入定长缓冲，超长时再用 mysql_stmt_fetch_column 取完整值
+struct StmtColumn {
+	char buf[256];
+	int i = 0;
+	double d = 0.0;
+	unsigned long length = 0;
+	StmtBool isNull = false;
+	StmtBool error = false;
+};
+static void bindResultInt(MYSQL_BIND& b, StmtColumn& c) {
+	std::memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_LONG;
+	b.buffer = &c.i;
+	b.is_null = &c.isNull;
+	b.error = &c.error;
+}
+static void bindResultDouble(MYSQL_BIND& b, StmtColumn& c) {
+	std::memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_DOUBLE;
+	b.buffer = &c.d;
+	b.is_null = &c.isNull;
+	b.error = &c.error;
+}
+static void bindResultString(MYSQL_BIND& b, StmtColumn& c) {
+	std::memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_STRING;
+	b.buffer = c.buf;
+	b.buffer_length = sizeof(c.buf);
+	b.length = &c.length;
+	b.is_null = &c.isNull;
+	b.error = &c.error;
+}
+static std::string columnString(MYSQL_STMT* stmt, StmtColumn& c, unsigned int index) {
+	if (c.isNull) return std::string();
+	if (c.length <= sizeof(c.buf)) return std::string(c.buf, c.length);
+	std::string out(c.length, '\0');
+	MYSQL_BIND b;
+	std::memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_STRING;
+	b.buffer = &out[0];
+	b.buffer_length = c.length;
+	if (mysql_stmt_fetch_column(stmt, &b, index, 0) != 0) {
+		return std::string(c.buf, sizeof(c.buf));
+	}
+	return out;
+}
+// 取一行：true 表示拿到数据（含可补救的截断），false 表示无数据或出错
+static bool fetchRow(MYSQL_STMT* stmt) {
+	int rc = mysql_stmt_fetch(stmt);
+	if (rc == 0 || rc == MYSQL_DATA_TRUNCATED) return true;
+	if (rc != MYSQL_NO_DATA) {
+		std::cerr << "MySQL stmt fetch error: " << mysql_stmt_error(stmt) << std::endl;
+	}
+	return false;
+}
+
+MYSQL_STMT* DatabaseManager::DTBprepared(StmtId id) {
+	MYSQL* c = conn();
+	if (!c) return nullptr;
+	{
+		std::lock_guard<std::mutex> lk(stmtMutex_);
+		auto& slots = stmtCache_[c];
+		if (slots.empty()) slots.assign(STMT_COUNT, nullptr);
+		if (slots[id]) return slots[id];
+	}
+	// 同一连接同一时刻只被一个线程使用，prepare 期间无需持锁
+	MYSQL_STMT* stmt = mysql_stmt_init(c);
+	if (!stmt) {
+		std::cerr << "mysql_stmt_init failed: " << mysql_error(c) << std::endl;
+		return nullptr;
+	}
+	const char* sql = kStatementSql[id];
+	if (mysql_stmt_prepare(stmt, sql, static_cast<unsigned long>(std::strlen(sql))) != 0) {
+		std::cerr << "mysql_stmt_prepare failed: " << mysql_stmt_error(stmt) << " | Query: " << sql << std::endl;
+		mysql_stmt_close(stmt);
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lk(stmtMutex_);
+	stmtCache_[c][id] = stmt;
+	return stmt;
+}
+void DatabaseManager::DTBdropStatement(StmtId id) {
+	MYSQL* c = conn();
+	if (!c) return;
+	MYSQL_STMT* stmt = nullptr;
+	{
+		std::lock_guard<std::mutex> lk(stmtMutex_);
+		auto it = stmtCache_.find(c);
+		if (it == stmtCache_.end() || it->second.empty()) return;
+		stmt = it->second[id];
+		it->second[id] = nullptr;
+	}
+	if (stmt) mysql_stmt_close(stmt);
+}
+bool DatabaseManager::DTBexecuteStatement(StmtId id, MYSQL_STMT* stmt, MYSQL_BIND* params) {
+	QueryTimer timer;
+	if ((params && mysql_stmt_bind_param(stmt, params)) ||
+		mysql_stmt_execute(stmt) != 0 ||
+		mysql_stmt_store_result(stmt) != 0) {
+		std::cerr << "MySQL stmt error: " << mysql_stmt_error(stmt) << " | Query: " << kStatementSql[id] << std::endl;
+		// 语句可能已失效（如表结构变更、连接重置），丢弃后下次重新 prepare
+		DTBdropStatement(id);
+		return false;
+	}
+	return true;
+}
+void DatabaseManager::DTBcloseConnection(MYSQL* c) {
+	if (!c) return;
+	std::vector<MYSQL_STMT*> stmts;
+	{
+		std::lock_guard<std::mutex> lk(stmtMutex_);
+		auto it = stmtCache_.find(c);
+		if (it != stmtCache_.end()) {
+			stmts.swap(it->second);
+			stmtCache_.erase(it);
+		}
+	}
+	for (MYSQL_STMT* stmt : stmts) {
+		if (stmt) mysql_stmt_close(stmt);
+	}
+	mysql_close(c);
 }
 
 //user
 bool DatabaseManager::DTBaddUser(const User& u) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string checkQuery = "SELECT COUNT(*) FROM user WHERE phone='" + u.getPhone() + "'";
 	MYSQL_RES* result = DTBexecuteSelect(checkQuery);
 	if (!result) return false;
@@ -88,62 +647,73 @@ bool DatabaseManager::DTBaddUser(const User& u) {
 	return DTBsaveUser(u);
 }
 bool DatabaseManager::DTBsaveUser(const User& u) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "INSERT INTO user (phone, password, address) VALUES ('" +
 		u.getPhone() + "', '" + u.getPassword() + "', '" + u.getAddress() + "')";
 	return DTBexecuteQuery(query);
 }
 bool DatabaseManager::DTBupdateUser(const User& u) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	// 统一使用表名 user（project 中其他地方也使用 user）
 	std::string query = "UPDATE user SET password='" + u.getPassword() +
 		"', address='" + u.getAddress() + "' WHERE phone='" + u.getPhone() + "'";
-	if (mysql_query(connection_, query.c_str()) == 0) {
+	if (countedQuery(conn(), query.c_str()) == 0) {
 		// 可选：检查受影响行数，0 表示未找到匹配行
-		my_ulonglong affected = mysql_affected_rows(connection_);
+		my_ulonglong affected = mysql_affected_rows(conn());
 		if (affected == 0) {
 			std::cerr << "DTBupdateUser: 未找到匹配用户 phone=" << u.getPhone() << std::endl;
 			return false;
 		}
 		return true;
 	} else {
-		std::cerr << "MySQL update error: " << mysql_error(connection_) << " | Query: " << query << std::endl;
+		std::cerr << "MySQL update error: " << mysql_error(conn()) << " | Query: " << query << std::endl;
 		return false;
 	}
 }
 bool DatabaseManager::DTBloadUser(const std::string& phone, User& u) {
-	if (!connection_) return false;
-	std::string query = "SELECT phone, password, address FROM user WHERE phone='" + phone + "'";
-	MYSQL_RES* result = DTBexecuteSelect(query);
-	if (!result) return false;
-	MYSQL_ROW row = mysql_fetch_row(result);
-	if (row) {
-		u = User(row[0] ? row[0] : "", row[1] ? row[1] : "", row[2] ? row[2] : "");
-		mysql_free_result(result);
-		return true;
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	MYSQL_STMT* stmt = DTBprepared(STMT_LOAD_USER);
+	if (!stmt) return false;
+	MYSQL_BIND param[1];
+	unsigned long phoneLen = 0;
+	bindParamString(param[0], phone, phoneLen);
+	if (!DTBexecuteStatement(STMT_LOAD_USER, stmt, param)) return false;
+
+	StmtColumn col[3];
+	MYSQL_BIND res[3];
+	for (int i = 0; i < 3; ++i) bindResultString(res[i], col[i]);
+	bool found = false;
+	if (!mysql_stmt_bind_result(stmt, res) && fetchRow(stmt)) {
+		u = User(columnString(stmt, col[0], 0), columnString(stmt, col[1], 1), columnString(stmt, col[2], 2));
+		found = true;
 	}
-	mysql_free_result(result);
-	return false;
+	mysql_stmt_free_result(stmt);
+	return found;
 }
 bool DatabaseManager::DTBdeleteUser(const std::string& phone) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	// 统一使用表名 user
 	std::string query = "DELETE FROM user WHERE phone='" + phone + "'";
-	if (mysql_query(connection_, query.c_str()) == 0) {
-		my_ulonglong affected = mysql_affected_rows(connection_);
+	if (countedQuery(conn(), query.c_str()) == 0) {
+		my_ulonglong affected = mysql_affected_rows(conn());
 		if (affected == 0) {
 			std::cerr << "DTBdeleteUser: 未找到匹配用户 phone=" << phone << std::endl;
 			return false;
 		}
 		return true;
 	} else {
-		std::cerr << "MySQL delete error: " << mysql_error(connection_) << " | Query: " << query << std::endl;
+		std::cerr << "MySQL delete error: " << mysql_error(conn()) << " | Query: " << query << std::endl;
 		return false;
 	}
 }
 std::vector<User> DatabaseManager::DTBloadAllUsers() {
 	std::vector<User> users;
-	if (!connection_) return users;
+	ConnectionLease lease(this);
+	if (!lease) return users;
 	std::string query = "SELECT phone, password, address FROM user";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return users;
@@ -154,17 +724,58 @@ std::vector<User> DatabaseManager::DTBloadAllUsers() {
 	mysql_free_result(result);
 	return users;
 }
+// 键集分页：WHERE 主键 >/< 游标 ORDER BY 主键 LIMIT n，走主键索引，代价与表大小无关
+std::vector<User> DatabaseManager::DTBloadUsersPage(const std::string& afterPhone, int limit, bool descending) {
+	std::vector<User> users;
+	if (limit <= 0) return users;
+	ConnectionLease lease(this);
+	if (!lease) return users;
+	std::string query = "SELECT phone, password, address FROM user";
+	if (!afterPhone.empty()) query += std::string(" WHERE phone") + (descending ? " < '" : " > '") + escapeForSql(lease.get(), afterPhone) + "'";
+	query += std::string(" ORDER BY phone") + (descending ? " DESC" : "") + " LIMIT " + std::to_string(limit);
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return users;
+	users.reserve(static_cast<size_t>(mysql_num_rows(result)));
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		users.emplace_back(row[0] ? row[0] : "", row[1] ? row[1] : "", row[2] ? row[2] : "");
+	}
+	mysql_free_result(result);
+	return users;
+}
+std::vector<User> DatabaseManager::DTBqueryUsers(const std::string& phone, const std::string& afterPhone, int limit, bool descending) {
+	std::vector<User> users;
+	if (limit <= 0) return users;
+	ConnectionLease lease(this);
+	if (!lease) return users;
+	std::string query = "SELECT phone, password, address FROM user WHERE phone LIKE " + likeContains(lease.get(), phone);
+	if (!afterPhone.empty()) query += std::string(" AND phone") + (descending ? " < '" : " > '") + escapeForSql(lease.get(), afterPhone) + "'";
+	query += std::string(" ORDER BY phone") + (descending ? " DESC" : "") + " LIMIT " + std::to_string(limit);
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return users;
+	users.reserve(static_cast<size_t>(mysql_num_rows(result)));
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		users.emplace_back(row[0] ? row[0] : "", row[1] ? row[1] : "", row[2] ? row[2] : "");
+	}
+	mysql_free_result(result);
+	return users;
+}
 
 //good
 
-bool DatabaseManager::DTBsaveGood(const Good& g) {
-	if (!connection_) return false;
+bool DatabaseManager::DTBsaveGood(const Good& g, int* newId) {
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "INSERT INTO good (name, price, stock, category) VALUES ('" +
 		g.name + "', " + std::to_string(g.price) + ", " + std::to_string(g.stock) + ", '" + g.category + "')";
-	return DTBexecuteQuery(query);
+	if (!DTBexecuteQuery(query)) return false;
+	if (newId) *newId = static_cast<int>(mysql_insert_id(lease.get()));
+	return true;
 }
 bool DatabaseManager::DTBupdateGood(const Good& g) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "UPDATE good SET name='" + g.name +
 		"', price=" + std::to_string(g.price) +
 		", stock=" + std::to_string(g.stock) +
@@ -173,46 +784,59 @@ bool DatabaseManager::DTBupdateGood(const Good& g) {
 	return DTBexecuteQuery(query);
 }
 bool DatabaseManager::DTBloadGood(int id, Good& g) {
-	if (!connection_) return false;
-	std::string query = "SELECT id, name, price, stock, category FROM good WHERE id=" + std::to_string(id);
-	MYSQL_RES* result = DTBexecuteSelect(query);
-	if (!result) return false;
-	MYSQL_ROW row = mysql_fetch_row(result);
-	if (row) {
-		g = Good(std::stoi(row[0] ? row[0] : "0"),
-			row[1] ? row[1] : "",
-			row[2] ? std::stod(row[2]) : 0.0,
-			row[3] ? std::stoi(row[3]) : 0,
-			row[4] ? row[4] : "");
-		mysql_free_result(result);
-		return true;
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	MYSQL_STMT* stmt = DTBprepared(STMT_LOAD_GOOD);
+	if (!stmt) return false;
+	MYSQL_BIND param[1];
+	bindParamInt(param[0], id);
+	if (!DTBexecuteStatement(STMT_LOAD_GOOD, stmt, param)) return false;
+
+	StmtColumn col[5];
+	MYSQL_BIND res[5];
+	bindResultInt(res[0], col[0]);
+	bindResultString(res[1], col[1]);
+	bindResultDouble(res[2], col[2]);
+	bindResultInt(res[3], col[3]);
+	bindResultString(res[4], col[4]);
+	bool found = false;
+	if (!mysql_stmt_bind_result(stmt, res) && fetchRow(stmt)) {
+		g.id = col[0].isNull ? 0 : col[0].i;
+		g.name = columnString(stmt, col[1], 1);
+		g.price = col[2].isNull ? 0.0 : col[2].d;
+		g.stock = col[3].isNull ? 0 : col[3].i;
+		g.category = columnString(stmt, col[4], 4);
+		found = true;
 	}
-	mysql_free_result(result);
-	return false;
+	mysql_stmt_free_result(stmt);
+	return found;
 }
 bool DatabaseManager::DTBdeleteGood(int id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "DELETE FROM good WHERE id=" + std::to_string(id);
 	return DTBexecuteQuery(query);
 }
-std::vector<Good> DatabaseManager::DTBloadAllGoods() {
+std::vector<Good> DatabaseManager::DTBloadAllGoods(bool* ok) {
 	std::vector<Good> goods;
-	if (!connection_) return goods;
+	if (ok) *ok = false;
+	ConnectionLease lease(this);
+	if (!lease) return goods;
 
 	std::string query = "SELECT id, name, price, stock, category FROM good";
 	// 调试性日志：显示 connection 指针与将要执行的查询
 	std::cout << "DTBloadAllGoods: this=" << static_cast<void*>(this)
-	          << " connection_=" << static_cast<void*>(connection_)
+	          << " connection_=" << static_cast<void*>(conn())
 	          << " Query=\"" << query << "\"" << std::endl;
 
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) {
 		// 如果 DTBexecuteSelect 返回 nullptr，额外输出当前数据库名与错误信息以便排查
 		std::cout << "DTBloadAllGoods: DTBexecuteSelect 返回 nullptr。";
-		if (connection_) {
+		if (conn()) {
 			// 获取当前默认数据库名，便于确认是否连接到期望的 schema
-			if (mysql_query(connection_, "SELECT DATABASE()") == 0) {
-				MYSQL_RES* dbRes = mysql_store_result(connection_);
+			if (countedQuery(conn(), "SELECT DATABASE()") == 0) {
+				MYSQL_RES* dbRes = mysql_store_result(conn());
 				if (dbRes) {
 					MYSQL_ROW dbRow = mysql_fetch_row(dbRes);
 					if (dbRow && dbRow[0]) {
@@ -221,7 +845,7 @@ std::vector<Good> DatabaseManager::DTBloadAllGoods() {
 					mysql_free_result(dbRes);
 				}
 			}
-			std::cerr << " MySQL error: " << mysql_error(connection_) << std::endl;
+			std::cerr << " MySQL error: " << mysql_error(conn()) << std::endl;
 		} else {
 			std::cout << " connection_ is nullptr." << std::endl;
 		}
@@ -231,6 +855,7 @@ std::vector<Good> DatabaseManager::DTBloadAllGoods() {
 	// 输出结果行数，帮助判定表是否为空
 	my_ulonglong rows = mysql_num_rows(result);
 	std::cout << "DTBloadAllGoods: mysql_num_rows = " << rows << std::endl;
+	if (ok) *ok = true;
 
 	MYSQL_ROW row;
 	while ((row = mysql_fetch_row(result))) {
@@ -243,9 +868,61 @@ std::vector<Good> DatabaseManager::DTBloadAllGoods() {
 	mysql_free_result(result);
 	return goods;
 }
+std::vector<Good> DatabaseManager::DTBloadGoodsPage(int afterId, int limit, bool descending) {
+	std::vector<Good> goods;
+	if (limit <= 0) return goods;
+	ConnectionLease lease(this);
+	if (!lease) return goods;
+	std::string query = "SELECT id, name, price, stock, category FROM good";
+	if (afterId > 0) query += std::string(" WHERE id") + (descending ? " < " : " > ") + std::to_string(afterId);
+	query += std::string(" ORDER BY id") + (descending ? " DESC" : "") + " LIMIT " + std::to_string(limit);
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return goods;
+	goods.reserve(static_cast<size_t>(mysql_num_rows(result)));
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		goods.emplace_back(std::stoi(row[0] ? row[0] : "0"),
+			row[1] ? row[1] : "",
+			row[2] ? std::stod(row[2]) : 0.0,
+			row[3] ? std::stoi(row[3]) : 0,
+			row[4] ? row[4] : "");
+	}
+	mysql_free_result(result);
+	return goods;
+}
+// 按主键顺序扫描并过滤，取满 limit 行即停；筛选条件无法走索引，但每页只扫描到凑满一页为止
+std::vector<Good> DatabaseManager::DTBqueryGoods(const GoodsQuery& q, int afterId, int limit, bool descending) {
+	std::vector<Good> goods;
+	if (limit <= 0) return goods;
+	ConnectionLease lease(this);
+	if (!lease) return goods;
+	std::vector<std::string> conds;
+	if (!q.name.empty()) conds.push_back("name LIKE " + likeContains(lease.get(), q.name));
+	if (!q.category.empty()) conds.push_back("category LIKE " + likeContains(lease.get(), q.category));
+	if (q.minPrice > 0.0) conds.push_back("price >= " + std::to_string(q.minPrice));
+	if (q.maxPrice >= 0.0) conds.push_back("price <= " + std::to_string(q.maxPrice));
+	if (afterId > 0) conds.push_back(std::string("id") + (descending ? " < " : " > ") + std::to_string(afterId));
+	std::string query = "SELECT id, name, price, stock, category FROM good";
+	for (size_t i = 0; i < conds.size(); ++i) query += (i ? " AND " : " WHERE ") + conds[i];
+	query += std::string(" ORDER BY id") + (descending ? " DESC" : "") + " LIMIT " + std::to_string(limit);
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return goods;
+	goods.reserve(static_cast<size_t>(mysql_num_rows(result)));
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		goods.emplace_back(std::stoi(row[0] ? row[0] : "0"),
+			row[1] ? row[1] : "",
+			row[2] ? std::stod(row[2]) : 0.0,
+			row[3] ? std::stoi(row[3]) : 0,
+			row[4] ? row[4] : "");
+	}
+	mysql_free_result(result);
+	return goods;
+}
 std::vector<Good> DatabaseManager::DTBloadGoodsByCategory(const std::string& category) {
 	std::vector<Good> goods;
-	if (!connection_) return goods;
+	ConnectionLease lease(this);
+	if (!lease) return goods;
 	std::string query = "SELECT id, name, price, stock, category FROM good WHERE category='" + category + "'";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return goods;
@@ -261,32 +938,144 @@ std::vector<Good> DatabaseManager::DTBloadGoodsByCategory(const std::string& cat
 	return goods;
 }
 bool DatabaseManager::DTBupdateGoodStock(int good_id, int new_stock) {
-	if (!connection_) return false;
-	std::string query = "UPDATE good SET stock=" + std::to_string(new_stock) +
-		" WHERE id=" + std::to_string(good_id);
-	return DTBexecuteQuery(query);
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	MYSQL_STMT* stmt = DTBprepared(STMT_UPDATE_GOOD_STOCK);
+	if (!stmt) return false;
+	MYSQL_BIND param[2];
+	bindParamInt(param[0], new_stock);
+	bindParamInt(param[1], good_id);
+	return DTBexecuteStatement(STMT_UPDATE_GOOD_STOCK, stmt, param);
 }
 
 //order
 
-bool DatabaseManager::DTBsaveOrder(const Order& o) {
-	if (!connection_) return false;
+// 写入订单头与全部订单项：订单项合并为一条多行 INSERT。调用方负责事务
+bool DatabaseManager::DTBinsertOrderRows(MYSQL* c, const Order& o) {
 	std::string query = "INSERT INTO `order` (order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy) VALUES ('" +
-		o.getOrderId() + "', '" + o.getUserPhone() + "', " + std::to_string(o.getTotalAmount()) +
+		escapeForSql(c, o.getOrderId()) + "', '" + escapeForSql(c, o.getUserPhone()) + "', " + std::to_string(o.getTotalAmount()) +
 		", " + std::to_string(o.getDiscountAmount()) + ", " + std::to_string(o.getFinalAmount()) +
-		", " + std::to_string(o.getStatus()) + ", '" + o.getShippingAddress() +
-		"', '" + o.getDiscountPolicy() + "')";
-	if (!DTBexecuteQuery(query)) return false;
-	for (const auto& item : o.getItems()) {
-		if (!DTBsaveOrderItem(item)) {
-			std::cerr << "Failed to save order item for order " << o.getOrderId() << std::endl;
-			return false;
-		}
+		", " + std::to_string(o.getStatus()) + ", '" + escapeForSql(c, o.getShippingAddress()) +
+		"', '" + escapeForSql(c, o.getDiscountPolicy()) + "')";
+	if (countedQuery(c, query.c_str()) != 0) {
+		std::cerr << "MySQL insert order error: " << mysql_error(c) << " | Query: " << query << std::endl;
+		return false;
+	}
+	return DTBinsertOrderItemRows(c, o.getOrderId(), o.getItems());
+}
+bool DatabaseManager::DTBinsertOrderItemRows(MYSQL* c, const std::string& order_id, const std::vector<OrderItem>& items) {
+	if (items.empty()) return true;
+	std::string escOrderId = escapeForSql(c, order_id);
+	std::string query = "INSERT INTO orderitem (order_id, good_id, good_name, price, quantity, subtotal) VALUES ";
+	for (size_t i = 0; i < items.size(); ++i) {
+		const OrderItem& item = items[i];
+		if (i > 0) query += ", ";
+		query += "('" + escOrderId + "', " +
+			std::to_string(item.getGoodId()) + ", '" +
+			escapeForSql(c, item.getGoodName()) + "', " +
+			std::to_string(item.getPrice()) + ", " +
+			std::to_string(item.getQuantity()) + ", " +
+			std::to_string(item.getSubtotal()) + ")";
+	}
+	if (countedQuery(c, query.c_str()) != 0) {
+		std::cerr << "MySQL insert orderitem error: " << mysql_error(c) << " | order_id=" << order_id << std::endl;
+		return false;
 	}
 	return true;
 }
+bool DatabaseManager::DTBsaveOrder(const Order& o) {
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	TxnScope txn(lease.get());
+	if (!txn.begun()) return false;
+	if (!DTBinsertOrderRows(lease.get(), o)) {
+		std::cerr << "Failed to save order " << o.getOrderId() << ", rolled back" << std::endl;
+		return false;
+	}
+	return txn.commit();
+}
+DatabaseManager::OrderSaveResult DatabaseManager::DTBsaveOrderWithStock(const Order& o) {
+	OrderSaveResult r;
+	ConnectionLease lease(this);
+	if (!lease) return r;
+	MYSQL* c = lease.get();
+
+	// 合并同一商品的购买数量
+	std::map<int, int> wanted;
+	for (const auto& item : o.getItems()) wanted[item.getGoodId()] += item.getQuantity();
+
+	TxnScope txn(c);
+	if (!txn.begun()) return r;
+
+	std::string idList;
+	for (const auto& kv : wanted) {
+		if (!idList.empty()) idList += ",";
+		idList += std::to_string(kv.first);
+	}
+
+	if (!wanted.empty()) {
+		// 锁定涉及的商品行并校验库存，避免并发下单超卖
+		std::string lockQuery = "SELECT id, stock FROM good WHERE id IN (" + idList + ") FOR UPDATE";
+		MYSQL_RES* res = DTBexecuteSelect(lockQuery);
+		if (!res) return r;
+		std::map<int, int> stock;
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(res))) {
+			if (row[0]) stock[std::stoi(row[0])] = row[1] ? std::stoi(row[1]) : 0;
+		}
+		mysql_free_result(res);
+		for (const auto& kv : wanted) {
+			auto it = stock.find(kv.first);
+			if (it == stock.end()) {
+				r.status = OrderSaveResult::GoodNotFound;
+				r.goodId = kv.first;
+				return r;
+			}
+			if (kv.second > it->second) {
+				r.status = OrderSaveResult::StockExceeded;
+				r.goodId = kv.first;
+				r.available = it->second;
+				r.requested = kv.second;
+				return r;
+			}
+		}
+	}
+
+	if (!DTBinsertOrderRows(c, o)) return r;
+
+	// 一条 UPDATE 扣减全部商品库存
+	std::string caseExpr;
+	std::string decIds;
+	size_t decCount = 0;
+	for (const auto& kv : wanted) {
+		if (kv.second <= 0) continue;
+		caseExpr += " WHEN " + std::to_string(kv.first) + " THEN " + std::to_string(kv.second);
+		if (!decIds.empty()) decIds += ",";
+		decIds += std::to_string(kv.first);
+		++decCount;
+	}
+	if (decCount > 0) {
+		std::string update = "UPDATE good SET stock = stock - CASE id" + caseExpr + " END WHERE id IN (" + decIds + ")";
+		if (countedQuery(c, update.c_str()) != 0) {
+			std::cerr << "MySQL update stock error: " << mysql_error(c) << " | Query: " << update << std::endl;
+			return r;
+		}
+		if (mysql_affected_rows(c) != decCount) {
+			std::cerr << "DTBsaveOrderWithStock: stock update affected " << mysql_affected_rows(c)
+				<< " rows, expected " << decCount << " (order_id=" << o.getOrderId() << ")" << std::endl;
+			return r;
+		}
+	}
+
+	if (!txn.commit()) return r;
+	r.status = OrderSaveResult::Ok;
+	return r;
+}
 bool DatabaseManager::DTBupdateOrder(const Order& o) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	TxnScope txn(lease.get());
+	if (!txn.begun()) return false;
 	std::string query = "UPDATE `order` SET "
 		"user_phone='" + o.getUserPhone() +
 		"', shipping_address='" + o.getShippingAddress() +
@@ -298,19 +1087,19 @@ bool DatabaseManager::DTBupdateOrder(const Order& o) {
 		" WHERE order_id='" + o.getOrderId() + "'";
 	if (!DTBexecuteQuery(query)) return false;
 	if (!DTBdeleteOrderItems(o.getOrderId())) return false;
-	for (const auto& item : o.getItems()) {
-		if (!DTBsaveOrderItem(item)) return false;
-	}
-	return true;
+	if (!DTBinsertOrderItemRows(lease.get(), o.getOrderId(), o.getItems())) return false;
+	return txn.commit();
 }
 bool DatabaseManager::DTBupdateOrderStatus(const std::string& order_id, int status) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "UPDATE `order` SET status=" + std::to_string(status) +
 		" WHERE order_id='" + order_id + "'";
 	return DTBexecuteQuery(query);
 }
 bool DatabaseManager::DTBloadOrder(const std::string& order_id, Order& o) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "SELECT order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy FROM `order` WHERE order_id='" + order_id + "'";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return false;
@@ -334,7 +1123,8 @@ bool DatabaseManager::DTBloadOrder(const std::string& order_id, Order& o) {
 	return false;
 }
 bool DatabaseManager::DTBdeleteOrder(const std::string& order_id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	if (!DTBdeleteOrderItems(order_id)) {
 		std::cerr << "Failed to delete order items for order " << order_id << std::endl;
 		return false;
@@ -344,7 +1134,8 @@ bool DatabaseManager::DTBdeleteOrder(const std::string& order_id) {
 }
 std::vector<Order> DatabaseManager::DTBloadOrdersByUser(const std::string& user_phone) {
 	std::vector<Order> orders;
-	if (!connection_) return orders;
+	ConnectionLease lease(this);
+	if (!lease) return orders;
 	std::string query = "SELECT order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy FROM `order` WHERE user_phone='" + user_phone + "'";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return orders;
@@ -359,15 +1150,16 @@ std::vector<Order> DatabaseManager::DTBloadOrdersByUser(const std::string& user_
 		o.setStatus(row[5] ? std::stoi(row[5]) : 0);
 		o.setShippingAddress(row[6] ? row[6] : "");
 		o.setDiscountPolicy(row[7] ? row[7] : "");
-		o.setItems(DTBloadOrderItems(o.getOrderId()));
 		orders.push_back(o);
 	}
 	mysql_free_result(result);
+	DTBattachOrderItems(orders);
 	return orders;
 }
 std::vector<Order> DatabaseManager::DTBloadOrdersByStatus(int status) {
 	std::vector<Order> orders;
-	if (!connection_) return orders;
+	ConnectionLease lease(this);
+	if (!lease) return orders;
 	std::string query = "SELECT order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy FROM `order` WHERE status=" + std::to_string(status);
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return orders;
@@ -382,15 +1174,16 @@ std::vector<Order> DatabaseManager::DTBloadOrdersByStatus(int status) {
 		o.setStatus(row[5] ? std::stoi(row[5]) : 0);
 		o.setShippingAddress(row[6] ? row[6] : "");
 		o.setDiscountPolicy(row[7] ? row[7] : "");
-		o.setItems(DTBloadOrderItems(o.getOrderId()));
 		orders.push_back(o);
 	}
 	mysql_free_result(result);
+	DTBattachOrderItems(orders);
 	return orders;
 }
 std::vector<Order> DatabaseManager::DTBloadRecentOrders(int limit) {
 	std::vector<Order> orders;
-	if (!connection_) return orders;
+	ConnectionLease lease(this);
+	if (!lease) return orders;
 	std::string query = "SELECT order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy FROM `order` ORDER BY order_id DESC LIMIT " + std::to_string(limit);
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return orders;
@@ -405,25 +1198,111 @@ std::vector<Order> DatabaseManager::DTBloadRecentOrders(int limit) {
 		o.setStatus(row[5] ? std::stoi(row[5]) : 0);
 		o.setShippingAddress(row[6] ? row[6] : "");
 		o.setDiscountPolicy(row[7] ? row[7] : "");
-		o.setItems(DTBloadOrderItems(o.getOrderId()));
+		orders.push_back(o);
+	}
+	mysql_free_result(result);
+	DTBattachOrderItems(orders);
+	return orders;
+}
+std::vector<Order> DatabaseManager::DTBloadOrdersPage(const std::string& afterOrderId, int limit, bool descending) {
+	std::vector<Order> orders;
+	if (limit <= 0) return orders;
+	ConnectionLease lease(this);
+	if (!lease) return orders;
+	std::string query = "SELECT order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy FROM `order`";
+	if (!afterOrderId.empty()) query += std::string(" WHERE order_id") + (descending ? " < '" : " > '") + escapeForSql(lease.get(), afterOrderId) + "'";
+	query += std::string(" ORDER BY order_id") + (descending ? " DESC" : "") + " LIMIT " + std::to_string(limit);
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return orders;
+	orders.reserve(static_cast<size_t>(mysql_num_rows(result)));
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		Order o;
+		o.setOrderId(row[0] ? row[0] : "");
+		o.setUserPhone(row[1] ? row[1] : "");
+		o.setTotalAmount(row[2] ? std::stod(row[2]) : 0.0);
+		o.setDiscountAmount(row[3] ? std::stod(row[3]) : 0.0);
+		o.setFinalAmount(row[4] ? std::stod(row[4]) : 0.0);
+		o.setStatus(row[5] ? std::stoi(row[5]) : 0);
+		o.setShippingAddress(row[6] ? row[6] : "");
+		o.setDiscountPolicy(row[7] ? row[7] : "");
+		orders.push_back(o);
+	}
+	mysql_free_result(result);
+	// 列表只需订单头，不再逐页读取订单项
+	return orders;
+}
+std::vector<Order> DatabaseManager::DTBqueryOrders(const OrderQuery& q, const std::string& afterOrderId, int limit, bool descending) {
+	std::vector<Order> orders;
+	if (limit <= 0) return orders;
+	ConnectionLease lease(this);
+	if (!lease) return orders;
+	std::vector<std::string> conds;
+	if (!q.userPhone.empty()) conds.push_back("user_phone = '" + escapeForSql(lease.get(), q.userPhone) + "'");
+	if (!q.statuses.empty()) {
+		std::string in = "status IN (";
+		for (size_t i = 0; i < q.statuses.size(); ++i) {
+			if (i) in += ",";
+			in += std::to_string(q.statuses[i]);
+		}
+		conds.push_back(in + ")");
+	}
+	if (q.hasTimeRange()) {
+		// 每个前缀一段主键范围（见 OrderQuery::idRange），范围条件的 OR 仍可走主键索引
+		std::string ranges;
+		for (const char* p = OrderQuery::OrderIdPrefixes; *p; ++p) {
+			std::string lower, upper;
+			q.idRange(*p, lower, upper);
+			if (!ranges.empty()) ranges += " OR ";
+			ranges += "(order_id >= '" + escapeForSql(lease.get(), lower) + "' AND order_id < '" + escapeForSql(lease.get(), upper) + "')";
+		}
+		conds.push_back("(" + ranges + ")");
+	}
+	if (!afterOrderId.empty()) conds.push_back(std::string("order_id") + (descending ? " < '" : " > '") + escapeForSql(lease.get(), afterOrderId) + "'");
+	std::string query = "SELECT order_id, user_phone, total_amount, discount_amount, final_amount, status, shipping_address, discount_policy FROM `order`";
+	for (size_t i = 0; i < conds.size(); ++i) query += (i ? " AND " : " WHERE ") + conds[i];
+	query += std::string(" ORDER BY order_id") + (descending ? " DESC" : "") + " LIMIT " + std::to_string(limit);
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return orders;
+	orders.reserve(static_cast<size_t>(mysql_num_rows(result)));
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		Order o;
+		o.setOrderId(row[0] ? row[0] : "");
+		o.setUserPhone(row[1] ? row[1] : "");
+		o.setTotalAmount(row[2] ? std::stod(row[2]) : 0.0);
+		o.setDiscountAmount(row[3] ? std::stod(row[3]) : 0.0);
+		o.setFinalAmount(row[4] ? std::stod(row[4]) : 0.0);
+		o.setStatus(row[5] ? std::stoi(row[5]) : 0);
+		o.setShippingAddress(row[6] ? row[6] : "");
+		o.setDiscountPolicy(row[7] ? row[7] : "");
 		orders.push_back(o);
 	}
 	mysql_free_result(result);
 	return orders;
 }
 bool DatabaseManager::DTBsaveOrderItem(const OrderItem& item) {
-	if (!connection_) return false;
-	std::string query = "INSERT INTO orderitem (order_id, good_id, good_name, price, quantity, subtotal) VALUES ('" +
-		item.getOrderId() + "', " +
-		std::to_string(item.getGoodId()) + ", '" +
-		item.getGoodName() + "', " +
-		std::to_string(item.getPrice()) + ", " +
-		std::to_string(item.getQuantity()) + ", " +
-		std::to_string(item.getSubtotal()) + ")";
-	return DTBexecuteQuery(query);
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	MYSQL_STMT* stmt = DTBprepared(STMT_SAVE_ORDER_ITEM);
+	if (!stmt) return false;
+	const int goodId = item.getGoodId();
+	const double price = item.getPrice();
+	const int quantity = item.getQuantity();
+	const double subtotal = item.getSubtotal();
+	MYSQL_BIND param[6];
+	unsigned long orderIdLen = 0, nameLen = 0;
+	bindParamString(param[0], item.getOrderId(), orderIdLen);
+	bindParamInt(param[1], goodId);
+	bindParamString(param[2], item.getGoodName(), nameLen);
+	bindParamDouble(param[3], price);
+	bindParamInt(param[4], quantity);
+	bindParamDouble(param[5], subtotal);
+	return DTBexecuteStatement(STMT_SAVE_ORDER_ITEM, stmt, param);
 }
 bool DatabaseManager::DTBupdateOrderItem(const OrderItem& item) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "UPDATE orderitem SET good_name='" + item.getGoodName() +
 		"', price=" + std::to_string(item.getPrice()) +
 		", quantity=" + std::to_string(item.getQuantity()) +
@@ -433,7 +1312,8 @@ bool DatabaseManager::DTBupdateOrderItem(const OrderItem& item) {
 }
 std::vector<OrderItem> DatabaseManager::DTBloadOrderItems(const std::string& order_id) {
 	std::vector<OrderItem> items;
-	if (!connection_) return items;
+	ConnectionLease lease(this);
+	if (!lease) return items;
 	std::string query = "SELECT order_id, good_id, good_name, price, quantity, subtotal FROM orderitem WHERE order_id='" + order_id + "'";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return items;
@@ -451,8 +1331,51 @@ std::vector<OrderItem> DatabaseManager::DTBloadOrderItems(const std::string& ord
 	mysql_free_result(result);
 	return items;
 }
+// 按批次读取多个订单的订单项（每批一条 IN 查询），按 order_id 分组返回
+std::map<std::string, std::vector<OrderItem>> DatabaseManager::DTBloadOrderItemsByOrders(const std::vector<std::string>& order_ids) {
+	std::map<std::string, std::vector<OrderItem>> grouped;
+	ConnectionLease lease(this);
+	if (!lease || order_ids.empty()) return grouped;
+	const size_t BatchSize = 500;
+	for (size_t begin = 0; begin < order_ids.size(); begin += BatchSize) {
+		size_t end = std::min(order_ids.size(), begin + BatchSize);
+		std::string inList;
+		for (size_t i = begin; i < end; ++i) {
+			if (i > begin) inList += ",";
+			inList += "'" + escapeForSql(lease.get(), order_ids[i]) + "'";
+		}
+		std::string query = "SELECT order_id, good_id, good_name, price, quantity, subtotal FROM orderitem WHERE order_id IN (" + inList + ")";
+		MYSQL_RES* result = DTBexecuteSelect(query);
+		if (!result) continue;
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(result))) {
+			OrderItem item;
+			item.setOrderId(row[0] ? row[0] : "");
+			item.setGoodId(row[1] ? std::stoi(row[1]) : 0);
+			item.setGoodName(row[2] ? row[2] : "");
+			item.setPrice(row[3] ? std::stod(row[3]) : 0.0);
+			item.setQuantity(row[4] ? std::stoi(row[4]) : 0);
+			item.setSubtotal(row[5] ? std::stod(row[5]) : 0.0);
+			grouped[item.getOrderId()].push_back(item);
+		}
+		mysql_free_result(result);
+	}
+	return grouped;
+}
+void DatabaseManager::DTBattachOrderItems(std::vector<Order>& orders) {
+	if (orders.empty()) return;
+	std::vector<std::string> ids;
+	ids.reserve(orders.size());
+	for (const auto& o : orders) ids.push_back(o.getOrderId());
+	std::map<std::string, std::vector<OrderItem>> grouped = DTBloadOrderItemsByOrders(ids);
+	for (auto& o : orders) {
+		auto it = grouped.find(o.getOrderId());
+		o.setItems(it != grouped.end() ? it->second : std::vector<OrderItem>());
+	}
+}
 bool DatabaseManager::DTBdeleteOrderItems(const std::string& order_id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "DELETE FROM orderitem WHERE order_id='" + order_id + "'";
 	return DTBexecuteQuery(query);
 }
@@ -460,7 +1383,8 @@ bool DatabaseManager::DTBdeleteOrderItems(const std::string& order_id) {
 //Cart
 
 bool DatabaseManager::DTBsaveTemporaryCart(const TemporaryCart& cart) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "INSERT INTO temporarycart (cart_id, user_phone, shipping_address, discount_policy, total_amount, discount_amount, final_amount, is_converted) VALUES ('" +
 		cart.cart_id + "', '" + cart.user_phone + "', '" + cart.shipping_address + "', '" + cart.discount_policy + "', " +
 		std::to_string(cart.total_amount) + ", " + std::to_string(cart.discount_amount) + ", " + std::to_string(cart.final_amount) +
@@ -475,7 +1399,8 @@ bool DatabaseManager::DTBsaveTemporaryCart(const TemporaryCart& cart) {
 	return true;
 }
 bool DatabaseManager::DTBupdateTemporaryCart(const TemporaryCart& cart) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "UPDATE temporarycart SET user_phone='" + cart.user_phone +
 		"', shipping_address='" + cart.shipping_address +
 		"', discount_policy='" + cart.discount_policy +
@@ -495,7 +1420,8 @@ bool DatabaseManager::DTBupdateTemporaryCart(const TemporaryCart& cart) {
 	return true;
 }
 bool DatabaseManager::DTBloadTemporaryCart(const std::string& cart_id, TemporaryCart& cart) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "SELECT cart_id, user_phone, shipping_address, discount_policy, total_amount, discount_amount, final_amount, is_converted FROM temporarycart WHERE cart_id='" + cart_id + "'";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return false;
@@ -517,14 +1443,16 @@ bool DatabaseManager::DTBloadTemporaryCart(const std::string& cart_id, Temporary
 	return false;
 }
 bool DatabaseManager::DTBdeleteTemporaryCart(const std::string& cart_id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	if (!DTBdeleteAllCartItems(cart_id)) return false;
 	std::string query = "DELETE FROM temporarycart WHERE cart_id='" + cart_id + "'";
 	return DTBexecuteQuery(query);
 }
 std::vector<TemporaryCart> DatabaseManager::DTBloadExpiredCarts() {
 	std::vector<TemporaryCart> carts;
-	if (!connection_) return carts;
+	ConnectionLease lease(this);
+	if (!lease) return carts;
 	std::string query = "SELECT cart_id, user_phone, shipping_address, discount_policy, total_amount, discount_amount, final_amount, is_converted FROM temporarycart WHERE is_converted=0 AND last_updated < NOW() - INTERVAL 1 DAY";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return carts;
@@ -546,23 +1474,29 @@ std::vector<TemporaryCart> DatabaseManager::DTBloadExpiredCarts() {
 	return carts;
 }
 bool DatabaseManager::DTBcleanupExpiredCarts() {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "DELETE FROM temporarycart WHERE is_converted=0 AND last_updated < NOW() - INTERVAL 1 DAY";
 	return DTBexecuteQuery(query);
 }
 bool DatabaseManager::DTBsaveCartItem(const CartItem& item, const std::string& cart_id) {
-	if (!connection_) return false;
-	std::string query = "INSERT INTO cartitem (cart_id, good_id, good_name, price, quantity, subtotal) VALUES ('" +
-		cart_id + "', " +
-		std::to_string(item.good_id) + ", '" +
-		item.good_name + "', " +
-		std::to_string(item.price) + ", " +
-		std::to_string(item.quantity) + ", " +
-		std::to_string(item.subtotal) + ")";
-	return DTBexecuteQuery(query);
+	ConnectionLease lease(this);
+	if (!lease) return false;
+	MYSQL_STMT* stmt = DTBprepared(STMT_SAVE_CART_ITEM);
+	if (!stmt) return false;
+	MYSQL_BIND param[6];
+	unsigned long cartIdLen = 0, nameLen = 0;
+	bindParamString(param[0], cart_id, cartIdLen);
+	bindParamInt(param[1], item.good_id);
+	bindParamString(param[2], item.good_name, nameLen);
+	bindParamDouble(param[3], item.price);
+	bindParamInt(param[4], item.quantity);
+	bindParamDouble(param[5], item.subtotal);
+	return DTBexecuteStatement(STMT_SAVE_CART_ITEM, stmt, param);
 }
 bool DatabaseManager::DTBupdateCartItem(const CartItem& item, const std::string& cart_id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "UPDATE cartitem SET good_name='" + item.good_name +
 		"', price=" + std::to_string(item.price) +
 		", quantity=" + std::to_string(item.quantity) +
@@ -571,74 +1505,146 @@ bool DatabaseManager::DTBupdateCartItem(const CartItem& item, const std::string&
 	return DTBexecuteQuery(query);
 }
 bool DatabaseManager::DTBdeleteCartItem(int good_id, const std::string& cart_id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "DELETE FROM cartitem WHERE cart_id='" + cart_id + "' AND good_id=" + std::to_string(good_id);
 	return DTBexecuteQuery(query);
 }
 bool DatabaseManager::DTBdeleteAllCartItems(const std::string& cart_id) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string query = "DELETE FROM cartitem WHERE cart_id='" + cart_id + "'";
 	return DTBexecuteQuery(query);
 }
+// 一次查询读取多个商品，返回 id -> Good（不存在的 id 不出现在结果中）
+std::map<int, Good> DatabaseManager::DTBloadGoodsByIds(const std::vector<int>& ids) {
+	std::map<int, Good> goods;
+	ConnectionLease lease(this);
+	if (!lease || ids.empty()) return goods;
+	std::string inList;
+	for (size_t i = 0; i < ids.size(); ++i) {
+		if (i > 0) inList += ",";
+		inList += std::to_string(ids[i]);
+	}
+	std::string query = "SELECT id, name, price, stock, category FROM good WHERE id IN (" + inList + ")";
+	MYSQL_RES* result = DTBexecuteSelect(query);
+	if (!result) return goods;
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		int id = std::stoi(row[0] ? row[0] : "0");
+		goods[id] = Good(id,
+			row[1] ? row[1] : "",
+			row[2] ? std::stod(row[2]) : 0.0,
+			row[3] ? std::stoi(row[3]) : 0,
+			row[4] ? row[4] : "");
+	}
+	mysql_free_result(result);
+	return goods;
+}
 std::vector<CartItem> DatabaseManager::DTBloadCartItems(const std::string& cart_id) {
-	if (!connection_) return std::vector<CartItem>();
+	ConnectionLease lease(this);
+	if (!lease) return std::vector<CartItem>();
 	std::vector<CartItem> items;
 	std::string query = "SELECT good_id, good_name, price, quantity, subtotal FROM cartitem WHERE cart_id='" + cart_id + "'";
 	MYSQL_RES* result = DTBexecuteSelect(query);
 	if (!result) return items;
+
+	// 先读出全部购物车行，再一次性查询引用到的商品，避免逐行 DTBloadGood
+	struct CartRow {
+		int goodId;
+		bool hasName, hasPrice, hasQuantity, hasSubtotal;
+		std::string name;
+		double price;
+		int quantity;
+		double subtotal;
+	};
+	std::vector<CartRow> rows;
+	std::vector<int> goodIds;
+	std::vector<int> staleIds;
 	MYSQL_ROW row;
 	while ((row = mysql_fetch_row(result))) {
 		int goodId = row[0] ? std::stoi(row[0]) : 0;
-		// 若 goodId 非法则跳过
+		// 若 goodId 非法则跳过，并在稍后删除该记录，避免重复问题
 		if (goodId <= 0) {
 			std::cerr << "DTBloadCartItems: invalid good_id in cartitem, skipping (cart_id=" << cart_id << ")" << std::endl;
-			// 尝试删除非法记录，避免重复问题
-			DTBdeleteCartItem(goodId, cart_id);
+			staleIds.push_back(goodId);
 			continue;
 		}
+		CartRow r;
+		r.goodId = goodId;
+		r.hasName = row[1] != nullptr;
+		r.name = row[1] ? row[1] : "";
+		r.hasPrice = row[2] != nullptr;
+		r.price = row[2] ? std::stod(row[2]) : 0.0;
+		r.hasQuantity = row[3] != nullptr;
+		r.quantity = row[3] ? std::stoi(row[3]) : 0;
+		r.hasSubtotal = row[4] != nullptr;
+		r.subtotal = row[4] ? std::stod(row[4]) : 0.0;
+		rows.push_back(r);
+		goodIds.push_back(goodId);
+	}
+	mysql_free_result(result);
 
-		// 检查对应的商品是否存在于 good 表
-		Good g;
-		if (!DTBloadGood(goodId, g)) {
+	// 检查对应的商品是否存在于 good 表
+	std::map<int, Good> goods = DTBloadGoodsByIds(goodIds);
+	for (const auto& r : rows) {
+		auto git = goods.find(r.goodId);
+		if (git == goods.end()) {
 			// 商品不存在：删除该购物车项并跳过（满足需求1/2）
-			std::cerr << "DTBloadCartItems: referenced good id " << goodId << " not found, deleting cartitem (cart_id=" << cart_id << ")" << std::endl;
-			DTBdeleteCartItem(goodId, cart_id);
+			std::cerr << "DTBloadCartItems: referenced good id " << r.goodId << " not found, deleting cartitem (cart_id=" << cart_id << ")" << std::endl;
+			staleIds.push_back(r.goodId);
 			continue;
 		}
-
+		const Good& g = git->second;
 		// 商品存在，构造 CartItem（优先使用 cartitem 表中的显示字段，但可用商品表数据作补充）
 		CartItem item{ Good(0, "", 0.0, 0, ""), 0 };
-		item.good_id = goodId;
-		item.good_name = row[1] ? row[1] : g.name; // 若 cartitem 中 name 为空则用 good 表的 name
-		item.price = row[2] ? std::stod(row[2]) : g.price;
-		item.quantity = row[3] ? std::stoi(row[3]) : 0;
-		item.subtotal = row[4] ? std::stod(row[4]) : (item.price * item.quantity);
+		item.good_id = r.goodId;
+		item.good_name = r.hasName ? r.name : g.name; // 若 cartitem 中 name 为空则用 good 表的 name
+		item.price = r.hasPrice ? r.price : g.price;
+		item.quantity = r.hasQuantity ? r.quantity : 0;
+		item.subtotal = r.hasSubtotal ? r.subtotal : (item.price * item.quantity);
 		items.push_back(item);
 	}
-	mysql_free_result(result);
+
+	if (!staleIds.empty()) {
+		std::string inList;
+		for (size_t i = 0; i < staleIds.size(); ++i) {
+			if (i > 0) inList += ",";
+			inList += std::to_string(staleIds[i]);
+		}
+		DTBexecuteQuery("DELETE FROM cartitem WHERE cart_id='" + cart_id + "' AND good_id IN (" + inList + ")");
+	}
 	return items;
 }
 bool DatabaseManager::DTBloadTemporaryCartByUserPhone(const std::string& userPhone, TemporaryCart& outCart) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	// 查找该 user_phone 最近的临时购物车（按 cart_id 倒序作为简单的“最近”策略）
-	std::string q = "SELECT cart_id, user_phone, shipping_address, discount_policy, total_amount, discount_amount, final_amount, is_converted "
-		"FROM temporarycart WHERE user_phone='" + userPhone + "' ORDER BY cart_id DESC LIMIT 1";
-	MYSQL_RES* res = DTBexecuteSelect(q);
-	if (!res) return false;
-	MYSQL_ROW row = mysql_fetch_row(res);
-	if (!row) {
-		mysql_free_result(res);
+	MYSQL_STMT* stmt = DTBprepared(STMT_LOAD_CART_BY_USER_PHONE);
+	if (!stmt) return false;
+	MYSQL_BIND param[1];
+	unsigned long phoneLen = 0;
+	bindParamString(param[0], userPhone, phoneLen);
+	if (!DTBexecuteStatement(STMT_LOAD_CART_BY_USER_PHONE, stmt, param)) return false;
+
+	StmtColumn col[8];
+	MYSQL_BIND res[8];
+	for (int i = 0; i < 4; ++i) bindResultString(res[i], col[i]);
+	for (int i = 4; i < 7; ++i) bindResultDouble(res[i], col[i]);
+	bindResultInt(res[7], col[7]);
+	if (mysql_stmt_bind_result(stmt, res) || !fetchRow(stmt)) {
+		mysql_stmt_free_result(stmt);
 		return false;
 	}
-	outCart.cart_id = row[0] ? row[0] : "";
-	outCart.user_phone = row[1] ? row[1] : userPhone;
-	outCart.shipping_address = row[2] ? row[2] : "";
-	outCart.discount_policy = row[3] ? row[3] : "";
-	outCart.total_amount = row[4] ? std::stod(row[4]) : 0.0;
-	outCart.discount_amount = row[5] ? std::stod(row[5]) : 0.0;
-	outCart.final_amount = row[6] ? std::stod(row[6]) : 0.0;
-	outCart.is_converted = row[7] ? (std::stoi(row[7]) != 0) : false;
-	mysql_free_result(res);
+	outCart.cart_id = columnString(stmt, col[0], 0);
+	outCart.user_phone = col[1].isNull ? userPhone : columnString(stmt, col[1], 1);
+	outCart.shipping_address = columnString(stmt, col[2], 2);
+	outCart.discount_policy = columnString(stmt, col[3], 3);
+	outCart.total_amount = col[4].isNull ? 0.0 : col[4].d;
+	outCart.discount_amount = col[5].isNull ? 0.0 : col[5].d;
+	outCart.final_amount = col[6].isNull ? 0.0 : col[6].d;
+	outCart.is_converted = col[7].isNull ? false : (col[7].i != 0);
+	mysql_stmt_free_result(stmt);
 
 	// 使用已有函数读取 cartitem
 	if (!outCart.cart_id.empty()) {
@@ -653,50 +1659,44 @@ bool DatabaseManager::DTBloadTemporaryCartByUserPhone(const std::string& userPho
 
 // ---------------- 促销策略（实现） ----------------
 
-static std::string escapeForSql(MYSQL* conn, const std::string& s) {
-    if (!conn) return s;
-    size_t maxLen = s.size() * 2 + 1;
-    char* buf = new char[maxLen];
-    unsigned long len = mysql_real_escape_string(conn, buf, s.c_str(), static_cast<unsigned long>(s.size()));
-    std::string out(buf, buf + len);
-    delete[] buf;
-    return out;
-}
-
 bool DatabaseManager::DTBsavePromotionStrategy(const std::string& name, const std::string& type,
     const std::string& config, const std::string& conditions) {
-    if (!connection_) return false;
-    std::string escName = escapeForSql(connection_, name);
-    std::string escPolicy = escapeForSql(connection_, config);
+    ConnectionLease lease(this);
+    if (!lease) return false;
+    std::string escName = escapeForSql(conn(), name);
+    std::string escPolicy = escapeForSql(conn(), config);
     // 目前表结构只存 policy_detail 与 name；保留 type/conditions 可扩展
     std::string q = "INSERT INTO promotionstrategy (name, policy_detail) VALUES ('" + escName + "', '" + escPolicy + "')";
-    if (mysql_query(connection_, q.c_str()) == 0) {
+    if (countedQuery(conn(), q.c_str()) == 0) {
         // 如果数据库有触发器或约束导致插入不真正生效，检查 affected rows
-        my_ulonglong affected = mysql_affected_rows(connection_);
+        my_ulonglong affected = mysql_affected_rows(conn());
         return affected > 0;
     } else {
-        std::cerr << "MySQL insert promotionstrategy error: " << mysql_error(connection_) << " | Query: " << q << std::endl;
+        std::cerr << "MySQL insert promotionstrategy error: " << mysql_error(conn()) << " | Query: " << q << std::endl;
         return false;
     }
 }
 
 bool DatabaseManager::DTBupdatePromotionStrategy(const std::string& name, bool /*is_active*/) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	// 当前表没有 is_active 字段；这里只提供占位逻辑（可根据实际表结构扩展）
 	std::cerr << "DTBupdatePromotionStrategy: table has no is_active column; no-op called for name=" << name << std::endl;
 	return true;
 }
 
 bool DatabaseManager::DTBdeletePromotionStrategy(const std::string& name) {
-	if (!connection_) return false;
+	ConnectionLease lease(this);
+	if (!lease) return false;
 	std::string q = "DELETE FROM promotionstrategy WHERE name = '" + name + "'";
 	return DTBexecuteQuery(q);
 }
 
 std::map<std::string, std::string> DatabaseManager::DTBloadPromotionStrategy(const std::string& name) {
     std::map<std::string, std::string> out;
-    if (!connection_) return out;
-    std::string escName = escapeForSql(connection_, name);
+    ConnectionLease lease(this);
+    if (!lease) return out;
+    std::string escName = escapeForSql(conn(), name);
     std::string q = "SELECT id, name, policy_detail FROM promotionstrategy WHERE name='" + escName + "' LIMIT 1";
     MYSQL_RES* res = DTBexecuteSelect(q);
     if (!res) return out;
@@ -712,7 +1712,8 @@ std::map<std::string, std::string> DatabaseManager::DTBloadPromotionStrategy(con
 
 std::vector<std::map<std::string, std::string>> DatabaseManager::DTBloadAllPromotionStrategies(bool /*active_only*/) {
  	std::vector<std::map<std::string, std::string>> out;
- 	if (!connection_) return out;
+ 	ConnectionLease lease(this);
+ 	if (!lease) return out;
  	std::string q = "SELECT id, name, policy_detail FROM promotionstrategy";
  	MYSQL_RES* res = DTBexecuteSelect(q);
  	if (!res) return out;
@@ -728,15 +1729,16 @@ std::vector<std::map<std::string, std::string>> DatabaseManager::DTBloadAllPromo
  	return out;
 }
 bool DatabaseManager::DTBupdatePromotionStrategyDetail(const std::string& name, const std::string& policy_detail) {
-    if (!connection_) return false;
-    std::string escName = escapeForSql(connection_, name);
-    std::string escPolicy = escapeForSql(connection_, policy_detail);
+    ConnectionLease lease(this);
+    if (!lease) return false;
+    std::string escName = escapeForSql(conn(), name);
+    std::string escPolicy = escapeForSql(conn(), policy_detail);
     std::string q = "UPDATE promotionstrategy SET policy_detail = '" + escPolicy + "' WHERE name = '" + escName + "'";
-    if (mysql_query(connection_, q.c_str()) == 0) {
-        my_ulonglong affected = mysql_affected_rows(connection_);
+    if (countedQuery(conn(), q.c_str()) == 0) {
+        my_ulonglong affected = mysql_affected_rows(conn());
         return affected > 0;
     } else {
-        std::cerr << "MySQL update promotionstrategy error: " << mysql_error(connection_) << " | Query: " << q << std::endl;
+        std::cerr << "MySQL update promotionstrategy error: " << mysql_error(conn()) << " | Query: " << q << std::endl;
         return false;
     }
 }
@@ -5,6 +5,9 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
 #include "user.h"
 #include "good.h"
 #include "order.h"
@@ -12,9 +15,12 @@
 #include "TemporaryCart.h"
 #include "cartItem.h"
 #include "PromotionStrategy.h"
+#include "Storage.h"
 #include <nlohmann/json.hpp>
 using nlohmann::json;
-class DatabaseManager {
+class TxnScope; // 定义见 databaseManager.cpp
+// MySQL 存储后端
+class DatabaseManager : public Storage {
 private:
     MYSQL* connection_;
     std::string host_;
@@ -25,76 +31,185 @@ private:
 
     bool DTBconnect();
     void DTBdisconnect();
+    MYSQL* DTBopenConnection();
     bool DTBexecuteQuery(const std::string& query);
     MYSQL_RES* DTBexecuteSelect(const std::string& query);
 
+    // 连接池（池化模式下启用，定义见 databaseManager.cpp）
+    struct Pool;
+    std::unique_ptr<Pool> pool_;
+    MYSQL* DTBacquire();
+    void DTBrelease(MYSQL* conn);
+    void DTBmaintainPool();
+    void DTBshutdownPool();
+
+    // 预处理语句缓存：每条连接各自缓存一组 MYSQL_STMT，首次使用时 prepare，连接关闭时一并释放
+    enum StmtId {
+        STMT_LOAD_GOOD,
+        STMT_LOAD_USER,
+        STMT_LOAD_CART_BY_USER_PHONE,
+        STMT_SAVE_ORDER_ITEM,
+        STMT_SAVE_CART_ITEM,
+        STMT_UPDATE_GOOD_STOCK,
+        STMT_COUNT
+    };
+    std::mutex stmtMutex_;
+    std::unordered_map<MYSQL*, std::vector<MYSQL_STMT*>> stmtCache_;
+    MYSQL_STMT* DTBprepared(StmtId id);
+    void DTBdropStatement(StmtId id);
+    // 执行已绑定参数的语句并缓冲结果；失败时输出错误并丢弃该语句（下次重新 prepare）
+    bool DTBexecuteStatement(StmtId id, MYSQL_STMT* stmt, MYSQL_BIND* params);
+    void DTBcloseConnection(MYSQL* conn);
+
+    // 为一组订单一次性填充订单项
+    void DTBattachOrderItems(std::vector<Order>& orders);
+
+    // 订单写入（需在事务内调用）
+    bool DTBinsertOrderRows(MYSQL* c, const Order& o);
+    bool DTBinsertOrderItemRows(MYSQL* c, const std::string& order_id, const std::vector<OrderItem>& items);
+
+    // 当前操作使用的连接：单连接模式下为 connection_，池化模式下为本线程租用的连接
+    MYSQL* conn() const;
+
+    // 租约：在一次 DTB* 调用期间持有一个连接，析构时归还；
+    // 同一线程内嵌套调用（如 DTBsaveOrder -> DTBsaveOrderItem）复用外层租约
+    class ConnectionLease {
+    public:
+        explicit ConnectionLease(DatabaseManager* owner);
+        ~ConnectionLease();
+        ConnectionLease(const ConnectionLease&) = delete;
+        ConnectionLease& operator=(const ConnectionLease&) = delete;
+        explicit operator bool() const { return conn_ != nullptr; }
+        MYSQL* get() const { return conn_; }
+    private:
+        DatabaseManager* owner_;
+        MYSQL* conn_ = nullptr;
+        bool acquired_ = false;
+        const DatabaseManager* prevOwner_ = nullptr;
+        MYSQL* prevConn_ = nullptr;
+    };
+
 public:
     DatabaseManager(const std::string& host, const std::string& user,
         const std::string& password, const std::string& database,
         unsigned int port = 3306);
-    ~DatabaseManager();
+    ~DatabaseManager() override;
 
     // 连接管理
-    bool DTBinitialize();
-    bool DTBisConnected() const;
+    bool DTBinitialize() override;
+    bool DTBisConnected() const override;
+    // 单连接模式下 MYSQL* 不能跨线程共享，只有池化模式可并发调用
+    bool DTBisThreadSafe() const override { return DTBisPooled(); }
+
+    // 连接池
+    // 需在并发使用前调用；size > 0 时切换为池化模式：最多 size 条连接，
+    // 每次 DTB* 调用租用一条，用完归还。空闲超过 idleCheckMs 的连接在租用前先 mysql_ping，
+    // 断开的连接由后台线程按 pingIntervalMs 周期探活并重连，请求线程不再同步重连。
+    // 已初始化的单连接会被关闭并替换为连接池。
+    void DTBsetPoolSize(int size, int leaseTimeoutMs = 3000, int pingIntervalMs = 30000, int idleCheckMs = 1000);
+    bool DTBisPooled() const { return pool_ != nullptr; }
+
+    struct PoolStats {
+        int capacity = 0;         // 池容量
+        int idle = 0;             // 空闲连接数
+        int inUse = 0;            // 已租出连接数
+        int broken = 0;           // 等待后台重连的连接数
+        uint64_t leases = 0;      // 成功租用次数
+        uint64_t waits = 0;       // 需要等待空闲连接的租用次数
+        uint64_t timeouts = 0;    // 租用失败次数（超时或无可用连接）
+        uint64_t reconnects = 0;  // 后台重连成功次数
+        uint64_t pingFailures = 0;// 探活失败次数
+        double totalWaitMs = 0.0; // 累计租用等待时间
+        double maxWaitMs = 0.0;   // 最长一次租用等待时间
+    };
+    PoolStats DTBpoolStats() const;
+
+    // 跨多次 DTB* 调用的事务：构造时租用一条连接并 START TRANSACTION，析构时若未提交则回滚。
+    // 存续期间本线程的 DTB* 调用复用该连接，其内部事务成为嵌套作用域，由这里统一提交/回滚
+    class Transaction : public Storage::Transaction {
+    public:
+        explicit Transaction(DatabaseManager* owner);
+        ~Transaction() override;
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+        // 连接与 START TRANSACTION 均成功
+        bool active() const override;
+        bool commit() override;
+    private:
+        std::unique_ptr<ConnectionLease> lease_;
+        std::unique_ptr<TxnScope> txn_;
+    };
+    std::unique_ptr<Storage::Transaction> DTBbeginTransaction() override;
 
     // 用户管理
-    bool DTBaddUser(const User& u); // 新增用户
-    bool DTBsaveUser(const User& u);
-    bool DTBupdateUser(const User& u);
-    bool DTBloadUser(const std::string& phone, User& u);
-    bool DTBdeleteUser(const std::string& phone);
-    std::vector<User> DTBloadAllUsers();
+    bool DTBaddUser(const User& u) override; // 新增用户
+    bool DTBsaveUser(const User& u) override;
+    bool DTBupdateUser(const User& u) override;
+    bool DTBloadUser(const std::string& phone, User& u) override;
+    bool DTBdeleteUser(const std::string& phone) override;
+    std::vector<User> DTBloadAllUsers() override;
+    std::vector<User> DTBloadUsersPage(const std::string& afterPhone, int limit, bool descending = false) override;
+    std::vector<User> DTBqueryUsers(const std::string& phone, const std::string& afterPhone, int limit, bool descending = false) override;
 
     // 商品管理
-    bool DTBsaveGood(const Good& g);
-    bool DTBupdateGood(const Good& g);
-    bool DTBloadGood(int id, Good& g);
-    bool DTBdeleteGood(int id);
-    std::vector<Good> DTBloadAllGoods();
-    std::vector<Good> DTBloadGoodsByCategory(const std::string& category);
-    bool DTBupdateGoodStock(int good_id, int new_stock);
+    bool DTBsaveGood(const Good& g, int* newId = nullptr) override; // newId 非空时返回自增 id
+    bool DTBupdateGood(const Good& g) override;
+    bool DTBloadGood(int id, Good& g) override;
+    bool DTBdeleteGood(int id) override;
+    std::vector<Good> DTBloadAllGoods(bool* ok = nullptr) override;
+    std::vector<Good> DTBloadGoodsPage(int afterId, int limit, bool descending = false) override;
+    std::vector<Good> DTBqueryGoods(const GoodsQuery& q, int afterId, int limit, bool descending = false) override;
+    std::vector<Good> DTBloadGoodsByCategory(const std::string& category) override;
+    std::map<int, Good> DTBloadGoodsByIds(const std::vector<int>& ids) override; // 单条 IN 查询
+    bool DTBupdateGoodStock(int good_id, int new_stock) override;
 
     // 订单管理
-    bool DTBsaveOrder(const Order& o);
-    bool DTBupdateOrder(const Order& o);
-    bool DTBupdateOrderStatus(const std::string& order_id, int status);
-    bool DTBloadOrder(const std::string& order_id, Order& o);
-    bool DTBdeleteOrder(const std::string& order_id);
-    std::vector<Order> DTBloadOrdersByUser(const std::string& user_phone);
-    std::vector<Order> DTBloadOrdersByStatus(int status);
-    std::vector<Order> DTBloadRecentOrders(int limit = 50);
+    bool DTBsaveOrder(const Order& o) override; // 订单头与订单项在同一事务内写入
+    // 结算下单：在一个事务内锁定并校验库存（SELECT ... FOR UPDATE）、写入订单与订单项、扣减库存，
+    // 往返次数与订单项数量无关
+    OrderSaveResult DTBsaveOrderWithStock(const Order& o) override;
+    bool DTBupdateOrder(const Order& o) override;
+    bool DTBupdateOrderStatus(const std::string& order_id, int status) override;
+    bool DTBloadOrder(const std::string& order_id, Order& o) override;
+    bool DTBdeleteOrder(const std::string& order_id) override;
+    std::vector<Order> DTBloadOrdersByUser(const std::string& user_phone) override;
+    std::vector<Order> DTBloadOrdersByStatus(int status) override;
+    std::vector<Order> DTBloadRecentOrders(int limit = 50) override;
+    std::vector<Order> DTBloadOrdersPage(const std::string& afterOrderId, int limit, bool descending = true) override;
+    std::vector<Order> DTBqueryOrders(const OrderQuery& q, const std::string& afterOrderId, int limit, bool descending = true) override;
 
     // 订单项管理
-    bool DTBsaveOrderItem(const OrderItem& item);
-    bool DTBupdateOrderItem(const OrderItem& item);
-    std::vector<OrderItem> DTBloadOrderItems(const std::string& order_id);
-    bool DTBdeleteOrderItems(const std::string& order_id);
+    bool DTBsaveOrderItem(const OrderItem& item) override;
+    bool DTBupdateOrderItem(const OrderItem& item) override;
+    std::vector<OrderItem> DTBloadOrderItems(const std::string& order_id) override;
+    // 批量读取多个订单的订单项（按 order_id 分组），避免逐订单查询
+    std::map<std::string, std::vector<OrderItem>> DTBloadOrderItemsByOrders(const std::vector<std::string>& order_ids) override;
+    bool DTBdeleteOrderItems(const std::string& order_id) override;
 
     // 临时购物车管理
  
-    bool DTBloadTemporaryCart(const std::string& cart_id, TemporaryCart& cart);
+    bool DTBloadTemporaryCart(const std::string& cart_id, TemporaryCart& cart) override;
     // 按用户手机号查找最新的临时购物车（返回 true 并填充 outCart 表示找到）
-    bool DTBloadTemporaryCartByUserPhone(const std::string & userPhone, TemporaryCart & outCart);
-    bool DTBdeleteTemporaryCart(const std::string& cart_id);
-    bool DTBsaveTemporaryCart(const TemporaryCart& cart);
-    bool DTBupdateTemporaryCart(const TemporaryCart& cart);
-    std::vector<TemporaryCart> DTBloadExpiredCarts();
-    bool DTBcleanupExpiredCarts();
+    bool DTBloadTemporaryCartByUserPhone(const std::string & userPhone, TemporaryCart & outCart) override;
+    bool DTBdeleteTemporaryCart(const std::string& cart_id) override;
+    bool DTBsaveTemporaryCart(const TemporaryCart& cart) override;
+    bool DTBupdateTemporaryCart(const TemporaryCart& cart) override;
+    std::vector<TemporaryCart> DTBloadExpiredCarts() override;
+    bool DTBcleanupExpiredCarts() override;
 
     // 购物车项管理
-    bool DTBsaveCartItem(const CartItem& item, const std::string& cart_id);
-    bool DTBupdateCartItem(const CartItem& item, const std::string& cart_id);
-    bool DTBdeleteCartItem(int good_id, const std::string& cart_id);
-    bool DTBdeleteAllCartItems(const std::string& cart_id);
-    std::vector<CartItem> DTBloadCartItems(const std::string& cart_id);
+    bool DTBsaveCartItem(const CartItem& item, const std::string& cart_id) override;
+    bool DTBupdateCartItem(const CartItem& item, const std::string& cart_id) override;
+    bool DTBdeleteCartItem(int good_id, const std::string& cart_id) override;
+    bool DTBdeleteAllCartItems(const std::string& cart_id) override;
+    std::vector<CartItem> DTBloadCartItems(const std::string& cart_id) override;
 
     // 促销策略
     bool DTBsavePromotionStrategy(const std::string& name, const std::string& type,
-        const std::string& config, const std::string& conditions = "");
-    bool DTBupdatePromotionStrategy(const std::string& name, bool is_active);
-    std::map<std::string, std::string> DTBloadPromotionStrategy(const std::string& name);
-    std::vector<std::map<std::string, std::string>> DTBloadAllPromotionStrategies(bool active_only = true);
-    bool DTBupdatePromotionStrategyDetail(const std::string& name, const std::string& policy_detail);
-    bool DTBdeletePromotionStrategy(const std::string& name);
+        const std::string& config, const std::string& conditions = "") override;
+    bool DTBupdatePromotionStrategy(const std::string& name, bool is_active) override;
+    std::map<std::string, std::string> DTBloadPromotionStrategy(const std::string& name) override;
+    std::vector<std::map<std::string, std::string>> DTBloadAllPromotionStrategies(bool active_only = true) override;
+    bool DTBupdatePromotionStrategyDetail(const std::string& name, const std::string& policy_detail) override;
+    bool DTBdeletePromotionStrategy(const std::string& name) override;
 };
\ No newline at end of file
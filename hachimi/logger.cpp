@@ -1,20 +1,121 @@
 #include "logger.h"
-#include <QTextCursor>
 #include <QDateTime>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <condition_variable>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 Logger& Logger::instance() {
     static Logger logger;
     return logger;
 }
 
+// 异步写线程与无锁有界队列（多生产者/单消费者，基于每槽位序号的环形缓冲）
+struct Logger::AsyncWriter {
+    struct Record {
+        Level level = Level::INFO;
+        qint64 msecs = 0;
+        std::string message;
+    };
+    struct Cell {
+        std::atomic<size_t> seq{ 0 };
+        Record rec;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{ 0 }; // 下一个写入位置（生产者）
+    alignas(64) std::atomic<size_t> tail{ 0 }; // 下一个读取位置（写线程）
+
+    OverflowPolicy policy = OverflowPolicy::Drop;
+    std::chrono::milliseconds fsyncInterval{ 1000 };
+
+    std::thread thread;
+    std::mutex waitMtx;
+    std::condition_variable wakeCv;    // 唤醒写线程
+    std::condition_variable drainedCv; // 通知 flush() 的等待者
+    std::condition_variable spaceCv;   // Block 策略：通知等待空槽位的生产者
+    int blockedProducers = 0;          // 正在等待空槽位的生产者数（受 waitMtx 保护）
+    std::atomic<bool> stopping{ false };
+    std::atomic<uint64_t> enqueued{ 0 };
+    std::atomic<uint64_t> written{ 0 };
+
+    explicit AsyncWriter(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        cells.reset(new Cell[cap]);
+        for (size_t i = 0; i < cap; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        mask = cap - 1;
+    }
+
+    // 成功时移走 rec 并返回 true；队列满返回 false（rec 不变）
+    bool tryPush(Record& rec) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells[pos & mask];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.rec = std::move(rec);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 仅写线程调用
+    bool tryPop(Record& out) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell& c = cells[pos & mask];
+        size_t seq = c.seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) return false;
+        out = std::move(c.rec);
+        c.seq.store(pos + mask + 1, std::memory_order_release);
+        tail.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void wake() { wakeCv.notify_one(); }
+};
+
+static void syncFileToDisk(std::FILE* f) {
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
 Logger::Logger() {
-    logFile.open("log.txt", std::ios::app);
+    logFile = std::fopen("log.txt", "a");
+    // 启动时可通过环境变量 HACHIMI_LOG 设置级别/采样，格式同 configure()
+    if (const char* spec = std::getenv("HACHIMI_LOG")) configure(spec);
 }
 
 Logger::~Logger() {
+    disableAsync();
     restoreCout();
-    if (logFile.is_open()) logFile.close();
+    if (logFile) {
+        std::fclose(logFile);
+        logFile = nullptr;
+    }
 }
 
 void Logger::setLogEdit(QPlainTextEdit* edit) {
@@ -25,25 +126,232 @@ void Logger::setLogEdit(QPlainTextEdit* edit) {
     }
 }
 
+std::string Logger::formatLine(Level level, const std::string& time, const std::string& message) {
+    std::string line;
+    line.reserve(time.size() + message.size() + 16);
+    line.append("[").append(time).append("][").append(levelToString(level)).append("] ").append(message).append("\n");
+    return line;
+}
+
+void Logger::writeToFile(const std::string& text, bool sync) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!logFile) return;
+    std::fwrite(text.data(), 1, text.size(), logFile);
+    std::fflush(logFile);
+    if (sync) syncFileToDisk(logFile);
+}
+
 void Logger::log(Level level, const std::string& message) {
-    // 先构造消息
-    std::string time = getCurrentTime();
-    std::string levelStr = levelToString(level);
-    std::string logMsg = "[" + time + "][" + levelStr + "] " + message + "\n";
-
-    // 写文件在锁内，emit 在锁外
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (logFile.is_open()) {
-            logFile << logMsg;
-            logFile.flush();
-        }
-    }
+    log(level, Subsystem::General, message);
+}
+
+void Logger::log(Level level, Subsystem subsystem, const std::string& message) {
+    if (!enabled(level, subsystem)) return;
+    if (asyncEnabled.load(std::memory_order_acquire) && enqueue(level, message)) return;
+
+    // 同步模式：先构造消息，写文件在锁内，emit 在锁外
+    std::string logMsg = formatLine(level, getCurrentTime(), message);
+    writeToFile(logMsg, false);
 
     // 将 std::string 转为 QString 后发出信号（不在锁内）
     emit logAppended(QString::fromStdString(logMsg));
 }
 
+// 异步入队：只记录时间戳与原始消息，格式化与 I/O 都在写线程完成。
+// 返回 false 表示异步模式已关闭，调用方改走同步路径。
+bool Logger::enqueue(Level level, const std::string& message) {
+    producers.fetch_add(1, std::memory_order_acq_rel);
+    if (!asyncEnabled.load(std::memory_order_acquire)) {
+        producers.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+    AsyncWriter& w = *writer;
+    AsyncWriter::Record rec;
+    rec.level = level;
+    rec.msecs = QDateTime::currentMSecsSinceEpoch();
+    rec.message = message;
+    bool pushed = w.tryPush(rec);
+    if (!pushed && w.policy == OverflowPolicy::Block) {
+        // 队列满：挂起等待写线程腾出槽位，而不是自旋占满一个核。
+        // 重试与登记都在 waitMtx 内，写线程取出记录后持同一把锁检查并通知，不会错过唤醒
+        std::unique_lock<std::mutex> lk(w.waitMtx);
+        ++w.blockedProducers;
+        while (!(pushed = w.tryPush(rec))) {
+            w.wakeCv.notify_one();
+            w.spaceCv.wait(lk);
+        }
+        --w.blockedProducers;
+    }
+    if (pushed) {
+        w.enqueued.fetch_add(1, std::memory_order_relaxed);
+        w.wake();
+    }
+    else {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    producers.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void Logger::enableAsync(size_t capacity, OverflowPolicy policy, int fsyncIntervalMs) {
+    if (asyncEnabled.load(std::memory_order_acquire)) return;
+    writer.reset(new AsyncWriter(capacity < 2 ? 2 : capacity));
+    writer->policy = policy;
+    writer->fsyncInterval = std::chrono::milliseconds(fsyncIntervalMs > 0 ? fsyncIntervalMs : 1000);
+
+    AsyncWriter* w = writer.get();
+    w->thread = std::thread([this, w]() {
+        const size_t maxBatch = 512;
+        auto lastSync = std::chrono::steady_clock::now();
+        bool unsynced = false;
+        AsyncWriter::Record rec;
+        std::string batch;
+        for (;;) {
+            batch.clear();
+            size_t n = 0;
+            while (n < maxBatch && w->tryPop(rec)) {
+                batch += formatLine(rec.level,
+                    QDateTime::fromMSecsSinceEpoch(rec.msecs).toString("yyyy-MM-dd HH:mm:ss").toStdString(),
+                    rec.message);
+                ++n;
+            }
+            if (n > 0 && w->policy == OverflowPolicy::Block) {
+                // 槽位已腾出：先放行等待的生产者，再做文件 I/O
+                std::lock_guard<std::mutex> lk(w->waitMtx);
+                if (w->blockedProducers > 0) w->spaceCv.notify_all();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (n > 0) {
+                unsynced = true;
+                bool doSync = now - lastSync >= w->fsyncInterval;
+                writeToFile(batch, doSync);
+                if (doSync) { lastSync = now; unsynced = false; }
+                emit logAppended(QString::fromStdString(batch));
+                w->written.fetch_add(n, std::memory_order_release);
+                std::lock_guard<std::mutex> lk(w->waitMtx);
+                w->drainedCv.notify_all();
+                continue; // 可能还有积压，继续取
+            }
+
+            if (unsynced && now - lastSync >= w->fsyncInterval) {
+                writeToFile(std::string(), true);
+                lastSync = now;
+                unsynced = false;
+            }
+            if (w->stopping.load(std::memory_order_acquire)) break;
+
+            std::unique_lock<std::mutex> lk(w->waitMtx);
+            // 超时兜底：生产者不持锁通知，可能错过一次唤醒
+            w->wakeCv.wait_for(lk, std::chrono::milliseconds(50));
+        }
+        if (unsynced) writeToFile(std::string(), true);
+    });
+    asyncEnabled.store(true, std::memory_order_release);
+}
+
+void Logger::disableAsync() {
+    if (!writer) return;
+    asyncEnabled.store(false, std::memory_order_release);
+    // 等待已进入 enqueue 的调用方完成入队，之后不会再有新记录
+    while (producers.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+    writer->stopping.store(true, std::memory_order_release);
+    writer->wake();
+    if (writer->thread.joinable()) writer->thread.join();
+    uint64_t lost = dropped.load(std::memory_order_relaxed);
+    writer.reset();
+    if (lost > 0) warn("Logger: async queue overflow dropped " + std::to_string(lost) + " records");
+}
+
+void Logger::flush() {
+    if (asyncEnabled.load(std::memory_order_acquire) && writer) {
+        AsyncWriter* w = writer.get();
+        uint64_t target = w->enqueued.load(std::memory_order_acquire);
+        w->wake();
+        std::unique_lock<std::mutex> lk(w->waitMtx);
+        w->drainedCv.wait(lk, [w, target] { return w->written.load(std::memory_order_acquire) >= target; });
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (logFile) std::fflush(logFile);
+}
+
+static const char* const kSubsystemNames[] = { "general", "server", "db", "client", "ui" };
+
+static bool parseLevelName(std::string name, Logger::Level& out) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (name == "debug") { out = Logger::Level::DEBUG; return true; }
+    if (name == "info") { out = Logger::Level::INFO; return true; }
+    if (name == "warn" || name == "warning") { out = Logger::Level::WARN; return true; }
+    if (name == "fail" || name == "error") { out = Logger::Level::FAIL; return true; }
+    return false;
+}
+
+static const char* severityName(int severity) {
+    switch (severity) {
+    case 0: return "debug";
+    case 2: return "warn";
+    case 3: return "fail";
+    default: return "info";
+    }
+}
+
+void Logger::setSubsystemLevel(Subsystem subsystem, Level level) {
+    if (subsystem == Subsystem::Count) return;
+    subsystemLevels[static_cast<int>(subsystem)].store(severity(level), std::memory_order_relaxed);
+}
+
+void Logger::clearSubsystemLevel(Subsystem subsystem) {
+    if (subsystem == Subsystem::Count) return;
+    subsystemLevels[static_cast<int>(subsystem)].store(-1, std::memory_order_relaxed);
+}
+
+bool Logger::configure(const std::string& spec) {
+    bool ok = true;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        const char* ws = " \t\r\n";
+        item.erase(0, item.find_first_not_of(ws));
+        item.erase(item.find_last_not_of(ws) + 1);
+        if (item.empty()) continue;
+
+        auto eq = item.find('=');
+        Level level;
+        if (eq == std::string::npos) {
+            if (parseLevelName(item, level)) setLevel(level); else ok = false;
+            continue;
+        }
+        std::string key = item.substr(0, eq);
+        std::string value = item.substr(eq + 1);
+        if (key == "sample") {
+            try { setRequestSampleRate(static_cast<uint32_t>(std::stoul(value))); }
+            catch (...) { ok = false; }
+            continue;
+        }
+        if (key == "database") key = "db";
+        int idx = -1;
+        for (int i = 0; i < static_cast<int>(Subsystem::Count); ++i) {
+            if (key == kSubsystemNames[i]) { idx = i; break; }
+        }
+        if (idx < 0) { ok = false; continue; }
+        if (value == "default") clearSubsystemLevel(static_cast<Subsystem>(idx));
+        else if (parseLevelName(value, level)) setSubsystemLevel(static_cast<Subsystem>(idx), level);
+        else ok = false;
+    }
+    return ok;
+}
+
+std::string Logger::describeConfig() const {
+    std::string out = severityName(globalLevel.load(std::memory_order_relaxed));
+    for (int i = 0; i < static_cast<int>(Subsystem::Count); ++i) {
+        int lv = subsystemLevels[i].load(std::memory_order_relaxed);
+        if (lv >= 0) out.append(",").append(kSubsystemNames[i]).append("=").append(severityName(lv));
+    }
+    out.append(",sample=").append(std::to_string(sampleEvery.load(std::memory_order_relaxed)));
+    return out;
+}
+
 std::string Logger::getCurrentTime() {
     return QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss").toStdString();
 }
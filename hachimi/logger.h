@@ -1,7 +1,14 @@
 #pragma once
+#ifdef HACHIMI_HEADLESS
+class QPlainTextEdit; // 无界面构建（hachimi-server）不链接 QtWidgets，这里只保存指针
+#else
 #include <QPlainTextEdit>
+#endif
 #include <mutex>
-#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <memory>
 #include <streambuf>
 #include <string>
 #include <QObject>
@@ -10,10 +17,38 @@ class Logger : public QObject {
     Q_OBJECT
 public:
     enum class Level { INFO, WARN, FAIL, DEBUG };
+    // 日志子系统：可分别设置级别，未单独设置时沿用全局级别
+    enum class Subsystem { General, Server, Database, Client, UI, Count };
+    // 异步模式下队列满时的处理：丢弃该条日志，或等待写线程腾出空间
+    enum class OverflowPolicy { Drop, Block };
 
     static Logger& instance();
 
     void log(Level level, const std::string& message);
+    void log(Level level, Subsystem subsystem, const std::string& message);
+
+    // 级别过滤：在构造日志字符串之前调用（LOG_* 宏已内置），开销仅为两次原子读
+    bool enabled(Level level, Subsystem subsystem = Subsystem::General) const {
+        int threshold = subsystemLevels[static_cast<int>(subsystem)].load(std::memory_order_relaxed);
+        if (threshold < 0) threshold = globalLevel.load(std::memory_order_relaxed);
+        return severity(level) >= threshold;
+    }
+    void setLevel(Level level) { globalLevel.store(severity(level), std::memory_order_relaxed); }
+    void setSubsystemLevel(Subsystem subsystem, Level level);
+    void clearSubsystemLevel(Subsystem subsystem);
+    // 请求/响应采样：每 n 个请求记录 1 个（n<=1 表示全部记录）
+    void setRequestSampleRate(uint32_t n) { sampleEvery.store(n < 1 ? 1 : n, std::memory_order_relaxed); }
+    uint32_t requestSampleRate() const { return sampleEvery.load(std::memory_order_relaxed); }
+    // 当前请求是否命中采样
+    bool sampleRequest() {
+        uint32_t n = sampleEvery.load(std::memory_order_relaxed);
+        return n <= 1 || sampleCounter.fetch_add(1, std::memory_order_relaxed) % n == 0;
+    }
+    // 文本配置，逗号分隔，例如 "warn,server=debug,db=info,sample=100"；
+    // 无 '=' 的项设置全局级别。返回 false 表示含无法识别的项（可识别的项仍生效）
+    bool configure(const std::string& spec);
+    // 当前配置（格式同 configure）
+    std::string describeConfig() const;
 
     void setLogEdit(QPlainTextEdit* edit); // 新增
 
@@ -22,6 +57,17 @@ public:
     void fail(const std::string& message) { log(Level::FAIL, message); }
     void debug(const std::string& message) { log(Level::DEBUG, message); }
 
+    // 异步模式：调用方只把记录放入无锁有界队列，后台线程批量写文件、
+    // 每 fsyncIntervalMs 毫秒 fsync 一次，并按批次发出 logAppended
+    void enableAsync(size_t capacity = 8192, OverflowPolicy policy = OverflowPolicy::Drop, int fsyncIntervalMs = 1000);
+    // 写完队列中剩余记录后回到同步模式
+    void disableAsync();
+    bool isAsync() const { return asyncEnabled.load(std::memory_order_acquire); }
+    // 阻塞直到此前入队的记录全部写入文件（同步模式下仅 fflush）
+    void flush();
+    // 异步模式下因队列满被丢弃的记录数
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
 signals:
     void logAppended(const QString& msg);
 
@@ -32,12 +78,37 @@ private:
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
-    std::ofstream logFile;
+    std::FILE* logFile = nullptr;
     std::mutex mtx;
     QPlainTextEdit* logEdit = nullptr; // 新增
 
+    // 级别数值：DEBUG < INFO < WARN < FAIL
+    static int severity(Level level) {
+        switch (level) {
+        case Level::DEBUG: return 0;
+        case Level::INFO: return 1;
+        case Level::WARN: return 2;
+        case Level::FAIL: return 3;
+        }
+        return 1;
+    }
+    std::atomic<int> globalLevel{ 1 }; // 默认 INFO
+    std::atomic<int> subsystemLevels[static_cast<int>(Subsystem::Count)] = { {-1}, {-1}, {-1}, {-1}, {-1} };
+    std::atomic<uint32_t> sampleEvery{ 1 };
+    std::atomic<uint64_t> sampleCounter{ 0 };
+
     std::string getCurrentTime();
     std::string levelToString(Level level);
+    std::string formatLine(Level level, const std::string& time, const std::string& message);
+    void writeToFile(const std::string& text, bool sync);
+
+    // 异步模式状态（队列与写线程，定义见 logger.cpp）
+    struct AsyncWriter;
+    std::unique_ptr<AsyncWriter> writer;
+    std::atomic<bool> asyncEnabled{ false };
+    std::atomic<int> producers{ 0 };   // 正在入队的调用方数量（关闭异步模式时等待其归零）
+    std::atomic<uint64_t> dropped{ 0 };
+    bool enqueue(Level level, const std::string& message);
 
     class QtLogStream : public std::streambuf {
     public:
@@ -55,4 +126,15 @@ private:
 public:
     void redirectCout(); // 新增
     void restoreCout();  // 新增
-};
\ No newline at end of file
+};
+
+// 惰性日志宏：级别未启用时不求值 message 表达式（不拼接字符串、不序列化 JSON）
+#define LOG_AT(level, subsystem, message) \
+    do { \
+        if (Logger::instance().enabled(Logger::Level::level, Logger::Subsystem::subsystem)) \
+            Logger::instance().log(Logger::Level::level, Logger::Subsystem::subsystem, (message)); \
+    } while (0)
+#define LOG_DEBUG(subsystem, message) LOG_AT(DEBUG, subsystem, message)
+#define LOG_INFO(subsystem, message) LOG_AT(INFO, subsystem, message)
+#define LOG_WARN(subsystem, message) LOG_AT(WARN, subsystem, message)
+#define LOG_FAIL(subsystem, message) LOG_AT(FAIL, subsystem, message)
@@ -13,6 +13,7 @@
 #include <QCoreApplication>
 #include <mysql.h>
 #include <iostream>
+#include <cstdlib>
 #include "admin.h"
 #include "AdminWindow.h"
 #include "cartItem.h"
@@ -43,9 +44,14 @@ int main(int argc, char* argv[])
 {
     QApplication app(argc, argv);
 
-    // 启动 Logger（确保先于窗口）
+    // 启动 Logger（确保先于窗口）；异步模式下请求处理线程不等待磁盘 I/O
+    Logger::instance().enableAsync(8192, Logger::OverflowPolicy::Drop, 1000);
     Logger::instance().info("应用启动");
 
+    // 可选的本地套接字端点（如 HACHIMI_LOCAL_SOCKET=/tmp/hachimi.sock）：Server 额外监听，Client 优先连接
+    const char* localSocketEnv = std::getenv("HACHIMI_LOCAL_SOCKET");
+    const std::string localSocket = localSocketEnv ? localSocketEnv : "";
+
     // —— 改动：尝试探测本地 127.0.0.1:8888 是否已经有 Server 在监听 —— //
     bool serverAlreadyRunning = false;
     {
@@ -63,19 +69,44 @@ int main(int argc, char* argv[])
     if (!serverAlreadyRunning) {
         // 没有检测到已有 Server，当前进程启动本地 Server
         serverPtr = new Server(8888);
+        // 请求处理线程池：I/O 线程只负责收发，业务处理（含数据库访问）在工作线程中执行
+        int workers = QThread::idealThreadCount();
+        if (workers < 2) workers = 2;
+        if (workers > 8) workers = 8;
+        serverPtr->SERsetWorkerThreads(workers);
+        serverPtr->SERsetDatabasePoolSize(workers);
+        // 指标导出为可选项（如 HACHIMI_METRICS_FILE=metrics.prom），未设置时不在工作目录写文件
+        if (const char* metricsEnv = std::getenv("HACHIMI_METRICS_FILE")) {
+            if (*metricsEnv) serverPtr->SERsetMetricsExport(metricsEnv, 15000);
+        }
+        serverPtr->SERsetLocalSocket(localSocket);
         serverThread = new QThread();
         serverPtr->moveToThread(serverThread);
-        QObject::connect(serverThread, &QThread::started, serverPtr, &Server::SERstart);
         QObject::connect(serverThread, &QThread::finished, serverPtr, &QObject::deleteLater);
         serverThread->start();
+        // 在 Server 线程上同步执行 SERstart：返回时监听与进程内通道均已就绪，
+        // 随后创建的 Client 能找到进程内通道而不是退回 TCP
+        QMetaObject::invokeMethod(serverPtr, [serverPtr]() { serverPtr->SERstart(); }, Qt::BlockingQueuedConnection);
         Logger::instance().info("本地 Server 已启动 (127.0.0.1:8888) 于专用线程");
     } else {
         Logger::instance().info("检测到已有本地 Server 监听 127.0.0.1:8888，跳过启动");
     }
     // —— 改动结束 —— //
 
-    // 启动 Client 并连接到本地 Server
+    // 启动 Client 并连接到本地 Server（本进程启动的 Server 自动走进程内通道，否则走 TCP）
     Client client; // 使用默认参数 127.0.0.1:8888
+    client.CLTsetLocalSocket(localSocket);
+    // 可选的二进制响应编码（HACHIMI_WIRE_ENCODING=cbor|msgpack），默认文本 JSON 便于调试
+    if (const char* encEnv = std::getenv("HACHIMI_WIRE_ENCODING")) {
+        WireEncoding enc;
+        if (WireFrame::parseEncoding(encEnv, enc)) client.CLTsetEncoding(enc);
+        else Logger::instance().warn(std::string("未知的 HACHIMI_WIRE_ENCODING: ") + encEnv);
+    }
+    // 可选的响应压缩（HACHIMI_WIRE_COMPRESSION=最小字节数，0 关闭），适用于经慢速链路连接远端 Server
+    if (const char* zEnv = std::getenv("HACHIMI_WIRE_COMPRESSION")) {
+        try { client.CLTsetCompression(static_cast<size_t>(std::stoul(zEnv))); }
+        catch (...) { Logger::instance().warn(std::string("无效的 HACHIMI_WIRE_COMPRESSION: ") + zEnv); }
+    }
     if (!client.CLTconnectToServer()) {
         Logger::instance().warn("Client 无法连接到 Server，继续启动 UI（部分功能不可用）");
     }
@@ -217,5 +248,7 @@ int main(int argc, char* argv[])
     }
 
     Logger::instance().info("应用退出\n");
+    // 写完队列中剩余日志
+    Logger::instance().disableAsync();
     return ret;
 }